@@ -17,12 +17,17 @@
 #include "cn24/util/Config.h"
 #include "cn24/util/Dataset.h"
 #include "cn24/util/Tensor.h"
+#include "cn24/util/TensorAllocator.h"
+#include "cn24/util/WorkerPool.h"
+#include "cn24/util/Transport.h"
+#include "cn24/util/RingAllReduce.h"
 #include "cn24/util/CompressedTensor.h"
 #include "cn24/util/TensorViewer.h"
 #include "cn24/util/CombinedTensor.h"
 #include "cn24/util/TensorStream.h"
 #include "cn24/util/CompressedTensorStream.h"
 #include "cn24/util/FloatTensorStream.h"
+#include "cn24/util/ByteTensorStream.h"
 #include "cn24/util/ListTensorStream.h"
 #include "cn24/util/PNGUtil.h"
 #include "cn24/util/JPGUtil.h"
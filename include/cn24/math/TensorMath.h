@@ -22,6 +22,16 @@
 
 namespace Conv {
 
+/**
+ * @brief Activation functions that can be fused into other operations.
+ */
+enum ActivationFunction {
+  ACTIVATION_NONE,
+  ACTIVATION_RELU,
+  ACTIVATION_TANH,
+  ACTIVATION_SIGMOID
+};
+
 class TensorMath {
 public:
   static void GEMM(
@@ -60,6 +70,36 @@ public:
     const int smY,
     const int incY);
   
+  /**
+   * @brief Computes batch independent GEMMs. GEMM number b works on the
+   *  matrices that start strideX elements after those of number b - 1.
+   *
+   * On the CPU, the batch is spread over the threads if it is large enough
+   * to keep all of them busy. Otherwise each GEMM is threaded by itself.
+   */
+  static void GEMM_BATCHED(
+    const bool is_row_major,
+    const bool transpose_A,
+    const bool transpose_B,
+    const int M,
+    const int N,
+    const int K,
+    const datum alpha,
+    const Tensor& A,
+    const int smA,
+    const int ldA,
+    const int strideA,
+    const Tensor& B,
+    const int smB,
+    const int ldB,
+    const int strideB,
+    const datum beta,
+    Tensor& C,
+    const int smC,
+    const int ldC,
+    const int strideC,
+    const int batch);
+  
   static void IM2COL(
     const Tensor& source,
     const int source_width,
@@ -88,6 +128,173 @@ public:
     const int pad_height,
     const Tensor& target);
   
+  /**
+   * @brief Computes C = alpha * A * P + beta * C without materializing P.
+   *
+   * P are the rows of IM2COL(source) that belong to the input maps
+   * [first_map, first_map + group_maps). A is M x (kernel size * group_maps).
+   * C is stored like a convolution output: the M rows of each sample are
+   * the maps [first_map_C, first_map_C + M) of that sample of C.
+   */
+  static void IM2COL_GEMM(
+    const int M,
+    const datum alpha,
+    const Tensor& A,
+    const int smA,
+    const int ldA,
+    const Tensor& source,
+    const int source_width,
+    const int source_height,
+    const int maps,
+    const int samples,
+    const int kernel_width,
+    const int kernel_height,
+    const int stride_width,
+    const int stride_height,
+    const int pad_width,
+    const int pad_height,
+    const int first_map,
+    const int group_maps,
+    const datum beta,
+    Tensor& C,
+    const int first_map_C);
+  
+  /**
+   * @brief Computes C = alpha * A * P^T + beta * C without materializing P.
+   *
+   * P is defined like in IM2COL_GEMM. A is stored like a convolution output,
+   * its M rows are the maps [first_map_A, first_map_A + M) of each sample.
+   */
+  static void IM2COL_GEMM_T(
+    const int M,
+    const datum alpha,
+    const Tensor& A,
+    const int first_map_A,
+    const Tensor& source,
+    const int source_width,
+    const int source_height,
+    const int maps,
+    const int samples,
+    const int kernel_width,
+    const int kernel_height,
+    const int stride_width,
+    const int stride_height,
+    const int pad_width,
+    const int pad_height,
+    const int first_map,
+    const int group_maps,
+    const datum beta,
+    Tensor& C,
+    const int smC,
+    const int ldC);
+  
+  /**
+   * @brief Computes the input maps [first_map, first_map + group_maps) of
+   *  COL2IM(alpha * A^T * B) without materializing A^T * B.
+   *
+   * A is K x (kernel size * group_maps). B is stored like a convolution
+   * output, its K rows are the maps [first_map_B, first_map_B + K) of each
+   * sample. The maps of target are overwritten.
+   */
+  static void GEMM_COL2IM(
+    const int K,
+    const datum alpha,
+    const Tensor& A,
+    const int smA,
+    const int ldA,
+    const Tensor& B,
+    const int first_map_B,
+    Tensor& target,
+    const int target_width,
+    const int target_height,
+    const int maps,
+    const int samples,
+    const int kernel_width,
+    const int kernel_height,
+    const int stride_width,
+    const int stride_height,
+    const int pad_width,
+    const int pad_height,
+    const int first_map,
+    const int group_maps);
+
+  /**
+   * @brief Winograd F(4x4, 3x3) input transform.
+   *
+   * The target holds 36 matrices of maps x (samples * tiles_y * tiles_x),
+   * one for each element of the 6x6 transformed tiles. Tile (tx, ty)
+   * starts at pixel (4 * tx + offset_x, 4 * ty + offset_y) of the source,
+   * pixels outside of it are zero.
+   */
+  static void WINOGRAD_INPUT(
+    const Tensor& source,
+    const int source_width,
+    const int source_height,
+    const int maps,
+    const int samples,
+    const int offset_x,
+    const int offset_y,
+    const int tiles_x,
+    const int tiles_y,
+    Tensor& target);
+
+  /**
+   * @brief Winograd F(4x4, 3x3) output transform.
+   *
+   * Inverse of WINOGRAD_INPUT for 4x4 output tiles starting at
+   * (4 * tx, 4 * ty). The target is overwritten with alpha * (result + bias),
+   * bias may be nullptr.
+   */
+  static void WINOGRAD_OUTPUT(
+    const Tensor& source,
+    const int tiles_x,
+    const int tiles_y,
+    const datum alpha,
+    const Tensor* bias,
+    Tensor& target,
+    const int target_width,
+    const int target_height,
+    const int maps,
+    const int samples);
+
+  /**
+   * @brief Transforms an output gradient in 4x4 tiles for
+   *  WINOGRAD_FILTER_GRADIENT, using the tiling of WINOGRAD_OUTPUT.
+   */
+  static void WINOGRAD_DELTA(
+    const Tensor& source,
+    const int source_width,
+    const int source_height,
+    const int maps,
+    const int samples,
+    const int tiles_x,
+    const int tiles_y,
+    Tensor& target);
+
+  /**
+   * @brief Transforms 3x3 kernels to 36 output_maps x input_maps matrices.
+   *
+   * If flip is set, the kernels are rotated by 180 degrees and stored as
+   * input_maps x output_maps matrices, which convolves output gradients
+   * back to input gradients.
+   */
+  static void WINOGRAD_FILTER(
+    const Tensor& weights,
+    const int output_maps,
+    const int input_maps,
+    const bool flip,
+    Tensor& target);
+
+  /**
+   * @brief Transforms a gradient w.r.t. the output of WINOGRAD_FILTER back
+   *  to a gradient w.r.t. the 3x3 kernels, overwriting the target.
+   */
+  static void WINOGRAD_FILTER_GRADIENT(
+    const Tensor& source,
+    const int output_maps,
+    const int input_maps,
+    Tensor& target);
+
   static void SETSAMPLE(
     Tensor& A,
     const int smA,
@@ -119,6 +326,57 @@ public:
     const Tensor& source_a,
     const Tensor& source_b,
     Tensor& target);
+  
+  /**
+   * @brief Computes target = exp(source) elementwise.
+   */
+  static void EXP(
+    const Tensor& source,
+    Tensor& target);
+  
+  /**
+   * @brief Computes target = f(scale * source + offset) elementwise, source
+   *  may be target.
+   *
+   * Uses vectorized approximations of tanh and sigmoid unless
+   * TensorMathKernels::SetExactMath is enabled.
+   */
+  static void ACTIVATION(
+    const Tensor& source,
+    const ActivationFunction activation,
+    Tensor& target,
+    const datum scale = 1.0,
+    const datum offset = 0.0);
+  
+  /**
+   * @brief Computes target = f(target + alpha * bias) in place for the
+   *  samples [first_sample, first_sample + samples) of target.
+   *
+   * bias holds one value per map of target and may be nullptr.
+   */
+  static void BIAS_ACTIVATION(
+    const Tensor* bias,
+    const datum alpha,
+    const ActivationFunction activation,
+    Tensor& target,
+    const int first_sample,
+    const int samples);
+  
+  /**
+   * @brief Backward pass of BIAS_ACTIVATION over all samples.
+   *
+   * Computes delta = output_delta * f'(x) from the activated output and
+   * sums it over the samples and pixels of each map into bias_delta. For
+   * ACTIVATION_NONE, delta is not written and bias_delta is the sum of
+   * output_delta. delta may be nullptr if only the bias gradient is needed,
+   * bias_delta may be nullptr as well.
+   */
+  static void ACTIVATION_GRADIENT(
+    const Tensor& output,
+    const Tensor& output_delta,
+    const ActivationFunction activation,
+    Tensor* delta,
+    Tensor* bias_delta);
 };
   
 }
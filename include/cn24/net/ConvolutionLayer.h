@@ -19,13 +19,44 @@
 #include <sstream>
 #include <string>
 
+#include "../math/TensorMath.h"
 #include "Layer.h"
 #include "SimpleLayer.h"
 
 namespace Conv {
 
+class FFTConvolution;
+class QuantizedConvolution;
+
 class ConvolutionLayer : public SimpleLayer {
 public:
+  /**
+   * @brief Ways to compute the convolution.
+   *
+   * IM2COL materializes the patch matrix and is the reference. IMPLICIT
+   * gathers patches inside the GEMM instead, saving the im2col buffers.
+   * WINOGRAD uses F(4x4, 3x3) transforms and needs 3x3 kernels, stride 1
+   * and group 1. It needs 4 instead of 9 multiplications per output, but
+   * is less precise: outputs and gradients agree with IM2COL to a relative
+   * error of about 1e-3 instead of 1e-5. FFT multiplies zero padded
+   * spectra, so its cost hardly depends on the kernel size. It needs
+   * stride 1 and group 1. POINTWISE handles 1x1 kernels with stride 1,
+   * no padding and group 1, including fully connected layers. The input
+   * already is the patch matrix, so it runs GEMMs directly on the input
+   * and output tensors without any buffers. AUTO picks POINTWISE for
+   * layers that support it, WINOGRAD for large enough layers, FFT for
+   * kernels of 5x5 and up if a cost estimate favors it and IM2COL
+   * otherwise.
+   */
+  enum ConvolutionEngine {
+    ENGINE_AUTO,
+    ENGINE_IM2COL,
+    ENGINE_IMPLICIT,
+    ENGINE_WINOGRAD,
+    ENGINE_FFT,
+    ENGINE_POINTWISE
+  };
+  
   /**
    * @brief Constructs a ConvolutionLayer.
    * 
@@ -44,12 +75,7 @@ public:
   
   explicit ConvolutionLayer(std::string configuration);
   
-  ~ConvolutionLayer() {
-    if(weights_ != nullptr)
-      delete weights_;
-    if(bias_ != nullptr)
-      delete bias_;
-  }
+  ~ConvolutionLayer();
   
   // Implementations for SimpleLayer
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
@@ -57,8 +83,67 @@ public:
   bool Connect (const CombinedTensor* input, CombinedTensor* output);
   void FeedForward();
   void BackPropagate();
+  bool NeedsOutputForBackprop() { return activation_ != ACTIVATION_NONE; }
+  bool IsRecomputable() { return dropout_fraction_ == 0; }
   
   void OnLayerConnect (const std::vector<Layer*> next_layer);
+  void OnParametersChanged() {
+    winograd_weights_valid_ = false;
+    winograd_flipped_weights_valid_ = false;
+    fft_weights_valid_ = false;
+    quantized_weights_valid_ = false;
+  }
+  
+  /**
+   * @brief Selects the convolution engine. Has to be called before Connect.
+   */
+  void SetEngine (const ConvolutionEngine engine) { requested_engine_ = engine; }
+  ConvolutionEngine GetEngine() const { return engine_; }
+  
+  /**
+   * @brief Parses an engine name as used in the "engine=" option.
+   * @returns False if the name is unknown
+   */
+  static bool ParseEngine (const std::string& name, ConvolutionEngine& engine);
+  static const char* GetEngineName (const ConvolutionEngine engine);
+  
+  /**
+   * @brief Selects an activation function that is applied to the output
+   *  together with the bias. Has to be called before Connect.
+   *
+   * The backward pass computes the activation gradient from the output and
+   * sums up the bias gradient in the same pass.
+   */
+  void SetActivation (const ActivationFunction activation) { activation_ = activation; }
+  ActivationFunction GetActivation() const { return activation_; }
+  
+  /**
+   * @brief Parses an activation name as used in the "activation=" option.
+   * @returns False if the name is unknown
+   */
+  static bool ParseActivation (const std::string& name, ActivationFunction& activation);
+  static const char* GetActivationName (const ActivationFunction activation);
+  
+  /**
+   * @brief Runs the forward pass in 8 bit integers while testing.
+   *
+   * Inputs are saturated to [-range, range] and quantized to 255 levels,
+   * kernels are quantized per output map. A range of zero switches back
+   * to the regular engine. The backward pass is not supported.
+   */
+  void SetQuantization (const datum range) { quantization_range_ = range; }
+  datum GetQuantization() const { return quantization_range_; }
+  
+  /**
+   * @brief Records the largest absolute input of the following forward
+   *  passes. Enabling resets the recorded range.
+   */
+  void SetCalibrationEnabled (const bool enabled) {
+    calibrating_ = enabled;
+    if(enabled)
+      calibration_range_ = 0;
+  }
+  datum GetCalibrationRange() const { return calibration_range_; }
   
   inline unsigned int Gain() {
     return kernel_width_ * kernel_height_ * input_maps_;
@@ -66,19 +151,67 @@ public:
 
 	inline std::string GetLayerDescription() {
 		std::ostringstream ss;
-		ss << "Convolutional Layer (" << output_maps_ << " kernels @ " << kernel_width_ << "x" << kernel_height_ << ")";
+		ss << "Convolutional Layer (" << output_maps_ << " kernels @ " << kernel_width_ << "x" << kernel_height_;
+		if(activation_ != ACTIVATION_NONE)
+			ss << ", " << GetActivationName(activation_);
+		ss << ")";
 		return ss.str();
 	}
   
   bool IsOpenCLAware();
 private:
+  ConvolutionEngine SelectEngine(const unsigned int samples);
+  bool SupportsWinograd() const;
+  bool SupportsFFT() const;
+  bool SupportsPointwise() const;
+  
+  // Bias and fused activation of the GEMM based engines, see ones_
+  void AddBias(const datum alpha, const unsigned int first_sample, const unsigned int samples);
+  void BiasGradient();
+  
   Tensor im2col_ff_buffer;
   Tensor sms_ff_buffer;
   Tensor sms2_bp_buffer;
   Tensor bp_deltax_buffer;
   
+  // IM2COL engine without the sms buffers, see Connect
+  bool direct_output_ = false;
+  
+  // Winograd engine, each tensor holds one matrix per sample
+  Tensor winograd_input_buffer_;
+  Tensor winograd_product_buffer_;
+  Tensor winograd_bp_input_buffer_;
+  Tensor winograd_bp_product_buffer_;
+  Tensor winograd_weights_;
+  Tensor winograd_flipped_weights_;
+  Tensor winograd_weights_delta_;
+  bool winograd_weights_valid_ = false;
+  bool winograd_flipped_weights_valid_ = false;
+  unsigned int output_tiles_x_ = 0;
+  unsigned int output_tiles_y_ = 0;
+  unsigned int input_tiles_x_ = 0;
+  unsigned int input_tiles_y_ = 0;
+  
+  // FFT engine, keeps the kernel spectra until the weights change
+  FFTConvolution* fft_ = nullptr;
+  bool fft_weights_valid_ = false;
+  
+  // 8 bit inference, see SetQuantization
+  QuantizedConvolution* quantized_ = nullptr;
+  bool quantized_weights_valid_ = false;
+  bool quantized_forward_ = false;
+  datum quantization_range_ = 0;
+  bool calibrating_ = false;
+  datum calibration_range_ = 0;
+  
+  // Sums up the Winograd bias gradient over all tiles. OpenCL builds also
+  // add the bias and sum up its gradient with it, see AddBias
   Tensor ones_;
   
+  // Fused activation and the gradient w.r.t. its input
+  ActivationFunction activation_ = ACTIVATION_NONE;
+  Tensor activation_delta_;
+  
   unsigned int input_maps_ = 0;
   unsigned int output_maps_ = 0;
   
@@ -105,6 +238,9 @@ private:
   unsigned int pad_height_ = 0;
   unsigned int group_ = 0;
   datum dropout_fraction_ = 0.0;
+  
+  ConvolutionEngine requested_engine_ = ENGINE_AUTO;
+  ConvolutionEngine engine_ = ENGINE_IM2COL;
 };
 
 }
@@ -18,6 +18,10 @@
 #include <vector>
 #include <random>
 #include <iostream>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 #include "Layer.h"
 #include "TrainingLayer.h"
@@ -40,7 +44,28 @@ public:
 			const datum loss_sampling_p = 1.0,
       const unsigned int seed = 0
 		    );
+  ~DatasetInputLayer();
   
+  /**
+   * @brief Only selects the training samples whose index is shard modulo
+   *  shards, so processes training together see different samples.
+   *  Batches that were already prefetched are dropped.
+   */
+  void SetShard (unsigned int shard, unsigned int shards);
+
+  /**
+   * @brief Loads training batches in the background while the net works on
+   *  the current one. The samples are the same as without prefetching.
+   *  Batches that were already prefetched are dropped, so the samples
+   *  selected for them are skipped.
+   *
+   * @param depth The number of batches to load ahead, zero disables
+   *  prefetching
+   * @param loaders The number of threads loading batches. Each batch is
+   *  loaded by one thread, the Dataset may decode its samples in parallel.
+   */
+  void SetPrefetching (unsigned int depth, unsigned int loaders = 1);
+
   // Implementations for Layer
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                       std::vector< CombinedTensor* >& outputs);
@@ -98,11 +123,59 @@ private:
   unsigned int current_element_ = 0;
 
   unsigned int current_element_testing_ = 0;
+
+  // Prefetching
+  struct PrefetchSlot {
+    Tensor data;
+    Tensor label;
+    Tensor helper;
+    Tensor weight;
+    std::vector<unsigned int> elements;
+    std::vector<std::vector<bool>> dropped_blocks;
+    bool loaded = false;
+  };
+  std::vector<PrefetchSlot> slots_;
+  unsigned int next_slot_ = 0;
+  unsigned int reserved_slots_ = 0;
+  std::vector<std::thread> loaders_;
+  std::mutex prefetch_mutex_;
+  std::condition_variable batch_queued_;
+  std::condition_variable batch_loaded_;
+  std::deque<unsigned int> batch_queue_;
+  bool loader_failed_ = false;
+  bool shutdown_ = false;
   
   /**
    * @brief Clears the permutation vector and generates a new one.
    */
   void RedoPermutation();
+
+  /**
+   * @brief Selects the next training sample from the permutation.
+   */
+  unsigned int SelectTrainingSample();
+
+  /**
+   * @brief Decides which blocks of the weight map are left out by loss
+   *  sampling.
+   */
+  void DrawLossSampling (std::vector<bool>& dropped_blocks);
+
+  /**
+   * @brief Copies a batch from the Dataset and applies loss sampling.
+   */
+  bool LoadBatch (Tensor& data, Tensor& label, Tensor& helper, Tensor& weight,
+                  const std::vector<unsigned int>& elements, bool testing,
+                  const std::vector<std::vector<bool>>& dropped_blocks);
+
+  /**
+   * @brief Selects the samples of the next batch and queues it for the
+   *  loader threads.
+   */
+  void ReserveSlot();
+  void FeedPrefetched();
+  void StopPrefetching();
+  void Load();
 };
 
 }
@@ -39,6 +39,7 @@ public:
   bool Connect (const CombinedTensor* input, CombinedTensor* output);
   void FeedForward();
   void BackPropagate();
+  bool NeedsOutputForBackprop() { return false; }
   
   inline unsigned int Gain() {
     return gain / (region_width_ * region_height_);
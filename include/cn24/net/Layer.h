@@ -89,6 +89,14 @@ public:
     backprop_enabled_ = backprop_enabled;
   }
 
+  /**
+   * @brief Makes CreateOutputs and Connect leave out deltas and buffers
+   *  that only BackPropagate uses. See NetStatus::SetInferenceOnly.
+   */
+  inline void SetInferenceOnly (const bool inference_only) {
+    inference_only_ = inference_only;
+  }
+
   /**
    * @brief This is called by the net when this layer has a child layer.
    */
@@ -98,6 +106,14 @@ public:
 			gain += next_layer->Gain();
   }
 
+  /**
+   * @brief This is called when the parameters were changed from outside of
+   *  the layer, e.g. by the Trainer or when loading a model.
+   *
+   * Layers that cache data derived from their parameters discard it here.
+   */
+  virtual void OnParametersChanged() {}
+
   /**
    * @brief Returns the layer's gain
    */
@@ -112,6 +128,33 @@ public:
    */
   virtual bool IsOpenCLAware() { return false; }
   
+  /**
+   * @brief Returns true if the layer can run in place, i.e. with its output
+   *  sharing the CombinedTensor of its only input.
+   *
+   * FeedForward then overwrites the input data and BackPropagate has to
+   * compute the input gradient from the output alone. NetGraph decides
+   * whether a layer actually runs in place, see NetGraph::InitializeNode.
+   */
+  virtual bool IsInPlaceCapable() { return false; }
+  
+  /**
+   * @brief Returns true if BackPropagate reads the data of the outputs.
+   *
+   * In-place layers overwrite the output data of the layer before them, so
+   * they only run in place after layers that return false here.
+   */
+  virtual bool NeedsOutputForBackprop() { return true; }
+
+  /**
+   * @brief Returns true if FeedForward gives the same outputs every time
+   *  it runs on the same inputs.
+   *
+   * NetGraph only discards the outputs of such layers when checkpointing,
+   * because it recomputes them during BackPropagate.
+   */
+  virtual bool IsRecomputable() { return true; }
+  
   /**
    * @brief Returns true if the layer should be ignored during gradient checks
    */
@@ -138,6 +181,11 @@ protected:
    */
   bool backprop_enabled_ = true;
 
+  /**
+   * @brief This boolean is set when BackPropagate will never be called.
+   */
+  bool inference_only_ = false;
+
   unsigned int gain = 0;
   
   /**
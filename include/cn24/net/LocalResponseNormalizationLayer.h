@@ -39,6 +39,7 @@ public:
   bool Connect(const CombinedTensor* input, CombinedTensor* output);
   void FeedForward();
   void BackPropagate();
+  bool NeedsOutputForBackprop() { return false; }
   
   std::string GetLayerDescription() { return "Local Response Normalization Layer"; }
   void CreateBufferDescriptors(std::vector< NetGraphBuffer >& buffers) {
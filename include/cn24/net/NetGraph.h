@@ -19,9 +19,12 @@
 #include "../util/CombinedTensor.h"
 #include "NetStatus.h"
 #include "../util/TensorViewer.h"
+#include "../util/WorkerPool.h"
 
 #include "StatLayer.h"
 
+#include <functional>
+#include <memory>
 #include <vector>
 
 namespace Conv {
@@ -50,11 +53,107 @@ public:
 	CombinedTensor* combined_tensor = nullptr;
 };
 
+enum CheckpointingMode {
+  CHECKPOINTING_OFF,
+  // Only the outputs of nodes marked as checkpoints are kept
+  CHECKPOINTING_MANUAL,
+  // Every n-th output is kept, n being the square root of the number of
+  // outputs that can be recomputed
+  CHECKPOINTING_AUTO
+};
+
+struct CheckpointingStats {
+  // Bytes in outputs that are discarded after use
+  std::size_t bytes_recomputable = 0;
+  // Most of these bytes that were held at the same time during a pass
+  std::size_t bytes_peak = 0;
+  double pass_seconds = 0;
+  double recompute_seconds = 0;
+  unsigned long recomputed_nodes = 0;
+
+  std::size_t bytes_saved() const {
+    return bytes_recomputable - bytes_peak;
+  }
+
+  // Time spent recomputing relative to the passes without it
+  double recompute_overhead() const {
+    return pass_seconds > recompute_seconds ? recompute_seconds / (pass_seconds - recompute_seconds) : 0;
+  }
+};
+
 class NetGraph : public NetStatus {
 public:
 	// Graph manipulation
 	void AddNode(NetGraphNode* node);
 	void Initialize();
+  
+  /**
+   * @brief Lets in-place capable layers share the buffer of their input,
+   *  see InitializeNode. Has to be called before Initialize.
+   */
+  void SetInPlaceEnabled(bool enabled) { inplace_enabled_ = enabled; }
+
+  /**
+   * @brief Runs up to this many independent nodes at the same time, see
+   *  RunScheduled. With one thread, which is the default, the nodes run
+   *  one at a time in depth-first order.
+   */
+  void SetSchedulerThreads(unsigned int threads);
+
+  /**
+   * @brief Calls the function after the backward pass of every node. The
+   *  gradients of the node's parameters are complete then. With the
+   *  scheduler, the function is called from several threads at once.
+   */
+  void SetBackPropagationCallback(std::function<void(NetGraphNode*)> callback) {
+    backpropagation_callback_ = callback;
+  }
+
+  /**
+   * @brief Places the hidden output buffers in one shared arena, where
+   *  buffers that are never alive at the same time use the same memory,
+   *  see PlanMemory. The graph can only run forward then. Has to be called
+   *  before Initialize.
+   */
+  void SetMemoryPlanningEnabled(bool enabled) { memory_planning_enabled_ = enabled; }
+
+  /**
+   * @brief Keeps the outputs of hidden nodes packed in a 16 bit format
+   *  while no layer works on them, see Tensor::Pack. Deltas stay unpacked.
+   */
+  void SetStoragePrecision(TensorPrecision precision);
+
+  /**
+   * @brief Discards hidden outputs after the forward pass is done with
+   *  them and recomputes them from the nearest kept output when the
+   *  backward pass needs them. Has to be called after Initialize.
+   *
+   * Outputs of input and output nodes, outputs read by loss layers and
+   * outputs of layers that are not recomputable are always kept.
+   */
+  void SetCheckpointing(CheckpointingMode mode);
+  inline CheckpointingMode GetCheckpointing() const { return checkpointing_; }
+  inline const CheckpointingStats& GetCheckpointingStats() const { return checkpointing_stats_; }
+  void ResetCheckpointingStats();
+
+  /**
+   * @brief Makes all convolutional layers record their input ranges,
+   *  see ConvolutionLayer::SetCalibrationEnabled.
+   */
+  void SetCalibrationEnabled(bool enabled);
+
+  /**
+   * @brief Runs the convolutional layers in 8 bit integers while testing,
+   *  using the recorded input ranges. See ConvolutionLayer::SetQuantization.
+   */
+  void SetQuantizationEnabled(bool enabled);
+
+  /**
+   * @brief Writes and reads the recorded input ranges, one line per
+   *  convolutional layer. Reading enables quantization for these layers.
+   */
+  void SerializeCalibration(std::ostream& output);
+  bool DeserializeCalibration(std::istream& input);
 
 	// Node queries
 	inline std::vector<NetGraphNode*>& GetOutputNodes() { return output_nodes_; }
@@ -90,6 +189,16 @@ private:
 	void FeedForward(NetGraphNode* node);
 	void BackPropagate(NetGraphNode* node);
 	void InitializeNode(NetGraphNode* node);
+  bool CanRunInPlace(NetGraphNode* node) const;
+  void PlanMemory();
+  void OrderNode(NetGraphNode* node, std::vector<NetGraphNode*>& order);
+  bool CanSchedule();
+  void BuildSchedule();
+  void RunScheduled(bool backward);
+  void PackIfUnused(CombinedTensor* tensor, bool after_backprop);
+  void DiscardIfUnused(CombinedTensor* tensor, bool after_backprop);
+  void Recompute(CombinedTensor* tensor);
+  void SetResident(CombinedTensor* tensor, bool resident);
   void InitializeWeights(NetGraphNode* node);
 	std::vector<NetGraphNode*> nodes_;
 
@@ -102,6 +211,36 @@ private:
 
 	int last_uid = -1;
   bool layerview_enabled_ = false;
+  bool inplace_enabled_ = true;
+  TensorPrecision storage_precision_ = PRECISION_FP32;
+  bool memory_planning_enabled_ = false;
+  bool memory_planned_ = false;
+  Tensor memory_arena_;
+
+  struct RecomputableBuffer {
+    CombinedTensor* tensor;
+    // The nodes that write to the tensor, in the order they run
+    std::vector<NetGraphNode*> writers;
+    bool resident;
+  };
+  RecomputableBuffer* FindRecomputable(CombinedTensor* tensor);
+  CheckpointingMode checkpointing_ = CHECKPOINTING_OFF;
+  std::vector<RecomputableBuffer> recomputable_;
+  std::size_t bytes_resident_ = 0;
+  CheckpointingStats checkpointing_stats_;
+
+  struct ScheduledNode {
+    // Number of nodes that have to be done first and the nodes waiting for
+    // this one, as indices into nodes_
+    unsigned int dependencies = 0;
+    std::vector<unsigned int> dependents;
+  };
+  std::unique_ptr<WorkerPool> worker_pool_;
+  std::vector<ScheduledNode> forward_schedule_;
+  std::vector<ScheduledNode> backward_schedule_;
+  bool schedule_built_ = false;
+  bool schedule_warned_ = false;
+  std::function<void(NetGraphNode*)> backpropagation_callback_;
   TensorViewer viewer;
 };
 
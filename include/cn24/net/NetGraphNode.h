@@ -54,6 +54,9 @@ public:
 	bool is_output = false;
 	bool is_input = false;
 
+	// Keeps its outputs when checkpointing, see NetGraph::SetCheckpointing
+	bool is_checkpoint = false;
+
 	// Status
 	bool initialized = false;
 
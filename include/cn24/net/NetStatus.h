@@ -36,8 +36,22 @@ public:
     is_testing_ = is_testing;
     System::stat_aggregator->hardcoded_stats_.is_training = !is_testing;
   }
+
+  /**
+   * @brief Returns true if the net never runs a backward pass
+   */
+  inline bool IsInferenceOnly() const { return is_inference_only_; }
+
+  /**
+   * @brief Lets the layers leave out deltas and everything else that only
+   *  the backward pass needs. Has to be set before the layers are connected.
+   */
+  inline void SetInferenceOnly(bool is_inference_only) {
+    is_inference_only_ = is_inference_only;
+  }
 private:
 	bool is_testing_ = false;
+	bool is_inference_only_ = false;
 };
 }
 
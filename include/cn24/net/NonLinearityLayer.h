@@ -53,6 +53,9 @@ public:
   bool Connect (const CombinedTensor* input, CombinedTensor* output);
   virtual void FeedForward() = 0;
   virtual void BackPropagate() = 0;
+  
+  // The input gradient only depends on the output
+  bool IsInPlaceCapable() { return true; }
 
 };
 
@@ -39,6 +39,7 @@ public:
   bool Connect (const CombinedTensor* input, CombinedTensor* output);
   void FeedForward();
   void BackPropagate();
+  bool NeedsOutputForBackprop() { return false; }
   bool IsOpenCLAware();
 
 	inline std::string GetLayerDescription() {
@@ -27,6 +27,7 @@ public:
                 const NetStatus* status );
   void FeedForward();
   void BackPropagate();
+  bool NeedsOutputForBackprop() { return false; }
 
   std::string GetLayerDescription() { return "Sum Layer"; }
   void CreateBufferDescriptors(std::vector< NetGraphBuffer >& buffers) {
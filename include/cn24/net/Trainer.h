@@ -16,9 +16,14 @@
 #define CONV_TRAINER_H
 
 #include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
 
 #include "../util/CombinedTensor.h"
 #include "../util/StatAggregator.h"
+#include "../util/WorkerPool.h"
+#include "../util/RingAllReduce.h"
 #include "TrainingLayer.h"
 #include "NetGraph.h"
 
@@ -46,6 +51,15 @@ public:
   unsigned int pbatchsize = 1;
   unsigned int sbatchsize = 1;
   unsigned int iterations = 500;
+  TensorPrecision storage_precision = PRECISION_FP32;
+  CheckpointingMode checkpointing = CHECKPOINTING_OFF;
+  unsigned int scheduler_threads = 1;
+  unsigned int replicas = 1;
+  unsigned int processes = 1;
+  TransportType transport = TRANSPORT_SHM;
+  unsigned int transport_port = 29400;
+  unsigned int prefetch = 2;
+  unsigned int loaders = 1;
 };
 
 class Trainer {
@@ -58,6 +72,26 @@ public:
 	*/
   Trainer (NetGraph& graph, TrainerSettings settings);
 
+  /**
+	* @brief Adds a replica of the net that trains on its own samples in its
+	*  own thread. The passes of a batch are split between the net and its
+	*  replicas and their gradients are summed before each update.
+	*
+	* @param replica A net built from the same configuration, with its own
+	*  training layer. It uses the parameters of the trained net.
+	*/
+  void AddReplica (NetGraph& replica);
+
+  /**
+	* @brief Trains together with the other processes of the Transport. Each
+	*  process has its own samples, the passes of a batch are split between
+	*  all processes and the gradients are summed over all processes. The
+	*  summing starts during the backward pass of the last pass.
+	*
+	* @param transport Ring of processes that all use the same settings
+	*/
+  void SetTransport (Transport& transport);
+
   /**
 	* @brief Train the net for the specified number of epochs
 	*
@@ -110,7 +144,17 @@ public:
 
 private:
   void ApplyGradients (datum lr);
+  void RunPasses (unsigned int replica, datum* loss_sums, datum& aggregate_loss);
+  void ReduceGradients();
+  void ShareParameters();
+  void SynchronizeParameters();
+  void OnBackPropagated (NetGraphNode* node);
+  void EnqueueReadyGradients();
+  void SumGradients();
   void InitializeStats();
+  void UpdateAllocatorStats();
+  void UpdateCheckpointingStats();
+  void UpdateDecompressionStats();
 
   // References for easy access
   NetGraph& graph_;
@@ -118,6 +162,20 @@ private:
   std::vector<Tensor*> last_deltas_;
   std::vector<Tensor*> last_gradients_;
   std::vector<Tensor*> accumulated_gradients_;
+
+  // Replicas with their gradients, the pool has a worker for every net
+  std::vector<NetGraph*> replicas_;
+  std::vector<std::vector<Tensor*>> replica_gradients_;
+  std::unique_ptr<WorkerPool> replica_pool_;
+
+  // Other processes, gradients are queued for summing in reverse order as
+  // soon as they are complete
+  std::unique_ptr<RingAllReduce> all_reduce_;
+  std::map<NetGraphNode*, unsigned int> first_parameter_;
+  std::vector<bool> gradient_ready_;
+  unsigned int gradients_queued_ = 0;
+  std::mutex gradient_mutex_;
+  bool last_pass_ = false;
   
 	// Saved pointers
 	TrainingLayer* first_training_layer_ = nullptr;
@@ -142,6 +200,11 @@ private:
   static StatDescriptor* stat_qp_caseM_;
   static StatDescriptor* stat_fps_;
   static StatDescriptor* stat_sps_;
+  static StatDescriptor* stat_allocations_;
+  static StatDescriptor* stat_memory_peak_;
+  static StatDescriptor* stat_checkpoint_saved_;
+  static StatDescriptor* stat_recompute_overhead_;
+  static StatDescriptor* stat_decompression_;
 };
 
 
@@ -0,0 +1,86 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file ByteTensorStream.h
+ * @brief TensorStream of tensors stored as one byte per value.
+ *
+ * Each tensor is stored as its samples, width, height and maps (uint64),
+ * a scale and an offset (double) and then one byte k per element,
+ * representing scale * k + offset. Images and one-hot labels need a
+ * quarter of the space of a FloatTensorStream this way. The whole file is
+ * memory mapped and converted to floats when a sample is copied.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_BYTETENSORSTREAM_H
+#define CONV_BYTETENSORSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <iostream>
+#include <vector>
+
+#include "Log.h"
+#include "Config.h"
+
+#include "Tensor.h"
+#include "TensorStream.h"
+
+#define CN24_BTS_MAGIC 0xC24CC24CC24CC248
+
+namespace Conv {
+
+class ByteTensorStream : public TensorStream {
+public:
+  ~ByteTensorStream();
+
+  // TensorStream implementations
+  std::size_t GetWidth(unsigned int index) { return index < tensors_.size() ? tensors_[index].width : 0; }
+  std::size_t GetHeight(unsigned int index) { return index < tensors_.size() ? tensors_[index].height : 0; }
+  std::size_t GetMaps(unsigned int index) { return index < tensors_.size() ? tensors_[index].maps : 0; }
+  std::size_t GetSamples(unsigned int index) { return index < tensors_.size() ? tensors_[index].samples : 0; }
+  unsigned int GetTensorCount() { return tensors_.size(); }
+  unsigned int LoadFile(std::string path);
+  bool CopySample(const unsigned int source_index, const std::size_t source_sample, Tensor& target, const std::size_t target_sample);
+
+  bool IsThreadSafe() { return true; }
+
+  /**
+   * @brief Writes the tensor in the format of this stream. Values that are
+   *  all DATUM_FROM_UCHAR of a byte or all bytes are stored exactly,
+   *  everything else is mapped linearly from its range to 0..255.
+   *
+   * @param output The output stream, after the magic number
+   * @param tensor The tensor to write
+   * @returns True if the tensor was stored exactly
+   */
+  static bool Serialize(std::ostream& output, Tensor& tensor);
+
+private:
+  struct ByteTensor {
+    std::size_t samples;
+    std::size_t width;
+    std::size_t height;
+    std::size_t maps;
+    datum scale;
+    datum offset;
+    const std::uint8_t* data;
+  };
+
+  std::vector<ByteTensor> tensors_;
+
+  // Either the memory mapped file or a copy of it
+  void* mapping_ = nullptr;
+  std::size_t mapping_length_ = 0;
+  std::vector<std::uint8_t> buffer_;
+};
+
+}
+
+#endif
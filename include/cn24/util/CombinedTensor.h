@@ -30,17 +30,20 @@ public:
    * place.
    * 
    * Contract:
-   * Code can expect the delta and data Tensors to have the same shape.
+   * Code can expect the delta and data Tensors to have the same shape,
+   * unless the delta was left out for an inference-only net.
    * Code must _not_ reshape only one of the Tensors.
    *
    * @see Tensor.h for size parameter documentation
+   * @param with_delta Allocate the delta Tensor, too
    */
   explicit CombinedTensor (const std::size_t samples,
                            const std::size_t width = 1,
                            const std::size_t height = 1,
-                           const std::size_t maps = 1) :
+                           const std::size_t maps = 1,
+                           const bool with_delta = true) :
     data (samples, width, height, maps),
-    delta (samples, width, height, maps) {}
+    delta (with_delta ? samples : 0, width, height, maps) {}
 
   Tensor data;
   Tensor delta;
@@ -9,6 +9,7 @@
 #define CONV_COMPRESSEDTENSOR_H
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <iostream>
 
@@ -19,6 +20,13 @@
 
 namespace Conv {
 
+enum CompressionCodec {
+  // Byte-level run length encoding, the only codec of version 1 streams
+  CODEC_RLE,
+  // Independently compressed blocks of LZ-coded bytes, see CompressBlocks
+  CODEC_BLOCK
+};
+
 class CompressedTensor;
 /**
  * @brief Prints size to the ostream, may be helpful.
@@ -37,15 +45,30 @@ public:
   /*
    * Compression and decompression encapsulated
    */
-  void Compress(Tensor& tensor);
+  void Compress(Tensor& tensor, CompressionCodec codec = CODEC_RLE);
   void Decompress(Tensor& tensor, datum* preallocated_memory = nullptr);
 
+  /**
+   * @brief Decompresses into memory for elements() datums. Does not change
+   *  the CompressedTensor, so several threads can do this at once. Blocks
+   *  of CODEC_BLOCK tensors are decompressed in parallel.
+   */
+  void Decompress(datum* target) const;
 
   /**
-   * @brief Serializes the CompressedTensor to the stream.
+   * @brief Checks if every value is scale * k for a byte k, bit by bit,
+   *  with the scale of DATUM_FROM_UCHAR or of integer labels.
+   *
+   * @param scale Set to the matching scale
+   * @returns True if the values can be stored as bytes exactly
+   */
+  static bool FindByteScale(const datum* data, const std::size_t elements, datum& scale);
+
+  /**
+   * @brief Serializes the CompressedTensor to the stream. The header
+   *  depends on the codec, see Deserialize.
    *
    * @param output The output stream
-   * @param convert Convert to byte
    */
   void Serialize (std::ostream& output);
 
@@ -57,8 +80,11 @@ public:
    * @param head_only Set to true to only read the dimensions
    * @param try_mmap Set to true to attempt to memory map the file
    * @param fd File descriptor for the SAME file as input's underlying
+   * @param codec The codec of the tensors in the stream, CODEC_RLE for
+   *  version 1 streams and CODEC_BLOCK for version 2 streams
    */
-  void Deserialize (std::istream& input, bool head_only = false, bool try_mmap = false, int fd = 0);
+  void Deserialize (std::istream& input, bool head_only = false, bool try_mmap = false, int fd = 0,
+                    CompressionCodec codec = CODEC_RLE);
   
 	/**
 	 * @brief Writes some tensor statistics to the debug output
@@ -89,6 +115,9 @@ public:
   inline std::size_t compressed_length() const {
     return compressed_length_;
   }
+  inline CompressionCodec codec() const {
+    return codec_;
+  }
 
 private:
   /**
@@ -110,9 +139,18 @@ private:
   std::size_t elements_ = 0;
   
   std::size_t compressed_length_ = 0;
+
+  // CODEC_BLOCK only: how the values are stored and how many per block
+  CompressionCodec codec_ = CODEC_RLE;
+  std::uint64_t encoding_ = 0;
+  datum scale_ = 1;
+  std::size_t block_elements_ = 0;
   
   static void CompressData(void* uncompressed, const std::size_t& uncompressed_elements, void* compressed, std::size_t& compressed_length);
   static void DecompressData(void* uncompressed, std::size_t& uncompressed_elements, void* compressed, const std::size_t& compressed_length);
+
+  void CompressBlocks(const Tensor& tensor);
+  bool DecompressBlock(std::size_t block, datum* target) const;
   
 public:
   
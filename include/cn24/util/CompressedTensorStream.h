@@ -11,6 +11,7 @@
 #include <cstddef>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #include "Log.h"
 #include "Config.h"
@@ -20,9 +21,23 @@
 
 #include "TensorStream.h"
 
+// Version 1 streams contain run length encoded tensors
 #define CN24_CTS_MAGIC 0xC24CC24CC24CC24C
+// Version 2 streams contain block compressed tensors
+#define CN24_CTS2_MAGIC 0xC24CC24CC24CC242
 
 namespace Conv {
+
+struct DecompressionStats {
+  // Decompressed bytes and the time spent on them, summed over all threads,
+  // since ResetStats
+  std::size_t bytes = 0;
+  double seconds = 0;
+
+  double mebibytes_per_second() const {
+    return seconds > 0 ? (double)bytes / 1048576.0 / seconds : 0;
+  }
+};
   
 class CompressedTensorStream : public TensorStream {
 public: 
@@ -41,10 +56,14 @@ public:
   unsigned int GetTensorCount() { return tensors_.size(); }
   unsigned int LoadFile(std::string path);
   bool CopySample(const unsigned int source_index, const std::size_t source_sample, Tensor& target, const std::size_t target_sample);
+
+  bool IsThreadSafe() { return true; }
+
+  static DecompressionStats GetStats();
+  static void ResetStats();
 private:
   std::vector<CompressedTensor*> tensors_;
   std::size_t max_elements_ = 0;
-  Tensor temp_tensor_;
 };
 
 }
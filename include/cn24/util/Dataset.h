@@ -103,6 +103,12 @@ public:
     */
   virtual bool SupportsTesting () const = 0;
 
+  /**
+    * @brief Checks if samples can be loaded from several threads at once.
+    * @returns True if GetTrainingSample and GetTestingSample are thread-safe
+    */
+  virtual bool SupportsConcurrentReads () const { return false; }
+
   /**
     * @brief Fill the specified Tensors with the specified training sample.
     * @param data_tensor An empty Tensor
@@ -130,6 +136,36 @@ public:
   virtual bool GetTestingSample ( Tensor& data_tensor, Tensor& label_tensor,
 				  Tensor& helper_tensor, Tensor& weight_tensor, 
 				   unsigned int sample, unsigned int index) = 0;
+
+  /**
+    * @brief Fill consecutive samples of the specified Tensors with the
+    *  specified training samples. Datasets that can load several samples at
+    *  once override this, the default loads one after another.
+    * @param indices The indices of the training samples to load
+    * @param first_sample The sample in the target Tensors for the first index
+    * @returns True on success
+    */
+  virtual bool GetTrainingBatch ( Tensor& data_tensor, Tensor& label_tensor,
+				  Tensor& helper_tensor, Tensor& weight_tensor,
+				  const std::vector<unsigned int>& indices, unsigned int first_sample = 0) {
+    bool success = true;
+    for (unsigned int s = 0; s < indices.size(); s++)
+      success &= GetTrainingSample (data_tensor, label_tensor, helper_tensor, weight_tensor, first_sample + s, indices[s]);
+    return success;
+  }
+
+  /**
+    * @brief Fill consecutive samples of the specified Tensors with the
+    *  specified testing samples, see GetTrainingBatch.
+    */
+  virtual bool GetTestingBatch ( Tensor& data_tensor, Tensor& label_tensor,
+				 Tensor& helper_tensor, Tensor& weight_tensor,
+				 const std::vector<unsigned int>& indices, unsigned int first_sample = 0) {
+    bool success = true;
+    for (unsigned int s = 0; s < indices.size(); s++)
+      success &= GetTestingSample (data_tensor, label_tensor, helper_tensor, weight_tensor, first_sample + s, indices[s]);
+    return success;
+  }
 				   
   /**
    * @brief Uses this Dataset's colors to colorize a net output
@@ -239,8 +275,11 @@ public:
   virtual unsigned int GetTrainingSamples() const;
   virtual unsigned int GetTestingSamples() const;
   virtual bool SupportsTesting() const;
+  virtual bool SupportsConcurrentReads() const;
   virtual bool GetTrainingSample(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index);
   virtual bool GetTestingSample(Tensor& data_tensor, Tensor& label_tensor,Tensor& helper_tensor, Tensor& weight_tensor,  unsigned int sample, unsigned int index);
+  virtual bool GetTrainingBatch(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, const std::vector<unsigned int>& indices, unsigned int first_sample = 0);
+  virtual bool GetTestingBatch(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, const std::vector<unsigned int>& indices, unsigned int first_sample = 0);
   
   static TensorStreamDataset* CreateFromConfiguration(std::istream& file, bool dont_load = false, DatasetLoadSelection selection = LOAD_BOTH);
   
@@ -271,6 +310,20 @@ private:
   std::vector<datum> class_weights_;
   unsigned int classes_;
   dataset_localized_error_function error_function_;
+
+  /**
+   * @brief Decompresses the images and labels of a batch together, see
+   *  TensorStream::CopySamples.
+   */
+  bool GetBatch(TensorStream* stream, unsigned int tensor_count, Tensor& data_tensor, Tensor& label_tensor,
+    Tensor& helper_tensor, Tensor& weight_tensor, const std::vector<unsigned int>& indices, unsigned int first_sample);
+
+  /**
+   * @brief Writes the spatial prior and the localized error of a sample
+   *  whose label is loaded already.
+   */
+  void WriteHelperAndWeight(TensorStream* stream, Tensor& label_tensor, Tensor& helper_tensor,
+    Tensor& weight_tensor, unsigned int sample, unsigned int index);
 };
 }
 
@@ -37,6 +37,7 @@ public:
   unsigned int GetTensorCount() { return tensors_.size(); }
   unsigned int LoadFile(std::string path);
   bool CopySample(const unsigned int source_index, const std::size_t source_sample, Tensor& target, const std::size_t target_sample);
+  bool IsThreadSafe() { return true; }
 private:
   std::vector<Tensor*> tensors_;
 };
@@ -0,0 +1,96 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file RingAllReduce.h
+ * @class RingAllReduce
+ * @brief Sums buffers over all processes of a Transport.
+ *
+ * A buffer is split into one chunk per rank. In size - 1 steps, every rank
+ * adds the chunk it receives from the previous rank to its own and passes
+ * the sum on, until each rank has one complete chunk. In another size - 1
+ * steps, the complete chunks are passed around the ring. Every rank sends
+ * and receives 2 (size - 1) / size times the buffer, no matter how many
+ * ranks there are, and all ranks end up with exactly the same sums.
+ *
+ * Buffers can also be queued and are then summed on a background thread
+ * while the caller continues. Small buffers are summed together in buckets.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_RINGALLREDUCE_H
+#define CONV_RINGALLREDUCE_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Config.h"
+#include "Transport.h"
+
+namespace Conv {
+
+class RingAllReduce {
+public:
+  /**
+   * @param transport The ring to sum over
+   * @param bucket_elements Queued buffers are summed together until
+   *  they have at least this many elements
+   */
+  explicit RingAllReduce(Transport& transport, std::size_t bucket_elements = 262144);
+  ~RingAllReduce();
+
+  /**
+   * @brief Sums the buffer over all ranks in place and returns when done.
+   *  Must not be called while queued buffers are being summed.
+   */
+  void Sum(datum* data, std::size_t elements);
+
+  /**
+   * @brief Queues the buffer to be summed in place on the background
+   *  thread. All ranks have to queue the same buffers in the same order.
+   */
+  void Enqueue(datum* data, std::size_t elements);
+
+  /**
+   * @brief Returns when all queued buffers are summed. If summing failed
+   *  on the background thread, the exception is thrown again here and the
+   *  buffers that were still queued are left as they are.
+   */
+  void Wait();
+
+  inline Transport& transport() { return transport_; }
+
+private:
+  struct Buffer {
+    datum* data;
+    std::size_t elements;
+  };
+  void Work();
+
+  Transport& transport_;
+  std::size_t bucket_elements_;
+  std::vector<datum> bucket_;
+  std::vector<datum> scratch_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable done_;
+  std::deque<Buffer> queue_;
+  std::size_t pending_ = 0;
+  bool flushed_ = false;
+  bool shutdown_ = false;
+  std::exception_ptr exception_;
+};
+
+}
+
+#endif
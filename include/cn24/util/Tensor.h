@@ -26,6 +26,7 @@
 #define CONV_TENSOR_H
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <iostream>
 
@@ -35,6 +36,16 @@
 namespace Conv {
 
 class Tensor;
+
+/**
+ * @brief Storage formats for Tensor::Pack. Computations always use datum.
+ */
+enum TensorPrecision {
+  PRECISION_FP32,
+  PRECISION_BF16,
+  PRECISION_FP16
+};
+
 /**
  * @brief Prints size to the ostream, may be helpful.
  */
@@ -99,6 +110,18 @@ public:
    */
   void Shadow (Tensor& tensor);
 
+  /**
+   * @brief Uses a part of the memory of another Tensor
+   *
+   * Packing and moving the shadow affect the whole shadowed Tensor.
+   *
+   * @param tensor Tensor to shadow
+   * @param offset Element where the part begins
+   */
+  void Shadow (Tensor& tensor, const std::size_t offset,
+               const std::size_t samples, const std::size_t width = 1,
+               const std::size_t height = 1, const std::size_t maps = 1);
+
   /**
    * @brief Resizes the Tensor with data loss.
    */
@@ -330,6 +353,41 @@ public:
   bool mmapped_ = false;
   void* original_mmap_ = nullptr;
   
+  /**
+   * @brief Converts the data to a 16 bit format and gives the memory of the
+   *  datums back to the system until Unpack is called.
+   *
+   * The data pointer stays valid, but its contents are undefined while the
+   * Tensor is packed. Empty and memory mapped Tensors are not packed.
+   */
+  void Pack(const TensorPrecision precision);
+  
+  /**
+   * @brief Converts packed data back to datums.
+   * @param no_copy Don't convert the data, the caller overwrites it
+   */
+  void Unpack(bool no_copy = false);
+  
+  inline bool packed() const {
+    return is_shadow_ ? shadow_target_->packed() : packed_ptr_ != nullptr;
+  }
+
+  /**
+   * @brief Gives the memory of the datums back to the system because the
+   *  contents are not needed anymore.
+   *
+   * The data pointer stays valid and reads as zero until it is written
+   * again. A shadow only discards the part it covers.
+   */
+  void Discard();
+  
+private:
+  static void ReleasePages(datum* data, const std::size_t elements);
+
+  std::uint16_t* packed_ptr_ = nullptr;
+  TensorPrecision packed_precision_ = PRECISION_FP32;
+  
+public:
   
   bool hint_ignore_content_ = false;
 };
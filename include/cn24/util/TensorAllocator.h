@@ -0,0 +1,89 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file TensorAllocator.h
+ * @class TensorAllocator
+ * @brief Provides aligned memory for Tensors and recycles it.
+ *
+ * Requests are rounded up to size classes, four per power of two. Freed
+ * blocks go to a cache of the freeing thread first and to a shared pool
+ * when that cache is full, so a Tensor that is resized to the same size
+ * over and over again does not reach the system allocator. Blocks of
+ * 2 MiB and up are mapped directly and can be backed by huge pages.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_TENSORALLOCATOR_H
+#define CONV_TENSORALLOCATOR_H
+
+#include <cstddef>
+
+namespace Conv {
+
+// Alignment of every block, enough for a cache line and any SIMD register
+#define CN24_TENSOR_ALIGNMENT 64
+
+struct TensorAllocatorStats {
+  // Bytes in blocks handed out, including the size class rounding
+  std::size_t bytes_live = 0;
+  std::size_t bytes_peak = 0;
+  // Bytes in blocks waiting to be recycled
+  std::size_t bytes_cached = 0;
+  // Requests and how many of them the system had to serve, since ResetStats
+  unsigned long allocations = 0;
+  unsigned long system_allocations = 0;
+  double seconds = 0;
+
+  double allocations_per_second() const {
+    return seconds > 0 ? (double)allocations / seconds : 0;
+  }
+};
+
+class TensorAllocator {
+public:
+  /**
+   * @brief Returns a block of at least the requested size, aligned to
+   *  CN24_TENSOR_ALIGNMENT bytes. Zero bytes give a nullptr.
+   */
+  static void* Allocate(const std::size_t bytes);
+
+  /**
+   * @brief Gives a block back. The size has to be the requested one.
+   */
+  static void Free(void* block, const std::size_t bytes);
+
+  /**
+   * @brief Backs new blocks of 2 MiB and up with transparent huge pages
+   *  where the system supports them. Off by default.
+   */
+  static void SetHugePagesEnabled(const bool enabled);
+
+  /**
+   * @brief Without pooling, every block goes back to the system right away.
+   *  This is useful for memory debuggers. On by default.
+   */
+  static void SetPoolingEnabled(const bool enabled);
+
+  /**
+   * @brief Releases the blocks cached by the calling thread and the shared
+   *  pool to the system.
+   */
+  static void Trim();
+
+  static TensorAllocatorStats GetStats();
+
+  /**
+   * @brief Restarts the request counters and sets the peak to the bytes
+   *  currently live.
+   */
+  static void ResetStats();
+};
+
+}
+
+#endif
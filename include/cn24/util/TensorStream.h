@@ -22,6 +22,8 @@ namespace Conv {
 
 class TensorStream {
 public:
+  virtual ~TensorStream() {}
+
   virtual std::size_t GetWidth(unsigned int index) = 0;
   virtual std::size_t GetHeight(unsigned int index) = 0;
   virtual std::size_t GetMaps(unsigned int index) = 0;
@@ -30,10 +32,31 @@ public:
   
   virtual bool CopySample(const unsigned int source, const std::size_t source_sample,
                           Tensor& target, const std::size_t target_sample) = 0;
+
+  /**
+   * @brief Copies the first sample of each source tensor into consecutive
+   *  samples of the target, starting at first_target_sample. Thread-safe
+   *  streams copy the samples in parallel.
+   */
+  virtual bool CopySamples(const std::vector<unsigned int>& sources, Tensor& target,
+                           const std::size_t first_target_sample = 0);
+
+  /**
+   * @brief Checks if CopySample can be called from several threads at once.
+   */
+  virtual bool IsThreadSafe() { return false; }
   
   virtual unsigned int GetTensorCount() = 0;
   
   static TensorStream* FromFile(std::string path, std::vector<unsigned int> class_colors = {});
+
+protected:
+  /**
+   * @brief Gets a Tensor of the specified size for decoding a sample that
+   *  does not fit its target. Every thread has its own scratch Tensor.
+   */
+  static Tensor& Scratch(const std::size_t samples, const std::size_t width,
+                         const std::size_t height, const std::size_t maps);
 };
 
 }
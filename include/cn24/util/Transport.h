@@ -0,0 +1,126 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file Transport.h
+ * @class Transport
+ * @brief Connects the processes of a distributed training run in a ring.
+ *
+ * Every process has a rank from 0 to size - 1 and only talks to its
+ * neighbours: it sends to rank + 1 and receives from rank - 1, both modulo
+ * size. This is all a ring all-reduce needs, see RingAllReduce.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_TRANSPORT_H
+#define CONV_TRANSPORT_H
+
+#include <cstddef>
+#include <string>
+
+namespace Conv {
+
+enum TransportType {
+  TRANSPORT_SHM,
+  TRANSPORT_TCP
+};
+
+class Transport {
+public:
+  virtual ~Transport() {}
+
+  /**
+   * @brief Creates a Transport of the specified type. The name identifies
+   *  the training run, all ranks have to use the same one.
+   *
+   * @param type Shared memory or TCP loopback
+   * @param name Name of the shared memory segments
+   * @param port First port for TCP, rank r listens on port + r
+   */
+  static Transport* Create(TransportType type, const std::string& name,
+                           unsigned int port, unsigned int rank, unsigned int size);
+
+  inline unsigned int rank() const { return rank_; }
+  inline unsigned int size() const { return size_; }
+  inline unsigned int next() const { return (rank_ + 1) % size_; }
+  inline unsigned int previous() const { return (rank_ + size_ - 1) % size_; }
+
+  /**
+   * @brief Sends bytes to the next rank while receiving bytes from the
+   *  previous rank and returns when both are done. Both directions make
+   *  progress at the same time, so a ring of these calls cannot deadlock.
+   */
+  void SendReceive(const void* send_data, std::size_t send_bytes,
+                   void* receive_data, std::size_t receive_bytes);
+
+protected:
+  Transport(unsigned int rank, unsigned int size);
+
+  /**
+   * @brief Sends or receives as many bytes as possible without waiting
+   *  and returns their number.
+   */
+  virtual std::size_t TrySend(const void* data, std::size_t bytes) = 0;
+  virtual std::size_t TryReceive(void* data, std::size_t bytes) = 0;
+
+  /**
+   * @brief Waits until TrySend or TryReceive can make progress, whichever
+   *  is still needed.
+   */
+  virtual void Wait(bool sending, bool receiving) = 0;
+
+  unsigned int rank_;
+  unsigned int size_;
+};
+
+/**
+ * @brief Passes the bytes through ring buffers in POSIX shared memory. The
+ *  segment of a link is created by the receiving rank.
+ */
+class SharedMemoryTransport : public Transport {
+public:
+  SharedMemoryTransport(const std::string& name, unsigned int rank,
+                        unsigned int size, std::size_t capacity = 4194304);
+  ~SharedMemoryTransport();
+
+protected:
+  std::size_t TrySend(const void* data, std::size_t bytes);
+  std::size_t TryReceive(void* data, std::size_t bytes);
+  void Wait(bool sending, bool receiving);
+
+private:
+  struct Link;
+  Link* Map(int fd, bool create);
+
+  std::string receive_name_;
+  std::size_t capacity_;
+  Link* send_link_ = nullptr;
+  Link* receive_link_ = nullptr;
+  unsigned int idle_waits_ = 0;
+};
+
+/**
+ * @brief Passes the bytes through TCP connections to 127.0.0.1.
+ */
+class TCPTransport : public Transport {
+public:
+  TCPTransport(unsigned int port, unsigned int rank, unsigned int size);
+  ~TCPTransport();
+
+protected:
+  std::size_t TrySend(const void* data, std::size_t bytes);
+  std::size_t TryReceive(void* data, std::size_t bytes);
+  void Wait(bool sending, bool receiving);
+
+private:
+  int send_socket_ = -1;
+  int receive_socket_ = -1;
+};
+
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file WorkerPool.h
+ * @class WorkerPool
+ * @brief Runs a task on a fixed number of threads at the same time.
+ *
+ * The threads are started once and wait for the next task in between. The
+ * calling thread is worker 0. With OpenMP, the threads of the caller are
+ * split between the workers, so parallel regions inside the task do not
+ * oversubscribe the machine.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_WORKERPOOL_H
+#define CONV_WORKERPOOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Conv {
+
+class WorkerPool {
+public:
+  explicit WorkerPool(const unsigned int workers);
+  ~WorkerPool();
+
+  /**
+   * @brief Calls the task once on every worker with the number of the
+   *  worker and returns when all calls have returned. If a call throws,
+   *  the first exception is thrown again here.
+   */
+  void Run(const std::function<void(unsigned int)>& task);
+
+  inline unsigned int workers() const { return workers_; }
+
+private:
+  void Work(const unsigned int worker);
+  void Call(const unsigned int worker, const int threads);
+
+  unsigned int workers_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable task_ready_;
+  std::condition_variable task_done_;
+  const std::function<void(unsigned int)>* task_ = nullptr;
+  unsigned long generation_ = 0;
+  unsigned int running_ = 0;
+  int threads_per_worker_ = 1;
+  bool shutdown_ = false;
+  std::exception_ptr exception_;
+};
+
+}
+
+#endif
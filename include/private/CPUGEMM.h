@@ -0,0 +1,116 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file CPUGEMM.h
+ * @brief Built-in cache-blocked GEMM engine used when no BLAS is linked.
+ *
+ * The engine follows the usual GotoBLAS structure: B is packed into
+ * KC x NC blocks of NR wide column panels, A into MC x KC blocks of MR tall
+ * row panels, and a register-tiled micro-kernel computes MR x NR tiles of C.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_CPUGEMM_H
+#define CONV_CPUGEMM_H
+
+#include "Config.h"
+
+namespace Conv {
+
+/**
+ * @brief Signature of a micro-kernel.
+ *
+ * Computes C = alpha * A_panel * B_panel + beta * C for a full MR x NR tile.
+ * If beta is zero, C is not read.
+ */
+typedef void (*GEMMMicroKernel) (const int kc, const datum* a_panel,
+  const datum* b_panel, datum* c, const int ldc, const datum alpha,
+  const datum beta);
+
+struct GEMMKernelDescriptor {
+  const char* name;
+  int mr;
+  int nr;
+  GEMMMicroKernel kernel;
+};
+
+/**
+ * @brief Produces packed panels of the B operand on the fly.
+ *
+ * Lets callers run GEMMs on a B matrix that never exists in memory, e.g.
+ * the patch matrix of a convolution.
+ */
+class GEMMPanelSource {
+public:
+  virtual ~GEMMPanelSource() {}
+
+  /**
+   * @brief Writes rows [k0, k0 + kc) and columns [j0, j0 + nc) of B into
+   *  consecutive NR wide panels, each holding kc rows of nr values.
+   *
+   * Columns past nc in the last panel have to be zero. May be called
+   * concurrently for disjoint column ranges.
+   */
+  virtual void PackPanels(const int k0, const int kc, const int j0,
+    const int nc, const int nr, datum* packed) const = 0;
+};
+
+/**
+ * @brief Consumes blocks of the C result instead of storing C in memory.
+ */
+class GEMMTileSink {
+public:
+  virtual ~GEMMTileSink() {}
+
+  /**
+   * @brief Receives the finished rows [i0, i0 + mc) and columns
+   *  [j0, j0 + nc) of C, stored row-major in tile with leading dimension ld.
+   *
+   * Calls are made one at a time.
+   */
+  virtual void ConsumeTile(const int i0, const int mc, const int j0,
+    const int nc, const datum* tile, const int ld) const = 0;
+};
+
+class CPUGEMM {
+public:
+  /**
+   * @brief Computes C = alpha * op(A) * op(B) + beta * C.
+   *
+   * The interface mirrors cblas_sgemm.
+   */
+  static void Sgemm(const bool is_row_major, const bool transpose_A,
+    const bool transpose_B, const int M, const int N, const int K,
+    const datum alpha, const datum* A, const int ldA, const datum* B,
+    const int ldB, const datum beta, datum* C, const int ldC);
+
+  /**
+   * @brief Computes C = alpha * op(A) * B + beta * C for row-major A and C,
+   *  where B (K x N) is packed by a GEMMPanelSource.
+   */
+  static void Sgemm(const bool transpose_A, const int M, const int N,
+    const int K, const datum alpha, const datum* A, const int ldA,
+    const GEMMPanelSource& B, const datum beta, datum* C, const int ldC);
+
+  /**
+   * @brief Computes alpha * op(A) * op(B) for row-major A and B and hands
+   *  the result to a GEMMTileSink block by block.
+   */
+  static void Sgemm(const bool transpose_A, const bool transpose_B,
+    const int M, const int N, const int K, const datum alpha, const datum* A,
+    const int ldA, const datum* B, const int ldB, const GEMMTileSink& C);
+
+  /**
+   * @brief Gets the micro-kernel the engine currently uses.
+   */
+  static const GEMMKernelDescriptor& GetKernel();
+};
+
+}
+
+#endif
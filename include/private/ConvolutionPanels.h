@@ -0,0 +1,109 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file ConvolutionPanels.h
+ * @brief GEMM panel sources and tile sinks that gather and scatter
+ *  convolution patches on the fly.
+ *
+ * These replace the IM2COL and COL2IM buffers for implicit GEMM convolutions. The patch
+ * matrix uses the same layout as TensorMath::IM2COL: row
+ * (map * kernel_height + ky) * kernel_width + kx, column
+ * (sample * output_height + oy) * output_width + ox.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_CONVOLUTIONPANELS_H
+#define CONV_CONVOLUTIONPANELS_H
+
+#include "Config.h"
+#include "CPUGEMM.h"
+
+namespace Conv {
+
+struct ConvolutionGeometry {
+  ConvolutionGeometry(const int input_width, const int input_height,
+    const int input_maps, const int samples, const int kernel_width,
+    const int kernel_height, const int stride_width, const int stride_height,
+    const int pad_width, const int pad_height) :
+    input_width(input_width), input_height(input_height),
+    input_maps(input_maps), samples(samples), kernel_width(kernel_width),
+    kernel_height(kernel_height), stride_width(stride_width),
+    stride_height(stride_height), pad_width(pad_width), pad_height(pad_height),
+    output_width((2 * pad_width + input_width - kernel_width) / stride_width + 1),
+    output_height((2 * pad_height + input_height - kernel_height) / stride_height + 1) {}
+
+  int input_width;
+  int input_height;
+  int input_maps;
+  int samples;
+  int kernel_width;
+  int kernel_height;
+  int stride_width;
+  int stride_height;
+  int pad_width;
+  int pad_height;
+  int output_width;
+  int output_height;
+};
+
+/**
+ * @brief The patch matrix of the input maps [first_map, first_map + maps),
+ *  as B operand of the forward GEMM.
+ */
+class PatchPanelSource : public GEMMPanelSource {
+public:
+  PatchPanelSource(const ConvolutionGeometry& geometry, const datum* image,
+    const int first_map) : geometry_(geometry), image_(image),
+    first_map_(first_map) {}
+  void PackPanels(const int k0, const int kc, const int j0, const int nc,
+    const int nr, datum* packed) const;
+private:
+  const ConvolutionGeometry& geometry_;
+  const datum* image_;
+  const int first_map_;
+};
+
+/**
+ * @brief The transposed patch matrix, as B operand of the weight
+ *  gradient GEMM.
+ */
+class TransposedPatchPanelSource : public GEMMPanelSource {
+public:
+  TransposedPatchPanelSource(const ConvolutionGeometry& geometry,
+    const datum* image, const int first_map) : geometry_(geometry),
+    image_(image), first_map_(first_map) {}
+  void PackPanels(const int k0, const int kc, const int j0, const int nc,
+    const int nr, datum* packed) const;
+private:
+  const ConvolutionGeometry& geometry_;
+  const datum* image_;
+  const int first_map_;
+};
+
+/**
+ * @brief Adds blocks of a patch matrix for the input maps
+ *  [first_map, first_map + maps) into an image, like COL2IM.
+ *
+ * The image has to be cleared before.
+ */
+class PatchTileSink : public GEMMTileSink {
+public:
+  PatchTileSink(const ConvolutionGeometry& geometry, datum* image,
+    const int first_map) : geometry_(geometry), image_(image),
+    first_map_(first_map) {}
+  void ConsumeTile(const int i0, const int mc, const int j0, const int nc,
+    const datum* tile, const int ld) const;
+private:
+  const ConvolutionGeometry& geometry_;
+  datum* image_;
+  const int first_map_;
+};
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file FFT.h
+ * @brief Self-contained mixed radix FFT for the FFT convolution engine.
+ *
+ * Complex data is stored as separate real and imaginary arrays. Many
+ * sequences are transformed at once, interleaved so that the butterflies
+ * vectorize across sequences (Stockham autosort, radices 2, 3, 4 and 5).
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_FFT_H
+#define CONV_FFT_H
+
+#include <vector>
+
+#include "Config.h"
+
+namespace Conv {
+
+class FFTPlan {
+public:
+  /**
+   * @brief Prepares transforms of the given length, which needs to be a
+   *  product of 2, 3 and 5.
+   */
+  explicit FFTPlan(const int length);
+
+  /**
+   * @brief Gets the smallest even product of 2, 3 and 5 that is at least
+   *  minimum.
+   */
+  static int GoodLength(const int minimum);
+
+  int length() const { return length_; }
+
+  /**
+   * @brief Transforms batch sequences in place, without scaling.
+   *
+   * Element j of sequence b is stored at [j * batch + b]. The work arrays
+   * need length * batch elements each.
+   */
+  void Transform(datum* re, datum* im, const int batch, const bool inverse,
+    datum* work_re, datum* work_im) const;
+
+private:
+  int length_;
+  std::vector<int> radices_;
+  // exp(-2 pi i k / length) = cos_[k] - i sin_[k]
+  std::vector<datum> cos_;
+  std::vector<datum> sin_;
+};
+
+/**
+ * @brief 2D FFT of real images on a height x width grid.
+ *
+ * Spectra have height rows of width / 2 + 1 frequencies, the remaining
+ * ones follow from symmetry. Both dimensions need to be even products of
+ * 2, 3 and 5.
+ */
+class RealFFT2D {
+public:
+  RealFFT2D(const int height, const int width);
+
+  int height() const { return height_; }
+  int width() const { return width_; }
+  int spectrum_width() const { return width_ / 2 + 1; }
+  int spectrum_size() const { return height_ * spectrum_width(); }
+
+  /**
+   * @brief Transforms a rows x columns image placed at (row0, column0) of
+   *  an otherwise zero grid.
+   */
+  void Forward(const datum* image, const int rows, const int columns,
+    const int row0, const int column0, datum* re, datum* im) const;
+
+  /**
+   * @brief Transforms back and writes scale * result + offset for the
+   *  rows x columns window at (row0, column0) to image.
+   *
+   * Scale 1 / (height * width) inverts Forward. The spectrum is destroyed.
+   */
+  void Inverse(datum* re, datum* im, const int rows, const int columns,
+    const int row0, const int column0, const datum scale, const datum offset,
+    datum* image) const;
+
+private:
+  int height_;
+  int width_;
+  FFTPlan row_plan_;
+  FFTPlan column_plan_;
+};
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file FFTConvolution.h
+ * @class FFTConvolution
+ * @brief Convolutions with stride 1 as pointwise products of 2D spectra.
+ *
+ * Images, gradients and kernels are zero padded to a common grid that is
+ * large enough to avoid wrap-around, so every pass is exact up to
+ * rounding. Memory layouts are the ones of ConvolutionLayer: images are
+ * [sample][map][y][x], kernels [output map][input map][y][x].
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_FFTCONVOLUTION_H
+#define CONV_FFTCONVOLUTION_H
+
+#include <vector>
+
+#include "Config.h"
+#include "ConvolutionPanels.h"
+#include "FFT.h"
+
+namespace Conv {
+
+class FFTConvolution {
+public:
+  /**
+   * @brief Plans the transforms for a geometry with stride 1.
+   */
+  FFTConvolution(const ConvolutionGeometry& geometry, const int output_maps);
+
+  /**
+   * @brief Transforms the kernels. Needs to be called again whenever
+   *  they change.
+   */
+  void SetWeights(const datum* weights);
+
+  /**
+   * @brief Computes output = alpha * (input * weights + bias).
+   *
+   * The input spectra are kept for the next call to Backward.
+   */
+  void Forward(const datum* input, const datum alpha, const datum* bias,
+    datum* output);
+
+  /**
+   * @brief Computes the gradients w.r.t. the input of the last Forward
+   *  call, the kernels and the bias.
+   *
+   * @param input_delta Overwritten, skipped if nullptr
+   */
+  void Backward(const datum* output_delta, datum* input_delta,
+    datum* weights_delta, datum* bias_delta);
+
+private:
+  // Transforms planes of rows x columns images placed at (row0, column0)
+  void TransformPlanes(const datum* images, const int planes, const int rows,
+    const int columns, const int row0, const int column0, datum* spectra) const;
+  // Inverse of TransformPlanes, adds offsets[plane % offset_period]
+  void InvertPlanes(const datum* spectra, const int planes, const int rows,
+    const int columns, const int row0, const int column0, const datum scale,
+    const datum* offsets, const int offset_period, datum* images) const;
+
+  ConvolutionGeometry geometry_;
+  int output_maps_;
+  RealFFT2D transform_;
+  int frequencies_;
+  int blocks_;
+
+  // Blocked spectra, see TensorMathKernelTable::spectrum_product
+  std::vector<datum> input_spectra_;
+  std::vector<datum> weight_spectra_;
+  std::vector<datum> output_spectra_;
+  std::vector<datum> product_spectra_;
+};
+
+}
+
+#endif
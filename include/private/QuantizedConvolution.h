@@ -0,0 +1,69 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file QuantizedConvolution.h
+ * @class QuantizedConvolution
+ * @brief Forward convolutions in 8 bit integers for inference.
+ *
+ * Inputs are quantized symmetrically to 255 levels per layer, kernels to
+ * 255 levels per output map. The products are summed up in 32 bit
+ * integers, see TensorMathKernelTable::gemm_u8s8, and scaled back to
+ * datums. Memory layouts are the ones of ConvolutionLayer.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_QUANTIZEDCONVOLUTION_H
+#define CONV_QUANTIZEDCONVOLUTION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Config.h"
+#include "ConvolutionPanels.h"
+
+namespace Conv {
+
+class QuantizedConvolution {
+public:
+  QuantizedConvolution(const ConvolutionGeometry& geometry,
+    const int output_maps, const int group);
+
+  /**
+   * @brief Quantizes the kernels. Needs to be called again whenever
+   *  they change.
+   */
+  void SetWeights(const datum* weights);
+
+  /**
+   * @brief Computes output = alpha * (input * weights) without the bias.
+   *
+   * @param range Inputs are quantized to [-range, range], values outside
+   *  are saturated
+   */
+  void Forward(const datum* input, const datum range, const datum alpha,
+    datum* output);
+
+private:
+  ConvolutionGeometry geometry_;
+  int output_maps_;
+  int group_;
+  // Patch matrix rows per group, and rounded up to a multiple of 4
+  int rows_;
+  int padded_rows_;
+
+  std::vector<std::int8_t> weights_;
+  std::vector<std::int32_t> offsets_;
+  std::vector<datum> weight_scales_;
+  std::vector<datum> scales_;
+  std::vector<datum> columns_;
+  std::vector<std::uint8_t> packed_;
+};
+
+}
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file TensorMathKernels.h
+ * @brief Runtime registry of the CPU implementations behind TensorMath.
+ *
+ * Every supported instruction set gets its own table of kernels. The bodies
+ * are written once in TensorMathKernelsImpl.h and compiled for each
+ * instruction set using target attributes, so a single binary can run on
+ * all hosts. The best table is bound once by System::Init.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_TENSORMATHKERNELS_H
+#define CONV_TENSORMATHKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Config.h"
+#include "CPUGEMM.h"
+#include "TensorMath.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CN24_X86_KERNELS
+#endif
+
+// Frequencies per block of a blocked spectrum, see spectrum_product
+#define CN24_SPECTRUM_LANES 16
+
+// Columns per panel of a packed 8 bit matrix, see pack_u8
+#define CN24_INT8_LANES 16
+
+namespace Conv {
+
+enum CPUInstructionSet {
+  CPU_ISA_GENERIC = 0,
+  CPU_ISA_SSE42 = 1,
+  CPU_ISA_AVX2 = 2,
+  CPU_ISA_AVX512 = 3
+};
+
+/*
+ * All kernels work on raw, row-major CPU memory. Dimension checks and
+ * OpenCL transfers are done by TensorMath before calling them.
+ */
+struct TensorMathKernelTable {
+  CPUInstructionSet isa;
+  const char* name;
+
+  GEMMKernelDescriptor gemm;
+
+  // A is M x N as in cblas_sgemv, so Y has N elements if transposed
+  void (*gemv) (const bool transpose_A, const int M, const int N,
+    const datum alpha, const datum* A, const int ldA, const datum* X,
+    const int incX, const datum beta, datum* Y, const int incY);
+
+  void (*im2col) (const datum* image, datum* columns,
+    const int image_width, const int image_height, const int maps,
+    const int samples, const int kernel_width, const int kernel_height,
+    const int stride_width, const int stride_height, const int pad_width,
+    const int pad_height);
+
+  void (*col2im) (datum* image, const datum* columns,
+    const int image_width, const int image_height, const int maps,
+    const int samples, const int kernel_width, const int kernel_height,
+    const int stride_width, const int stride_height, const int pad_width,
+    const int pad_height);
+
+  void (*sms) (const datum* source, datum* target, const int width,
+    const int height, const int maps, const int samples);
+
+  void (*down) (const datum* source, datum* target, const int source_width,
+    const int source_height, const int target_width, const int target_height,
+    const int planes, const int region_width, const int region_height,
+    const datum target_factor);
+
+  void (*up) (const datum* source, datum* target, const int source_width,
+    const int source_height, const int target_width, const int target_height,
+    const int planes, const int region_width, const int region_height,
+    const datum target_factor);
+
+  void (*add) (const datum* source_a, const datum* source_b, datum* target,
+    const std::size_t elements);
+
+  /*
+   * Elementwise exp and target = f(scale * source + offset), source may be
+   * target. Unless exact is set, tanh, sigmoid and exp use polynomial
+   * approximations, see TensorMathKernelsImpl.h for their error bounds.
+   */
+  void (*exp) (const datum* source, datum* target, const std::size_t elements,
+    const bool exact);
+  void (*activation) (const datum* source, datum* target,
+    const std::size_t elements, const datum scale, const datum offset,
+    const ActivationFunction activation, const bool exact);
+  /*
+   * Convolution epilogues on planes of pixels elements, plane p belongs to
+   * map p % maps. bias_activation computes image = f(image + alpha * bias),
+   * bias may be nullptr. activation_gradient computes
+   * delta = output_delta * f'(x) from the activated output, skipping delta
+   * for ACTIVATION_NONE or if it is nullptr, and sums delta per map into
+   * bias_delta unless that is nullptr.
+   */
+  void (*bias_activation) (datum* image, const int pixels, const int maps,
+    const int samples, const datum alpha, const datum* bias,
+    const ActivationFunction activation, const bool exact);
+
+  void (*activation_gradient) (const datum* output, const datum* output_delta,
+    datum* delta, const int pixels, const int maps, const int samples,
+    const ActivationFunction activation, datum* bias_delta);
+
+  /*
+   * Winograd F(4x4, 3x3) transforms. Transformed tensors are 36 matrices,
+   * one per element of the 6x6 tile, with rows (maps) and columns (tiles)
+   * where tile = (sample * tiles_y + ty) * tiles_x + tx.
+   */
+  void (*winograd_input) (const datum* image, datum* transformed,
+    const int width, const int height, const int maps, const int samples,
+    const int offset_x, const int offset_y, const int tiles_x,
+    const int tiles_y);
+
+  void (*winograd_output) (const datum* transformed, datum* image,
+    const int width, const int height, const int maps, const int samples,
+    const int tiles_x, const int tiles_y, const datum alpha,
+    const datum* bias);
+
+  void (*winograd_delta) (const datum* image, datum* transformed,
+    const int width, const int height, const int maps, const int samples,
+    const int tiles_x, const int tiles_y);
+
+  void (*winograd_filter) (const datum* weights, datum* transformed,
+    const int output_maps, const int input_maps, const bool flip);
+
+  void (*winograd_filter_gradient) (const datum* transformed,
+    datum* weights, const int output_maps, const int input_maps);
+
+  /*
+   * One radix 2, 3, 4 or 5 step of a batched FFT, see FFTPlan. Reads
+   * radix * m contiguous vectors, cosine and sine hold exp(-2 pi i k / length).
+   */
+  void (*fft_pass) (const datum* re, const datum* im, datum* target_re,
+    datum* target_im, const int radix, const int m, const int vector,
+    const int length, const int twiddle_step, const datum* cosine,
+    const datum* sine, const bool inverse);
+
+  /*
+   * Sums of pointwise products of blocked spectra. Each block of a
+   * spectrum holds CN24_SPECTRUM_LANES frequencies of all planes, as the
+   * real parts followed by the imaginary parts. Computes
+   * product(i, j) = sum over l of a(i * a_row + l * a_inner) *
+   * b(j * b_column + l * b_inner), conjugating a or b if requested. The
+   * product has rows * columns planes.
+   */
+  void (*spectrum_product) (const datum* a, const datum* b, datum* product,
+    const int blocks, const int rows, const int columns, const int inner,
+    const int a_planes, const int a_row, const int a_inner,
+    const bool conjugate_a, const int b_planes, const int b_column,
+    const int b_inner, const bool conjugate_b);
+
+  /*
+   * Conversion to and from 16 bit storage, bfloat16 if bfloat is set and
+   * IEEE half precision otherwise. Rounds to the nearest even number, the
+   * results do not depend on the instruction set except for NaN payloads.
+   */
+  void (*pack_half) (const datum* source, std::uint16_t* target,
+    const std::size_t elements, const bool bfloat);
+  void (*unpack_half) (const std::uint16_t* source, datum* target,
+    const std::size_t elements, const bool bfloat);
+
+  /*
+   * Conversion from 8 bit storage, target = scale * source + offset. The
+   * results do not depend on the instruction set if offset is zero,
+   * otherwise they may differ in the last bit where an FMA is used.
+   */
+  void (*unpack_u8) (const std::uint8_t* source, datum* target,
+    const std::size_t elements, const datum scale, const datum offset);
+
+  /*
+   * 8 bit GEMM for quantized inference. pack_u8 quantizes the K x N matrix
+   * B(k, n) = B[k * k_stride + n * n_stride] to round(B / scale) + 128,
+   * saturated to [1, 255]. It stores panels of CN24_INT8_LANES columns,
+   * each a sequence of 4 consecutive k for every column, padding K to a
+   * multiple of 4 and N to a multiple of CN24_INT8_LANES. gemm_u8s8
+   * computes C(m, n) = scale[m] * (sum over k of A(m, k) * packed(k, n)
+   * - offset[m]) with C(m, n) at C[m * m_stride + n * n_stride]. A holds
+   * signed bytes in rows of K rounded up to a multiple of 4, zero padded.
+   */
+  void (*pack_u8) (const datum* B, const int K, const int N,
+    const int k_stride, const int n_stride, const datum scale,
+    std::uint8_t* packed);
+  void (*gemm_u8s8) (const int M, const int N, const int K,
+    const std::int8_t* A, const std::uint8_t* packed,
+    const std::int32_t* offset, const datum* scale, datum* C,
+    const int m_stride, const int n_stride);
+};
+
+class TensorMathKernels {
+public:
+  /**
+   * @brief Detects the CPU and binds the best supported kernel table.
+   *
+   * @param requested_isa Forces a specific instruction set if not empty.
+   *  Requests the host cannot execute are ignored with a warning.
+   */
+  static void Init(const std::string& requested_isa = "");
+
+  /**
+   * @brief Gets the currently bound kernel table.
+   *
+   * Binds the best supported table if Init has not been called yet.
+   */
+  static const TensorMathKernelTable& Get();
+
+  /**
+   * @brief Gets the best instruction set supported by this host.
+   */
+  static CPUInstructionSet DetectInstructionSet();
+
+  /**
+   * @brief Gets the kernel table for an instruction set, nullptr if
+   *  this build does not contain it.
+   */
+  static const TensorMathKernelTable* GetTable(CPUInstructionSet isa);
+
+  /**
+   * @brief Makes exp, tanh and sigmoid use libm in double precision instead
+   *  of the vectorized approximations, reproducing earlier results
+   *  bit by bit.
+   */
+  static void SetExactMath(const bool exact);
+  static bool IsExactMath();
+
+  static const char* GetInstructionSetName(CPUInstructionSet isa);
+  static bool ParseInstructionSet(const std::string& name, CPUInstructionSet& isa);
+};
+
+// Defined in the TensorMathKernels*.cpp files, one per instruction set
+const TensorMathKernelTable* GetGenericKernelTable();
+const TensorMathKernelTable* GetSSE42KernelTable();
+const TensorMathKernelTable* GetAVX2KernelTable();
+const TensorMathKernelTable* GetAVX512KernelTable();
+
+}
+
+#endif
@@ -0,0 +1,1453 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file TensorMathKernelsImpl.h
+ * @brief Kernel bodies shared by all instruction sets.
+ *
+ * This file is included once per instruction set, inside a namespace of its
+ * own, by the TensorMathKernels*.cpp files. It deliberately has no include
+ * guard. Before including it, the following macros have to be defined:
+ *
+ * CN24_KERNEL_TARGET     Function attribute selecting the instruction set
+ * CN24_KERNEL_ISA        The CPUInstructionSet value
+ * CN24_KERNEL_ISA_NAME   Name of the instruction set for logging
+ * CN24_VEC               Vector type, datum for the scalar build
+ * CN24_VEC_WIDTH         Number of datums in CN24_VEC
+ * CN24_VEC_ZERO() CN24_VEC_SET1(x) CN24_VEC_LOAD(p) CN24_VEC_STORE(p, v)
+ * CN24_VEC_ADD(a, b) CN24_VEC_MUL(a, b) CN24_VEC_FMA(a, b, c) = a * b + c
+ * CN24_VEC_SUB(a, b) CN24_VEC_DIV(a, b) CN24_VEC_MIN(a, b) CN24_VEC_MAX(a, b)
+ * CN24_VEC_ROUND(a)     Rounds to the nearest integer
+ * CN24_VEC_POW2(n)      2^n for integers n in [-126, 127]
+ *
+ * Optionally, CN24_VEC_TO_HALF(p, v) and CN24_VEC_FROM_HALF(p) convert
+ * CN24_VEC_WIDTH datums to and from IEEE half precision at p,
+ * CN24_VEC_FROM_U8(p) widens CN24_VEC_WIDTH unsigned bytes at p, and
+ * CN24_KERNEL_GEMM_U8S8 replaces the portable 8 bit GEMM. It has to be
+ * declared before and defined after including this file.
+ *
+ * If CN24_VEC_SCALAR is defined, a portable 4x8 GEMM micro-kernel is used
+ * instead of the vectorized 6 x (2 * CN24_VEC_WIDTH) one.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifdef CN24_VEC_SCALAR
+/*
+ * Portable micro-kernel. The inner loop has a constant trip count, so the
+ * compiler can still vectorize it for the baseline instruction set.
+ */
+template <int MR, int NR>
+CN24_KERNEL_TARGET static void MicroKernelTemplate(const int kc, const datum* a,
+  const datum* b, datum* c, const int ldc, const datum alpha, const datum beta) {
+  datum ab[MR * NR];
+  for(int i = 0; i < MR * NR; i++)
+    ab[i] = 0;
+
+  for(int k = 0; k < kc; k++) {
+    for(int i = 0; i < MR; i++) {
+      const datum a_value = a[i];
+      for(int j = 0; j < NR; j++)
+        ab[i * NR + j] += a_value * b[j];
+    }
+    a += MR;
+    b += NR;
+  }
+
+  if(beta == 0.0) {
+    for(int i = 0; i < MR; i++)
+      for(int j = 0; j < NR; j++)
+        c[i * ldc + j] = alpha * ab[i * NR + j];
+  } else {
+    for(int i = 0; i < MR; i++)
+      for(int j = 0; j < NR; j++)
+        c[i * ldc + j] = beta * c[i * ldc + j] + alpha * ab[i * NR + j];
+  }
+}
+
+#define CN24_GEMM_MR 4
+#define CN24_GEMM_NR 8
+CN24_KERNEL_TARGET static void MicroKernel(const int kc, const datum* a,
+  const datum* b, datum* c, const int ldc, const datum alpha, const datum beta) {
+  MicroKernelTemplate<CN24_GEMM_MR, CN24_GEMM_NR>(kc, a, b, c, ldc, alpha, beta);
+}
+#else
+/*
+ * 6 x (2 * CN24_VEC_WIDTH) micro-kernel: twelve vector accumulators, two
+ * registers for the row of B and one for the broadcast element of A.
+ */
+#define CN24_GEMM_MR 6
+#define CN24_GEMM_NR (2 * CN24_VEC_WIDTH)
+CN24_KERNEL_TARGET static void MicroKernel(const int kc, const datum* a,
+  const datum* b, datum* c, const int ldc, const datum alpha, const datum beta) {
+  CN24_VEC c00 = CN24_VEC_ZERO(), c01 = CN24_VEC_ZERO();
+  CN24_VEC c10 = CN24_VEC_ZERO(), c11 = CN24_VEC_ZERO();
+  CN24_VEC c20 = CN24_VEC_ZERO(), c21 = CN24_VEC_ZERO();
+  CN24_VEC c30 = CN24_VEC_ZERO(), c31 = CN24_VEC_ZERO();
+  CN24_VEC c40 = CN24_VEC_ZERO(), c41 = CN24_VEC_ZERO();
+  CN24_VEC c50 = CN24_VEC_ZERO(), c51 = CN24_VEC_ZERO();
+
+  for(int k = 0; k < kc; k++) {
+    const CN24_VEC b0 = CN24_VEC_LOAD(b);
+    const CN24_VEC b1 = CN24_VEC_LOAD(b + CN24_VEC_WIDTH);
+    CN24_VEC a_value;
+
+    a_value = CN24_VEC_SET1(a[0]);
+    c00 = CN24_VEC_FMA(a_value, b0, c00);
+    c01 = CN24_VEC_FMA(a_value, b1, c01);
+    a_value = CN24_VEC_SET1(a[1]);
+    c10 = CN24_VEC_FMA(a_value, b0, c10);
+    c11 = CN24_VEC_FMA(a_value, b1, c11);
+    a_value = CN24_VEC_SET1(a[2]);
+    c20 = CN24_VEC_FMA(a_value, b0, c20);
+    c21 = CN24_VEC_FMA(a_value, b1, c21);
+    a_value = CN24_VEC_SET1(a[3]);
+    c30 = CN24_VEC_FMA(a_value, b0, c30);
+    c31 = CN24_VEC_FMA(a_value, b1, c31);
+    a_value = CN24_VEC_SET1(a[4]);
+    c40 = CN24_VEC_FMA(a_value, b0, c40);
+    c41 = CN24_VEC_FMA(a_value, b1, c41);
+    a_value = CN24_VEC_SET1(a[5]);
+    c50 = CN24_VEC_FMA(a_value, b0, c50);
+    c51 = CN24_VEC_FMA(a_value, b1, c51);
+
+    a += CN24_GEMM_MR;
+    b += CN24_GEMM_NR;
+  }
+
+  const CN24_VEC valpha = CN24_VEC_SET1(alpha);
+  if(beta == 0.0) {
+#define CN24_STORE_ROW(r) \
+    CN24_VEC_STORE(c + r * ldc, CN24_VEC_MUL(valpha, c##r##0)); \
+    CN24_VEC_STORE(c + r * ldc + CN24_VEC_WIDTH, CN24_VEC_MUL(valpha, c##r##1));
+    CN24_STORE_ROW(0) CN24_STORE_ROW(1) CN24_STORE_ROW(2)
+    CN24_STORE_ROW(3) CN24_STORE_ROW(4) CN24_STORE_ROW(5)
+#undef CN24_STORE_ROW
+  } else {
+    const CN24_VEC vbeta = CN24_VEC_SET1(beta);
+#define CN24_UPDATE_ROW(r) \
+    CN24_VEC_STORE(c + r * ldc, CN24_VEC_FMA(valpha, c##r##0, \
+      CN24_VEC_MUL(vbeta, CN24_VEC_LOAD(c + r * ldc)))); \
+    CN24_VEC_STORE(c + r * ldc + CN24_VEC_WIDTH, CN24_VEC_FMA(valpha, c##r##1, \
+      CN24_VEC_MUL(vbeta, CN24_VEC_LOAD(c + r * ldc + CN24_VEC_WIDTH))));
+    CN24_UPDATE_ROW(0) CN24_UPDATE_ROW(1) CN24_UPDATE_ROW(2)
+    CN24_UPDATE_ROW(3) CN24_UPDATE_ROW(4) CN24_UPDATE_ROW(5)
+#undef CN24_UPDATE_ROW
+  }
+}
+#endif
+
+/*
+ * Helpers for contiguous rows
+ */
+CN24_KERNEL_TARGET static datum Dot(const datum* a, const datum* b, const int n) {
+  CN24_VEC sum0 = CN24_VEC_ZERO(), sum1 = CN24_VEC_ZERO();
+  int i = 0;
+  for(; i + 2 * CN24_VEC_WIDTH <= n; i += 2 * CN24_VEC_WIDTH) {
+    sum0 = CN24_VEC_FMA(CN24_VEC_LOAD(a + i), CN24_VEC_LOAD(b + i), sum0);
+    sum1 = CN24_VEC_FMA(CN24_VEC_LOAD(a + i + CN24_VEC_WIDTH),
+                        CN24_VEC_LOAD(b + i + CN24_VEC_WIDTH), sum1);
+  }
+  datum lanes[CN24_VEC_WIDTH];
+  CN24_VEC_STORE(lanes, CN24_VEC_ADD(sum0, sum1));
+  datum sum = 0;
+  for(int l = 0; l < CN24_VEC_WIDTH; l++)
+    sum += lanes[l];
+  for(; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+// target += factor * source
+CN24_KERNEL_TARGET static void Axpy(datum* target, const datum* source,
+  const datum factor, const int n) {
+  const CN24_VEC vfactor = CN24_VEC_SET1(factor);
+  int i = 0;
+  for(; i + CN24_VEC_WIDTH <= n; i += CN24_VEC_WIDTH)
+    CN24_VEC_STORE(target + i, CN24_VEC_FMA(vfactor, CN24_VEC_LOAD(source + i),
+                                            CN24_VEC_LOAD(target + i)));
+  for(; i < n; i++)
+    target[i] += factor * source[i];
+}
+
+// target += source
+CN24_KERNEL_TARGET static void Accumulate(datum* target, const datum* source, const int n) {
+  int i = 0;
+  for(; i + CN24_VEC_WIDTH <= n; i += CN24_VEC_WIDTH)
+    CN24_VEC_STORE(target + i, CN24_VEC_ADD(CN24_VEC_LOAD(target + i),
+                                            CN24_VEC_LOAD(source + i)));
+  for(; i < n; i++)
+    target[i] += source[i];
+}
+
+CN24_KERNEL_TARGET static void Copy(datum* target, const datum* source, const int n) {
+  int i = 0;
+  for(; i + CN24_VEC_WIDTH <= n; i += CN24_VEC_WIDTH)
+    CN24_VEC_STORE(target + i, CN24_VEC_LOAD(source + i));
+  for(; i < n; i++)
+    target[i] = source[i];
+}
+
+CN24_KERNEL_TARGET static void Fill(datum* target, const datum value, const int n) {
+  const CN24_VEC vvalue = CN24_VEC_SET1(value);
+  int i = 0;
+  for(; i + CN24_VEC_WIDTH <= n; i += CN24_VEC_WIDTH)
+    CN24_VEC_STORE(target + i, vvalue);
+  for(; i < n; i++)
+    target[i] = value;
+}
+
+CN24_KERNEL_TARGET static void Scale(datum* target, const datum factor, const int n) {
+  const CN24_VEC vfactor = CN24_VEC_SET1(factor);
+  int i = 0;
+  for(; i + CN24_VEC_WIDTH <= n; i += CN24_VEC_WIDTH)
+    CN24_VEC_STORE(target + i, CN24_VEC_MUL(vfactor, CN24_VEC_LOAD(target + i)));
+  for(; i < n; i++)
+    target[i] *= factor;
+}
+
+/*
+ * Range of output columns [begin, end) whose input column
+ * ox * stride - pad + kx lies inside [0, image_width).
+ */
+static inline void ValidColumnRange(const int image_width, const int columns,
+  const int stride, const int pad, const int kx, int& begin, int& end) {
+  const int first = pad - kx;
+  begin = first > 0 ? (first + stride - 1) / stride : 0;
+  const int limit = image_width + pad - kx;
+  end = limit > 0 ? std::min(columns, (limit + stride - 1) / stride) : 0;
+  if(begin > end)
+    begin = end;
+}
+
+/*
+ * TensorMath kernels
+ */
+CN24_KERNEL_TARGET static void GEMV(const bool transpose_A, const int M,
+  const int N, const datum alpha, const datum* A, const int ldA,
+  const datum* X, const int incX, const datum beta, datum* Y, const int incY) {
+  if(!transpose_A) {
+    #pragma omp parallel for default(shared)
+    for(int i = 0; i < M; i++) {
+      const datum* a_row = A + (std::size_t)i * ldA;
+      datum sum = 0;
+      if(incX == 1) {
+        sum = Dot(a_row, X, N);
+      } else {
+        for(int j = 0; j < N; j++)
+          sum += a_row[j] * X[j * incX];
+      }
+      if(beta == 0.0)
+        Y[i * incY] = alpha * sum;
+      else
+        Y[i * incY] = beta * Y[i * incY] + alpha * sum;
+    }
+  } else {
+    // Y_j = sum_i A_ij X_i, walked along the rows of A in chunks of Y
+    const int chunk_size = 512;
+    const int chunks = (N + chunk_size - 1) / chunk_size;
+    #pragma omp parallel for default(shared)
+    for(int chunk = 0; chunk < chunks; chunk++) {
+      const int j0 = chunk * chunk_size;
+      const int n = std::min(chunk_size, N - j0);
+      datum sums[chunk_size];
+      Fill(sums, 0, n);
+      for(int i = 0; i < M; i++)
+        Axpy(sums, A + (std::size_t)i * ldA + j0, X[i * incX], n);
+      for(int j = 0; j < n; j++) {
+        datum* y = Y + (j0 + j) * incY;
+        if(beta == 0.0)
+          *y = alpha * sums[j];
+        else
+          *y = beta * *y + alpha * sums[j];
+      }
+    }
+  }
+}
+
+CN24_KERNEL_TARGET static void IM2COL(const datum* image, datum* columns,
+  const int image_width, const int image_height, const int maps,
+  const int samples, const int kernel_width, const int kernel_height,
+  const int stride_width, const int stride_height, const int pad_width,
+  const int pad_height) {
+  const int target_width = (2 * pad_width + image_width - kernel_width) / stride_width + 1;
+  const int target_height = (2 * pad_height + image_height - kernel_height) / stride_height + 1;
+  const int target_maps = kernel_width * kernel_height * maps;
+  const std::size_t target_map_size = (std::size_t)samples * target_width * target_height;
+
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < samples * target_maps; task++) {
+    const int sample = task / target_maps;
+    const int target_map = task % target_maps;
+    const int kx = target_map % kernel_width;
+    const int ky = (target_map / kernel_width) % kernel_height;
+    const int imap = target_map / (kernel_width * kernel_height);
+
+    const datum* image_plane = image + ((std::size_t)sample * maps + imap) * image_width * image_height;
+    datum* target_plane = columns + target_map * target_map_size
+      + (std::size_t)sample * target_width * target_height;
+
+    int ox_begin, ox_end;
+    ValidColumnRange(image_width, target_width, stride_width, pad_width, kx, ox_begin, ox_end);
+
+    for(int oy = 0; oy < target_height; oy++) {
+      datum* target_row = target_plane + oy * target_width;
+      const int iy = oy * stride_height - pad_height + ky;
+      if(iy < 0 || iy >= image_height) {
+        Fill(target_row, 0, target_width);
+        continue;
+      }
+      const datum* image_row = image_plane + iy * image_width - pad_width + kx;
+      Fill(target_row, 0, ox_begin);
+      if(stride_width == 1) {
+        Copy(target_row + ox_begin, image_row + ox_begin, ox_end - ox_begin);
+      } else {
+        for(int ox = ox_begin; ox < ox_end; ox++)
+          target_row[ox] = image_row[ox * stride_width];
+      }
+      Fill(target_row + ox_end, 0, target_width - ox_end);
+    }
+  }
+}
+
+/*
+ * Every task owns one (sample, input map) plane, so there are no write
+ * conflicts. Each image row gathers the column rows that overlap it while it
+ * is hot in cache. The first contribution is written instead of added, which
+ * replaces the separate zeroing pass over the whole image.
+ */
+CN24_KERNEL_TARGET static void COL2IM(datum* image, const datum* columns,
+  const int image_width, const int image_height, const int maps,
+  const int samples, const int kernel_width, const int kernel_height,
+  const int stride_width, const int stride_height, const int pad_width,
+  const int pad_height) {
+  const int target_width = (2 * pad_width + image_width - kernel_width) / stride_width + 1;
+  const int target_height = (2 * pad_height + image_height - kernel_height) / stride_height + 1;
+  const std::size_t target_map_size = (std::size_t)samples * target_width * target_height;
+
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < samples * maps; task++) {
+    const int sample = task / maps;
+    const int imap = task % maps;
+    datum* image_plane = image + ((std::size_t)sample * maps + imap) * image_width * image_height;
+
+    for(int iy = 0; iy < image_height; iy++) {
+      datum* image_row = image_plane + iy * image_width;
+      bool written = false;
+
+      for(int ky = 0; ky < kernel_height; ky++) {
+        const int oy_scaled = iy + pad_height - ky;
+        if(oy_scaled < 0 || oy_scaled % stride_height != 0)
+          continue;
+        const int oy = oy_scaled / stride_height;
+        if(oy >= target_height)
+          continue;
+
+        for(int kx = 0; kx < kernel_width; kx++) {
+          const int target_map = (imap * kernel_height + ky) * kernel_width + kx;
+          const datum* target_row = columns + target_map * target_map_size
+            + ((std::size_t)sample * target_height + oy) * target_width;
+
+          int ox_begin, ox_end;
+          ValidColumnRange(image_width, target_width, stride_width, pad_width, kx, ox_begin, ox_end);
+          if(ox_begin == ox_end)
+            continue;
+
+          // image_row[ox * stride_width + shift] receives target_row[ox]
+          const int shift = kx - pad_width;
+          if(stride_width == 1) {
+            if(!written) {
+              const int ix_begin = ox_begin + shift, ix_end = ox_end + shift;
+              Fill(image_row, 0, ix_begin);
+              Copy(image_row + ix_begin, target_row + ox_begin, ix_end - ix_begin);
+              Fill(image_row + ix_end, 0, image_width - ix_end);
+            } else {
+              Accumulate(image_row + ox_begin + shift, target_row + ox_begin, ox_end - ox_begin);
+            }
+          } else {
+            if(!written)
+              Fill(image_row, 0, image_width);
+            for(int ox = ox_begin; ox < ox_end; ox++)
+              image_row[ox * stride_width + shift] += target_row[ox];
+          }
+          written = true;
+        }
+      }
+
+      if(!written)
+        Fill(image_row, 0, image_width);
+    }
+  }
+}
+
+CN24_KERNEL_TARGET static void SMS(const datum* source, datum* target,
+  const int width, const int height, const int maps, const int samples) {
+  const std::size_t plane_size = (std::size_t)width * height;
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < samples * maps; task++) {
+    const int sample = task / maps;
+    const int map = task % maps;
+    std::memcpy(target + ((std::size_t)sample * maps + map) * plane_size,
+                source + ((std::size_t)map * samples + sample) * plane_size,
+                sizeof(datum) * plane_size);
+  }
+}
+
+CN24_KERNEL_TARGET static void DOWN(const datum* source, datum* target,
+  const int source_width, const int source_height, const int target_width,
+  const int target_height, const int planes, const int region_width,
+  const int region_height, const datum target_factor) {
+  #pragma omp parallel for default(shared)
+  for(int plane = 0; plane < planes; plane++) {
+    const datum* source_plane = source + (std::size_t)plane * source_width * source_height;
+    datum* target_plane = target + (std::size_t)plane * target_width * target_height;
+    for(int target_y = 0; target_y < target_height; target_y++) {
+      datum* target_row = target_plane + target_y * target_width;
+      Fill(target_row, 0, target_width);
+      for(int ry = 0; ry < region_height; ry++) {
+        const datum* source_row = source_plane + (target_y * region_height + ry) * source_width;
+        if(region_width == 1) {
+          Accumulate(target_row, source_row, target_width);
+        } else {
+          for(int target_x = 0; target_x < target_width; target_x++)
+            for(int rx = 0; rx < region_width; rx++)
+              target_row[target_x] += source_row[target_x * region_width + rx];
+        }
+      }
+      Scale(target_row, target_factor, target_width);
+    }
+  }
+}
+
+CN24_KERNEL_TARGET static void UP(const datum* source, datum* target,
+  const int source_width, const int source_height, const int target_width,
+  const int target_height, const int planes, const int region_width,
+  const int region_height, const datum target_factor) {
+  #pragma omp parallel for default(shared)
+  for(int plane = 0; plane < planes; plane++) {
+    const datum* source_plane = source + (std::size_t)plane * source_width * source_height;
+    datum* target_plane = target + (std::size_t)plane * target_width * target_height;
+    for(int y = 0; y < source_height; y++) {
+      const datum* source_row = source_plane + y * source_width;
+      datum* target_row = target_plane + (y * region_height) * target_width;
+      for(int x = 0; x < source_width; x++) {
+        const datum value = source_row[x] * target_factor;
+        for(int rx = 0; rx < region_width; rx++)
+          target_row[x * region_width + rx] = value;
+      }
+      for(int ry = 1; ry < region_height; ry++)
+        Copy(target_row + ry * target_width, target_row, source_width * region_width);
+    }
+  }
+}
+
+CN24_KERNEL_TARGET static void ADD(const datum* source_a, const datum* source_b,
+  datum* target, const std::size_t elements) {
+  const int chunk_size = 16384;
+  const int chunks = (int)((elements + chunk_size - 1) / chunk_size);
+  #pragma omp parallel for default(shared)
+  for(int chunk = 0; chunk < chunks; chunk++) {
+    const std::size_t begin = (std::size_t)chunk * chunk_size;
+    const int n = (int)std::min((std::size_t)chunk_size, elements - begin);
+    const datum* a = source_a + begin;
+    const datum* b = source_b + begin;
+    datum* t = target + begin;
+    int i = 0;
+    for(; i + CN24_VEC_WIDTH <= n; i += CN24_VEC_WIDTH)
+      CN24_VEC_STORE(t + i, CN24_VEC_ADD(CN24_VEC_LOAD(a + i), CN24_VEC_LOAD(b + i)));
+    for(; i < n; i++)
+      t[i] = a[i] + b[i];
+  }
+}
+
+/*
+ * Elementwise transcendentals. VecExp follows Cephes' expf: exp(x) =
+ * 2^n * p(r) with n = round(x / ln 2) and a degree 7 polynomial p on
+ * |r| <= ln(2) / 2. Arguments are clamped to [-87.3, 88], so the result
+ * stays finite and normalized. VecTanh is a 13/6 rational approximation
+ * on [-7.9, 7.9], where tanh rounds to +-1 outside. VecSigmoid is
+ * 1 / (1 + exp(-x)). Compared to double precision libm, the maximum
+ * relative error is 2e-7 for exp, 3e-7 for sigmoid above -80 and 5e-7
+ * for tanh. The TensorMathKernels test checks these bounds for all
+ * instruction sets.
+ *
+ * ExactActivation computes the same functions in double precision using
+ * libm, as the NonLinearityLayers did before, for bit-exact reproduction.
+ */
+CN24_KERNEL_TARGET static inline CN24_VEC VecExp(CN24_VEC x) {
+  x = CN24_VEC_MIN(CN24_VEC_MAX(x, CN24_VEC_SET1(-87.33654f)), CN24_VEC_SET1(88.0f));
+  const CN24_VEC n = CN24_VEC_ROUND(CN24_VEC_MUL(x, CN24_VEC_SET1(1.44269504088896341f)));
+  // ln 2 in two parts, so r is exact
+  CN24_VEC r = CN24_VEC_FMA(n, CN24_VEC_SET1(-0.693359375f), x);
+  r = CN24_VEC_FMA(n, CN24_VEC_SET1(2.12194440e-4f), r);
+  CN24_VEC p = CN24_VEC_SET1(1.9875691500e-4f);
+  p = CN24_VEC_FMA(p, r, CN24_VEC_SET1(1.3981999507e-3f));
+  p = CN24_VEC_FMA(p, r, CN24_VEC_SET1(8.3334519073e-3f));
+  p = CN24_VEC_FMA(p, r, CN24_VEC_SET1(4.1665795894e-2f));
+  p = CN24_VEC_FMA(p, r, CN24_VEC_SET1(1.6666665459e-1f));
+  p = CN24_VEC_FMA(p, r, CN24_VEC_SET1(5.0000001201e-1f));
+  p = CN24_VEC_FMA(p, CN24_VEC_MUL(r, r), CN24_VEC_ADD(r, CN24_VEC_SET1(1.0f)));
+  return CN24_VEC_MUL(p, CN24_VEC_POW2(n));
+}
+
+CN24_KERNEL_TARGET static inline CN24_VEC VecTanh(CN24_VEC x) {
+  x = CN24_VEC_MIN(CN24_VEC_MAX(x, CN24_VEC_SET1(-7.90531110763549805f)),
+    CN24_VEC_SET1(7.90531110763549805f));
+  const CN24_VEC x2 = CN24_VEC_MUL(x, x);
+  CN24_VEC p = CN24_VEC_SET1(-2.76076847742355e-16f);
+  p = CN24_VEC_FMA(p, x2, CN24_VEC_SET1(2.00018790482477e-13f));
+  p = CN24_VEC_FMA(p, x2, CN24_VEC_SET1(-8.60467152213735e-11f));
+  p = CN24_VEC_FMA(p, x2, CN24_VEC_SET1(5.12229709037114e-08f));
+  p = CN24_VEC_FMA(p, x2, CN24_VEC_SET1(1.48572235717979e-05f));
+  p = CN24_VEC_FMA(p, x2, CN24_VEC_SET1(6.37261928875436e-04f));
+  p = CN24_VEC_FMA(p, x2, CN24_VEC_SET1(4.89352455891786e-03f));
+  p = CN24_VEC_MUL(p, x);
+  CN24_VEC q = CN24_VEC_SET1(1.19825839466702e-06f);
+  q = CN24_VEC_FMA(q, x2, CN24_VEC_SET1(1.18534705686654e-04f));
+  q = CN24_VEC_FMA(q, x2, CN24_VEC_SET1(2.26843463243900e-03f));
+  q = CN24_VEC_FMA(q, x2, CN24_VEC_SET1(4.89352518554385e-03f));
+  return CN24_VEC_DIV(p, q);
+}
+
+CN24_KERNEL_TARGET static inline CN24_VEC VecSigmoid(const CN24_VEC x) {
+  const CN24_VEC one = CN24_VEC_SET1(1.0f);
+  return CN24_VEC_DIV(one, CN24_VEC_ADD(one, VecExp(CN24_VEC_SUB(CN24_VEC_ZERO(), x))));
+}
+
+CN24_KERNEL_TARGET static inline CN24_VEC VecActivation(const CN24_VEC x,
+  const ActivationFunction activation) {
+  switch(activation) {
+    case ACTIVATION_RELU:
+      return CN24_VEC_MAX(x, CN24_VEC_ZERO());
+    case ACTIVATION_TANH:
+      return VecTanh(x);
+    case ACTIVATION_SIGMOID:
+      return VecSigmoid(x);
+    default:
+      return x;
+  }
+}
+
+CN24_KERNEL_TARGET static inline datum ExactActivation(const datum x,
+  const ActivationFunction activation) {
+  switch(activation) {
+    case ACTIVATION_RELU:
+      return x > 0 ? x : 0;
+    case ACTIVATION_TANH:
+      return (datum)(1.0 - 2.0 / (std::exp(2.0 * x) + 1.0));
+    case ACTIVATION_SIGMOID:
+      return (datum)(1.0 / (1.0 + std::exp(-(double)x)));
+    default:
+      return x;
+  }
+}
+
+CN24_KERNEL_TARGET static void EXP(const datum* source, datum* target,
+  const std::size_t elements, const bool exact) {
+  const std::size_t block = 4096;
+  #pragma omp parallel for default(shared)
+  for(std::size_t b = 0; b < (elements + block - 1) / block; b++) {
+    const std::size_t begin = b * block;
+    const std::size_t end = std::min(elements, begin + block);
+    std::size_t i = begin;
+    if(exact) {
+      for(; i < end; i++)
+        target[i] = (datum)std::exp((double)source[i]);
+      continue;
+    }
+    for(; i + CN24_VEC_WIDTH <= end; i += CN24_VEC_WIDTH)
+      CN24_VEC_STORE(target + i, VecExp(CN24_VEC_LOAD(source + i)));
+    if(i < end) {
+      datum tail[CN24_VEC_WIDTH] = {0};
+      for(std::size_t j = 0; i + j < end; j++)
+        tail[j] = source[i + j];
+      CN24_VEC_STORE(tail, VecExp(CN24_VEC_LOAD(tail)));
+      for(std::size_t j = 0; i + j < end; j++)
+        target[i + j] = tail[j];
+    }
+  }
+}
+
+/*
+ * Activations and convolution epilogues. The gradients of one row are
+ * computed in blocks of CN24_EPILOGUE_LANES, the constant trip count lets
+ * the compiler vectorize the ReLU masks.
+ */
+#define CN24_EPILOGUE_LANES 16
+
+// Computes target = f(scale * source + offset), source may be target
+CN24_KERNEL_TARGET static void ActivateRow(const datum* source, datum* target,
+  const int n, const datum scale, const datum offset,
+  const ActivationFunction activation, const bool exact) {
+  if(exact && (activation == ACTIVATION_TANH || activation == ACTIVATION_SIGMOID)) {
+    for(int i = 0; i < n; i++)
+      target[i] = ExactActivation(scale * source[i] + offset, activation);
+    return;
+  }
+  const CN24_VEC vscale = CN24_VEC_SET1(scale);
+  const CN24_VEC voffset = CN24_VEC_SET1(offset);
+  int i = 0;
+  for(; i + CN24_VEC_WIDTH <= n; i += CN24_VEC_WIDTH)
+    CN24_VEC_STORE(target + i, VecActivation(CN24_VEC_FMA(CN24_VEC_LOAD(source + i),
+      vscale, voffset), activation));
+  if(i < n) {
+    // The tail goes through the vector code as well, so results do not
+    // depend on the alignment of the row
+    datum tail[CN24_VEC_WIDTH] = {0};
+    for(int j = 0; i + j < n; j++)
+      tail[j] = source[i + j];
+    CN24_VEC_STORE(tail, VecActivation(CN24_VEC_FMA(CN24_VEC_LOAD(tail),
+      vscale, voffset), activation));
+    for(int j = 0; i + j < n; j++)
+      target[i + j] = tail[j];
+  }
+}
+
+// delta = output_delta * f'(x), returns the sum of delta
+CN24_KERNEL_TARGET static datum ActivationGradientRow(const datum* output,
+  const datum* output_delta, datum* delta, const int n,
+  const ActivationFunction activation) {
+  datum lanes[CN24_EPILOGUE_LANES] = {0};
+  datum block[CN24_EPILOGUE_LANES];
+  int i = 0;
+  for(; i + CN24_EPILOGUE_LANES <= n; i += CN24_EPILOGUE_LANES) {
+    const datum* y = output + i;
+    const datum* dy = output_delta + i;
+    switch(activation) {
+      case ACTIVATION_NONE:
+        for(int l = 0; l < CN24_EPILOGUE_LANES; l++)
+          block[l] = dy[l];
+        break;
+      case ACTIVATION_RELU:
+        for(int l = 0; l < CN24_EPILOGUE_LANES; l++)
+          block[l] = y[l] > 0 ? dy[l] : 0;
+        break;
+      case ACTIVATION_TANH:
+        for(int l = 0; l < CN24_EPILOGUE_LANES; l++)
+          block[l] = dy[l] * ((datum)1.0 - y[l] * y[l]);
+        break;
+      case ACTIVATION_SIGMOID:
+        for(int l = 0; l < CN24_EPILOGUE_LANES; l++)
+          block[l] = dy[l] * y[l] * ((datum)1.0 - y[l]);
+        break;
+    }
+    for(int l = 0; l < CN24_EPILOGUE_LANES; l++)
+      lanes[l] += block[l];
+    if(delta != nullptr)
+      std::memcpy(delta + i, block, sizeof(block));
+  }
+  datum sum = 0;
+  for(int l = 0; l < CN24_EPILOGUE_LANES; l++)
+    sum += lanes[l];
+  for(; i < n; i++) {
+    datum value = output_delta[i];
+    switch(activation) {
+      case ACTIVATION_NONE: break;
+      case ACTIVATION_RELU: value = output[i] > 0 ? value : 0; break;
+      case ACTIVATION_TANH: value *= (datum)1.0 - output[i] * output[i]; break;
+      case ACTIVATION_SIGMOID: value *= output[i] * ((datum)1.0 - output[i]); break;
+    }
+    sum += value;
+    if(delta != nullptr)
+      delta[i] = value;
+  }
+  return sum;
+}
+
+CN24_KERNEL_TARGET static void BIAS_ACTIVATION(datum* image, const int pixels,
+  const int maps, const int samples, const datum alpha, const datum* bias,
+  const ActivationFunction activation, const bool exact) {
+  #pragma omp parallel for default(shared)
+  for(int plane = 0; plane < samples * maps; plane++) {
+    const datum offset = bias == nullptr ? 0 : alpha * bias[plane % maps];
+    datum* row = image + (std::size_t)plane * pixels;
+    if(offset != 0 || activation != ACTIVATION_NONE)
+      ActivateRow(row, row, pixels, 1, offset, activation, exact);
+  }
+}
+
+CN24_KERNEL_TARGET static void ACTIVATION(const datum* source, datum* target,
+  const std::size_t elements, const datum scale, const datum offset,
+  const ActivationFunction activation, const bool exact) {
+  const std::size_t block = 4096;
+  #pragma omp parallel for default(shared)
+  for(std::size_t b = 0; b < (elements + block - 1) / block; b++) {
+    const std::size_t begin = b * block;
+    ActivateRow(source + begin, target + begin,
+      (int)(std::min(elements, begin + block) - begin), scale, offset,
+      activation, exact);
+  }
+}
+
+CN24_KERNEL_TARGET static void ACTIVATION_GRADIENT(const datum* output,
+  const datum* output_delta, datum* delta, const int pixels, const int maps,
+  const int samples, const ActivationFunction activation, datum* bias_delta) {
+  if(activation == ACTIVATION_NONE)
+    delta = nullptr;
+  #pragma omp parallel for default(shared)
+  for(int map = 0; map < maps; map++) {
+    datum sum = 0;
+    for(int sample = 0; sample < samples; sample++) {
+      const std::size_t offset = ((std::size_t)sample * maps + map) * pixels;
+      sum += ActivationGradientRow(output + offset, output_delta + offset,
+        delta == nullptr ? nullptr : delta + offset, pixels, activation);
+    }
+    if(bias_delta != nullptr)
+      bias_delta[map] = sum;
+  }
+}
+
+#undef CN24_EPILOGUE_LANES
+
+/*
+ * Winograd F(4x4, 3x3), see Lavin and Gray, "Fast Algorithms for
+ * Convolutional Neural Networks". Groups of CN24_WINOGRAD_LANES tiles are
+ * transformed together, element e of tile i is stored at
+ * [e * CN24_WINOGRAD_LANES + i] so that the transforms vectorize across
+ * tiles. The 1D transforms read with stride s and write with stride t.
+ * Tiles are transformed column by column first and row by row second.
+ */
+#define CN24_WINOGRAD_LANES 16
+
+CN24_KERNEL_TARGET static inline void WinogradBT(const datum* d, const int s,
+  datum* __restrict r, const int t) {
+  for(int i = 0; i < CN24_WINOGRAD_LANES; i++) {
+    const datum d0 = d[i], d1 = d[s + i], d2 = d[2 * s + i];
+    const datum d3 = d[3 * s + i], d4 = d[4 * s + i], d5 = d[5 * s + i];
+    r[i] = 4 * d0 - 5 * d2 + d4;
+    r[t + i] = d3 + d4 - 4 * (d1 + d2);
+    r[2 * t + i] = 4 * (d1 - d2) - d3 + d4;
+    r[3 * t + i] = 2 * (d3 - d1) - d2 + d4;
+    r[4 * t + i] = 2 * (d1 - d3) - d2 + d4;
+    r[5 * t + i] = 4 * d1 - 5 * d3 + d5;
+  }
+}
+
+CN24_KERNEL_TARGET static inline void WinogradAT(const datum* m, const int s,
+  datum* __restrict r, const int t) {
+  for(int i = 0; i < CN24_WINOGRAD_LANES; i++) {
+    const datum sum12 = m[s + i] + m[2 * s + i], diff12 = m[s + i] - m[2 * s + i];
+    const datum sum34 = m[3 * s + i] + m[4 * s + i], diff34 = m[3 * s + i] - m[4 * s + i];
+    r[i] = m[i] + sum12 + sum34;
+    r[t + i] = diff12 + 2 * diff34;
+    r[2 * t + i] = sum12 + 4 * sum34;
+    r[3 * t + i] = diff12 + 8 * diff34 + m[5 * s + i];
+  }
+}
+
+CN24_KERNEL_TARGET static inline void WinogradA(const datum* y, const int s,
+  datum* __restrict r, const int t) {
+  for(int i = 0; i < CN24_WINOGRAD_LANES; i++) {
+    const datum y0 = y[i], y1 = y[s + i], y2 = y[2 * s + i], y3 = y[3 * s + i];
+    r[i] = y0;
+    r[t + i] = y0 + y1 + y2 + y3;
+    r[2 * t + i] = y0 - y1 + y2 - y3;
+    r[3 * t + i] = y0 + 2 * y1 + 4 * y2 + 8 * y3;
+    r[4 * t + i] = y0 - 2 * y1 + 4 * y2 - 8 * y3;
+    r[5 * t + i] = y3;
+  }
+}
+
+CN24_KERNEL_TARGET static inline void WinogradG(const datum* g, const int s,
+  datum* __restrict r, const int t) {
+  for(int i = 0; i < CN24_WINOGRAD_LANES; i++) {
+    const datum g0 = g[i], g1 = g[s + i], g2 = g[2 * s + i];
+    r[i] = g0 / 4;
+    r[t + i] = -(g0 + g1 + g2) / 6;
+    r[2 * t + i] = -(g0 - g1 + g2) / 6;
+    r[3 * t + i] = g0 / 24 + g1 / 12 + g2 / 6;
+    r[4 * t + i] = g0 / 24 - g1 / 12 + g2 / 6;
+    r[5 * t + i] = g2;
+  }
+}
+
+CN24_KERNEL_TARGET static inline void WinogradGT(const datum* u, const int s,
+  datum* __restrict r, const int t) {
+  for(int i = 0; i < CN24_WINOGRAD_LANES; i++) {
+    const datum u0 = u[i], u1 = u[s + i], u2 = u[2 * s + i];
+    const datum u3 = u[3 * s + i], u4 = u[4 * s + i], u5 = u[5 * s + i];
+    r[i] = u0 / 4 - (u1 + u2) / 6 + (u3 + u4) / 24;
+    r[t + i] = (u2 - u1) / 6 + (u3 - u4) / 12;
+    r[2 * t + i] = (u3 + u4 - u1 - u2) / 6 + u5;
+  }
+}
+
+/*
+ * Tile (tx, ty) starts at input pixel (4 * tx + offset_x, 4 * ty + offset_y),
+ * everything outside the image is zero.
+ */
+CN24_KERNEL_TARGET static void WINOGRAD_INPUT(const datum* image,
+  datum* transformed, const int width, const int height, const int maps,
+  const int samples, const int offset_x, const int offset_y,
+  const int tiles_x, const int tiles_y) {
+  const int lanes = CN24_WINOGRAD_LANES;
+  const std::size_t sample_tiles = (std::size_t)tiles_x * tiles_y;
+  const std::size_t element_stride = (std::size_t)maps * samples * sample_tiles;
+  const int tasks = samples * maps * tiles_y;
+
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < tasks; task++) {
+    const int plane = task / tiles_y, ty = task % tiles_y;
+    const int sample = plane / maps, map = plane % maps;
+    const datum* source = image + (std::size_t)plane * width * height;
+    datum* target = transformed + ((std::size_t)map * samples + sample) * sample_tiles
+      + (std::size_t)ty * tiles_x;
+    const int y0 = 4 * ty + offset_y;
+
+    for(int tx0 = 0; tx0 < tiles_x; tx0 += lanes) {
+      const int n = std::min(lanes, tiles_x - tx0);
+      const int x0 = 4 * tx0 + offset_x;
+      // Pixels x0 + [first, last) of each row are inside the image
+      const int first = std::max(0, -x0);
+      const int last = std::max(first, std::min(4 * n + 2, width - x0));
+      datum d[36 * CN24_WINOGRAD_LANES], t[36 * CN24_WINOGRAD_LANES];
+      datum padded_row[4 * CN24_WINOGRAD_LANES + 2];
+
+      for(int y = 0; y < 6; y++) {
+        const int iy = y0 + y;
+        const datum* row = padded_row;
+        if(iy < 0 || iy >= height) {
+          Fill(padded_row, 0, 4 * lanes + 2);
+        } else if(first == 0 && last == 4 * lanes + 2) {
+          row = source + iy * width + x0;
+        } else {
+          Fill(padded_row, 0, first);
+          Copy(padded_row + first, source + iy * width + x0 + first, last - first);
+          Fill(padded_row + last, 0, 4 * lanes + 2 - last);
+        }
+        for(int x = 0; x < 6; x++) {
+          datum* lane = d + (6 * y + x) * lanes;
+          for(int i = 0; i < lanes; i++)
+            lane[i] = row[4 * i + x];
+        }
+      }
+
+      for(int x = 0; x < 6; x++)
+        WinogradBT(d + x * lanes, 6 * lanes, t + x * lanes, 6 * lanes);
+      for(int y = 0; y < 6; y++)
+        WinogradBT(t + 6 * y * lanes, lanes, d + 6 * y * lanes, lanes);
+
+      for(int e = 0; e < 36; e++)
+        Copy(target + e * element_stride + tx0, d + e * lanes, n);
+    }
+  }
+}
+
+/*
+ * Overwrites the image with alpha * (A^T M A + bias). Tile (tx, ty) covers
+ * the pixels from (4 * tx, 4 * ty), bias may be nullptr.
+ */
+CN24_KERNEL_TARGET static void WINOGRAD_OUTPUT(const datum* transformed,
+  datum* image, const int width, const int height, const int maps,
+  const int samples, const int tiles_x, const int tiles_y, const datum alpha,
+  const datum* bias) {
+  const int lanes = CN24_WINOGRAD_LANES;
+  const std::size_t sample_tiles = (std::size_t)tiles_x * tiles_y;
+  const std::size_t element_stride = (std::size_t)maps * samples * sample_tiles;
+  const int tasks = samples * maps * tiles_y;
+
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < tasks; task++) {
+    const int plane = task / tiles_y, ty = task % tiles_y;
+    const int sample = plane / maps, map = plane % maps;
+    datum* target = image + (std::size_t)plane * width * height;
+    const datum* source = transformed + ((std::size_t)map * samples + sample) * sample_tiles
+      + (std::size_t)ty * tiles_x;
+    const datum offset = bias == nullptr ? 0 : bias[map];
+    const int y0 = 4 * ty;
+    const int rows = std::min(4, height - y0);
+
+    for(int tx0 = 0; tx0 < tiles_x; tx0 += lanes) {
+      const int n = std::min(lanes, tiles_x - tx0);
+      datum m[36 * CN24_WINOGRAD_LANES], t[24 * CN24_WINOGRAD_LANES], y[16 * CN24_WINOGRAD_LANES];
+
+      for(int e = 0; e < 36; e++) {
+        Copy(m + e * lanes, source + e * element_stride + tx0, n);
+        Fill(m + e * lanes + n, 0, lanes - n);
+      }
+
+      for(int x = 0; x < 6; x++)
+        WinogradAT(m + x * lanes, 6 * lanes, t + x * lanes, 6 * lanes);
+      for(int r = 0; r < 4; r++)
+        WinogradAT(t + 6 * r * lanes, lanes, y + 4 * r * lanes, lanes);
+
+      for(int r = 0; r < rows; r++) {
+        datum* row = target + (y0 + r) * width + 4 * tx0;
+        const int columns = std::min(4 * n, width - 4 * tx0);
+        for(int x = 0; x < columns; x++)
+          row[x] = alpha * (y[(4 * r + (x & 3)) * lanes + (x >> 2)] + offset);
+      }
+    }
+  }
+}
+
+/*
+ * Transforms the output gradient for the weight gradient: A D A^T for
+ * 4x4 tiles starting at (4 * tx, 4 * ty), zero outside the image.
+ */
+CN24_KERNEL_TARGET static void WINOGRAD_DELTA(const datum* image,
+  datum* transformed, const int width, const int height, const int maps,
+  const int samples, const int tiles_x, const int tiles_y) {
+  const int lanes = CN24_WINOGRAD_LANES;
+  const std::size_t sample_tiles = (std::size_t)tiles_x * tiles_y;
+  const std::size_t element_stride = (std::size_t)maps * samples * sample_tiles;
+  const int tasks = samples * maps * tiles_y;
+
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < tasks; task++) {
+    const int plane = task / tiles_y, ty = task % tiles_y;
+    const int sample = plane / maps, map = plane % maps;
+    const datum* source = image + (std::size_t)plane * width * height;
+    datum* target = transformed + ((std::size_t)map * samples + sample) * sample_tiles
+      + (std::size_t)ty * tiles_x;
+    const int y0 = 4 * ty;
+    const int rows = std::min(4, height - y0);
+
+    for(int tx0 = 0; tx0 < tiles_x; tx0 += lanes) {
+      const int n = std::min(lanes, tiles_x - tx0);
+      datum y[16 * CN24_WINOGRAD_LANES], t[24 * CN24_WINOGRAD_LANES], z[36 * CN24_WINOGRAD_LANES];
+
+      Fill(y, 0, 16 * lanes);
+      for(int r = 0; r < rows; r++) {
+        const datum* row = source + (y0 + r) * width + 4 * tx0;
+        const int columns = std::min(4 * n, width - 4 * tx0);
+        for(int x = 0; x < columns; x++)
+          y[(4 * r + (x & 3)) * lanes + (x >> 2)] = row[x];
+      }
+
+      for(int x = 0; x < 4; x++)
+        WinogradA(y + x * lanes, 4 * lanes, t + x * lanes, 4 * lanes);
+      for(int r = 0; r < 6; r++)
+        WinogradA(t + 4 * r * lanes, lanes, z + 6 * r * lanes, lanes);
+
+      for(int e = 0; e < 36; e++)
+        Copy(target + e * element_stride + tx0, z + e * lanes, n);
+    }
+  }
+}
+
+/*
+ * Transforms 3x3 weights to 36 output_maps x input_maps matrices. If flip
+ * is set, the kernels are rotated by 180 degrees and the result is stored
+ * as 36 input_maps x output_maps matrices instead, for backpropagation.
+ */
+CN24_KERNEL_TARGET static void WINOGRAD_FILTER(const datum* weights,
+  datum* transformed, const int output_maps, const int input_maps,
+  const bool flip) {
+  const int lanes = CN24_WINOGRAD_LANES;
+  const int kernels = output_maps * input_maps;
+  const std::size_t element_stride = (std::size_t)kernels;
+
+  #pragma omp parallel for default(shared)
+  for(int k0 = 0; k0 < kernels; k0 += lanes) {
+    const int n = std::min(lanes, kernels - k0);
+    datum g[9 * CN24_WINOGRAD_LANES], t[18 * CN24_WINOGRAD_LANES], u[36 * CN24_WINOGRAD_LANES];
+    for(int e = 0; e < 9; e++)
+      for(int i = 0; i < lanes; i++)
+        g[e * lanes + i] = i < n ? weights[(std::size_t)(k0 + i) * 9 + (flip ? 8 - e : e)] : 0;
+
+    for(int x = 0; x < 3; x++)
+      WinogradG(g + x * lanes, 3 * lanes, t + x * lanes, 3 * lanes);
+    for(int r = 0; r < 6; r++)
+      WinogradG(t + 3 * r * lanes, lanes, u + 6 * r * lanes, lanes);
+
+    for(int i = 0; i < n; i++) {
+      const int output_map = (k0 + i) / input_maps, input_map = (k0 + i) % input_maps;
+      datum* out = transformed + (flip ? (std::size_t)input_map * output_maps + output_map : (std::size_t)(k0 + i));
+      for(int e = 0; e < 36; e++)
+        out[e * element_stride] = u[e * lanes + i];
+    }
+  }
+}
+
+/*
+ * Transforms the gradient of the 36 output_maps x input_maps matrices
+ * WINOGRAD_FILTER produces back to the 3x3 weights, overwriting them.
+ */
+CN24_KERNEL_TARGET static void WINOGRAD_FILTER_GRADIENT(const datum* transformed,
+  datum* weights, const int output_maps, const int input_maps) {
+  const int lanes = CN24_WINOGRAD_LANES;
+  const int kernels = output_maps * input_maps;
+  const std::size_t element_stride = (std::size_t)kernels;
+
+  #pragma omp parallel for default(shared)
+  for(int k0 = 0; k0 < kernels; k0 += lanes) {
+    const int n = std::min(lanes, kernels - k0);
+    datum u[36 * CN24_WINOGRAD_LANES], t[18 * CN24_WINOGRAD_LANES], g[9 * CN24_WINOGRAD_LANES];
+    for(int e = 0; e < 36; e++) {
+      Copy(u + e * lanes, transformed + e * element_stride + k0, n);
+      Fill(u + e * lanes + n, 0, lanes - n);
+    }
+
+    for(int x = 0; x < 6; x++)
+      WinogradGT(u + x * lanes, 6 * lanes, t + x * lanes, 6 * lanes);
+    for(int r = 0; r < 3; r++)
+      WinogradGT(t + 6 * r * lanes, lanes, g + 3 * r * lanes, lanes);
+
+    for(int i = 0; i < n; i++)
+      for(int e = 0; e < 9; e++)
+        weights[(std::size_t)(k0 + i) * 9 + e] = g[e * lanes + i];
+  }
+}
+
+#undef CN24_WINOGRAD_LANES
+
+/*
+ * One Stockham step of a batched FFT, see FFTPlan. The sub-transforms of
+ * length radix * m are split into radix interleaved ones. Butterfly pp
+ * reads the contiguous vectors pp + j * m and writes radix * pp + k,
+ * multiplying output k by the twiddle w^(pp * k). Groups of CN24_FFT_LANES
+ * vector elements are processed at once so the butterflies vectorize.
+ */
+#define CN24_FFT_LANES 16
+
+// a and o hold the real and imaginary part of every input and output
+template <int L>
+CN24_KERNEL_TARGET static inline void FFTRadix2(const datum* const* a,
+  datum* const* o, const datum* w, const int v) {
+  const datum* ar = a[0] + v; const datum* ai = a[1] + v;
+  const datum* br = a[2] + v; const datum* bi = a[3] + v;
+  datum* __restrict o0r = o[0] + v; datum* __restrict o0i = o[1] + v;
+  datum* __restrict o1r = o[2] + v; datum* __restrict o1i = o[3] + v;
+  for(int i = 0; i < L; i++) {
+    const datum dr = ar[i] - br[i], di = ai[i] - bi[i];
+    o0r[i] = ar[i] + br[i];
+    o0i[i] = ai[i] + bi[i];
+    o1r[i] = dr * w[0] - di * w[1];
+    o1i[i] = dr * w[1] + di * w[0];
+  }
+}
+
+template <int L>
+CN24_KERNEL_TARGET static inline void FFTRadix4(const datum* const* a,
+  datum* const* o, const datum* w, const datum sign, const int v) {
+  const datum* a0r = a[0] + v; const datum* a0i = a[1] + v;
+  const datum* a1r = a[2] + v; const datum* a1i = a[3] + v;
+  const datum* a2r = a[4] + v; const datum* a2i = a[5] + v;
+  const datum* a3r = a[6] + v; const datum* a3i = a[7] + v;
+  datum* __restrict o0r = o[0] + v; datum* __restrict o0i = o[1] + v;
+  datum* __restrict o1r = o[2] + v; datum* __restrict o1i = o[3] + v;
+  datum* __restrict o2r = o[4] + v; datum* __restrict o2i = o[5] + v;
+  datum* __restrict o3r = o[6] + v; datum* __restrict o3i = o[7] + v;
+  for(int i = 0; i < L; i++) {
+    const datum t0r = a0r[i] + a2r[i], t0i = a0i[i] + a2i[i];
+    const datum t1r = a0r[i] - a2r[i], t1i = a0i[i] - a2i[i];
+    const datum t2r = a1r[i] + a3r[i], t2i = a1i[i] + a3i[i];
+    // -i * (a1 - a3) for the forward transform, +i for the inverse
+    const datum t3r = sign * (a1i[i] - a3i[i]), t3i = sign * (a3r[i] - a1r[i]);
+    const datum b1r = t1r + t3r, b1i = t1i + t3i;
+    const datum b2r = t0r - t2r, b2i = t0i - t2i;
+    const datum b3r = t1r - t3r, b3i = t1i - t3i;
+    o0r[i] = t0r + t2r;
+    o0i[i] = t0i + t2i;
+    o1r[i] = b1r * w[0] - b1i * w[1];
+    o1i[i] = b1r * w[1] + b1i * w[0];
+    o2r[i] = b2r * w[2] - b2i * w[3];
+    o2i[i] = b2r * w[3] + b2i * w[2];
+    o3r[i] = b3r * w[4] - b3i * w[5];
+    o3i[i] = b3r * w[5] + b3i * w[4];
+  }
+}
+
+// Radices 3 and 5 as a direct DFT, c holds the coefficient of input j for
+// output k at 2 * (j * P + k), twiddles included
+template <int L, int P>
+CN24_KERNEL_TARGET static inline void FFTRadixDFT(const datum* const* a,
+  datum* const* o, const datum* c, const int v) {
+  for(int k = 0; k < P; k++) {
+    datum* __restrict or_ = o[2 * k] + v;
+    datum* __restrict oi = o[2 * k + 1] + v;
+    for(int i = 0; i < L; i++) {
+      datum sr = 0, si = 0;
+      for(int j = 0; j < P; j++) {
+        const datum xr = a[2 * j][v + i], xi = a[2 * j + 1][v + i];
+        sr += xr * c[2 * (j * P + k)] - xi * c[2 * (j * P + k) + 1];
+        si += xr * c[2 * (j * P + k) + 1] + xi * c[2 * (j * P + k)];
+      }
+      or_[i] = sr;
+      oi[i] = si;
+    }
+  }
+}
+
+template <int L>
+CN24_KERNEL_TARGET static inline void FFTButterfly(const int radix,
+  const datum* const* a, datum* const* o, const datum* w, const datum* c,
+  const datum sign, const int v) {
+  switch(radix) {
+    case 2:
+      FFTRadix2<L>(a, o, w, v);
+      break;
+    case 3:
+      FFTRadixDFT<L, 3>(a, o, c, v);
+      break;
+    case 4:
+      FFTRadix4<L>(a, o, w, sign, v);
+      break;
+    case 5:
+      FFTRadixDFT<L, 5>(a, o, c, v);
+      break;
+  }
+}
+
+CN24_KERNEL_TARGET static void FFT_PASS(const datum* re, const datum* im,
+  datum* target_re, datum* target_im, const int radix, const int m,
+  const int vector, const int length, const int twiddle_step,
+  const datum* cosine, const datum* sine, const bool inverse) {
+  const int lanes = CN24_FFT_LANES;
+  const datum sign = inverse ? -1 : 1;
+  const datum* a[10];
+  datum* o[10];
+  datum w[6], c[50];
+
+  for(int pp = 0; pp < m; pp++) {
+    for(int j = 0; j < radix; j++) {
+      a[2 * j] = re + (std::size_t)(pp + j * m) * vector;
+      a[2 * j + 1] = im + (std::size_t)(pp + j * m) * vector;
+      o[2 * j] = target_re + (std::size_t)(radix * pp + j) * vector;
+      o[2 * j + 1] = target_im + (std::size_t)(radix * pp + j) * vector;
+    }
+    if(radix == 2 || radix == 4) {
+      for(int k = 1; k < radix; k++) {
+        w[2 * k - 2] = cosine[pp * k * twiddle_step];
+        w[2 * k - 1] = -sign * sine[pp * k * twiddle_step];
+      }
+    } else {
+      for(int j = 0; j < radix; j++) {
+        for(int k = 0; k < radix; k++) {
+          const int t = (((j * k) % radix) * (length / radix) + pp * k * twiddle_step) % length;
+          c[2 * (j * radix + k)] = cosine[t];
+          c[2 * (j * radix + k) + 1] = -sign * sine[t];
+        }
+      }
+    }
+
+    int v = 0;
+    for(; v + lanes <= vector; v += lanes)
+      FFTButterfly<CN24_FFT_LANES>(radix, a, o, w, c, sign, v);
+    for(; v < vector; v++)
+      FFTButterfly<1>(radix, a, o, w, c, sign, v);
+  }
+}
+
+#undef CN24_FFT_LANES
+
+/*
+ * Pointwise products of spectra, summed over the inner dimension:
+ * product(i, j) = sum over l of a(i, l) * b(j, l), see TensorMathKernelTable.
+ * Products for four j at a time share the loads of a(i, l).
+ */
+template <int J>
+CN24_KERNEL_TARGET static inline void SpectrumProductTile(const datum* a,
+  const int a_inner, const datum* const* b, const int b_inner,
+  const int inner, const datum sign_a, const datum sign_b, datum* const* product) {
+  const int lanes = CN24_SPECTRUM_LANES;
+  datum sum[J][2][CN24_SPECTRUM_LANES];
+  for(int j = 0; j < J; j++)
+    for(int i = 0; i < lanes; i++) {
+      sum[j][0][i] = 0;
+      sum[j][1][i] = 0;
+    }
+
+  for(int l = 0; l < inner; l++) {
+    const datum* ar = a + (std::size_t)l * a_inner;
+    datum ai[CN24_SPECTRUM_LANES];
+    for(int i = 0; i < lanes; i++)
+      ai[i] = sign_a * ar[lanes + i];
+    for(int j = 0; j < J; j++) {
+      const datum* br = b[j] + (std::size_t)l * b_inner;
+      for(int i = 0; i < lanes; i++) {
+        const datum bi = sign_b * br[lanes + i];
+        sum[j][0][i] += ar[i] * br[i] - ai[i] * bi;
+        sum[j][1][i] += ar[i] * bi + ai[i] * br[i];
+      }
+    }
+  }
+
+  for(int j = 0; j < J; j++)
+    for(int i = 0; i < lanes; i++) {
+      product[j][i] = sum[j][0][i];
+      product[j][lanes + i] = sum[j][1][i];
+    }
+}
+
+CN24_KERNEL_TARGET static void SPECTRUM_PRODUCT(const datum* a,
+  const datum* b, datum* product, const int blocks, const int rows,
+  const int columns, const int inner, const int a_planes, const int a_row,
+  const int a_inner, const bool conjugate_a, const int b_planes,
+  const int b_column, const int b_inner, const bool conjugate_b) {
+  const int plane = 2 * CN24_SPECTRUM_LANES;
+  const datum sign_a = conjugate_a ? -1 : 1;
+  const datum sign_b = conjugate_b ? -1 : 1;
+  const int tasks = blocks * rows;
+
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < tasks; task++) {
+    const int block = task / rows, i = task % rows;
+    const datum* a_block = a + ((std::size_t)block * a_planes + (std::size_t)i * a_row) * plane;
+    const datum* b_block = b + (std::size_t)block * b_planes * plane;
+    datum* product_row = product + ((std::size_t)block * rows + i) * columns * plane;
+
+    int j = 0;
+    for(; j + 4 <= columns; j += 4) {
+      const datum* b_tile[4];
+      datum* product_tile[4];
+      for(int t = 0; t < 4; t++) {
+        b_tile[t] = b_block + (std::size_t)(j + t) * b_column * plane;
+        product_tile[t] = product_row + (std::size_t)(j + t) * plane;
+      }
+      SpectrumProductTile<4>(a_block, a_inner * plane, b_tile, b_inner * plane,
+        inner, sign_a, sign_b, product_tile);
+    }
+    for(; j < columns; j++) {
+      const datum* b_tile[1] = {b_block + (std::size_t)j * b_column * plane};
+      datum* product_tile[1] = {product_row + (std::size_t)j * plane};
+      SpectrumProductTile<1>(a_block, a_inner * plane, b_tile, b_inner * plane,
+        inner, sign_a, sign_b, product_tile);
+    }
+  }
+}
+
+/*
+ * 16 bit storage formats. bfloat16 is the upper half of a float, the half
+ * precision conversions follow F. Giesen's float_to_half_fast3_rtne and
+ * half_to_float, letting the FPU round subnormals. Blocks of
+ * CN24_HALF_LANES have a constant trip count so the compiler can turn the
+ * branches into selects.
+ */
+#define CN24_HALF_LANES 16
+
+CN24_KERNEL_TARGET static inline std::uint16_t FloatToBFloat(const float value) {
+  std::uint32_t f;
+  std::memcpy(&f, &value, sizeof(f));
+  // Keep NaNs quiet instead of rounding them to infinity
+  if((f & 0x7fffffff) > 0x7f800000)
+    return (std::uint16_t)((f >> 16) | 0x40);
+  return (std::uint16_t)((f + 0x7fff + ((f >> 16) & 1)) >> 16);
+}
+
+CN24_KERNEL_TARGET static inline float BFloatToFloat(const std::uint16_t value) {
+  const std::uint32_t f = (std::uint32_t)value << 16;
+  float result;
+  std::memcpy(&result, &f, sizeof(result));
+  return result;
+}
+
+CN24_KERNEL_TARGET static inline std::uint16_t FloatToHalf(const float value) {
+  std::uint32_t f;
+  std::memcpy(&f, &value, sizeof(f));
+  const std::uint32_t sign = (f >> 16) & 0x8000;
+  f &= 0x7fffffff;
+  std::uint32_t h;
+  if(f >= 0x47800000) {
+    // At least 2^16, infinite or NaN
+    h = f > 0x7f800000 ? 0x7e00 : 0x7c00;
+  } else if(f < 0x38800000) {
+    // Subnormal, adding 0.5 moves the mantissa into the lowest bits
+    float x;
+    std::memcpy(&x, &f, sizeof(x));
+    x += 0.5f;
+    std::memcpy(&h, &x, sizeof(h));
+    h -= 0x3f000000;
+  } else {
+    // Rebias the exponent and round the 13 dropped bits
+    h = (f + 0xc8000fff + ((f >> 13) & 1)) >> 13;
+  }
+  return (std::uint16_t)(h | sign);
+}
+
+CN24_KERNEL_TARGET static inline float HalfToFloat(const std::uint16_t value) {
+  const std::uint32_t shifted_exponent = 0x7c00u << 13;
+  std::uint32_t f = ((std::uint32_t)value & 0x7fff) << 13;
+  const std::uint32_t exponent = f & shifted_exponent;
+  f += (127 - 15) << 23;
+  if(exponent == shifted_exponent) {
+    // Infinite or NaN
+    f += (128 - 16) << 23;
+  } else if(exponent == 0) {
+    // Zero or subnormal, renormalized by subtracting 2^-14
+    f += 1 << 23;
+    float x;
+    std::memcpy(&x, &f, sizeof(x));
+    x -= 6.103515625e-05f;
+    std::memcpy(&f, &x, sizeof(f));
+  }
+  f |= ((std::uint32_t)value & 0x8000) << 16;
+  float result;
+  std::memcpy(&result, &f, sizeof(result));
+  return result;
+}
+
+CN24_KERNEL_TARGET static void PACK_HALF(const datum* source,
+  std::uint16_t* target, const std::size_t elements, const bool bfloat) {
+  const std::size_t block = 4096;
+  #pragma omp parallel for default(shared)
+  for(std::size_t b = 0; b < (elements + block - 1) / block; b++) {
+    const std::size_t begin = b * block;
+    const std::size_t end = std::min(elements, begin + block);
+    std::size_t i = begin;
+    for(; i + CN24_HALF_LANES <= end; i += CN24_HALF_LANES) {
+      const datum* s = source + i;
+      std::uint16_t* t = target + i;
+      if(bfloat) {
+        for(int l = 0; l < CN24_HALF_LANES; l++)
+          t[l] = FloatToBFloat(s[l]);
+      } else {
+#ifdef CN24_VEC_TO_HALF
+        for(int l = 0; l < CN24_HALF_LANES; l += CN24_VEC_WIDTH)
+          CN24_VEC_TO_HALF(t + l, CN24_VEC_LOAD(s + l));
+#else
+        for(int l = 0; l < CN24_HALF_LANES; l++)
+          t[l] = FloatToHalf(s[l]);
+#endif
+      }
+    }
+    for(; i < end; i++)
+      target[i] = bfloat ? FloatToBFloat(source[i]) : FloatToHalf(source[i]);
+  }
+}
+
+CN24_KERNEL_TARGET static void UNPACK_HALF(const std::uint16_t* source,
+  datum* target, const std::size_t elements, const bool bfloat) {
+  const std::size_t block = 4096;
+  #pragma omp parallel for default(shared)
+  for(std::size_t b = 0; b < (elements + block - 1) / block; b++) {
+    const std::size_t begin = b * block;
+    const std::size_t end = std::min(elements, begin + block);
+    std::size_t i = begin;
+    for(; i + CN24_HALF_LANES <= end; i += CN24_HALF_LANES) {
+      const std::uint16_t* s = source + i;
+      datum* t = target + i;
+      if(bfloat) {
+        for(int l = 0; l < CN24_HALF_LANES; l++)
+          t[l] = BFloatToFloat(s[l]);
+      } else {
+#ifdef CN24_VEC_FROM_HALF
+        for(int l = 0; l < CN24_HALF_LANES; l += CN24_VEC_WIDTH)
+          CN24_VEC_STORE(t + l, CN24_VEC_FROM_HALF(s + l));
+#else
+        for(int l = 0; l < CN24_HALF_LANES; l++)
+          t[l] = HalfToFloat(s[l]);
+#endif
+      }
+    }
+    for(; i < end; i++)
+      target[i] = bfloat ? BFloatToFloat(source[i]) : HalfToFloat(source[i]);
+  }
+}
+
+#undef CN24_HALF_LANES
+
+/*
+ * 8 bit storage, see TensorMathKernelTable::unpack_u8.
+ */
+CN24_KERNEL_TARGET static void UNPACK_U8(const std::uint8_t* source,
+  datum* target, const std::size_t elements, const datum scale,
+  const datum offset) {
+  std::size_t i = 0;
+#ifdef CN24_VEC_FROM_U8
+  const CN24_VEC scale_v = CN24_VEC_SET1(scale);
+  const CN24_VEC offset_v = CN24_VEC_SET1(offset);
+  for(; i + 4 * CN24_VEC_WIDTH <= elements; i += 4 * CN24_VEC_WIDTH) {
+    for(int l = 0; l < 4 * CN24_VEC_WIDTH; l += CN24_VEC_WIDTH)
+      CN24_VEC_STORE(target + i + l, CN24_VEC_ADD(CN24_VEC_MUL(CN24_VEC_FROM_U8(source + i + l), scale_v), offset_v));
+  }
+#endif
+  for(; i < elements; i++)
+    target[i] = scale * (datum)source[i] + offset;
+}
+
+/*
+ * 8 bit GEMM, see TensorMathKernelTable::gemm_u8s8. The portable version
+ * computes blocks of 4 rows and one panel with constant trip counts.
+ */
+CN24_KERNEL_TARGET static void PACK_U8(const datum* B, const int K,
+  const int N, const int k_stride, const int n_stride, const datum scale,
+  std::uint8_t* packed) {
+  const int lanes = CN24_INT8_LANES;
+  const int K4 = (K + 3) / 4;
+  const int panels = (N + lanes - 1) / lanes;
+  const datum inverse = (datum)1 / scale;
+  #pragma omp parallel for default(shared)
+  for(int p = 0; p < panels; p++) {
+    std::uint8_t* panel = packed + (std::size_t)p * K4 * lanes * 4;
+    const int columns = std::min(lanes, N - p * lanes);
+    for(int k = 0; k < K4 * 4; k++) {
+      std::uint8_t* target = panel + (std::size_t)(k / 4) * lanes * 4 + (k % 4);
+      const datum* source = B + (std::size_t)k * k_stride + (std::size_t)p * lanes * n_stride;
+      int l = 0;
+      if(k < K) {
+        for(; l < columns; l++) {
+          datum q = source[(std::size_t)l * n_stride] * inverse;
+          q = q > (datum)127 ? (datum)127 : (q < (datum)-127 ? (datum)-127 : q);
+          // Positive after the shift, so truncation rounds
+          target[l * 4] = (std::uint8_t)(int)(q + (datum)128.5);
+        }
+      }
+      for(; l < lanes; l++)
+        target[l * 4] = 128;
+    }
+  }
+}
+
+CN24_KERNEL_TARGET static inline void StoreU8S8Block(const std::int32_t* acc,
+  const int m, const int n0, const int columns, const std::int32_t* offset,
+  const datum* scale, datum* C, const int m_stride, const int n_stride) {
+  datum* target = C + (std::size_t)m * m_stride + (std::size_t)n0 * n_stride;
+  for(int l = 0; l < columns; l++)
+    target[(std::size_t)l * n_stride] = scale[m] * (datum)(acc[l] - offset[m]);
+}
+
+CN24_KERNEL_TARGET static void GEMM_U8S8(const int M, const int N,
+  const int K, const std::int8_t* A, const std::uint8_t* packed,
+  const std::int32_t* offset, const datum* scale, datum* C,
+  const int m_stride, const int n_stride) {
+  const int lanes = CN24_INT8_LANES;
+  const int K4 = (K + 3) / 4;
+  const int panels = (N + lanes - 1) / lanes;
+  const int row_blocks = (M + 3) / 4;
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < row_blocks * panels; task++) {
+    const int m0 = (task / panels) * 4, p = task % panels;
+    const int rows = std::min(4, M - m0);
+    const std::uint8_t* panel = packed + (std::size_t)p * K4 * lanes * 4;
+    // Missing rows repeat the last one and are not stored
+    const std::int8_t* a[4];
+    for(int r = 0; r < 4; r++)
+      a[r] = A + (std::size_t)(m0 + std::min(r, rows - 1)) * K4 * 4;
+    std::int32_t acc[4][CN24_INT8_LANES] = {{0}};
+    for(int k4 = 0; k4 < K4; k4++) {
+      const std::uint8_t* b = panel + (std::size_t)k4 * lanes * 4;
+      for(int r = 0; r < 4; r++) {
+        const std::int32_t a0 = a[r][4 * k4], a1 = a[r][4 * k4 + 1],
+          a2 = a[r][4 * k4 + 2], a3 = a[r][4 * k4 + 3];
+        for(int l = 0; l < CN24_INT8_LANES; l++)
+          acc[r][l] += b[4 * l] * a0 + b[4 * l + 1] * a1 + b[4 * l + 2] * a2 +
+            b[4 * l + 3] * a3;
+      }
+    }
+    for(int r = 0; r < rows; r++)
+      StoreU8S8Block(acc[r], m0 + r, p * lanes, std::min(lanes, N - p * lanes),
+        offset, scale, C, m_stride, n_stride);
+  }
+}
+
+#ifndef CN24_KERNEL_GEMM_U8S8
+#define CN24_KERNEL_GEMM_U8S8 GEMM_U8S8
+#endif
+
+static const TensorMathKernelTable kernel_table = {
+  CN24_KERNEL_ISA, CN24_KERNEL_ISA_NAME,
+  { CN24_KERNEL_ISA_NAME, CN24_GEMM_MR, CN24_GEMM_NR, MicroKernel },
+  GEMV, IM2COL, COL2IM, SMS, DOWN, UP, ADD, EXP, ACTIVATION, BIAS_ACTIVATION,
+  ACTIVATION_GRADIENT,
+  WINOGRAD_INPUT, WINOGRAD_OUTPUT, WINOGRAD_DELTA, WINOGRAD_FILTER,
+  WINOGRAD_FILTER_GRADIENT, FFT_PASS, SPECTRUM_PRODUCT, PACK_HALF, UNPACK_HALF,
+  UNPACK_U8, PACK_U8, CN24_KERNEL_GEMM_U8S8
+};
+
+#undef CN24_GEMM_MR
+#undef CN24_GEMM_NR
@@ -163,6 +163,10 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
   int stack_b_pos = -1;
 
 	bool already_upscaled = (factorx == 1) && (factory == 1);
+  
+  // Convolution added by the previous line, an activation directly
+  // following it is fused into the layer instead of getting its own node
+  ConvolutionLayer* fusable_convolution = nullptr;
 
   if (method_ == FCN && (receptive_field_x_ > 0) && (receptive_field_y_ > 0)) {
 		ResizeLayer* rl = new ResizeLayer(receptive_field_x_, receptive_field_y_);
@@ -218,6 +222,12 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
 			is_output = true;
     }
     
+    ConvolutionLayer* previous_convolution = nullptr;
+    if (line.length() > 0) {
+      previous_convolution = fusable_convolution;
+      fusable_convolution = nullptr;
+    }
+    
     /*
      * STACK OPERATIONS
      */
@@ -237,6 +247,11 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
       last_connection = stack_b[stack_b_pos--];
     }
     
+    // Marks the last node for manual checkpointing, see NetGraph::SetCheckpointing
+    if (line.compare(0, 10, "checkpoint") == 0 && line.compare(0, 13, "checkpointing") != 0) {
+      last_connection.node->is_checkpoint = true;
+    }
+    
     /*
      * PARSING
      */
@@ -256,15 +271,24 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
         ParseDatumParamIfPossible (line, "dropout", dropout_fraction);
         ParseDatumParamIfPossible (line, "llr", llr);
         LOGDEBUG << "Parsed dropout fraction: " << dropout_fraction;
+        
+        std::string engine_name;
+        ConvolutionLayer::ConvolutionEngine engine = ConvolutionLayer::ENGINE_AUTO;
+        ParseStringParamIfPossible (line, "engine", engine_name);
+        if(engine_name.length() > 0 && !ConvolutionLayer::ParseEngine(engine_name, engine)) {
+          FATAL("Unknown convolution engine: " << engine_name);
+        }
 
         ConvolutionLayer* cl = new ConvolutionLayer (kx, ky, k, stridex, stridey, padx, pady, group, rand(), dropout_fraction);
 				cl->SetLocalLearningRate (llr);
+				cl->SetEngine (engine);
 
 				NetGraphNode* node = new NetGraphNode(cl, last_connection);
 				net.AddNode(node);
 				last_connection.buffer = 0;
 				last_connection.node = node;
 				last_connection.backprop = true;
+				fusable_convolution = cl;
       }
       
       if (StartsWithIdentifier (line, "lrn")) {
@@ -334,7 +358,10 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
         last_connection.backprop = true;
       }
 
-      if (StartsWithIdentifier (line, "sigm")) {
+      if (StartsWithIdentifier (line, "sigm") && previous_convolution != nullptr && !is_output) {
+        LOGDEBUG << "Fusing activation into the previous convolution";
+        previous_convolution->SetActivation (ACTIVATION_SIGMOID);
+      } else if (StartsWithIdentifier (line, "sigm")) {
         SigmoidLayer* l = new SigmoidLayer();
 				NetGraphNode* node = new NetGraphNode(l, last_connection);
 				node->is_output = is_output && (method_ == PATCH || already_upscaled);
@@ -359,7 +386,10 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
 				last_connection.backprop = true;
       }
       
-      if (StartsWithIdentifier (line, "relu")) {
+      if (StartsWithIdentifier (line, "relu") && previous_convolution != nullptr && !is_output) {
+        LOGDEBUG << "Fusing activation into the previous convolution";
+        previous_convolution->SetActivation (ACTIVATION_RELU);
+      } else if (StartsWithIdentifier (line, "relu")) {
         ReLULayer* l = new ReLULayer();
 				NetGraphNode* node = new NetGraphNode(l, last_connection);
 				node->is_output = is_output && (method_ == PATCH || already_upscaled);
@@ -369,7 +399,10 @@ bool ConfigurableFactory::AddLayers(NetGraph& net, NetGraphConnection data_layer
 				last_connection.backprop = true;
       }
 
-      if (StartsWithIdentifier (line, "tanh")) {
+      if (StartsWithIdentifier (line, "tanh") && previous_convolution != nullptr && !is_output) {
+        LOGDEBUG << "Fusing activation into the previous convolution";
+        previous_convolution->SetActivation (ACTIVATION_TANH);
+      } else if (StartsWithIdentifier (line, "tanh")) {
         TanhLayer* l = new TanhLayer();
 				NetGraphNode* node = new NetGraphNode(l, last_connection);
 				node->is_output = is_output && (method_ == PATCH || already_upscaled);
@@ -523,6 +556,12 @@ void ConfigurableFactory::InitOptimalSettings() {
     ParseUIntIfPossible (line, "iterations", optimal_settings_.iterations);
     ParseUIntIfPossible (line, "sbatchsize", optimal_settings_.sbatchsize);
     ParseUIntIfPossible (line, "pbatchsize", optimal_settings_.pbatchsize);
+    ParseUIntIfPossible (line, "scheduler_threads", optimal_settings_.scheduler_threads);
+    ParseUIntIfPossible (line, "replicas", optimal_settings_.replicas);
+    ParseUIntIfPossible (line, "processes", optimal_settings_.processes);
+    ParseUIntIfPossible (line, "transport_port", optimal_settings_.transport_port);
+    ParseUIntIfPossible (line, "prefetch", optimal_settings_.prefetch);
+    ParseUIntIfPossible (line, "loaders", optimal_settings_.loaders);
     
     std::string method;
     ParseStringIfPossible(line, "optimization", method);
@@ -531,6 +570,34 @@ void ConfigurableFactory::InitOptimalSettings() {
     } else if(method.compare(0, 9, "quickprop") == 0) {
       optimal_settings_.optimization_method = QUICKPROP;
     }
+
+    std::string precision;
+    ParseStringIfPossible(line, "storage_precision", precision);
+    if(precision.compare(0, 4, "bf16") == 0) {
+      optimal_settings_.storage_precision = PRECISION_BF16;
+    } else if(precision.compare(0, 4, "fp16") == 0) {
+      optimal_settings_.storage_precision = PRECISION_FP16;
+    } else if(precision.compare(0, 4, "fp32") == 0) {
+      optimal_settings_.storage_precision = PRECISION_FP32;
+    }
+
+    std::string checkpointing;
+    ParseStringIfPossible(line, "checkpointing", checkpointing);
+    if(checkpointing.compare(0, 4, "auto") == 0) {
+      optimal_settings_.checkpointing = CHECKPOINTING_AUTO;
+    } else if(checkpointing.compare(0, 6, "manual") == 0) {
+      optimal_settings_.checkpointing = CHECKPOINTING_MANUAL;
+    } else if(checkpointing.compare(0, 3, "off") == 0) {
+      optimal_settings_.checkpointing = CHECKPOINTING_OFF;
+    }
+
+    std::string transport;
+    ParseStringIfPossible(line, "transport", transport);
+    if(transport.compare(0, 3, "shm") == 0) {
+      optimal_settings_.transport = TRANSPORT_SHM;
+    } else if(transport.compare(0, 3, "tcp") == 0) {
+      optimal_settings_.transport = TRANSPORT_TCP;
+    }
   }
 }
 
@@ -0,0 +1,300 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Log.h"
+#include "CPUGEMM.h"
+#include "TensorMathKernels.h"
+
+namespace Conv {
+
+/*
+ * Blocking parameters. A KC x NR panel of B (16 KiB for NR=16) is meant to
+ * stay in L1, the MC x KC block of A (120 KiB) and the KC x NC block of
+ * B (1 MiB) in L2.
+ */
+const int GEMM_MC = 120;
+const int GEMM_KC = 256;
+const int GEMM_NC = 1024;
+
+const int GEMM_MAX_MR = 16;
+const int GEMM_MAX_NR = 32;
+
+const GEMMKernelDescriptor& CPUGEMM::GetKernel() {
+  return TensorMathKernels::Get().gemm;
+}
+
+/*
+ * Packing buffers are kept per thread so that concurrent callers do not
+ * have to allocate on every call.
+ */
+static datum* GetAlignedBuffer(std::vector<datum>& buffer, const std::size_t elements) {
+  const std::size_t padding = 64 / sizeof(datum);
+  if(buffer.size() < elements + padding)
+    buffer.resize(elements + padding);
+  const std::uintptr_t address = (std::uintptr_t)buffer.data();
+  return (datum*)((address + 63) & ~((std::uintptr_t)63));
+}
+
+/*
+ * Packs rows [0, mc) and columns [0, kc) of op(A) into MR tall panels.
+ * Rows past mc are zero-padded so the micro-kernel always sees full panels.
+ */
+static void PackA(const bool transpose_A, const int mc, const int kc, const int mr,
+  const datum* a, const int ldA, datum* packed) {
+  const int panels = (mc + mr - 1) / mr;
+  #pragma omp parallel for default(shared)
+  for(int p = 0; p < panels; p++) {
+    datum* target = packed + p * mr * kc;
+    const int i0 = p * mr;
+    const int rows = std::min(mr, mc - i0);
+    for(int k = 0; k < kc; k++) {
+      for(int r = 0; r < rows; r++)
+        target[r] = transpose_A ? a[k * ldA + i0 + r] : a[(i0 + r) * ldA + k];
+      for(int r = rows; r < mr; r++)
+        target[r] = 0;
+      target += mr;
+    }
+  }
+}
+
+/*
+ * Packs rows [k0, k0 + kc) and columns [j0, j0 + nc) of op(B) from memory.
+ * Without transposition, rows of B are walked sequentially across the
+ * panels instead of jumping ldB for every row of a single panel.
+ */
+class MatrixPanelSource : public GEMMPanelSource {
+public:
+  MatrixPanelSource(const bool transpose_B, const datum* b, const int ldB) :
+    transpose_B_(transpose_B), b_(b), ldB_(ldB) {}
+
+  void PackPanels(const int k0, const int kc, const int j0, const int nc,
+    const int nr, datum* packed) const {
+    const int panels = (nc + nr - 1) / nr;
+    if(transpose_B_) {
+      for(int p = 0; p < panels; p++) {
+        datum* target = packed + p * nr * kc;
+        const int jp = j0 + p * nr;
+        const int columns = std::min(nr, nc - p * nr);
+        for(int k = 0; k < kc; k++) {
+          for(int c = 0; c < columns; c++)
+            target[c] = b_[(std::size_t)(jp + c) * ldB_ + k0 + k];
+          for(int c = columns; c < nr; c++)
+            target[c] = 0;
+          target += nr;
+        }
+      }
+    } else {
+      for(int k = 0; k < kc; k++) {
+        const datum* source = b_ + (std::size_t)(k0 + k) * ldB_ + j0;
+        for(int p = 0; p < panels; p++) {
+          datum* target = packed + p * nr * kc + k * nr;
+          const int columns = std::min(nr, nc - p * nr);
+          if(columns == nr) {
+            std::memcpy(target, source + p * nr, nr * sizeof(datum));
+          } else {
+            for(int c = 0; c < columns; c++)
+              target[c] = source[p * nr + c];
+            for(int c = columns; c < nr; c++)
+              target[c] = 0;
+          }
+        }
+      }
+    }
+  }
+
+private:
+  const bool transpose_B_;
+  const datum* b_;
+  const int ldB_;
+};
+
+/*
+ * Packs a KC x NC block of B. Groups of panels are handed to the
+ * source in parallel.
+ */
+static void PackB(const GEMMPanelSource& source, const int k0, const int kc,
+  const int j0, const int nc, const int nr, datum* packed) {
+  const int panels = (nc + nr - 1) / nr;
+  const int panels_per_group = 16;
+  const int groups = (panels + panels_per_group - 1) / panels_per_group;
+  #pragma omp parallel for default(shared)
+  for(int g = 0; g < groups; g++) {
+    const int first_column = g * panels_per_group * nr;
+    const int columns = std::min(panels_per_group * nr, nc - first_column);
+    source.PackPanels(k0, kc, j0 + first_column, columns, nr,
+      packed + (std::size_t)first_column * kc);
+  }
+}
+
+static void MacroKernel(const GEMMKernelDescriptor& kd, const int mc, const int nc,
+  const int kc, const datum alpha, const datum* packed_a, const datum* packed_b,
+  const datum beta, datum* c, const int ldC) {
+  const int mr = kd.mr;
+  const int nr = kd.nr;
+  const int panels_m = (mc + mr - 1) / mr;
+  const int panels_n = (nc + nr - 1) / nr;
+
+  // Every thread owns whole columns of tiles, so the result does not
+  // depend on the number of threads.
+  #pragma omp parallel for default(shared)
+  for(int jp = 0; jp < panels_n; jp++) {
+    const int j = jp * nr;
+    const int columns = std::min(nr, nc - j);
+    for(int ip = 0; ip < panels_m; ip++) {
+      const int i = ip * mr;
+      const int rows = std::min(mr, mc - i);
+      datum* c_tile = c + i * ldC + j;
+      const datum* a_panel = packed_a + ip * mr * kc;
+      const datum* b_panel = packed_b + jp * nr * kc;
+
+      if(rows == mr && columns == nr) {
+        kd.kernel(kc, a_panel, b_panel, c_tile, ldC, alpha, beta);
+      } else {
+        // Edge tile, compute into a scratch tile first
+        alignas(64) datum tile[GEMM_MAX_MR * GEMM_MAX_NR];
+        kd.kernel(kc, a_panel, b_panel, tile, nr, 1.0, 0.0);
+        for(int r = 0; r < rows; r++) {
+          for(int s = 0; s < columns; s++) {
+            if(beta == 0.0)
+              c_tile[r * ldC + s] = alpha * tile[r * nr + s];
+            else
+              c_tile[r * ldC + s] = beta * c_tile[r * ldC + s] + alpha * tile[r * nr + s];
+          }
+        }
+      }
+    }
+  }
+}
+
+static void ScaleMatrix(const int M, const int N, const datum beta, datum* c, const int ldC) {
+  #pragma omp parallel for default(shared)
+  for(int i = 0; i < M; i++) {
+    for(int j = 0; j < N; j++) {
+      if(beta == 0.0)
+        c[i * ldC + j] = 0;
+      else
+        c[i * ldC + j] *= beta;
+    }
+  }
+}
+
+void CPUGEMM::Sgemm(const bool is_row_major, const bool transpose_A,
+  const bool transpose_B, const int M, const int N, const int K,
+  const datum alpha, const datum* A, const int ldA, const datum* B,
+  const int ldB, const datum beta, datum* C, const int ldC) {
+  if(!is_row_major) {
+    // A column-major C is a row-major C^T = op(B)^T * op(A)^T
+    Sgemm(true, transpose_B, transpose_A, N, M, K, alpha, B, ldB, A, ldA,
+      beta, C, ldC);
+    return;
+  }
+
+  MatrixPanelSource source(transpose_B, B, ldB);
+  Sgemm(transpose_A, M, N, K, alpha, A, ldA, source, beta, C, ldC);
+}
+
+void CPUGEMM::Sgemm(const bool transpose_A, const int M, const int N,
+  const int K, const datum alpha, const datum* A, const int ldA,
+  const GEMMPanelSource& B, const datum beta, datum* C, const int ldC) {
+  if(M <= 0 || N <= 0)
+    return;
+
+  if(K <= 0 || alpha == 0.0) {
+    if(beta != 1.0)
+      ScaleMatrix(M, N, beta, C, ldC);
+    return;
+  }
+
+  const GEMMKernelDescriptor& kd = GetKernel();
+
+  static thread_local std::vector<datum> a_buffer;
+  static thread_local std::vector<datum> b_buffer;
+
+  const int nc_max = std::min(GEMM_NC, ((N + kd.nr - 1) / kd.nr) * kd.nr);
+  const int kc_max = std::min(GEMM_KC, K);
+  const int mc_max = std::min(GEMM_MC, ((M + kd.mr - 1) / kd.mr) * kd.mr);
+  datum* packed_a = GetAlignedBuffer(a_buffer, (std::size_t)mc_max * kc_max);
+  datum* packed_b = GetAlignedBuffer(b_buffer, (std::size_t)nc_max * kc_max);
+
+  for(int jc = 0; jc < N; jc += GEMM_NC) {
+    const int nc = std::min(GEMM_NC, N - jc);
+    for(int pc = 0; pc < K; pc += GEMM_KC) {
+      const int kc = std::min(GEMM_KC, K - pc);
+      const datum block_beta = (pc == 0) ? beta : (datum)1.0;
+
+      PackB(B, pc, kc, jc, nc, kd.nr, packed_b);
+
+      for(int ic = 0; ic < M; ic += GEMM_MC) {
+        const int mc = std::min(GEMM_MC, M - ic);
+
+        const datum* a_block = transpose_A ? A + pc * ldA + ic : A + ic * ldA + pc;
+        PackA(transpose_A, mc, kc, kd.mr, a_block, ldA, packed_a);
+
+        MacroKernel(kd, mc, nc, kc, alpha, packed_a, packed_b, block_beta,
+          C + ic * ldC + jc, ldC);
+      }
+    }
+  }
+}
+
+void CPUGEMM::Sgemm(const bool transpose_A, const bool transpose_B,
+  const int M, const int N, const int K, const datum alpha, const datum* A,
+  const int ldA, const datum* B, const int ldB, const GEMMTileSink& C) {
+  if(M <= 0 || N <= 0)
+    return;
+
+  const GEMMKernelDescriptor& kd = GetKernel();
+  const MatrixPanelSource source(transpose_B, B, ldB);
+
+  static thread_local std::vector<datum> a_buffer;
+  static thread_local std::vector<datum> b_buffer;
+  static thread_local std::vector<datum> c_buffer;
+
+  const int nc_max = std::min(GEMM_NC, ((N + kd.nr - 1) / kd.nr) * kd.nr);
+  const int kc_max = std::max(1, std::min(GEMM_KC, K));
+  const int mc_max = std::min(GEMM_MC, ((M + kd.mr - 1) / kd.mr) * kd.mr);
+  datum* packed_a = GetAlignedBuffer(a_buffer, (std::size_t)mc_max * kc_max);
+  datum* packed_b = GetAlignedBuffer(b_buffer, (std::size_t)nc_max * kc_max);
+  datum* tile = GetAlignedBuffer(c_buffer, (std::size_t)mc_max * nc_max);
+
+  // The K loop is innermost here so that only one MC x NC block of C has
+  // to be kept. If K fits into one block, B is packed once per column block.
+  const bool single_k_block = K <= GEMM_KC;
+
+  for(int jc = 0; jc < N; jc += GEMM_NC) {
+    const int nc = std::min(GEMM_NC, N - jc);
+    if(single_k_block && K > 0)
+      PackB(source, 0, K, jc, nc, kd.nr, packed_b);
+
+    for(int ic = 0; ic < M; ic += GEMM_MC) {
+      const int mc = std::min(GEMM_MC, M - ic);
+      if(K <= 0 || alpha == 0.0)
+        ScaleMatrix(mc, nc, 0.0, tile, nc_max);
+
+      for(int pc = 0; pc < K; pc += GEMM_KC) {
+        const int kc = std::min(GEMM_KC, K - pc);
+        if(!single_k_block)
+          PackB(source, pc, kc, jc, nc, kd.nr, packed_b);
+
+        const datum* a_block = transpose_A ? A + pc * ldA + ic : A + ic * ldA + pc;
+        PackA(transpose_A, mc, kc, kd.mr, a_block, ldA, packed_a);
+
+        MacroKernel(kd, mc, nc, kc, alpha, packed_a, packed_b,
+          pc == 0 ? (datum)0.0 : (datum)1.0, tile, nc_max);
+      }
+
+      C.ConsumeTile(ic, mc, jc, nc, tile, nc_max);
+    }
+  }
+}
+
+}
@@ -0,0 +1,158 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+
+#include "ConvolutionPanels.h"
+
+namespace Conv {
+
+static inline void Zero(datum* target, const int count, const int stride) {
+  for(int i = 0; i < count; i++)
+    target[i * stride] = 0;
+}
+
+/*
+ * Writes count consecutive columns of patch row (map, ky, kx), starting at
+ * column position, to target with the given stride.
+ */
+static void GatherPatchRow(const ConvolutionGeometry& g, const datum* image,
+  const int map, const int ky, const int kx, const int position, int count,
+  datum* target, const int stride) {
+  const int output_size = g.output_width * g.output_height;
+  int sample = position / output_size;
+  int oy = (position % output_size) / g.output_width;
+  int ox = position % g.output_width;
+
+  // Output columns whose input column lies inside the image
+  const int first = g.pad_width - kx;
+  const int ox_begin = first > 0 ? (first + g.stride_width - 1) / g.stride_width : 0;
+  const int limit = g.input_width + g.pad_width - kx;
+  const int ox_end = limit > 0 ? std::min(g.output_width, (limit + g.stride_width - 1) / g.stride_width) : 0;
+
+  while(count > 0) {
+    const int run = std::min(count, g.output_width - ox);
+    const int iy = oy * g.stride_height - g.pad_height + ky;
+    if(iy < 0 || iy >= g.input_height || ox_begin >= ox_end) {
+      Zero(target, run, stride);
+    } else {
+      const datum* row = image + (((std::size_t)sample * g.input_maps + map)
+        * g.input_height + iy) * g.input_width + kx - g.pad_width;
+      const int lo = std::max(ox, std::min(ox_begin, ox + run));
+      const int hi = std::max(lo, std::min(ox_end, ox + run));
+      Zero(target, lo - ox, stride);
+      datum* valid_target = target + (lo - ox) * stride;
+      for(int x = lo; x < hi; x++)
+        valid_target[(x - lo) * stride] = row[x * g.stride_width];
+      Zero(target + (hi - ox) * stride, ox + run - hi, stride);
+    }
+
+    target += run * stride;
+    count -= run;
+    ox = 0;
+    if(++oy == g.output_height) {
+      oy = 0;
+      sample++;
+    }
+  }
+}
+
+void PatchPanelSource::PackPanels(const int k0, const int kc, const int j0,
+  const int nc, const int nr, datum* packed) const {
+  const int kernel_size = geometry_.kernel_width * geometry_.kernel_height;
+  const int panels = (nc + nr - 1) / nr;
+  for(int p = 0; p < panels; p++) {
+    const int columns = std::min(nr, nc - p * nr);
+    for(int k = 0; k < kc; k++) {
+      const int row = k0 + k;
+      const int map = first_map_ + row / kernel_size;
+      const int ky = (row % kernel_size) / geometry_.kernel_width;
+      const int kx = row % geometry_.kernel_width;
+      datum* target = packed + ((std::size_t)p * kc + k) * nr;
+      GatherPatchRow(geometry_, image_, map, ky, kx, j0 + p * nr, columns, target, 1);
+      Zero(target + columns, nr - columns, 1);
+    }
+  }
+}
+
+void TransposedPatchPanelSource::PackPanels(const int k0, const int kc,
+  const int j0, const int nc, const int nr, datum* packed) const {
+  const int kernel_size = geometry_.kernel_width * geometry_.kernel_height;
+  const int panels = (nc + nr - 1) / nr;
+  for(int p = 0; p < panels; p++) {
+    datum* panel = packed + (std::size_t)p * kc * nr;
+    const int columns = std::min(nr, nc - p * nr);
+    for(int c = 0; c < columns; c++) {
+      const int row = j0 + p * nr + c;
+      const int map = first_map_ + row / kernel_size;
+      const int ky = (row % kernel_size) / geometry_.kernel_width;
+      const int kx = row % geometry_.kernel_width;
+      GatherPatchRow(geometry_, image_, map, ky, kx, k0, kc, panel + c, nr);
+    }
+    for(int c = columns; c < nr; c++)
+      Zero(panel + c, kc, nr);
+  }
+}
+
+void PatchTileSink::ConsumeTile(const int i0, const int mc, const int j0,
+  const int nc, const datum* tile, const int ld) const {
+  const ConvolutionGeometry& g = geometry_;
+  const int kernel_size = g.kernel_width * g.kernel_height;
+  const int first_local_map = i0 / kernel_size;
+  const int last_local_map = (i0 + mc - 1) / kernel_size;
+  const int output_size = g.output_width * g.output_height;
+
+  // Rows of different maps never write to the same pixels
+  #pragma omp parallel for default(shared)
+  for(int local_map = first_local_map; local_map <= last_local_map; local_map++) {
+    const int row_begin = std::max(i0, local_map * kernel_size);
+    const int row_end = std::min(i0 + mc, (local_map + 1) * kernel_size);
+    const int map = first_map_ + local_map;
+    for(int row = row_begin; row < row_end; row++) {
+      const int ky = (row % kernel_size) / g.kernel_width;
+      const int kx = row % g.kernel_width;
+      const datum* source = tile + (std::size_t)(row - i0) * ld;
+
+      const int first = g.pad_width - kx;
+      const int ox_begin = first > 0 ? (first + g.stride_width - 1) / g.stride_width : 0;
+      const int limit = g.input_width + g.pad_width - kx;
+      const int ox_end = limit > 0 ? std::min(g.output_width, (limit + g.stride_width - 1) / g.stride_width) : 0;
+
+      int sample = j0 / output_size;
+      int oy = (j0 % output_size) / g.output_width;
+      int ox = j0 % g.output_width;
+      int count = nc;
+      while(count > 0) {
+        const int run = std::min(count, g.output_width - ox);
+        const int iy = oy * g.stride_height - g.pad_height + ky;
+        if(iy >= 0 && iy < g.input_height) {
+          datum* image_row = image_ + (((std::size_t)sample * g.input_maps + map)
+            * g.input_height + iy) * g.input_width + kx - g.pad_width;
+          const int lo = std::max(ox, ox_begin);
+          const int hi = std::min(ox + run, ox_end);
+          const datum* valid_source = source - ox;
+          if(g.stride_width == 1) {
+            for(int x = lo; x < hi; x++)
+              image_row[x] += valid_source[x];
+          } else {
+            for(int x = lo; x < hi; x++)
+              image_row[x * g.stride_width] += valid_source[x];
+          }
+        }
+        source += run;
+        count -= run;
+        ox = 0;
+        if(++oy == g.output_height) {
+          oy = 0;
+          sample++;
+        }
+      }
+    }
+  }
+}
+
+}
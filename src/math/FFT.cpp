@@ -0,0 +1,189 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "Log.h"
+#include "FFT.h"
+#include "TensorMathKernels.h"
+
+namespace Conv {
+
+FFTPlan::FFTPlan(const int length) : length_(length) {
+  int remaining = length;
+  // Radix 4 first, it needs the fewest operations per element
+  while(remaining % 4 == 0) { radices_.push_back(4); remaining /= 4; }
+  while(remaining % 2 == 0) { radices_.push_back(2); remaining /= 2; }
+  while(remaining % 3 == 0) { radices_.push_back(3); remaining /= 3; }
+  while(remaining % 5 == 0) { radices_.push_back(5); remaining /= 5; }
+  if(remaining != 1 || length < 1) {
+    FATAL("FFT length " << length << " is not a product of 2, 3 and 5");
+  }
+
+  cos_.resize(length);
+  sin_.resize(length);
+  const double pi = 3.14159265358979323846;
+  for(int k = 0; k < length; k++) {
+    const double angle = 2.0 * pi * (double)k / (double)length;
+    cos_[k] = (datum)std::cos(angle);
+    sin_[k] = (datum)std::sin(angle);
+  }
+}
+
+int FFTPlan::GoodLength(const int minimum) {
+  for(int length = std::max(2, minimum);; length++) {
+    if(length % 2 != 0)
+      continue;
+    int remaining = length;
+    while(remaining % 2 == 0) remaining /= 2;
+    while(remaining % 3 == 0) remaining /= 3;
+    while(remaining % 5 == 0) remaining /= 5;
+    if(remaining == 1)
+      return length;
+  }
+}
+
+void FFTPlan::Transform(datum* re, datum* im, const int batch,
+  const bool inverse, datum* work_re, datum* work_im) const {
+  datum* xr = re; datum* xi = im;
+  datum* yr = work_re; datum* yi = work_im;
+  const TensorMathKernelTable& kernels = TensorMathKernels::Get();
+  int n = length_, s = 1;
+  for(const int p : radices_) {
+    const int m = n / p;
+    kernels.fft_pass(xr, xi, yr, yi, p, m, s * batch, length_, s,
+      cos_.data(), sin_.data(), inverse);
+    std::swap(xr, yr);
+    std::swap(xi, yi);
+    s *= p;
+    n = m;
+  }
+  if(xr != re) {
+    std::memcpy(re, xr, sizeof(datum) * length_ * batch);
+    std::memcpy(im, xi, sizeof(datum) * length_ * batch);
+  }
+}
+
+RealFFT2D::RealFFT2D(const int height, const int width) :
+  height_(height), width_(width), row_plan_(width), column_plan_(height) {
+  if(height % 2 != 0) {
+    FATAL("FFT height " << height << " has to be even");
+  }
+}
+
+/*
+ * Work buffers are kept per thread, like the GEMM packing buffers.
+ */
+static datum* GetWorkBuffer(std::vector<datum>& buffer, const std::size_t elements) {
+  if(buffer.size() < elements)
+    buffer.resize(elements);
+  return buffer.data();
+}
+
+/*
+ * Rows q and q + height / 2 are transformed together as the real and
+ * imaginary part of one complex sequence, stored column-major so that the
+ * row FFT vectorizes across rows.
+ */
+void RealFFT2D::Forward(const datum* image, const int rows, const int columns,
+  const int row0, const int column0, datum* re, datum* im) const {
+  static thread_local std::vector<datum> buffer;
+  const int half = height_ / 2;
+  const int spectrum_width = width_ / 2 + 1;
+  const std::size_t elements = (std::size_t)width_ * half;
+  const std::size_t work_elements = (std::size_t)height_ * spectrum_width;
+  datum* zr = GetWorkBuffer(buffer, 2 * elements + 2 * work_elements);
+  datum* zi = zr + elements;
+  datum* work_re = zi + elements;
+  datum* work_im = work_re + work_elements;
+
+  std::memset(zr, 0, sizeof(datum) * 2 * elements);
+  for(int r = 0; r < rows; r++) {
+    const int y = row0 + r;
+    datum* target = (y < half ? zr : zi) + (y % half);
+    const datum* source = image + r * columns;
+    for(int c = 0; c < columns; c++)
+      target[(column0 + c) * half] = source[c];
+  }
+
+  row_plan_.Transform(zr, zi, half, false, work_re, work_im);
+
+  // Separate the spectra of both rows: X1 = (Z[k] + Z*[-k]) / 2 and
+  // X2 = (Z[k] - Z*[-k]) / 2i
+  for(int k = 0; k < spectrum_width; k++) {
+    const int mirrored = (width_ - k) % width_;
+    const datum* ar = zr + k * half; const datum* ai = zi + k * half;
+    const datum* br = zr + mirrored * half; const datum* bi = zi + mirrored * half;
+    for(int q = 0; q < half; q++) {
+      re[q * spectrum_width + k] = (datum)0.5 * (ar[q] + br[q]);
+      im[q * spectrum_width + k] = (datum)0.5 * (ai[q] - bi[q]);
+      re[(q + half) * spectrum_width + k] = (datum)0.5 * (ai[q] + bi[q]);
+      im[(q + half) * spectrum_width + k] = (datum)0.5 * (br[q] - ar[q]);
+    }
+  }
+
+  // Column FFT, vectorized across frequencies
+  column_plan_.Transform(re, im, spectrum_width, false, work_re, work_im);
+}
+
+void RealFFT2D::Inverse(datum* re, datum* im, const int rows,
+  const int columns, const int row0, const int column0, const datum scale,
+  const datum offset, datum* image) const {
+  static thread_local std::vector<datum> buffer;
+  const int half = height_ / 2;
+  const int spectrum_width = width_ / 2 + 1;
+  const std::size_t column_elements = (std::size_t)height_ * spectrum_width;
+  const std::size_t row_elements = (std::size_t)width_ * half;
+  const std::size_t work_elements = std::max(column_elements, row_elements);
+  datum* work_re = GetWorkBuffer(buffer, 2 * work_elements + 2 * row_elements);
+  datum* work_im = work_re + work_elements;
+  datum* zr = work_im + work_elements;
+  datum* zi = zr + row_elements;
+
+  column_plan_.Transform(re, im, spectrum_width, true, work_re, work_im);
+
+  // Only the rows inside the window are transformed back
+  int first = half, last = -1;
+  for(int r = 0; r < rows; r++) {
+    const int q = (row0 + r) % half;
+    first = std::min(first, q);
+    last = std::max(last, q);
+  }
+  const int batch = last - first + 1;
+
+  // Z[k] = X_q[k] + i X_(q + half)[k], with X[k] = X*[-k] for the upper half
+  for(int k = 0; k < width_; k++) {
+    const bool upper = k >= spectrum_width;
+    const int source_k = upper ? width_ - k : k;
+    const datum conjugate = upper ? -1 : 1;
+    datum* target_r = zr + k * batch; datum* target_i = zi + k * batch;
+    for(int b = 0; b < batch; b++) {
+      const int q = first + b;
+      const datum x1r = re[q * spectrum_width + source_k];
+      const datum x1i = conjugate * im[q * spectrum_width + source_k];
+      const datum x2r = re[(q + half) * spectrum_width + source_k];
+      const datum x2i = conjugate * im[(q + half) * spectrum_width + source_k];
+      target_r[b] = x1r - x2i;
+      target_i[b] = x1i + x2r;
+    }
+  }
+
+  row_plan_.Transform(zr, zi, batch, true, work_re, work_im);
+
+  for(int r = 0; r < rows; r++) {
+    const int y = row0 + r;
+    const datum* source = (y < half ? zr : zi) + (y % half - first);
+    datum* target = image + r * columns;
+    for(int c = 0; c < columns; c++)
+      target[c] = scale * source[(column0 + c) * batch] + offset;
+  }
+}
+
+}
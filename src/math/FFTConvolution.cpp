@@ -0,0 +1,175 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Log.h"
+#include "FFTConvolution.h"
+#include "TensorMathKernels.h"
+
+namespace Conv {
+
+/*
+ * The pointwise products work on blocked spectra, see
+ * TensorMathKernelTable::spectrum_product. The transforms produce and
+ * consume contiguous ones, these convert between both.
+ */
+static void StoreSpectrum(const datum* re, const datum* im, const int frequencies,
+  datum* blocked, const int planes, const int plane) {
+  const int lanes = CN24_SPECTRUM_LANES;
+  for(int f0 = 0; f0 < frequencies; f0 += lanes) {
+    datum* target = blocked + ((std::size_t)(f0 / lanes) * planes + plane) * 2 * lanes;
+    const int n = std::min(lanes, frequencies - f0);
+    std::memcpy(target, re + f0, sizeof(datum) * n);
+    std::memcpy(target + lanes, im + f0, sizeof(datum) * n);
+  }
+}
+
+static void LoadSpectrum(const datum* blocked, const int planes, const int plane,
+  const int frequencies, datum* re, datum* im) {
+  const int lanes = CN24_SPECTRUM_LANES;
+  for(int f0 = 0; f0 < frequencies; f0 += lanes) {
+    const datum* source = blocked + ((std::size_t)(f0 / lanes) * planes + plane) * 2 * lanes;
+    const int n = std::min(lanes, frequencies - f0);
+    std::memcpy(re + f0, source, sizeof(datum) * n);
+    std::memcpy(im + f0, source + lanes, sizeof(datum) * n);
+  }
+}
+
+static datum* GetSpectrumBuffer(const int frequencies) {
+  static thread_local std::vector<datum> buffer;
+  if(buffer.size() < 2 * (std::size_t)frequencies)
+    buffer.resize(2 * (std::size_t)frequencies);
+  return buffer.data();
+}
+
+FFTConvolution::FFTConvolution(const ConvolutionGeometry& geometry,
+  const int output_maps) : geometry_(geometry), output_maps_(output_maps),
+  transform_(FFTPlan::GoodLength(geometry.input_height + 2 * geometry.pad_height),
+    FFTPlan::GoodLength(geometry.input_width + 2 * geometry.pad_width)) {
+  if(geometry.stride_width != 1 || geometry.stride_height != 1) {
+    FATAL("FFT convolutions need stride 1");
+  }
+  frequencies_ = transform_.spectrum_size();
+  blocks_ = (frequencies_ + CN24_SPECTRUM_LANES - 1) / CN24_SPECTRUM_LANES;
+
+  // Frequencies past the end of the last block stay zero
+  const std::size_t plane = 2 * CN24_SPECTRUM_LANES * (std::size_t)blocks_;
+  const int samples = geometry.samples, input_maps = geometry.input_maps;
+  input_spectra_.resize(plane * samples * input_maps, 0);
+  weight_spectra_.resize(plane * output_maps * input_maps, 0);
+  output_spectra_.resize(plane * samples * output_maps, 0);
+  product_spectra_.resize(plane * std::max(samples, output_maps) * input_maps, 0);
+  LOGDEBUG << "FFT grid: " << transform_.width() << "x" << transform_.height();
+}
+
+void FFTConvolution::TransformPlanes(const datum* images, const int planes,
+  const int rows, const int columns, const int row0, const int column0,
+  datum* spectra) const {
+  #pragma omp parallel for default(shared)
+  for(int p = 0; p < planes; p++) {
+    datum* spectrum = GetSpectrumBuffer(frequencies_);
+    transform_.Forward(images + (std::size_t)p * rows * columns, rows, columns,
+      row0, column0, spectrum, spectrum + frequencies_);
+    StoreSpectrum(spectrum, spectrum + frequencies_, frequencies_, spectra, planes, p);
+  }
+}
+
+void FFTConvolution::InvertPlanes(const datum* spectra, const int planes,
+  const int rows, const int columns, const int row0, const int column0,
+  const datum scale, const datum* offsets, const int offset_period,
+  datum* images) const {
+  #pragma omp parallel for default(shared)
+  for(int p = 0; p < planes; p++) {
+    datum* spectrum = GetSpectrumBuffer(frequencies_);
+    LoadSpectrum(spectra, planes, p, frequencies_, spectrum, spectrum + frequencies_);
+    const datum offset = offsets == nullptr ? 0 : offsets[p % offset_period];
+    transform_.Inverse(spectrum, spectrum + frequencies_, rows, columns,
+      row0, column0, scale, offset, images + (std::size_t)p * rows * columns);
+  }
+}
+
+void FFTConvolution::SetWeights(const datum* weights) {
+  TransformPlanes(weights, output_maps_ * geometry_.input_maps,
+    geometry_.kernel_height, geometry_.kernel_width, 0, 0,
+    weight_spectra_.data());
+}
+
+void FFTConvolution::Forward(const datum* input, const datum alpha,
+  const datum* bias, datum* output) {
+  const int samples = geometry_.samples, input_maps = geometry_.input_maps;
+  const datum scale = alpha / (datum)(transform_.width() * transform_.height());
+
+  // The input sits at the padding offset, the output is the correlation
+  // at non-negative shifts
+  TransformPlanes(input, samples * input_maps, geometry_.input_height,
+    geometry_.input_width, geometry_.pad_height, geometry_.pad_width,
+    input_spectra_.data());
+
+  // Y(s, o) = sum over c of X(s, c) * conj(W(o, c))
+  TensorMathKernels::Get().spectrum_product(input_spectra_.data(),
+    weight_spectra_.data(), output_spectra_.data(), blocks_,
+    samples, output_maps_, input_maps,
+    samples * input_maps, input_maps, 1, false,
+    output_maps_ * input_maps, input_maps, 1, true);
+
+  std::vector<datum> offsets(output_maps_, 0);
+  if(bias != nullptr)
+    for(int o = 0; o < output_maps_; o++)
+      offsets[o] = alpha * bias[o];
+  InvertPlanes(output_spectra_.data(), samples * output_maps_,
+    geometry_.output_height, geometry_.output_width, 0, 0, scale,
+    offsets.data(), output_maps_, output);
+}
+
+void FFTConvolution::Backward(const datum* output_delta, datum* input_delta,
+  datum* weights_delta, datum* bias_delta) {
+  const int samples = geometry_.samples, input_maps = geometry_.input_maps;
+  const int output_planes = samples * output_maps_;
+  const datum scale = 1.0 / (datum)(transform_.width() * transform_.height());
+  const TensorMathKernelTable& kernels = TensorMathKernels::Get();
+
+  TransformPlanes(output_delta, output_planes, geometry_.output_height,
+    geometry_.output_width, 0, 0, output_spectra_.data());
+
+  // The bias gradient is the DC component of the output gradient, the
+  // first real part of the first block
+  for(int o = 0; o < output_maps_; o++) {
+    datum sum = 0;
+    for(int s = 0; s < samples; s++)
+      sum += output_spectra_[(std::size_t)(s * output_maps_ + o) * 2 * CN24_SPECTRUM_LANES];
+    bias_delta[o] = sum;
+  }
+
+  // DW(o, c) = sum over s of conj(DY(s, o)) * X(s, c)
+  kernels.spectrum_product(output_spectra_.data(), input_spectra_.data(),
+    product_spectra_.data(), blocks_, output_maps_, input_maps, samples,
+    output_planes, 1, output_maps_, true,
+    samples * input_maps, 1, input_maps, false);
+
+  InvertPlanes(product_spectra_.data(), output_maps_ * input_maps,
+    geometry_.kernel_height, geometry_.kernel_width, 0, 0, scale, nullptr, 1,
+    weights_delta);
+
+  if(input_delta == nullptr)
+    return;
+
+  // DX(s, c) = sum over o of DY(s, o) * W(o, c), a full convolution that is
+  // cropped to the unpadded input
+  kernels.spectrum_product(output_spectra_.data(), weight_spectra_.data(),
+    product_spectra_.data(), blocks_, samples, input_maps, output_maps_,
+    output_planes, output_maps_, 1, false,
+    output_maps_ * input_maps, 1, input_maps, false);
+
+  InvertPlanes(product_spectra_.data(), samples * input_maps,
+    geometry_.input_height, geometry_.input_width, geometry_.pad_height,
+    geometry_.pad_width, scale, nullptr, 1, input_delta);
+}
+
+}
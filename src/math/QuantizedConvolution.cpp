@@ -0,0 +1,114 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Log.h"
+#include "QuantizedConvolution.h"
+#include "TensorMathKernels.h"
+
+namespace Conv {
+
+QuantizedConvolution::QuantizedConvolution(const ConvolutionGeometry& geometry,
+  const int output_maps, const int group) : geometry_(geometry),
+  output_maps_(output_maps), group_(group) {
+  rows_ = geometry.kernel_width * geometry.kernel_height * geometry.input_maps / group;
+  padded_rows_ = (rows_ + 3) & ~3;
+  weights_.resize((std::size_t)output_maps * padded_rows_, 0);
+  offsets_.resize(output_maps);
+  weight_scales_.resize(output_maps);
+  scales_.resize(output_maps);
+}
+
+void QuantizedConvolution::SetWeights(const datum* weights) {
+  #pragma omp parallel for default(shared)
+  for(int m = 0; m < output_maps_; m++) {
+    const datum* kernel = weights + (std::size_t)m * rows_;
+    std::int8_t* quantized = &weights_[(std::size_t)m * padded_rows_];
+    datum range = 0;
+    for(int k = 0; k < rows_; k++)
+      range = std::max(range, std::fabs(kernel[k]));
+
+    // All zero kernels keep a scale of one
+    const datum scale = range > 0 ? range / (datum)127 : (datum)1;
+    std::int32_t sum = 0;
+    for(int k = 0; k < rows_; k++) {
+      const int q = (int)std::lround(kernel[k] / scale);
+      quantized[k] = (std::int8_t)std::max(-127, std::min(127, q));
+      sum += quantized[k];
+    }
+    // The packed inputs are shifted by 128, see pack_u8
+    offsets_[m] = 128 * sum;
+    weight_scales_[m] = scale;
+  }
+}
+
+void QuantizedConvolution::Forward(const datum* input, const datum range,
+  const datum alpha, datum* output) {
+  const TensorMathKernelTable& kernels = TensorMathKernels::Get();
+  const ConvolutionGeometry& g = geometry_;
+  const int input_size = g.input_maps * g.input_width * g.input_height;
+  const int pixels = g.output_width * g.output_height;
+  const int group_maps = output_maps_ / group_;
+  const datum input_scale = range / (datum)127;
+
+  for(int m = 0; m < output_maps_; m++)
+    scales_[m] = alpha * input_scale * weight_scales_[m];
+
+  // Kernels covering the whole input see one column per sample
+  const bool whole_input = pixels == 1 && g.pad_width == 0 && g.pad_height == 0
+    && g.kernel_width == g.input_width && g.kernel_height == g.input_height;
+  const bool pointwise = g.kernel_width == 1 && g.kernel_height == 1
+    && g.stride_width == 1 && g.stride_height == 1 && g.pad_width == 0
+    && g.pad_height == 0;
+
+  const int columns = whole_input ? g.samples : pixels;
+  const std::size_t packed_size = (std::size_t)padded_rows_ *
+    ((columns + CN24_INT8_LANES - 1) / CN24_INT8_LANES) * CN24_INT8_LANES;
+  if(packed_.size() < packed_size)
+    packed_.resize(packed_size);
+
+  if(whole_input) {
+    for(int group = 0; group < group_; group++) {
+      kernels.pack_u8(input + (std::size_t)group * rows_, rows_, g.samples, 1,
+        input_size, input_scale, packed_.data());
+      kernels.gemm_u8s8(group_maps, g.samples, padded_rows_,
+        &weights_[(std::size_t)group * group_maps * padded_rows_], packed_.data(),
+        &offsets_[group * group_maps], &scales_[group * group_maps],
+        output + group * group_maps, 1, output_maps_);
+    }
+    return;
+  }
+
+  if(!pointwise && columns_.size() < (std::size_t)rows_ * group_ * pixels)
+    columns_.resize((std::size_t)rows_ * group_ * pixels);
+
+  for(int sample = 0; sample < g.samples; sample++) {
+    const datum* image = input + (std::size_t)sample * input_size;
+    const datum* patches = image;
+    if(!pointwise) {
+      kernels.im2col(image, columns_.data(), g.input_width, g.input_height,
+        g.input_maps, 1, g.kernel_width, g.kernel_height, g.stride_width,
+        g.stride_height, g.pad_width, g.pad_height);
+      patches = columns_.data();
+    }
+
+    datum* sample_output = output + (std::size_t)sample * output_maps_ * pixels;
+    for(int group = 0; group < group_; group++) {
+      kernels.pack_u8(patches + (std::size_t)group * rows_ * pixels, rows_, pixels,
+        pixels, 1, input_scale, packed_.data());
+      kernels.gemm_u8s8(group_maps, pixels, padded_rows_,
+        &weights_[(std::size_t)group * group_maps * padded_rows_], packed_.data(),
+        &offsets_[group * group_maps], &scales_[group * group_maps],
+        sample_output + (std::size_t)group * group_maps * pixels, pixels, 1);
+    }
+  }
+}
+
+}
@@ -7,8 +7,17 @@
 
 #include "MKLHelper.h"
 #include "CLHelper.h"
+#include "CPUGEMM.h"
+#include "TensorMathKernels.h"
+#include "ConvolutionPanels.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
 #include <cstring>
+#include <vector>
 
 #include "TensorMath.h"
 
@@ -55,36 +64,10 @@ void TensorMath::GEMM(const bool is_row_major, const bool transpose_A, const boo
     B.data_ptr_const(0,0,0,smB), ldB,
     beta, C.data_ptr(0,0,0,smC), ldC);
 #else
-  if(!is_row_major)
-    FATAL("Reference GEMM does not support column-major matrices!");
-  
-  const datum* a_ptr = A.data_ptr_const(0, 0, 0, smA);
-  const datum* b_ptr = B.data_ptr_const(0, 0, 0, smB);
-  datum* c_ptr = C.data_ptr(0, 0, 0, smC);
-  
-  #pragma omp parallel for default(shared)
-  for(int i = 0; i < M; i++) {
-    for(int j = 0; j < N; j++) {
-      datum sum = 0.0;
-      for(int k = 0; k < K; k++) {
-        const datum a_value = transpose_A ?
-          a_ptr[k * ldA + i]
-        :
-          a_ptr[i * ldA + k];
-        
-        const datum b_value = transpose_B ?
-          b_ptr[j * ldB + k]
-        :
-          b_ptr[k * ldB + j];
-          
-        sum += a_value * b_value;
-      }
-      if(beta == 0.0)
-        c_ptr[ldC * i + j] = alpha * sum;
-      else
-        c_ptr[ldC * i + j] = beta * c_ptr[ldC * i + j] + alpha * sum;
-    }
-  }
+  CPUGEMM::Sgemm(is_row_major, transpose_A, transpose_B, M, N, K,
+    alpha, A.data_ptr_const(0,0,0,smA), ldA,
+    B.data_ptr_const(0,0,0,smB), ldB,
+    beta, C.data_ptr(0,0,0,smC), ldC);
 #endif // BUILD_BLAS
 #endif // BUILD_CLBLAS
   C.hint_ignore_content_ = false;
@@ -127,35 +110,79 @@ void TensorMath::GEMV(const bool is_row_major, const bool transpose_A, const int
             M, N, alpha, A.data_ptr_const(0,0,0,smA),
             ldA, X.data_ptr_const(0,0,0,smX), incX, beta, Y.data_ptr(0,0,0,smY), incY);
 #else
-  if(!is_row_major)
-    FATAL("Reference GEMV does not support column-major matrices!");
+  // A column-major A is a row-major A^T
+  TensorMathKernels::Get().gemv(is_row_major ? transpose_A : !transpose_A,
+    is_row_major ? M : N, is_row_major ? N : M, alpha,
+    A.data_ptr_const(0, 0, 0, smA), ldA, X.data_ptr_const(0, 0, 0, smX), incX,
+    beta, Y.data_ptr(0, 0, 0, smY), incY);
   
-  // ...
-  const datum* a_ptr = A.data_ptr_const(0, 0, 0, smA);
-  const datum* x_ptr = X.data_ptr_const(0, 0, 0, smX);
-  datum* y_ptr = Y.data_ptr(0, 0, 0, smY);
+#endif // BUILD_BLAS
+#endif // BUILD_CLBLAS
+  Y.hint_ignore_content_ = false;
+}
+
+void TensorMath::GEMM_BATCHED(const bool is_row_major, const bool transpose_A, const bool transpose_B, const int M, const int N, const int K, const datum alpha, const Tensor& A, const int smA, const int ldA, const int strideA, const Tensor& B, const int smB, const int ldB, const int strideB, const datum beta, Tensor& C, const int smC, const int ldC, const int strideC, const int batch)
+{
+#ifdef BUILD_CLBLAS
+  ((Tensor&)A).MoveToGPU();
+  ((Tensor&)B).MoveToGPU();
+  C.MoveToGPU(C.hint_ignore_content_ && beta == 0.0);
   
-  #pragma omp parallel for default(shared)
-  for(int i = 0; i < M; i++) {
-    datum sum = 0.0;
-    for(int j = 0; j < N; j++) {
-      const datum a_value = transpose_A ?
-        a_ptr[j * ldA + i]
-      :
-        a_ptr[i * ldA + j];
-      
-      const datum x_value = x_ptr[j * incX];
-      sum += x_value * a_value;
-    }
-    if(beta == 0.0)
-      y_ptr[i * incY] = alpha * sum;
-    else 
-      y_ptr[i * incY] = beta * y_ptr[i * incY] + alpha * sum;
+  const int offA = A.width() * A.height() * A.maps() * smA;
+  const int offB = B.width() * B.height() * B.maps() * smB;
+  const int offC = C.width() * C.height() * C.maps() * smC;
+  
+  // The calls are queued without waiting, so the device sees them back to back
+  for(int b = 0; b < batch; b++) {
+    cl_event done_event = NULL;
+    cl_int err =
+      clblasSgemm(is_row_major ? clblasRowMajor : clblasColumnMajor,
+      transpose_A ? clblasTrans : clblasNoTrans,
+      transpose_B ? clblasTrans : clblasNoTrans,
+      M, N, K, alpha, (cl_mem)A.cl_data_ptr_, offA + b * strideA, ldA,
+      (cl_mem)B.cl_data_ptr_, offB + b * strideB, ldB, beta,
+      (cl_mem)C.cl_data_ptr_, offC + b * strideC, ldC,
+      1, &(CLHelper::queue), 0, NULL, &done_event);
+    
+    if(err!=CL_SUCCESS)
+      FATAL("Call to clblasSgemm failed. Error: " << err);
   }
+#else
+  
+#ifdef BUILD_OPENCL
+  ((Tensor&)A).MoveToCPU();
+  ((Tensor&)B).MoveToCPU();
+  C.MoveToCPU(C.hint_ignore_content_ && beta == 0.0);
+#endif 
   
+  const datum* a = A.data_ptr_const(0,0,0,smA);
+  const datum* b = B.data_ptr_const(0,0,0,smB);
+  datum* c = C.data_ptr(0,0,0,smC);
+  
+#ifdef _OPENMP
+  // Nested regions inside the GEMMs run on the calling thread only
+  const bool parallel_batch = batch >= omp_get_max_threads() && batch > 1;
+#endif
+  
+  #pragma omp parallel for default(shared) if(parallel_batch)
+  for(int g = 0; g < batch; g++) {
+#ifdef BUILD_BLAS
+    INNERGEMM(is_row_major ? CblasRowMajor : CblasColMajor,
+      transpose_A ? CblasTrans : CblasNoTrans,
+      transpose_B ? CblasTrans : CblasNoTrans,
+      M, N, K,
+      alpha, a + (std::size_t)g * strideA, ldA,
+      b + (std::size_t)g * strideB, ldB,
+      beta, c + (std::size_t)g * strideC, ldC);
+#else
+    CPUGEMM::Sgemm(is_row_major, transpose_A, transpose_B, M, N, K,
+      alpha, a + (std::size_t)g * strideA, ldA,
+      b + (std::size_t)g * strideB, ldB,
+      beta, c + (std::size_t)g * strideC, ldC);
 #endif // BUILD_BLAS
+  }
 #endif // BUILD_CLBLAS
-  Y.hint_ignore_content_ = false;
+  C.hint_ignore_content_ = false;
 }
 
 
@@ -221,35 +248,9 @@ void TensorMath::IM2COL(const Tensor& source, const int source_width, const int
       FATAL("Target size wrong!");
     
     
-    #pragma omp parallel for default(shared)
-    for(int sample = 0; sample < samples; sample++) {
-      const datum* source_ptr = source.data_ptr_const(0, 0, 0, sample);
-      for(int target_map = 0; target_map < target_maps; target_map++) {
-        datum* target_ptr = target.data_ptr(0, 0, 0, target_map); 
-        int kx = target_map % kernel_width;
-        int ky = (target_map / kernel_width) % kernel_height;
-        int imap = target_map / (kernel_width * kernel_height);
-        for(int oy = 0; oy < target_height; oy++) {
-          int iy = oy * stride_height - pad_height + ky;
-          if(iy >= 0 && iy < source_height) {
-            for(int ox = 0; ox < target_width; ox++) {
-              int ix = ox * stride_width - pad_width + kx;
-              if(ix >= 0 && ix < source_width) {
-                target_ptr[(sample * target_height + oy) * target_width + ox] =
-                  source_ptr[(imap * source_height + iy) * source_width + ix];
-              } else {
-                target_ptr[(sample * target_height + oy) * target_width + ox] = 0;
-              }
-            }
-          } else {
-            // Zero out
-            for(int ox = 0; ox < target_width; ox++) {
-                target_ptr[(sample * target_height + oy) * target_width + ox] = 0;
-            } 
-          }
-        }
-      }
-    }
+    TensorMathKernels::Get().im2col(source.data_ptr_const(), target.data_ptr(),
+      source_width, source_height, maps, samples, kernel_width, kernel_height,
+      stride_width, stride_height, pad_width, pad_height);
     
 #ifdef BUILD_OPENCL
   }
@@ -308,8 +309,6 @@ void TensorMath::COL2IM(Tensor& source, const int source_width, const int source
     ((Tensor&)target).MoveToCPU();
     source.MoveToCPU(true);
 #endif    
-    SETSAMPLE(source, -1, 0.0);
-    
     const int target_width = (2 * pad_width + source_width - kernel_width) / stride_width + 1;
     const int target_height = (2 * pad_height + source_height - kernel_height) / stride_height + 1;
     const int target_maps = kernel_width * kernel_height * maps;
@@ -320,27 +319,9 @@ void TensorMath::COL2IM(Tensor& source, const int source_width, const int source
     if(target_size != actual_target_size)
       FATAL("Target size wrong!");
     
-    for(int sample = 0; sample < samples; sample++) {
-      datum* source_ptr = source.data_ptr(0, 0, 0, sample);
-      for(int target_map = 0; target_map < target_maps; target_map++) {
-        const datum* target_ptr = target.data_ptr_const(0, 0, 0, target_map);
-        int kx = target_map % kernel_width;
-        int ky = (target_map / kernel_width) % kernel_height;
-        int imap = target_map / (kernel_width * kernel_height);
-        for(int oy = 0; oy < target_height; oy++) {
-          int iy = oy * stride_height - pad_height + ky;
-          if(iy >= 0 && iy < source_height) {
-            for(int ox = 0; ox < target_width; ox++) {
-              int ix = ox * stride_width - pad_width + kx;
-              if(ix >= 0 && iy < source_width) {
-                source_ptr[(imap * source_height + iy) * source_width + ix] +=
-                  target_ptr[(sample * target_height + oy) * target_width + ox];
-              } 
-            }
-          }
-        }
-      }
-    }
+    TensorMathKernels::Get().col2im(source.data_ptr(), target.data_ptr_const(),
+      source_width, source_height, maps, samples, kernel_width, kernel_height,
+      stride_width, stride_height, pad_width, pad_height);
   
 #ifdef BUILD_OPENCL
   }
@@ -348,6 +329,246 @@ void TensorMath::COL2IM(Tensor& source, const int source_width, const int source
   source.hint_ignore_content_ = false;
 }
 
+/*
+ * The implicit GEMMs see a chunk of samples as one M x (samples * pixels)
+ * matrix. Small images are gathered into this layout chunk by chunk, so
+ * each GEMM stays large enough while the copies stay in the cache. Images
+ * with at least SAMPLE_CHUNK_COLUMNS pixels are used in place.
+ */
+const int SAMPLE_CHUNK_COLUMNS = 1024;
+
+static int SampleChunk(const int pixels, const int samples) {
+  return std::max(1, std::min(samples, SAMPLE_CHUNK_COLUMNS / pixels));
+}
+
+static datum* GetChunkBuffer(const std::size_t elements) {
+  static thread_local std::vector<datum> buffer;
+  if(buffer.size() < elements)
+    buffer.resize(elements);
+  return buffer.data();
+}
+
+static void GatherChunk(const Tensor& image, const int first_map, const int maps,
+  const int sample0, const int samples, const int pixels, datum* matrix) {
+  for(int m = 0; m < maps; m++)
+    for(int s = 0; s < samples; s++)
+      std::memcpy(matrix + ((std::size_t)m * samples + s) * pixels,
+        image.data_ptr_const(0, 0, first_map + m, sample0 + s), sizeof(datum) * pixels);
+}
+
+static void ScatterChunk(const datum* matrix, const int first_map, const int maps,
+  const int sample0, const int samples, const int pixels, Tensor& image) {
+  for(int m = 0; m < maps; m++)
+    for(int s = 0; s < samples; s++)
+      std::memcpy(image.data_ptr(0, 0, first_map + m, sample0 + s),
+        matrix + ((std::size_t)m * samples + s) * pixels, sizeof(datum) * pixels);
+}
+
+void TensorMath::IM2COL_GEMM(const int M, const datum alpha, const Tensor& A, const int smA, const int ldA, const Tensor& source, const int source_width, const int source_height, const int maps, const int samples, const int kernel_width, const int kernel_height, const int stride_width, const int stride_height, const int pad_width, const int pad_height, const int first_map, const int group_maps, const datum beta, Tensor& C, const int first_map_C)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)A).MoveToCPU();
+  ((Tensor&)source).MoveToCPU();
+  C.MoveToCPU(C.hint_ignore_content_ && beta == 0.0);
+#endif
+  const int pixels = ((2 * pad_width + source_width - kernel_width) / stride_width + 1) *
+    ((2 * pad_height + source_height - kernel_height) / stride_height + 1);
+  
+  if(first_map + group_maps > maps || source.elements() < (std::size_t)samples * maps * source_width * source_height)
+    FATAL("Source size wrong!");
+  if(first_map_C + M > (int)C.maps() || C.samples() < (std::size_t)samples || C.width() * C.height() != (std::size_t)pixels)
+    FATAL("Target size wrong!");
+  
+  const int chunk = SampleChunk(pixels, samples);
+  for(int sample = 0; sample < samples; sample += chunk) {
+    const int count = std::min(chunk, samples - sample);
+    const ConvolutionGeometry geometry(source_width, source_height, maps, count,
+      kernel_width, kernel_height, stride_width, stride_height, pad_width, pad_height);
+    const PatchPanelSource patches(geometry, source.data_ptr_const(0, 0, 0, sample), first_map);
+    if(chunk == 1) {
+      CPUGEMM::Sgemm(false, M, pixels, kernel_width * kernel_height * group_maps, alpha,
+        A.data_ptr_const(0, 0, 0, smA), ldA, patches, beta,
+        C.data_ptr(0, 0, first_map_C, sample), pixels);
+    } else {
+      datum* matrix = GetChunkBuffer((std::size_t)M * count * pixels);
+      if(beta != 0.0)
+        GatherChunk(C, first_map_C, M, sample, count, pixels, matrix);
+      CPUGEMM::Sgemm(false, M, count * pixels, kernel_width * kernel_height * group_maps, alpha,
+        A.data_ptr_const(0, 0, 0, smA), ldA, patches, beta, matrix, count * pixels);
+      ScatterChunk(matrix, first_map_C, M, sample, count, pixels, C);
+    }
+  }
+  
+  C.hint_ignore_content_ = false;
+}
+
+void TensorMath::IM2COL_GEMM_T(const int M, const datum alpha, const Tensor& A, const int first_map_A, const Tensor& source, const int source_width, const int source_height, const int maps, const int samples, const int kernel_width, const int kernel_height, const int stride_width, const int stride_height, const int pad_width, const int pad_height, const int first_map, const int group_maps, const datum beta, Tensor& C, const int smC, const int ldC)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)A).MoveToCPU();
+  ((Tensor&)source).MoveToCPU();
+  C.MoveToCPU(C.hint_ignore_content_ && beta == 0.0);
+#endif
+  const int pixels = ((2 * pad_width + source_width - kernel_width) / stride_width + 1) *
+    ((2 * pad_height + source_height - kernel_height) / stride_height + 1);
+  
+  if(first_map + group_maps > maps || source.elements() < (std::size_t)samples * maps * source_width * source_height)
+    FATAL("Source size wrong!");
+  if(first_map_A + M > (int)A.maps() || A.samples() < (std::size_t)samples || A.width() * A.height() != (std::size_t)pixels)
+    FATAL("Operand size wrong!");
+  
+  // The products of all chunks are summed up in C
+  const int chunk = SampleChunk(pixels, samples);
+  for(int sample = 0; sample < samples; sample += chunk) {
+    const int count = std::min(chunk, samples - sample);
+    const ConvolutionGeometry geometry(source_width, source_height, maps, count,
+      kernel_width, kernel_height, stride_width, stride_height, pad_width, pad_height);
+    const TransposedPatchPanelSource patches(geometry, source.data_ptr_const(0, 0, 0, sample), first_map);
+    const datum* matrix = A.data_ptr_const(0, 0, first_map_A, sample);
+    if(chunk > 1) {
+      datum* buffer = GetChunkBuffer((std::size_t)M * count * pixels);
+      GatherChunk(A, first_map_A, M, sample, count, pixels, buffer);
+      matrix = buffer;
+    }
+    CPUGEMM::Sgemm(false, M, kernel_width * kernel_height * group_maps, count * pixels,
+      alpha, matrix, count * pixels, patches, sample == 0 ? beta : 1.0,
+      C.data_ptr(0, 0, 0, smC), ldC);
+  }
+  
+  C.hint_ignore_content_ = false;
+}
+
+void TensorMath::GEMM_COL2IM(const int K, const datum alpha, const Tensor& A, const int smA, const int ldA, const Tensor& B, const int first_map_B, Tensor& target, const int target_width, const int target_height, const int maps, const int samples, const int kernel_width, const int kernel_height, const int stride_width, const int stride_height, const int pad_width, const int pad_height, const int first_map, const int group_maps)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)A).MoveToCPU();
+  ((Tensor&)B).MoveToCPU();
+  target.MoveToCPU(target.hint_ignore_content_);
+#endif
+  const int pixels = ((2 * pad_width + target_width - kernel_width) / stride_width + 1) *
+    ((2 * pad_height + target_height - kernel_height) / stride_height + 1);
+  
+  if(first_map + group_maps > maps || target.elements() < (std::size_t)samples * maps * target_width * target_height)
+    FATAL("Target size wrong!");
+  if(first_map_B + K > (int)B.maps() || B.samples() < (std::size_t)samples || B.width() * B.height() != (std::size_t)pixels)
+    FATAL("Operand size wrong!");
+  
+  // The sink adds into the target, clear the maps of this group first
+  const std::size_t map_size = (std::size_t)target_width * target_height;
+  #pragma omp parallel for default(shared)
+  for(int sample = 0; sample < samples; sample++)
+    std::memset(target.data_ptr(0, 0, first_map, sample), 0, sizeof(datum) * map_size * group_maps);
+  
+  const int chunk = SampleChunk(pixels, samples);
+  for(int sample = 0; sample < samples; sample += chunk) {
+    const int count = std::min(chunk, samples - sample);
+    const ConvolutionGeometry geometry(target_width, target_height, maps, count,
+      kernel_width, kernel_height, stride_width, stride_height, pad_width, pad_height);
+    const PatchTileSink patches(geometry, target.data_ptr(0, 0, 0, sample), first_map);
+    const datum* matrix = B.data_ptr_const(0, 0, first_map_B, sample);
+    if(chunk > 1) {
+      datum* buffer = GetChunkBuffer((std::size_t)K * count * pixels);
+      GatherChunk(B, first_map_B, K, sample, count, pixels, buffer);
+      matrix = buffer;
+    }
+    CPUGEMM::Sgemm(true, false, kernel_width * kernel_height * group_maps, count * pixels, K,
+      alpha, A.data_ptr_const(0, 0, 0, smA), ldA, matrix, count * pixels, patches);
+  }
+  
+  target.hint_ignore_content_ = false;
+}
+
+void TensorMath::WINOGRAD_INPUT(const Tensor& source, const int source_width, const int source_height, const int maps, const int samples, const int offset_x, const int offset_y, const int tiles_x, const int tiles_y, Tensor& target)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)source).MoveToCPU();
+  target.MoveToCPU(true);
+#endif
+  if(source.elements() < (std::size_t)samples * maps * source_width * source_height)
+    FATAL("Source size wrong!");
+  if(target.elements() < (std::size_t)36 * maps * samples * tiles_x * tiles_y)
+    FATAL("Target size wrong!");
+
+  TensorMathKernels::Get().winograd_input(source.data_ptr_const(), target.data_ptr(),
+    source_width, source_height, maps, samples, offset_x, offset_y, tiles_x, tiles_y);
+
+  target.hint_ignore_content_ = false;
+}
+
+void TensorMath::WINOGRAD_OUTPUT(const Tensor& source, const int tiles_x, const int tiles_y, const datum alpha, const Tensor* bias, Tensor& target, const int target_width, const int target_height, const int maps, const int samples)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)source).MoveToCPU();
+  if(bias != nullptr)
+    ((Tensor*)bias)->MoveToCPU();
+  target.MoveToCPU(true);
+#endif
+  if(source.elements() < (std::size_t)36 * maps * samples * tiles_x * tiles_y)
+    FATAL("Source size wrong!");
+  if(target.elements() < (std::size_t)samples * maps * target_width * target_height ||
+     4 * tiles_x < target_width || 4 * tiles_y < target_height)
+    FATAL("Target size wrong!");
+  if(bias != nullptr && bias->elements() < (std::size_t)maps)
+    FATAL("Bias size wrong!");
+
+  TensorMathKernels::Get().winograd_output(source.data_ptr_const(), target.data_ptr(),
+    target_width, target_height, maps, samples, tiles_x, tiles_y, alpha,
+    bias == nullptr ? nullptr : bias->data_ptr_const());
+
+  target.hint_ignore_content_ = false;
+}
+
+void TensorMath::WINOGRAD_DELTA(const Tensor& source, const int source_width, const int source_height, const int maps, const int samples, const int tiles_x, const int tiles_y, Tensor& target)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)source).MoveToCPU();
+  target.MoveToCPU(true);
+#endif
+  if(source.elements() < (std::size_t)samples * maps * source_width * source_height)
+    FATAL("Source size wrong!");
+  if(target.elements() < (std::size_t)36 * maps * samples * tiles_x * tiles_y)
+    FATAL("Target size wrong!");
+
+  TensorMathKernels::Get().winograd_delta(source.data_ptr_const(), target.data_ptr(),
+    source_width, source_height, maps, samples, tiles_x, tiles_y);
+
+  target.hint_ignore_content_ = false;
+}
+
+void TensorMath::WINOGRAD_FILTER(const Tensor& weights, const int output_maps, const int input_maps, const bool flip, Tensor& target)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)weights).MoveToCPU();
+  target.MoveToCPU(true);
+#endif
+  if(weights.elements() < (std::size_t)9 * output_maps * input_maps)
+    FATAL("Weights size wrong!");
+  if(target.elements() < (std::size_t)36 * output_maps * input_maps)
+    FATAL("Target size wrong!");
+
+  TensorMathKernels::Get().winograd_filter(weights.data_ptr_const(), target.data_ptr(),
+    output_maps, input_maps, flip);
+
+  target.hint_ignore_content_ = false;
+}
+
+void TensorMath::WINOGRAD_FILTER_GRADIENT(const Tensor& source, const int output_maps, const int input_maps, Tensor& target)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)source).MoveToCPU();
+  target.MoveToCPU(true);
+#endif
+  if(source.elements() < (std::size_t)36 * output_maps * input_maps)
+    FATAL("Source size wrong!");
+  if(target.elements() < (std::size_t)9 * output_maps * input_maps)
+    FATAL("Target size wrong!");
+
+  TensorMathKernels::Get().winograd_filter_gradient(source.data_ptr_const(), target.data_ptr(),
+    output_maps, input_maps);
+
+  target.hint_ignore_content_ = false;
+}
+
 void TensorMath::SETSAMPLE(Tensor& A, const int smA, const datum value)
 {
 #ifdef BUILD_OPENCL
@@ -434,13 +655,8 @@ void TensorMath::SMS(const Tensor& source, Tensor& target)
     const int height = target.height();
     const int maps = target.maps();
     const int samples = target.samples();
-    for(int sample = 0; sample < samples; sample++) {
-      for(int map = 0; map < maps; map++) {
-        const datum* src = source.data_ptr_const(0, 0, sample, map);
-        datum* tgt = target.data_ptr(0, 0, map, sample);
-        std::memcpy(tgt, src, sizeof(datum) * width * height);
-      }
-    }
+    TensorMathKernels::Get().sms(source.data_ptr_const(), target.data_ptr(),
+      width, height, maps, samples);
   
 #ifdef BUILD_OPENCL
   }
@@ -495,25 +711,9 @@ void TensorMath::DOWN(const Tensor& source, Tensor& target, const int region_wid
     const int target_height = target.height();
     const int maps = target.maps();
     const int samples = target.samples();
-    for(int sample = 0; sample < samples; sample++) {
-      for(int map = 0; map < maps; map++) {
-        for(unsigned int target_y = 0; target_y < target_height; target_y++) {
-          const unsigned int source_y = region_height * target_y;
-          for(unsigned int target_x = 0; target_x < target_width; target_x++) {
-            const unsigned int source_x = region_width * target_x;
-            datum sum = 0;
-            for(unsigned int ry = 0; ry < region_height; ry++) {
-              for(unsigned int rx = 0; rx < region_width; rx++) {
-                const datum* src = source.data_ptr_const(source_x + rx, source_y + ry, map, sample);
-                sum += *src;
-              }
-            }
-            datum* tgt = target.data_ptr(target_x, target_y, map, sample);
-            *tgt = sum * target_factor;
-          }
-        }
-      }
-    }
+    TensorMathKernels::Get().down(source.data_ptr_const(), target.data_ptr(),
+      source.width(), source.height(), target_width, target_height,
+      maps * samples, region_width, region_height, target_factor);
     
 #ifdef BUILD_OPENCL
   }
@@ -568,24 +768,9 @@ void TensorMath::UP(const Tensor& source, Tensor& target, const int region_width
     const int height = source.height();
     const int maps = source.maps();
     const int samples = source.samples();
-    for(int sample = 0; sample < samples; sample++) {
-      for(int map = 0; map < maps; map++) {
-        for(unsigned int y = 0; y < height; y++) {
-          const unsigned int iy = region_height * y;
-          for(unsigned int x = 0; x < width; x++) {
-            const unsigned int ix = region_width * x;
-            const datum* src = source.data_ptr_const(x, y, map, sample);
-            datum sum = *src;
-            for(unsigned int ry = 0; ry < region_height; ry++) {
-              for(unsigned int rx = 0; rx < region_width; rx++) {
-                datum* tgt = target.data_ptr(ix + rx, iy + ry, map, sample);
-                *tgt = sum * target_factor;
-              }
-            }
-          }
-        }
-      }
-    }
+    TensorMathKernels::Get().up(source.data_ptr_const(), target.data_ptr(),
+      width, height, target.width(), target.height(), maps * samples,
+      region_width, region_height, target_factor);
 #ifdef BUILD_OPENCL
   }
 #endif
@@ -607,17 +792,86 @@ void TensorMath::ADD(const Tensor& source_a, const Tensor& source_b, Tensor& tar
     FATAL("Dimensions don't match!");
   }
   
-  #pragma omp parallel for default(shared)
-  for(unsigned int element = 0; element < source_a.elements(); element++) {
-    const datum* source_a_ptr = &(source_a.data_ptr_const()[element]);
-    const datum* source_b_ptr = &(source_b.data_ptr_const()[element]);
-    datum* target_ptr = &(target.data_ptr()[element]);
-    
-    *target_ptr = *source_a_ptr + *source_b_ptr;
-  }
+  TensorMathKernels::Get().add(source_a.data_ptr_const(), source_b.data_ptr_const(),
+    target.data_ptr(), source_a.elements());
+  
+  target.hint_ignore_content_ = false;
+}
+
+
+void TensorMath::EXP(const Tensor& source, Tensor& target)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)source).MoveToCPU();
+  target.MoveToCPU(true);
+#endif
+  if(source.elements() != target.elements())
+    FATAL("Dimensions don't match!");
+  
+  TensorMathKernels::Get().exp(source.data_ptr_const(), target.data_ptr(),
+    source.elements(), TensorMathKernels::IsExactMath());
+  
+  target.hint_ignore_content_ = false;
+}
+
+void TensorMath::ACTIVATION(const Tensor& source, const ActivationFunction activation, Tensor& target, const datum scale, const datum offset)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)source).MoveToCPU();
+  target.MoveToCPU(&source != &target);
+#endif
+  if(source.elements() != target.elements())
+    FATAL("Dimensions don't match!");
+  
+  TensorMathKernels::Get().activation(source.data_ptr_const(), target.data_ptr(),
+    source.elements(), scale, offset, activation, TensorMathKernels::IsExactMath());
   
   target.hint_ignore_content_ = false;
 }
 
+void TensorMath::BIAS_ACTIVATION(const Tensor* bias, const datum alpha, const ActivationFunction activation, Tensor& target, const int first_sample, const int samples)
+{
+#ifdef BUILD_OPENCL
+  if(bias != nullptr)
+    ((Tensor*)bias)->MoveToCPU();
+  target.MoveToCPU();
+#endif
+  if(first_sample + samples > (int)target.samples() || (bias != nullptr && bias->elements() < target.maps()))
+    FATAL("Dimensions don't match!");
+  
+  TensorMathKernels::Get().bias_activation(target.data_ptr(0, 0, 0, first_sample),
+    target.width() * target.height(), target.maps(), samples, alpha,
+    bias == nullptr ? nullptr : bias->data_ptr_const(), activation,
+    TensorMathKernels::IsExactMath());
+  
+  target.hint_ignore_content_ = false;
+}
+
+void TensorMath::ACTIVATION_GRADIENT(const Tensor& output, const Tensor& output_delta, const ActivationFunction activation, Tensor* delta, Tensor* bias_delta)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)output).MoveToCPU();
+  ((Tensor&)output_delta).MoveToCPU();
+  if(delta != nullptr && activation != ACTIVATION_NONE)
+    delta->MoveToCPU(true);
+  if(bias_delta != nullptr)
+    bias_delta->MoveToCPU(true);
+#endif
+  if(output.elements() != output_delta.elements()
+    || (delta != nullptr && delta->elements() != output.elements())
+    || (bias_delta != nullptr && bias_delta->elements() < output.maps())) {
+    FATAL("Dimensions don't match!");
+  }
+  
+  TensorMathKernels::Get().activation_gradient(output.data_ptr_const(),
+    output_delta.data_ptr_const(), delta == nullptr ? nullptr : delta->data_ptr(),
+    output.width() * output.height(), output.maps(), output.samples(), activation,
+    bias_delta == nullptr ? nullptr : bias_delta->data_ptr());
+  
+  if(delta != nullptr && activation != ACTIVATION_NONE)
+    delta->hint_ignore_content_ = false;
+  if(bias_delta != nullptr)
+    bias_delta->hint_ignore_content_ = false;
+}
 
 }
@@ -0,0 +1,127 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <atomic>
+#include <string>
+
+#include "Log.h"
+#include "TensorMathKernels.h"
+
+namespace Conv {
+
+static std::atomic<const TensorMathKernelTable*> bound_table(nullptr);
+static std::atomic<bool> exact_math(false);
+
+CPUInstructionSet TensorMathKernels::DetectInstructionSet() {
+#ifdef CN24_X86_KERNELS
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return CPU_ISA_AVX512;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return CPU_ISA_AVX2;
+  if(__builtin_cpu_supports("sse4.2"))
+    return CPU_ISA_SSE42;
+#endif
+  return CPU_ISA_GENERIC;
+}
+
+const TensorMathKernelTable* TensorMathKernels::GetTable(CPUInstructionSet isa) {
+  switch(isa) {
+    case CPU_ISA_GENERIC:
+      return GetGenericKernelTable();
+    case CPU_ISA_SSE42:
+      return GetSSE42KernelTable();
+    case CPU_ISA_AVX2:
+      return GetAVX2KernelTable();
+    case CPU_ISA_AVX512:
+      return GetAVX512KernelTable();
+  }
+  return nullptr;
+}
+
+const char* TensorMathKernels::GetInstructionSetName(CPUInstructionSet isa) {
+  switch(isa) {
+    case CPU_ISA_GENERIC:
+      return "generic";
+    case CPU_ISA_SSE42:
+      return "sse4.2";
+    case CPU_ISA_AVX2:
+      return "avx2";
+    case CPU_ISA_AVX512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+bool TensorMathKernels::ParseInstructionSet(const std::string& name, CPUInstructionSet& isa) {
+  for(int i = CPU_ISA_GENERIC; i <= CPU_ISA_AVX512; i++) {
+    if(name.compare(GetInstructionSetName((CPUInstructionSet)i)) == 0) {
+      isa = (CPUInstructionSet)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Returns the best table not above the given instruction set that this
+ * build contains. The generic table always exists.
+ */
+static const TensorMathKernelTable* BestTable(CPUInstructionSet isa) {
+  for(int i = isa; i > CPU_ISA_GENERIC; i--) {
+    const TensorMathKernelTable* table = TensorMathKernels::GetTable((CPUInstructionSet)i);
+    if(table != nullptr)
+      return table;
+  }
+  return GetGenericKernelTable();
+}
+
+void TensorMathKernels::Init(const std::string& requested_isa) {
+  const CPUInstructionSet detected_isa = DetectInstructionSet();
+  CPUInstructionSet isa = detected_isa;
+
+  if(requested_isa.length() > 0) {
+    CPUInstructionSet forced_isa;
+    if(!ParseInstructionSet(requested_isa, forced_isa)) {
+      LOGWARN << "Unknown instruction set \"" << requested_isa << "\", ignoring";
+    } else if(forced_isa > detected_isa) {
+      LOGWARN << "Instruction set \"" << requested_isa << "\" is not supported by this CPU, ignoring";
+    } else {
+      isa = forced_isa;
+    }
+  }
+
+  const TensorMathKernelTable* table = BestTable(isa);
+  bound_table.store(table);
+
+  LOGINFO << "Using " << table->name << " CPU kernels (detected: "
+    << GetInstructionSetName(detected_isa) << ", GEMM tile: " << table->gemm.mr
+    << "x" << table->gemm.nr << ")";
+}
+
+const TensorMathKernelTable& TensorMathKernels::Get() {
+  const TensorMathKernelTable* table = bound_table.load(std::memory_order_acquire);
+  if(table == nullptr) {
+    // TensorMath used before System::Init
+    table = BestTable(DetectInstructionSet());
+    bound_table.store(table);
+  }
+  return *table;
+}
+
+void TensorMathKernels::SetExactMath(const bool exact) {
+  exact_math.store(exact);
+  if(exact) {
+    LOGINFO << "Using libm for exp, tanh and sigmoid";
+  }
+}
+
+bool TensorMathKernels::IsExactMath() {
+  return exact_math.load(std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "TensorMathKernels.h"
+
+#ifdef CN24_X86_KERNELS
+#include <immintrin.h>
+
+namespace Conv {
+
+namespace KernelsAVX2 {
+#define CN24_KERNEL_TARGET __attribute__((target("avx2,fma")))
+#define CN24_KERNEL_ISA CPU_ISA_AVX2
+#define CN24_KERNEL_ISA_NAME "avx2"
+#define CN24_VEC __m256
+#define CN24_VEC_WIDTH 8
+#define CN24_VEC_ZERO() _mm256_setzero_ps()
+#define CN24_VEC_SET1(x) _mm256_set1_ps(x)
+#define CN24_VEC_LOAD(p) _mm256_loadu_ps(p)
+#define CN24_VEC_STORE(p, v) _mm256_storeu_ps(p, v)
+#define CN24_VEC_ADD(a, b) _mm256_add_ps(a, b)
+#define CN24_VEC_MUL(a, b) _mm256_mul_ps(a, b)
+#define CN24_VEC_FMA(a, b, c) _mm256_fmadd_ps(a, b, c)
+#define CN24_VEC_MAX(a, b) _mm256_max_ps(a, b)
+#define CN24_VEC_SUB(a, b) _mm256_sub_ps(a, b)
+#define CN24_VEC_DIV(a, b) _mm256_div_ps(a, b)
+#define CN24_VEC_MIN(a, b) _mm256_min_ps(a, b)
+#define CN24_VEC_ROUND(a) _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define CN24_VEC_POW2(n) _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23))
+#define CN24_VEC_FROM_U8(p) _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p))))
+#include "TensorMathKernelsImpl.h"
+}
+
+const TensorMathKernelTable* GetAVX2KernelTable() {
+  return &KernelsAVX2::kernel_table;
+}
+
+}
+
+#else
+
+namespace Conv {
+
+const TensorMathKernelTable* GetAVX2KernelTable() {
+  return nullptr;
+}
+
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "TensorMathKernels.h"
+
+#ifdef CN24_X86_KERNELS
+#include <immintrin.h>
+
+namespace Conv {
+
+namespace KernelsAVX512 {
+#define CN24_KERNEL_TARGET __attribute__((target("avx512f")))
+#define CN24_KERNEL_ISA CPU_ISA_AVX512
+#define CN24_KERNEL_ISA_NAME "avx512"
+#define CN24_VEC __m512
+#define CN24_VEC_WIDTH 16
+#define CN24_VEC_ZERO() _mm512_setzero_ps()
+#define CN24_VEC_SET1(x) _mm512_set1_ps(x)
+#define CN24_VEC_LOAD(p) _mm512_loadu_ps(p)
+#define CN24_VEC_STORE(p, v) _mm512_storeu_ps(p, v)
+#define CN24_VEC_ADD(a, b) _mm512_add_ps(a, b)
+#define CN24_VEC_MUL(a, b) _mm512_mul_ps(a, b)
+#define CN24_VEC_FMA(a, b, c) _mm512_fmadd_ps(a, b, c)
+/*
+ * GCC 12 implements most unmasked AVX-512 intrinsics as masked builtins
+ * on _mm512_undefined_ps, which -Wmaybe-uninitialized reports once they
+ * are inlined. The masked forms with all lanes set and a defined source
+ * compile to the same instructions.
+ */
+#define CN24_ALL_LANES ((__mmask16)0xFFFF)
+#define CN24_VEC_MAX(a, b) _mm512_mask_max_ps(_mm512_setzero_ps(), CN24_ALL_LANES, a, b)
+#define CN24_VEC_SUB(a, b) _mm512_sub_ps(a, b)
+#define CN24_VEC_DIV(a, b) _mm512_div_ps(a, b)
+#define CN24_VEC_MIN(a, b) _mm512_mask_min_ps(_mm512_setzero_ps(), CN24_ALL_LANES, a, b)
+#define CN24_VEC_ROUND(a) _mm512_mask_roundscale_ps(_mm512_setzero_ps(), CN24_ALL_LANES, a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define CN24_VEC_POW2(n) _mm512_castsi512_ps(_mm512_mask_slli_epi32(_mm512_setzero_si512(), CN24_ALL_LANES, \
+  _mm512_add_epi32(_mm512_mask_cvtps_epi32(_mm512_setzero_si512(), CN24_ALL_LANES, n), _mm512_set1_epi32(127)), 23))
+#define CN24_VEC_TO_HALF(p, v) _mm256_storeu_si256((__m256i*)(p), _mm512_mask_cvtps_ph(_mm256_setzero_si256(), CN24_ALL_LANES, \
+  v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC))
+#define CN24_VEC_FROM_HALF(p) _mm512_mask_cvtph_ps(_mm512_setzero_ps(), CN24_ALL_LANES, _mm256_loadu_si256((const __m256i*)(p)))
+#define CN24_VEC_FROM_U8(p) _mm512_mask_cvtepi32_ps(_mm512_setzero_ps(), CN24_ALL_LANES, \
+  _mm512_mask_cvtepu8_epi32(_mm512_setzero_si512(), CN24_ALL_LANES, _mm_loadu_si128((const __m128i*)(p))))
+#define CN24_KERNEL_GEMM_U8S8 GEMMU8S8Dispatch
+static void GEMMU8S8Dispatch(const int M, const int N, const int K,
+  const std::int8_t* A, const std::uint8_t* packed, const std::int32_t* offset,
+  const datum* scale, datum* C, const int m_stride, const int n_stride);
+#include "TensorMathKernelsImpl.h"
+
+/*
+ * 8 bit GEMM with VPDPBUSD, which adds four products of unsigned and
+ * signed bytes to each 32 bit lane. Blocks of 4 rows and 2 panels keep
+ * 8 accumulators.
+ */
+__attribute__((target("avx512f,avx512vnni")))
+static void GEMMU8S8VNNI(const int M, const int N, const int K,
+  const std::int8_t* A, const std::uint8_t* packed, const std::int32_t* offset,
+  const datum* scale, datum* C, const int m_stride, const int n_stride) {
+  const int lanes = CN24_INT8_LANES;
+  const int K4 = (K + 3) / 4;
+  const int panels = (N + lanes - 1) / lanes;
+  const int panel_pairs = (panels + 1) / 2;
+  const int row_blocks = (M + 3) / 4;
+  #pragma omp parallel for default(shared)
+  for(int task = 0; task < row_blocks * panel_pairs; task++) {
+    const int m0 = (task / panel_pairs) * 4, p0 = (task % panel_pairs) * 2;
+    const int rows = std::min(4, M - m0);
+    const int pair = std::min(2, panels - p0);
+    const std::uint8_t* b0 = packed + (std::size_t)p0 * K4 * lanes * 4;
+    // A missing second panel repeats the first one and is not stored
+    const std::uint8_t* b1 = b0 + (pair == 2 ? (std::size_t)K4 * lanes * 4 : 0);
+    const std::int8_t* a[4];
+    for(int r = 0; r < 4; r++)
+      a[r] = A + (std::size_t)(m0 + std::min(r, rows - 1)) * K4 * 4;
+
+    __m512i acc[4][2];
+    for(int r = 0; r < 4; r++)
+      acc[r][0] = acc[r][1] = _mm512_setzero_si512();
+    for(int k4 = 0; k4 < K4; k4++) {
+      const __m512i v0 = _mm512_loadu_si512(b0 + (std::size_t)k4 * lanes * 4);
+      const __m512i v1 = _mm512_loadu_si512(b1 + (std::size_t)k4 * lanes * 4);
+      for(int r = 0; r < 4; r++) {
+        std::int32_t quad;
+        std::memcpy(&quad, a[r] + 4 * k4, sizeof(quad));
+        const __m512i w = _mm512_set1_epi32(quad);
+        acc[r][0] = _mm512_dpbusd_epi32(acc[r][0], v0, w);
+        acc[r][1] = _mm512_dpbusd_epi32(acc[r][1], v1, w);
+      }
+    }
+
+    for(int r = 0; r < rows; r++) {
+      for(int q = 0; q < pair; q++) {
+        const int n0 = (p0 + q) * lanes;
+        const int columns = std::min(lanes, N - n0);
+        const int m = m0 + r;
+        if(n_stride == 1) {
+          const __m512 result = _mm512_mul_ps(_mm512_set1_ps(scale[m]), _mm512_mask_cvtepi32_ps(
+            _mm512_setzero_ps(), CN24_ALL_LANES, _mm512_sub_epi32(acc[r][q], _mm512_set1_epi32(offset[m]))));
+          _mm512_mask_storeu_ps(C + (std::size_t)m * m_stride + n0,
+            (__mmask16)((1u << columns) - 1), result);
+        } else {
+          std::int32_t block[CN24_INT8_LANES];
+          _mm512_storeu_si512(block, acc[r][q]);
+          StoreU8S8Block(block, m, n0, columns, offset, scale, C, m_stride, n_stride);
+        }
+      }
+    }
+  }
+}
+
+static void GEMMU8S8Dispatch(const int M, const int N, const int K,
+  const std::int8_t* A, const std::uint8_t* packed, const std::int32_t* offset,
+  const datum* scale, datum* C, const int m_stride, const int n_stride) {
+  static const bool vnni = __builtin_cpu_supports("avx512vnni");
+  if(vnni)
+    GEMMU8S8VNNI(M, N, K, A, packed, offset, scale, C, m_stride, n_stride);
+  else
+    GEMM_U8S8(M, N, K, A, packed, offset, scale, C, m_stride, n_stride);
+}
+}
+
+const TensorMathKernelTable* GetAVX512KernelTable() {
+  return &KernelsAVX512::kernel_table;
+}
+
+}
+
+#else
+
+namespace Conv {
+
+const TensorMathKernelTable* GetAVX512KernelTable() {
+  return nullptr;
+}
+
+}
+
+#endif
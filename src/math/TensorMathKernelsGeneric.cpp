@@ -0,0 +1,43 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "TensorMathKernels.h"
+
+namespace Conv {
+
+namespace KernelsGeneric {
+#define CN24_KERNEL_TARGET
+#define CN24_KERNEL_ISA CPU_ISA_GENERIC
+#define CN24_KERNEL_ISA_NAME "generic"
+#define CN24_VEC_SCALAR
+#define CN24_VEC datum
+#define CN24_VEC_WIDTH 1
+#define CN24_VEC_ZERO() ((datum)0)
+#define CN24_VEC_SET1(x) (x)
+#define CN24_VEC_LOAD(p) (*(p))
+#define CN24_VEC_STORE(p, v) (*(p) = (v))
+#define CN24_VEC_ADD(a, b) ((a) + (b))
+#define CN24_VEC_MUL(a, b) ((a) * (b))
+#define CN24_VEC_FMA(a, b, c) ((a) * (b) + (c))
+#define CN24_VEC_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define CN24_VEC_SUB(a, b) ((a) - (b))
+#define CN24_VEC_DIV(a, b) ((a) / (b))
+#define CN24_VEC_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define CN24_VEC_ROUND(a) std::nearbyint(a)
+#define CN24_VEC_POW2(n) std::ldexp((datum)1, (int)(n))
+#include "TensorMathKernelsImpl.h"
+}
+
+const TensorMathKernelTable* GetGenericKernelTable() {
+  return &KernelsGeneric::kernel_table;
+}
+
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "TensorMathKernels.h"
+
+#ifdef CN24_X86_KERNELS
+#include <immintrin.h>
+
+namespace Conv {
+
+namespace KernelsSSE42 {
+#define CN24_KERNEL_TARGET __attribute__((target("sse4.2")))
+#define CN24_KERNEL_ISA CPU_ISA_SSE42
+#define CN24_KERNEL_ISA_NAME "sse4.2"
+#define CN24_VEC __m128
+#define CN24_VEC_WIDTH 4
+#define CN24_VEC_ZERO() _mm_setzero_ps()
+#define CN24_VEC_SET1(x) _mm_set1_ps(x)
+#define CN24_VEC_LOAD(p) _mm_loadu_ps(p)
+#define CN24_VEC_STORE(p, v) _mm_storeu_ps(p, v)
+#define CN24_VEC_ADD(a, b) _mm_add_ps(a, b)
+#define CN24_VEC_MUL(a, b) _mm_mul_ps(a, b)
+#define CN24_VEC_FMA(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#define CN24_VEC_MAX(a, b) _mm_max_ps(a, b)
+#define CN24_VEC_SUB(a, b) _mm_sub_ps(a, b)
+#define CN24_VEC_DIV(a, b) _mm_div_ps(a, b)
+#define CN24_VEC_MIN(a, b) _mm_min_ps(a, b)
+#define CN24_VEC_ROUND(a) _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define CN24_VEC_POW2(n) _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23))
+// Loads four bytes without assuming their alignment
+CN24_KERNEL_TARGET static inline __m128 FromU8(const std::uint8_t* p) {
+  std::int32_t bytes;
+  std::memcpy(&bytes, p, sizeof(bytes));
+  return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)));
+}
+#define CN24_VEC_FROM_U8(p) FromU8(p)
+#include "TensorMathKernelsImpl.h"
+}
+
+const TensorMathKernelTable* GetSSE42KernelTable() {
+  return &KernelsSSE42::kernel_table;
+}
+
+}
+
+#else
+
+namespace Conv {
+
+const TensorMathKernelTable* GetSSE42KernelTable() {
+  return nullptr;
+}
+
+}
+
+#endif
@@ -17,6 +17,7 @@
 
 
 #include "CLHelper.h"
+#include "TensorMath.h"
 #include "NonLinearityLayer.h"
 
 namespace Conv {
@@ -66,14 +67,8 @@ void SigmoidLayer::FeedForward () {
 #endif
 
 #else
-#pragma omp parallel for default(shared)
-  for (std::size_t element = 0; element < input_->data.elements(); element++) {
-    const datum input_data = input_->data.data_ptr_const() [element];
-
-    // Calculate sigmoid: sigm(x) = 1.0 / (1.0 + e^-x)
-    const datum output_data = 1.0 / (1.0 + exp (-input_data));
-    output_->data.data_ptr() [element] = output_data;
-  }
+  // Calculate sigmoid: sigm(x) = 1.0 / (1.0 + e^-x)
+  TensorMath::ACTIVATION(input_->data, ACTIVATION_SIGMOID, output_->data);
 #endif
 }
 
@@ -111,21 +106,12 @@ void SigmoidLayer::BackPropagate () {
  
   
 #else
-#pragma omp parallel for default(shared)
-  for (std::size_t element = 0; element < input_->data.elements (); element++) {
-    const datum output_delta = output_->delta.data_ptr_const ()[element];
-    const datum output_data = output_->data.data_ptr_const ()[element];
-
-    // sigm'(x) = sigm(x) * (1.0 - sigm(x))
-    // sigm(x) = output
-    // this is why we use output_data here (so we don't need to calculate
-    // sigm(x) twice).
-    // This may be slower for wide networks and large batches
-    // because of cache limitations.
-
-    const datum input_delta = (datum) (output_delta * output_data * (1.0 - output_data));
-    input_->delta.data_ptr ()[element] = input_delta;
-  }
+  // sigm'(x) = sigm(x) * (1.0 - sigm(x))
+  // sigm(x) = output
+  // this is why we use the output here (so we don't need to calculate
+  // sigm(x) twice).
+  TensorMath::ACTIVATION_GRADIENT(output_->data, output_->delta, ACTIVATION_SIGMOID,
+    &input_->delta, nullptr);
 #endif
 }
 
@@ -158,14 +144,8 @@ void TanhLayer::FeedForward () {
 #endif
 
 #else
-#pragma omp parallel for default(shared)
-  for (std::size_t element = 0; element < input_->data.elements(); element++) {
-    const datum input_data = input_->data.data_ptr_const() [element];
-
-    // Calculate hyperbolic tangent: tanh(x) = 1.0 - 2.0 / (e^(2*x) + 1)
-    const datum output_data = 1.0 - 2.0 / (exp (2.0 * input_data) + 1.0);
-    output_->data.data_ptr() [element] = output_data;
-  }
+  // Calculate hyperbolic tangent
+  TensorMath::ACTIVATION(input_->data, ACTIVATION_TANH, output_->data);
 #endif
 }
 
@@ -202,56 +182,37 @@ void TanhLayer::BackPropagate () {
 
   
 #else
-#pragma omp parallel for default(shared)
-  for (std::size_t element = 0; element < input_->data.elements (); element++) {
-    const datum output_delta = output_->delta.data_ptr_const ()[element];
-    const datum output_data = output_->data.data_ptr_const ()[element];
-
-    // tanh'(x) = 1 - (tanh(x))^2
-    // tanh(x) = output
-    // see SigmoidLayer::BackPropagate for an explanation
-
-    const datum input_delta = (datum) (output_delta * (1.0 - output_data * output_data));
-    input_->delta.data_ptr ()[element] = input_delta;
-  }
+  // tanh'(x) = 1 - (tanh(x))^2
+  // tanh(x) = output
+  // see SigmoidLayer::BackPropagate for an explanation
+  TensorMath::ACTIVATION_GRADIENT(output_->data, output_->delta, ACTIVATION_TANH,
+    &input_->delta, nullptr);
 #endif
 }
 
 void ReLULayer::FeedForward () {
-#pragma omp parallel for default(shared)
-  for (std::size_t element = 0; element < input_->data.elements (); element++) {
-    const datum input_data = input_->data.data_ptr_const ()[element];
-
-    // max(0, x)
-    const datum output_data = input_data > 0 ? input_data : 0;
-    output_->data.data_ptr ()[element] = output_data;
-  }
+  // max(0, x)
+  TensorMath::ACTIVATION(input_->data, ACTIVATION_RELU, output_->data);
 }
 
 void ReLULayer::BackPropagate () {
-#pragma omp parallel for default(shared)
-  for (std::size_t element = 0; element < input_->data.elements (); element++) {
-    const datum output_delta = output_->delta.data_ptr_const ()[element];
-    const datum input_data = input_->data.data_ptr_const ()[element];
-
-    // There is more than one way to do this. max(0,x) is not differentiable
-    // at x=0 so we have to make a choice. It doesn't affect the learning in
-    // any meaningful way.
-    const datum input_delta = (input_data > 0 ? output_delta : 0);
-    input_->delta.data_ptr ()[element] = input_delta;
-  }
+  // There is more than one way to do this. max(0,x) is not differentiable
+  // at x=0 so we have to make a choice. It doesn't affect the learning in
+  // any meaningful way. The output is positive exactly where the input is.
+  TensorMath::ACTIVATION_GRADIENT(output_->data, output_->delta, ACTIVATION_RELU,
+    &input_->delta, nullptr);
 }
 
 void SoftmaxLayer::FeedForward () {
+  TensorMath::EXP(input_->data, output_->data);
 #pragma omp parallel for default(shared)
   for (std::size_t sample = 0; sample < input_->data.samples (); sample++) {
     float sum = 0.0f;
     for(std::size_t element = 0; element < input_->data.width (); element++) {
-      sum += exp (*input_->data.data_ptr (element,0,0,sample));
+      sum += *output_->data.data_ptr (element,0,0,sample);
     }
     for (std::size_t element = 0; element < input_->data.width () ; element++) {
-      *output_->data.data_ptr(element,0,0,sample) =
-          (datum) exp (*input_->data.data_ptr (element,0,0,sample)) / sum;
+      *output_->data.data_ptr(element,0,0,sample) /= sum;
     }
   }
 }
@@ -65,7 +65,7 @@ bool AdvancedMaxPoolingLayer::CreateOutputs (
   // Create output
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
       output_width, output_height,
-      input->data.maps());
+      input->data.maps(), !inference_only_);
 
   // Tell network about the output
   outputs.push_back (output);
@@ -91,8 +91,12 @@ bool AdvancedMaxPoolingLayer::Connect (const CombinedTensor* input,
 
   maps_ = input->data.maps();
 
-  maximum_mask_.Resize (input->data.samples(), output_width_,
-			output_height_, maps_);
+  // Only the backward pass reads the mask, the OpenCL kernel always writes it
+#ifndef BUILD_OPENCL_MAX
+  if (!inference_only_)
+#endif
+    maximum_mask_.Resize (input->data.samples(), output_width_,
+			  output_height_, maps_);
 
   return true;
 }
@@ -160,7 +164,8 @@ void AdvancedMaxPoolingLayer::FeedForward() {
           }
           
           // Found maximum, save
-          *maximum_mask_.data_ptr(ox, oy, map, sample) = input_width_ * miy + mix;
+          if (!inference_only_)
+            *maximum_mask_.data_ptr(ox, oy, map, sample) = input_width_ * miy + mix;
           
           // Feed forward
           *output_->data.data_ptr(ox, oy, map, sample) = maximum;
@@ -45,7 +45,7 @@ bool ConcatenationLayer::CreateOutputs (const std::vector< CombinedTensor* >& in
   unsigned int maps_b = input_b->data.maps();
   unsigned int samples = input_a->data.samples();
   CombinedTensor* output = new CombinedTensor(samples, input_a->data.width(),
-    input_b->data.height(), maps_a + maps_b);
+    input_b->data.height(), maps_a + maps_b, !inference_only_);
   
   outputs.push_back(output);
   return true;
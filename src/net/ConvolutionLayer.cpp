@@ -4,6 +4,7 @@
  *
  * For licensing information, see the LICENSE file included with this project.
  */
+#include <cmath>
 #include <cstring>
 #include <algorithm>
 
@@ -20,6 +21,8 @@
 #include "CLHelper.h"
 #include "TensorMath.h"
 #include "ConfigParsing.h"
+#include "FFTConvolution.h"
+#include "QuantizedConvolution.h"
 
 #include "TensorViewer.h"
 
@@ -92,11 +95,34 @@ ConvolutionLayer::ConvolutionLayer(std::string configuration) :
   ParseDatumParamIfPossible (configuration, "llr", local_lr);
   ParseCountIfPossible(configuration, "seed", seed);
   
+  std::string engine_name;
+  ParseStringParamIfPossible (configuration, "engine", engine_name);
+  if(engine_name.length() > 0 && !ParseEngine(engine_name, requested_engine_)) {
+    FATAL("Unknown convolution engine: " << engine_name);
+  }
+  
+  std::string activation_name;
+  ParseStringParamIfPossible (configuration, "activation", activation_name);
+  if(activation_name.length() > 0 && !ParseActivation(activation_name, activation_)) {
+    FATAL("Unknown activation function: " << activation_name);
+  }
+  
   // TODO Validation like in large constructor
   
   SetLocalLearningRate(local_lr);
 }
 
+ConvolutionLayer::~ConvolutionLayer() {
+  if(weights_ != nullptr)
+    delete weights_;
+  if(bias_ != nullptr)
+    delete bias_;
+  if(fft_ != nullptr)
+    delete fft_;
+  if(quantized_ != nullptr)
+    delete quantized_;
+}
+
 bool ConvolutionLayer::CreateOutputs (
   const std::vector< CombinedTensor* >& inputs,
   std::vector< CombinedTensor* >& outputs) {
@@ -135,7 +161,7 @@ bool ConvolutionLayer::CreateOutputs (
   
   // Create output
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
-      output_width, output_height, output_maps_);
+      output_width, output_height, output_maps_, !inference_only_);
 
   // Tell network about the output
   outputs.push_back (output);
@@ -163,27 +189,92 @@ bool ConvolutionLayer::Connect (const CombinedTensor* input,
 
   LOGDEBUG << "Local learning rate is now " << local_lr_;
   
-  // Create im2col output buffer
-  im2col_ff_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_, output_width_,
-                           output_height_, input->data.samples());
+  engine_ = SelectEngine(input->data.samples());
+  LOGDEBUG << "Using " << GetEngineName(engine_) << " engine";
   
-  sms_ff_buffer.Resize(output_maps_, output_width_, output_height_, input->data.samples());
+  // Im2col convolutions with large enough outputs run one batch of group
+  // GEMMs per sample that writes straight into the output. Smaller ones are
+  // faster as one batch over all samples and a transpose afterwards.
+  direct_output_ = engine_ == ENGINE_IM2COL &&
+    output_width_ * output_height_ >= 256;
   
-  sms2_bp_buffer.Resize(output_maps_, output_width_, output_height_, input->data.samples());
-
-  bp_deltax_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_, output_width_,
-                           output_height_, input->data.samples());
-
-  // This is faster than adding manually...
-  ones_.Resize (1, output_width_ * output_height_ * input->data.samples());
+  if(direct_output_) {
+    // Create im2col output buffer. Each row of the patch matrix holds one
+    // block of output pixels per sample, so the per-sample GEMMs can address
+    // a block as a "sample" of these buffers
+    im2col_ff_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_ * input->data.samples(),
+                             output_width_, output_height_);
+  
+    if(!inference_only_)
+      bp_deltax_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_ * input->data.samples(),
+                               output_width_, output_height_);
+  } else if(engine_ == ENGINE_IM2COL) {
+    im2col_ff_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_, output_width_,
+                             output_height_, input->data.samples());
+  
+    if(!inference_only_)
+      bp_deltax_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_, output_width_,
+                               output_height_, input->data.samples());
+  
+    // These GEMMs produce map-major results that are transposed into the
+    // output afterwards
+    sms_ff_buffer.Resize(output_maps_, output_width_, output_height_, input->data.samples());
+  
+    if(!inference_only_)
+      sms2_bp_buffer.Resize(output_maps_, output_width_, output_height_, input->data.samples());
+  }
+  
+  if(engine_ == ENGINE_WINOGRAD) {
+    // 4x4 output tiles for the forward pass and the weight gradient,
+    // input sized tiles for the input gradient
+    output_tiles_x_ = (output_width_ + 3) / 4;
+    output_tiles_y_ = (output_height_ + 3) / 4;
+    input_tiles_x_ = (input_width_ + 3) / 4;
+    input_tiles_y_ = (input_height_ + 3) / 4;
+    const unsigned int output_tiles = output_tiles_x_ * output_tiles_y_ * input->data.samples();
+    const unsigned int input_tiles = input_tiles_x_ * input_tiles_y_ * input->data.samples();
+    
+    winograd_input_buffer_.Resize(36, output_tiles, input_maps_);
+    winograd_product_buffer_.Resize(36, output_tiles, output_maps_);
+    winograd_weights_.Resize(36, input_maps_, output_maps_);
+    
+    if(!inference_only_) {
+      winograd_bp_input_buffer_.Resize(36, input_tiles, output_maps_);
+      winograd_bp_product_buffer_.Resize(36, input_tiles, input_maps_);
+      winograd_flipped_weights_.Resize(36, output_maps_, input_maps_);
+      winograd_weights_delta_.Resize(36, input_maps_, output_maps_);
+      
+      ones_.Resize(1, output_tiles);
+      for (unsigned int i = 0; i < ones_.elements(); i++) {
+        ones_[i] = 1;
+      }
+    }
+    OnParametersChanged();
+  } else if(engine_ == ENGINE_FFT) {
+    if(fft_ != nullptr)
+      delete fft_;
+    fft_ = new FFTConvolution(ConvolutionGeometry(input_width_, input_height_, input_maps_,
+          input->data.samples(), kernel_width_, kernel_height_, 1, 1, pad_width_, pad_height_), output_maps_);
+    OnParametersChanged();
+  }
 
-  for (unsigned int i = 0; i < ones_.elements(); i++) {
-    ones_[i] = 1;
+#ifdef BUILD_OPENCL_CONV
+  // The bias GEMMs stay on the device, see AddBias
+  if(engine_ != ENGINE_WINOGRAD && engine_ != ENGINE_FFT) {
+    ones_.Resize(1, std::max((std::size_t)(output_width_ * output_height_), input->data.samples()));
+    for (unsigned int i = 0; i < ones_.elements(); i++) {
+      ones_[i] = 1;
+    }
   }
+#endif
+
+  // Gradient w.r.t. the input of the fused activation
+  if(activation_ != ACTIVATION_NONE && !inference_only_)
+    activation_delta_.Resize(input->data.samples(), output_width_, output_height_, output_maps_);
 
   // Create kernels
-  weights_ = new CombinedTensor (output_maps_, kernel_width_, kernel_height_, input_maps_ / group_);
-  bias_ = new CombinedTensor (1, output_maps_);
+  weights_ = new CombinedTensor (output_maps_, kernel_width_, kernel_height_, input_maps_ / group_, !inference_only_);
+  bias_ = new CombinedTensor (1, output_maps_, 1, 1, !inference_only_);
 
   // Initialize weights to zero so the net won't work if Net::InitializeWeights
   // is not called. Random memory junk may work but is certainly not optimal.
@@ -204,40 +295,156 @@ void ConvolutionLayer::FeedForward() {
   const datum p = net_->IsTesting() ? 0.0 : dropout_fraction_;
   const datum w = net_->IsTesting() ? (1.0 - dropout_fraction_) : 1.0;
   
-  im2col_ff_buffer.hint_ignore_content_ = true;
   output_->data.hint_ignore_content_ = true;
-  sms_ff_buffer.hint_ignore_content_ = true;
   
-  TensorMath::IM2COL(input_->data, input_width_, input_height_, input_maps_, input_->data.samples(),
-        kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_, im2col_ff_buffer);
+#ifdef BUILD_OPENCL
+  if(calibrating_ || (quantization_range_ > 0 && net_->IsTesting())) {
+    input_->data.MoveToCPU();
+    weights_->data.MoveToCPU();
+    bias_->data.MoveToCPU();
+    output_->data.MoveToCPU(true);
+  }
+#endif
   
-
-  for(unsigned int g = 0; g < group_; g++) {
-    // Convolve
-    TensorMath::GEMM(true, false, false, output_maps_ / group_,
-          output_width_ * output_height_ * input_->data.samples(),
-          (kernel_width_ * kernel_height_ * input_maps_) / group_,
-          w, weights_->data, (g * output_maps_) / group_, (kernel_width_ * kernel_height_ * input_maps_) / group_,
-          im2col_ff_buffer, (kernel_width_ * kernel_height_ * input_maps_ * g) / group_, output_width_ * output_height_ * input_->data.samples(),
-          0.0, sms_ff_buffer, (g * output_maps_) / group_, output_width_ * output_height_ * input_->data.samples());
+  if(calibrating_) {
+    const datum* input = input_->data.data_ptr_const();
+    for(std::size_t e = 0; e < input_->data.elements(); e++)
+      calibration_range_ = std::max(calibration_range_, (datum)std::fabs(input[e]));
   }
   
-  // Add bias
-  TensorMath::GEMM (true, false, false, output_maps_,
-        output_width_ * output_height_ * input_->data.samples(), 1, w, bias_->data, 0, 1,
-        ones_, 0, output_width_ * output_height_ * input_->data.samples(),
-        1.0, sms_ff_buffer, 0, output_width_ * output_height_ * input_->data.samples());
-
-  TensorMath::SMS(sms_ff_buffer, output_->data);
-
-  /*for(unsigned int sample = 0; sample < input_->data.samples(); sample++) {
-    // Add bias
-    TensorMath::GEMM (true, false, false, output_maps_,
-          output_width_ * output_height_, 1, w, bias_->data, 0, 1,
-          ones_, 0, output_width_ * output_height_,
-          1.0, output_->data, sample, output_width_ * output_height_);
-
-  }*/
+  quantized_forward_ = quantization_range_ > 0 && net_->IsTesting();
+  if(quantized_forward_) {
+    if(quantized_ == nullptr)
+      quantized_ = new QuantizedConvolution(ConvolutionGeometry(input_width_, input_height_,
+            input_maps_, input_->data.samples(), kernel_width_, kernel_height_,
+            stride_width_, stride_height_, pad_width_, pad_height_), output_maps_, group_);
+    if(!quantized_weights_valid_) {
+      quantized_->SetWeights(weights_->data.data_ptr_const());
+      quantized_weights_valid_ = true;
+    }
+    
+    quantized_->Forward(input_->data.data_ptr_const(), quantization_range_, w, output_->data.data_ptr());
+    TensorMath::BIAS_ACTIVATION(&(bias_->data), w, activation_, output_->data, 0, input_->data.samples());
+    return;
+  }
+  
+  if(engine_ == ENGINE_WINOGRAD) {
+    const unsigned int tiles = output_tiles_x_ * output_tiles_y_ * input_->data.samples();
+    
+    if(!winograd_weights_valid_) {
+      winograd_weights_.hint_ignore_content_ = true;
+      TensorMath::WINOGRAD_FILTER(weights_->data, output_maps_, input_maps_, false, winograd_weights_);
+      winograd_weights_valid_ = true;
+    }
+    
+    winograd_input_buffer_.hint_ignore_content_ = true;
+    winograd_product_buffer_.hint_ignore_content_ = true;
+    TensorMath::WINOGRAD_INPUT(input_->data, input_width_, input_height_, input_maps_, input_->data.samples(),
+          -(int)pad_width_, -(int)pad_height_, output_tiles_x_, output_tiles_y_, winograd_input_buffer_);
+    
+    // One GEMM per element of the transformed tiles
+    for(unsigned int e = 0; e < 36; e++) {
+      TensorMath::GEMM(true, false, false, output_maps_, tiles, input_maps_,
+            1.0, winograd_weights_, e, input_maps_,
+            winograd_input_buffer_, e, tiles,
+            0.0, winograd_product_buffer_, e, tiles);
+    }
+    
+    // Transform back, adding the bias, directly to the sample-major output
+    TensorMath::WINOGRAD_OUTPUT(winograd_product_buffer_, output_tiles_x_, output_tiles_y_,
+          w, &(bias_->data), output_->data, output_width_, output_height_, output_maps_, input_->data.samples());
+    
+    if(activation_ != ACTIVATION_NONE)
+      TensorMath::BIAS_ACTIVATION(nullptr, w, activation_, output_->data, 0, input_->data.samples());
+  } else if(engine_ == ENGINE_FFT) {
+#ifdef BUILD_OPENCL
+    input_->data.MoveToCPU();
+    weights_->data.MoveToCPU();
+    bias_->data.MoveToCPU();
+    output_->data.MoveToCPU(true);
+#endif
+    if(!fft_weights_valid_) {
+      fft_->SetWeights(weights_->data.data_ptr_const());
+      fft_weights_valid_ = true;
+    }
+    
+    fft_->Forward(input_->data.data_ptr_const(), w, bias_->data.data_ptr_const(), output_->data.data_ptr());
+    
+    if(activation_ != ACTIVATION_NONE)
+      TensorMath::BIAS_ACTIVATION(nullptr, w, activation_, output_->data, 0, input_->data.samples());
+  } else if(engine_ == ENGINE_POINTWISE) {
+    const unsigned int samples = input_->data.samples();
+    const unsigned int pixels = output_width_ * output_height_;
+    if(pixels == 1) {
+      // Fully connected: one row per sample, Y = f(X * W^T + b^T)
+      TensorMath::GEMM(true, false, true, samples, output_maps_, input_maps_,
+            w, input_->data, 0, input_maps_,
+            weights_->data, 0, input_maps_,
+            0.0, output_->data, 0, output_maps_);
+      AddBias(w, 0, samples);
+    } else {
+      // Each sample of the input is a maps x pixels matrix already
+      for(unsigned int sample = 0; sample < samples; sample++) {
+        TensorMath::GEMM(true, false, false, output_maps_, pixels, input_maps_,
+              w, weights_->data, 0, input_maps_,
+              input_->data, sample, pixels,
+              0.0, output_->data, sample, pixels);
+        AddBias(w, sample, 1);
+      }
+    }
+  } else if(engine_ == ENGINE_IMPLICIT) {
+    for(unsigned int g = 0; g < group_; g++) {
+      // Convolve, gathering the patches inside the GEMM
+      TensorMath::IM2COL_GEMM(output_maps_ / group_, w, weights_->data,
+            (g * output_maps_) / group_, (kernel_width_ * kernel_height_ * input_maps_) / group_,
+            input_->data, input_width_, input_height_, input_maps_, input_->data.samples(),
+            kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_,
+            (g * input_maps_) / group_, input_maps_ / group_,
+            0.0, output_->data, (g * output_maps_) / group_);
+    }
+    AddBias(w, 0, input_->data.samples());
+  } else if(direct_output_) {
+    const unsigned int samples = input_->data.samples();
+    const unsigned int pixels = output_width_ * output_height_;
+    im2col_ff_buffer.hint_ignore_content_ = true;
+  
+    TensorMath::IM2COL(input_->data, input_width_, input_height_, input_maps_, samples,
+          kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_, im2col_ff_buffer);
+  
+    const unsigned int group_rows = (kernel_width_ * kernel_height_ * input_maps_) / group_;
+    const unsigned int group_maps = output_maps_ / group_;
+  
+    // Convolve each sample straight into the output, one GEMM per group.
+    // Bias and activation are applied while the sample is still cached.
+    for(unsigned int sample = 0; sample < samples; sample++) {
+      TensorMath::GEMM_BATCHED(true, false, false, group_maps, pixels, group_rows,
+            w, weights_->data, 0, group_rows, group_maps * group_rows,
+            im2col_ff_buffer, sample, pixels * samples, group_rows * pixels * samples,
+            0.0, output_->data, sample, pixels, group_maps * pixels, group_);
+      AddBias(w, sample, 1);
+    }
+  } else {
+    const unsigned int samples = input_->data.samples();
+    const unsigned int pixels = output_width_ * output_height_;
+    const unsigned int group_rows = (kernel_width_ * kernel_height_ * input_maps_) / group_;
+    const unsigned int group_maps = output_maps_ / group_;
+    im2col_ff_buffer.hint_ignore_content_ = true;
+    sms_ff_buffer.hint_ignore_content_ = true;
+  
+    TensorMath::IM2COL(input_->data, input_width_, input_height_, input_maps_, samples,
+          kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_, im2col_ff_buffer);
+  
+    // Convolve, one GEMM per group
+    TensorMath::GEMM_BATCHED(true, false, false, group_maps, pixels * samples, group_rows,
+          w, weights_->data, 0, group_rows, group_maps * group_rows,
+          im2col_ff_buffer, 0, pixels * samples, group_rows * pixels * samples,
+          0.0, sms_ff_buffer, 0, pixels * samples, group_maps * pixels * samples, group_);
+
+    // The outputs of this path are small, so the epilogue runs as a
+    // separate pass over the transposed result
+    TensorMath::SMS(sms_ff_buffer, output_->data);
+    AddBias(w, 0, samples);
+  }
 
   // Very simple dropout FF implementation
   // This could be optimized a _lot_
@@ -266,6 +473,9 @@ void ConvolutionLayer::FeedForward() {
 }
 
 void ConvolutionLayer::BackPropagate() {
+  if(quantized_forward_)
+    FATAL("Cannot backpropagate through a quantized forward pass");
+  
   // Very simple dropout backprop implementation
   // This could be optimized a _lot_
   /*unsigned int sk_id = 0;
@@ -280,47 +490,209 @@ void ConvolutionLayer::BackPropagate() {
     sk_id++;
   }*/
 
-  bp_deltax_buffer.hint_ignore_content_ = true;
   sms2_bp_buffer.hint_ignore_content_ = true;
   weights_->delta.hint_ignore_content_ = true;
   bias_->delta.hint_ignore_content_ = true;
-  input_->delta.hint_ignore_content_ = true;
+  // Other layers may read the same input at the same time, see
+  // NetGraph::RunScheduled
+  if(backprop_enabled_)
+    input_->delta.hint_ignore_content_ = true;
+  activation_delta_.hint_ignore_content_ = true;
   
-  TensorMath::SMS(output_->delta, sms2_bp_buffer);
+  /*
+   * 0. Gradient w.r.t. the input of the fused activation. The bias gradient
+   *    is summed up in the same pass, except for the Winograd and FFT
+   *    engines which get it from their transforms.
+   */
+  const Tensor& delta = activation_ == ACTIVATION_NONE ? output_->delta : activation_delta_;
+  if(engine_ == ENGINE_WINOGRAD || engine_ == ENGINE_FFT) {
+    if(activation_ != ACTIVATION_NONE)
+      TensorMath::ACTIVATION_GRADIENT(output_->data, output_->delta, activation_, &activation_delta_, nullptr);
+  } else {
+    BiasGradient();
+  }
   
-  for(unsigned int g = 0; g < group_; g++) {
+  if(engine_ == ENGINE_WINOGRAD) {
+    const unsigned int tiles = output_tiles_x_ * output_tiles_y_ * input_->data.samples();
+    const unsigned int input_tiles = input_tiles_x_ * input_tiles_y_ * input_->data.samples();
+    
     /*
-    * 1. Backpropagation
-    */
-    if (backprop_enabled_)
-      TensorMath::GEMM (true, true, false,
-            (kernel_width_ * kernel_height_ * input_maps_) / group_,
-            output_width_ * output_height_ * input_->data.samples(),
-            output_maps_ / group_,
-            1.0, weights_->data, (g * output_maps_) / group_, (kernel_width_ * kernel_height_ * input_maps_) / group_,
-            sms2_bp_buffer, (g * output_maps_) / group_, output_width_ * output_height_ * input_->data.samples(),
-            0.0, bp_deltax_buffer, (kernel_width_ * kernel_height_ * input_maps_ * g) / group_, output_width_ * output_height_ * input_->data.samples());
+     * 1. Backpropagation: a Winograd convolution of the output gradient
+     *    with the rotated kernels
+     */
+    if (backprop_enabled_) {
+      if(!winograd_flipped_weights_valid_) {
+        winograd_flipped_weights_.hint_ignore_content_ = true;
+        TensorMath::WINOGRAD_FILTER(weights_->data, output_maps_, input_maps_, true, winograd_flipped_weights_);
+        winograd_flipped_weights_valid_ = true;
+      }
+      
+      winograd_bp_input_buffer_.hint_ignore_content_ = true;
+      winograd_bp_product_buffer_.hint_ignore_content_ = true;
+      TensorMath::WINOGRAD_INPUT(delta, output_width_, output_height_, output_maps_, input_->data.samples(),
+            (int)pad_width_ - 2, (int)pad_height_ - 2, input_tiles_x_, input_tiles_y_, winograd_bp_input_buffer_);
+      
+      for(unsigned int e = 0; e < 36; e++) {
+        TensorMath::GEMM(true, false, false, input_maps_, input_tiles, output_maps_,
+              1.0, winograd_flipped_weights_, e, output_maps_,
+              winograd_bp_input_buffer_, e, input_tiles,
+              0.0, winograd_bp_product_buffer_, e, input_tiles);
+      }
+      
+      TensorMath::WINOGRAD_OUTPUT(winograd_bp_product_buffer_, input_tiles_x_, input_tiles_y_,
+            1.0, nullptr, input_->delta, input_width_, input_height_, input_maps_, input_->data.samples());
+    }
+    
+    /*
+     * 2. Weight gradient calculation in the Winograd domain, reusing the
+     *    transformed input of the forward pass
+     */
+    winograd_product_buffer_.hint_ignore_content_ = true;
+    winograd_weights_delta_.hint_ignore_content_ = true;
+    TensorMath::WINOGRAD_DELTA(delta, output_width_, output_height_, output_maps_, input_->data.samples(),
+          output_tiles_x_, output_tiles_y_, winograd_product_buffer_);
+    
+    for(unsigned int e = 0; e < 36; e++) {
+      TensorMath::GEMM(true, false, true, output_maps_, input_maps_, tiles,
+            1.0, winograd_product_buffer_, e, tiles,
+            winograd_input_buffer_, e, tiles,
+            0.0, winograd_weights_delta_, e, input_maps_);
+    }
+    
+    TensorMath::WINOGRAD_FILTER_GRADIENT(winograd_weights_delta_, output_maps_, input_maps_, weights_->delta);
     
     /*
-    * 2. Weight gradient calculation
-    */
-    TensorMath::GEMM (true, false, true, output_maps_ / group_,
-          (kernel_width_ * kernel_height_ * input_maps_) / group_,
-          output_width_ * output_height_ * input_->data.samples(),
-          1.0, sms2_bp_buffer, (g * output_maps_) / group_, output_width_ * output_height_ * input_->data.samples(),
-          im2col_ff_buffer, (kernel_width_ * kernel_height_ * input_maps_ * g) / group_, output_width_ * output_height_ * input_->data.samples(),
-          0.0, weights_->delta, (g * output_maps_) / group_, (kernel_width_ * kernel_height_ * input_maps_) / group_);
+     * 3. Bias gradient calculation. Element (1,1) of a transformed
+     *    gradient tile is the sum over the tile.
+     */
+    TensorMath::GEMV(true, false, output_maps_, tiles, 1.0,
+          winograd_product_buffer_, 7, tiles,
+          ones_, 0, 1, 0.0, bias_->delta, 0, 1);
+    return;
   }
-  /*
-  * 3. Bias gradient calculation
-  */
-  TensorMath::GEMV(true, false, output_maps_, output_width_ * output_height_ * input_->data.samples(), 1.0,
-        sms2_bp_buffer, 0, output_width_ * output_height_ * input_->data.samples(),
-        ones_, 0, 1, 0.0, bias_->delta, 0, 1);
-
   
-  if(backprop_enabled_)
-    TensorMath::COL2IM(input_->delta, input_width_, input_height_, input_maps_, input_->data.samples(),
+  if(engine_ == ENGINE_FFT) {
+#ifdef BUILD_OPENCL
+    ((Tensor&)delta).MoveToCPU();
+    weights_->delta.MoveToCPU(true);
+    bias_->delta.MoveToCPU(true);
+    if(backprop_enabled_)
+      input_->delta.MoveToCPU(true);
+#endif
+    // The input spectra are left over from the forward pass
+    fft_->Backward(delta.data_ptr_const(),
+          backprop_enabled_ ? input_->delta.data_ptr() : nullptr,
+          weights_->delta.data_ptr(), bias_->delta.data_ptr());
+    return;
+  }
+  
+  if(engine_ == ENGINE_POINTWISE) {
+    const unsigned int samples = input_->data.samples();
+    const unsigned int pixels = output_width_ * output_height_;
+    if(pixels == 1) {
+      if (backprop_enabled_)
+        TensorMath::GEMM(true, false, false, samples, input_maps_, output_maps_,
+              1.0, delta, 0, output_maps_,
+              weights_->data, 0, input_maps_,
+              0.0, input_->delta, 0, input_maps_);
+      
+      TensorMath::GEMM(true, true, false, output_maps_, input_maps_, samples,
+            1.0, delta, 0, output_maps_,
+            input_->data, 0, input_maps_,
+            0.0, weights_->delta, 0, input_maps_);
+    } else {
+      // Gradients of all samples are summed up in the weight delta
+      for(unsigned int sample = 0; sample < samples; sample++) {
+        const datum beta = sample == 0 ? 0.0 : 1.0;
+        if (backprop_enabled_)
+          TensorMath::GEMM(true, true, false, input_maps_, pixels, output_maps_,
+                1.0, weights_->data, 0, input_maps_,
+                delta, sample, pixels,
+                0.0, input_->delta, sample, pixels);
+        
+        TensorMath::GEMM(true, false, true, output_maps_, input_maps_, pixels,
+              1.0, delta, sample, pixels,
+              input_->data, sample, pixels,
+              beta, weights_->delta, 0, input_maps_);
+      }
+    }
+    return;
+  }
+  
+  const unsigned int samples = input_->data.samples();
+  const unsigned int pixels = output_width_ * output_height_;
+  
+  if(engine_ == ENGINE_IMPLICIT) {
+    for(unsigned int g = 0; g < group_; g++) {
+      /*
+       * 1. Backpropagation, scattering directly into the input delta
+       */
+      if (backprop_enabled_)
+        TensorMath::GEMM_COL2IM(output_maps_ / group_, 1.0,
+              weights_->data, (g * output_maps_) / group_, (kernel_width_ * kernel_height_ * input_maps_) / group_,
+              delta, (g * output_maps_) / group_,
+              input_->delta, input_width_, input_height_, input_maps_, samples,
+              kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_,
+              (g * input_maps_) / group_, input_maps_ / group_);
+      
+      /*
+       * 2. Weight gradient calculation
+       */
+      TensorMath::IM2COL_GEMM_T(output_maps_ / group_, 1.0,
+            delta, (g * output_maps_) / group_,
+            input_->data, input_width_, input_height_, input_maps_, samples,
+            kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_,
+            (g * input_maps_) / group_, input_maps_ / group_,
+            0.0, weights_->delta, (g * output_maps_) / group_, (kernel_width_ * kernel_height_ * input_maps_) / group_);
+    }
+  } else {
+    const unsigned int group_rows = (kernel_width_ * kernel_height_ * input_maps_) / group_;
+    const unsigned int group_maps = output_maps_ / group_;
+    bp_deltax_buffer.hint_ignore_content_ = true;
+    
+    if(direct_output_) {
+      // Gradients of all samples are summed up in the weight delta
+      for(unsigned int sample = 0; sample < samples; sample++) {
+        /*
+        * 1. Backpropagation
+        */
+        if (backprop_enabled_)
+          TensorMath::GEMM_BATCHED (true, true, false, group_rows, pixels, group_maps,
+                1.0, weights_->data, 0, group_rows, group_maps * group_rows,
+                delta, sample, pixels, group_maps * pixels,
+                0.0, bp_deltax_buffer, sample, pixels * samples, group_rows * pixels * samples, group_);
+      
+        /*
+        * 2. Weight gradient calculation
+        */
+        TensorMath::GEMM_BATCHED (true, false, true, group_maps, group_rows, pixels,
+              1.0, delta, sample, pixels, group_maps * pixels,
+              im2col_ff_buffer, sample, pixels * samples, group_rows * pixels * samples,
+              sample == 0 ? 0.0 : 1.0, weights_->delta, 0, group_rows, group_maps * group_rows, group_);
+      }
+    } else {
+      TensorMath::SMS(delta, sms2_bp_buffer);
+      
+      /*
+      * 1. Backpropagation
+      */
+      if (backprop_enabled_)
+        TensorMath::GEMM_BATCHED (true, true, false, group_rows, pixels * samples, group_maps,
+              1.0, weights_->data, 0, group_rows, group_maps * group_rows,
+              sms2_bp_buffer, 0, pixels * samples, group_maps * pixels * samples,
+              0.0, bp_deltax_buffer, 0, pixels * samples, group_rows * pixels * samples, group_);
+    
+      /*
+      * 2. Weight gradient calculation
+      */
+      TensorMath::GEMM_BATCHED (true, false, true, group_maps, group_rows, pixels * samples,
+            1.0, sms2_bp_buffer, 0, pixels * samples, group_maps * pixels * samples,
+            im2col_ff_buffer, 0, pixels * samples, group_rows * pixels * samples,
+            0.0, weights_->delta, 0, group_rows, group_maps * group_rows, group_);
+    }
+  }
+  if(backprop_enabled_ && engine_ == ENGINE_IM2COL)
+    TensorMath::COL2IM(input_->delta, input_width_, input_height_, input_maps_, samples,
         kernel_width_, kernel_height_, stride_width_, stride_height_, pad_width_, pad_height_, bp_deltax_buffer);
 }
 
@@ -345,6 +717,174 @@ void ConvolutionLayer::OnLayerConnect (const std::vector<Layer*> next_layers) {
 
   LOGDEBUG << "Updating weights: " << this_layer_gain << " -> "
            << next_layer_gain;
+  
+  OnParametersChanged();
+}
+
+ConvolutionLayer::ConvolutionEngine ConvolutionLayer::SelectEngine(const unsigned int samples) {
+  if(requested_engine_ == ENGINE_WINOGRAD && !SupportsWinograd()) {
+    LOGWARN << "Winograd engine needs 3x3 kernels, stride 1 and group 1, using im2col";
+    return ENGINE_IM2COL;
+  }
+  
+  if(requested_engine_ == ENGINE_FFT && !SupportsFFT()) {
+    LOGWARN << "FFT engine needs stride 1 and group 1, using im2col";
+    return ENGINE_IM2COL;
+  }
+  
+  if(requested_engine_ == ENGINE_POINTWISE && !SupportsPointwise()) {
+    LOGWARN << "Pointwise engine needs 1x1 kernels, stride 1, no padding and group 1, using im2col";
+    return ENGINE_IM2COL;
+  }
+  
+  if(requested_engine_ != ENGINE_AUTO)
+    return requested_engine_;
+  
+  // No patches to gather, on every device
+  if(SupportsPointwise())
+    return ENGINE_POINTWISE;
+  
+#ifndef BUILD_OPENCL_CONV
+  // The transforms run on the CPU only. The 36 GEMMs are small, so few
+  // maps or tiles make them slower than a single large one.
+  const unsigned int tiles = samples * ((output_width_ + 3) / 4) * ((output_height_ + 3) / 4);
+  if(SupportsWinograd() && input_maps_ >= 16 && output_maps_ >= 16 && tiles >= 256)
+    return ENGINE_WINOGRAD;
+  
+  // Rough cost of a training step in GEMM multiply-adds. The FFT engine
+  // transforms every input, output and kernel gradient plane once and
+  // multiplies spectra in all three passes. The constants were measured
+  // against im2col, it needs to be clearly faster to be picked.
+  if(SupportsFFT() && kernel_width_ >= 5 && kernel_height_ >= 5) {
+    const double grid = (double)FFTPlan::GoodLength(input_height_ + 2 * pad_height_) *
+      (double)FFTPlan::GoodLength(input_width_ + 2 * pad_width_);
+    const double planes = 2.0 * samples * (input_maps_ + output_maps_) + (double)output_maps_ * input_maps_;
+    const double fft_cost = 10.0 * grid * std::log2(grid) * planes +
+      5.0 * (grid / 2.0) * 3.0 * samples * output_maps_ * input_maps_;
+    const double direct_cost = 3.0 * samples * output_maps_ * input_maps_ * kernel_width_ * kernel_height_ *
+      output_width_ * output_height_;
+    if(fft_cost < 0.8 * direct_cost)
+      return ENGINE_FFT;
+  }
+#endif
+  
+  return ENGINE_IM2COL;
+}
+
+bool ConvolutionLayer::SupportsWinograd() const {
+  return kernel_width_ == 3 && kernel_height_ == 3 && stride_width_ == 1 &&
+    stride_height_ == 1 && group_ == 1;
+}
+
+bool ConvolutionLayer::SupportsFFT() const {
+  return stride_width_ == 1 && stride_height_ == 1 && group_ == 1;
+}
+
+bool ConvolutionLayer::SupportsPointwise() const {
+  return kernel_width_ == 1 && kernel_height_ == 1 && stride_width_ == 1 &&
+    stride_height_ == 1 && pad_width_ == 0 && pad_height_ == 0 && group_ == 1;
+}
+
+bool ConvolutionLayer::ParseEngine(const std::string& name, ConvolutionEngine& engine) {
+  const ConvolutionEngine engines[] = {ENGINE_AUTO, ENGINE_IM2COL, ENGINE_IMPLICIT, ENGINE_WINOGRAD, ENGINE_FFT, ENGINE_POINTWISE};
+  for(const ConvolutionEngine candidate : engines) {
+    if(name.compare(GetEngineName(candidate)) == 0) {
+      engine = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* ConvolutionLayer::GetEngineName(const ConvolutionEngine engine) {
+  switch(engine) {
+    case ENGINE_AUTO:
+      return "auto";
+    case ENGINE_IM2COL:
+      return "im2col";
+    case ENGINE_IMPLICIT:
+      return "implicit";
+    case ENGINE_WINOGRAD:
+      return "winograd";
+    case ENGINE_FFT:
+      return "fft";
+    case ENGINE_POINTWISE:
+      return "pointwise";
+  }
+  return "unknown";
+}
+
+void ConvolutionLayer::AddBias(const datum alpha, const unsigned int first_sample, const unsigned int samples) {
+#ifdef BUILD_OPENCL_CONV
+  // Rank-1 updates against ones_ run on the device. Only the activation
+  // needs the output on the host.
+  const unsigned int pixels = output_width_ * output_height_;
+  if(pixels == 1) {
+    TensorMath::GEMM(true, false, false, samples, output_maps_, 1,
+          alpha, ones_, 0, 1,
+          bias_->data, 0, output_maps_,
+          1.0, output_->data, first_sample, output_maps_);
+  } else {
+    for(unsigned int sample = first_sample; sample < first_sample + samples; sample++)
+      TensorMath::GEMM(true, false, false, output_maps_, pixels, 1,
+            alpha, bias_->data, 0, 1,
+            ones_, 0, pixels,
+            1.0, output_->data, sample, pixels);
+  }
+  if(activation_ != ACTIVATION_NONE)
+    TensorMath::BIAS_ACTIVATION(nullptr, alpha, activation_, output_->data, first_sample, samples);
+#else
+  TensorMath::BIAS_ACTIVATION(&(bias_->data), alpha, activation_, output_->data, first_sample, samples);
+#endif
+}
+
+void ConvolutionLayer::BiasGradient() {
+#ifdef BUILD_OPENCL_CONV
+  const Tensor& delta = activation_ == ACTIVATION_NONE ? output_->delta : activation_delta_;
+  if(activation_ != ACTIVATION_NONE)
+    TensorMath::ACTIVATION_GRADIENT(output_->data, output_->delta, activation_, &activation_delta_, nullptr);
+  
+  const unsigned int samples = input_->data.samples();
+  const unsigned int pixels = output_width_ * output_height_;
+  if(pixels == 1) {
+    TensorMath::GEMV(true, true, samples, output_maps_, 1.0,
+          delta, 0, output_maps_,
+          ones_, 0, 1, 0.0, bias_->delta, 0, 1);
+  } else {
+    for(unsigned int sample = 0; sample < samples; sample++)
+      TensorMath::GEMV(true, false, output_maps_, pixels, 1.0,
+            delta, sample, pixels,
+            ones_, 0, 1, sample == 0 ? 0.0 : 1.0, bias_->delta, 0, 1);
+  }
+#else
+  TensorMath::ACTIVATION_GRADIENT(output_->data, output_->delta, activation_,
+        activation_ == ACTIVATION_NONE ? nullptr : &activation_delta_, &(bias_->delta));
+#endif
+}
+
+bool ConvolutionLayer::ParseActivation(const std::string& name, ActivationFunction& activation) {
+  const ActivationFunction activations[] = {ACTIVATION_NONE, ACTIVATION_RELU, ACTIVATION_TANH, ACTIVATION_SIGMOID};
+  for(const ActivationFunction candidate : activations) {
+    if(name.compare(GetActivationName(candidate)) == 0) {
+      activation = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* ConvolutionLayer::GetActivationName(const ActivationFunction activation) {
+  switch(activation) {
+    case ACTIVATION_NONE:
+      return "none";
+    case ACTIVATION_RELU:
+      return "relu";
+    case ACTIVATION_TANH:
+      return "tanh";
+    case ACTIVATION_SIGMOID:
+      return "sigm";
+  }
+  return "unknown";
 }
 
 bool ConvolutionLayer::IsOpenCLAware() {
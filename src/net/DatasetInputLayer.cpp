@@ -16,12 +16,18 @@
 #include <random>
 #include <algorithm>
 #include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 #include "NetGraph.h"
 #include "DatasetInputLayer.h"
 
 namespace Conv {
 
+// Replicas of a net and loader threads read from the same Dataset
+static std::mutex dataset_mutex;
+
 DatasetInputLayer::DatasetInputLayer (Dataset& dataset,
                                       const unsigned int batch_size,
                                       const datum loss_sampling_p,
@@ -59,6 +65,63 @@ DatasetInputLayer::DatasetInputLayer (Dataset& dataset,
   RedoPermutation();
 }
 
+DatasetInputLayer::~DatasetInputLayer() {
+  StopPrefetching();
+}
+
+void DatasetInputLayer::SetShard (const unsigned int shard, const unsigned int shards) {
+  if (shard >= shards || shards > elements_training_)
+    FATAL ("Cannot select shard " << shard << " of " << shards << " from " << elements_training_ << " samples");
+
+  // Batches that were selected from the old permutation are dropped
+  const unsigned int depth = (unsigned int)slots_.size();
+  const unsigned int loaders = (unsigned int)loaders_.size();
+  StopPrefetching();
+
+  perm_.clear();
+  for (unsigned int i = shard; i < elements_training_; i += shards) {
+    perm_.push_back (i);
+  }
+
+  current_element_ = 0;
+  RedoPermutation();
+  LOGDEBUG << "Using " << perm_.size() << " training samples of shard " << shard;
+
+  SetPrefetching (depth, loaders);
+}
+
+void DatasetInputLayer::SetPrefetching (const unsigned int depth, const unsigned int loaders) {
+  StopPrefetching();
+  if (depth == 0)
+    return;
+  if (loaders == 0)
+    FATAL ("Prefetching needs at least one loader");
+
+  std::vector<PrefetchSlot> slots (depth);
+  slots_.swap (slots);
+  next_slot_ = 0;
+  reserved_slots_ = 0;
+  loader_failed_ = false;
+  shutdown_ = false;
+  for (unsigned int l = 0; l < loaders; l++)
+    loaders_.push_back (std::thread (&DatasetInputLayer::Load, this));
+
+  LOGDEBUG << "Prefetching " << depth << " batches with " << loaders << " loaders";
+}
+
+void DatasetInputLayer::StopPrefetching() {
+  {
+    std::lock_guard<std::mutex> lock (prefetch_mutex_);
+    shutdown_ = true;
+    batch_queue_.clear();
+  }
+  batch_queued_.notify_all();
+  for (std::thread& loader : loaders_)
+    loader.join();
+  loaders_.clear();
+  slots_.clear();
+}
+
 bool DatasetInputLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                                        std::vector< CombinedTensor* >& outputs) {
   if (inputs.size() != 0) {
@@ -69,19 +132,19 @@ bool DatasetInputLayer::CreateOutputs (const std::vector< CombinedTensor* >& inp
   if (dataset_.GetMethod() == FCN) {
     CombinedTensor* data_output =
       new CombinedTensor (batch_size_, dataset_.GetWidth(),
-                          dataset_.GetHeight(), input_maps_);
+                          dataset_.GetHeight(), input_maps_, !inference_only_);
 
     CombinedTensor* label_output =
       new CombinedTensor (batch_size_, dataset_.GetWidth(),
-                          dataset_.GetHeight(), label_maps_);
+                          dataset_.GetHeight(), label_maps_, !inference_only_);
 
     CombinedTensor* helper_output =
       new CombinedTensor (batch_size_, dataset_.GetWidth(),
-                          dataset_.GetHeight(), 2);
+                          dataset_.GetHeight(), 2, !inference_only_);
 
     CombinedTensor* localized_error_output =
       new CombinedTensor (batch_size_, dataset_.GetWidth(),
-                          dataset_.GetHeight(), 1);
+                          dataset_.GetHeight(), 1, !inference_only_);
 
     outputs.push_back (data_output);
     outputs.push_back (label_output);
@@ -90,19 +153,19 @@ bool DatasetInputLayer::CreateOutputs (const std::vector< CombinedTensor* >& inp
   } else if (dataset_.GetMethod() == PATCH) {
     CombinedTensor* data_output =
       new CombinedTensor (batch_size_, dataset_.GetWidth(),
-                          dataset_.GetHeight(), input_maps_);
+                          dataset_.GetHeight(), input_maps_, !inference_only_);
 
     CombinedTensor* label_output =
       new CombinedTensor (batch_size_, 1,
-                          1, label_maps_);
+                          1, label_maps_, !inference_only_);
 
     CombinedTensor* helper_output =
       new CombinedTensor (batch_size_, 1,
-                          1, 2);
+                          1, 2, !inference_only_);
 
     CombinedTensor* localized_error_output =
       new CombinedTensor (batch_size_, 1,
-                          1, 1);
+                          1, 1, !inference_only_);
 
     outputs.push_back (data_output);
     outputs.push_back (label_output);
@@ -146,68 +209,189 @@ void DatasetInputLayer::FeedForward() {
   localized_error_output_->data.MoveToCPU (true);
 #endif
 
-  for (std::size_t sample = 0; sample < batch_size_; sample++) {
-    unsigned int selected_element = 0;
-    bool force_no_weight = false;
+  if (!testing_ && slots_.size() > 0) {
+    FeedPrefetched();
+    return;
+  }
 
+  std::vector<unsigned int> selected_elements (batch_size_, 0);
+  std::vector<std::vector<bool>> dropped_blocks (batch_size_);
+  std::vector<bool> force_no_weight (batch_size_, false);
+  for (std::size_t sample = 0; sample < batch_size_; sample++) {
     if (testing_) {
       // The testing samples are not randomized
       if (current_element_testing_ >= elements_testing_) {
-        force_no_weight = true;
-        selected_element = 0;
+        force_no_weight[sample] = true;
+        selected_elements[sample] = 0;
       } else {
-        selected_element = current_element_testing_++;
+        selected_elements[sample] = current_element_testing_++;
       }
 
     } else {
-      // Select samples until one from the right subset is hit
-      // Select a sample from the permutation
-      selected_element = perm_[current_element_];
-
-      // Select next element
-      current_element_++;
-
-      // If this is is out of bounds, start at the beginning and randomize
-      // again.
-      if (current_element_ >= perm_.size()) {
-        current_element_ = 0;
-        RedoPermutation();
-      }
+      selected_elements[sample] = SelectTrainingSample();
+      DrawLossSampling (dropped_blocks[sample]);
     }
+  }
 
-    // Copy image and label
-    bool success;
+  // Copy images and labels
+  if (!LoadBatch (data_output_->data, label_output_->data, helper_output_->data,
+                  localized_error_output_->data, selected_elements, testing_, dropped_blocks)) {
+    FATAL ("Cannot load samples from Dataset!");
+  }
 
-    if (testing_)
-      success = dataset_.GetTestingSample (data_output_->data, label_output_->data, helper_output_->data, localized_error_output_->data, sample, selected_element);
-    else
-      success = dataset_.GetTrainingSample (data_output_->data, label_output_->data, helper_output_->data, localized_error_output_->data, sample, selected_element);
+  // Copy localized error
+  for (std::size_t sample = 0; sample < batch_size_; sample++) {
+    if (force_no_weight[sample])
+      localized_error_output_->data.Clear (0.0, sample);
+  }
+}
+
+void DatasetInputLayer::FeedPrefetched() {
+  // Keep the loaders busy with the next batches
+  while (reserved_slots_ < slots_.size())
+    ReserveSlot();
 
-    if (!success) {
+  PrefetchSlot& slot = slots_[next_slot_];
+  {
+    std::unique_lock<std::mutex> lock (prefetch_mutex_);
+    batch_loaded_.wait (lock, [this, &slot]() { return slot.loaded || loader_failed_; });
+    if (loader_failed_)
       FATAL ("Cannot load samples from Dataset!");
+  }
+
+  // Layers may hold on to the output memory, so the batch is copied
+  std::memcpy (data_output_->data.data_ptr(), slot.data.data_ptr_const(), slot.data.elements() * sizeof (datum));
+  std::memcpy (label_output_->data.data_ptr(), slot.label.data_ptr_const(), slot.label.elements() * sizeof (datum));
+  std::memcpy (helper_output_->data.data_ptr(), slot.helper.data_ptr_const(), slot.helper.elements() * sizeof (datum));
+  std::memcpy (localized_error_output_->data.data_ptr(), slot.weight.data_ptr_const(), slot.weight.elements() * sizeof (datum));
+
+  next_slot_ = (next_slot_ + 1) % slots_.size();
+  reserved_slots_--;
+  ReserveSlot();
+}
+
+void DatasetInputLayer::ReserveSlot() {
+  PrefetchSlot& slot = slots_[(next_slot_ + reserved_slots_) % slots_.size()];
+  if (slot.data.elements() == 0) {
+    slot.data.Resize (data_output_->data);
+    slot.label.Resize (label_output_->data);
+    slot.helper.Resize (helper_output_->data);
+    slot.weight.Resize (localized_error_output_->data);
+    slot.elements.resize (batch_size_);
+    slot.dropped_blocks.resize (batch_size_);
+  }
+
+  // The samples are selected here and in the same order as without
+  // prefetching, only the loading happens on the loader threads
+  for (unsigned int sample = 0; sample < batch_size_; sample++) {
+    slot.elements[sample] = SelectTrainingSample();
+    DrawLossSampling (slot.dropped_blocks[sample]);
+  }
+
+  const unsigned int slot_index = (next_slot_ + reserved_slots_) % slots_.size();
+  {
+    std::lock_guard<std::mutex> lock (prefetch_mutex_);
+    slot.loaded = false;
+    batch_queue_.push_back (slot_index);
+  }
+  batch_queued_.notify_one();
+  reserved_slots_++;
+}
+
+void DatasetInputLayer::Load() {
+  std::unique_lock<std::mutex> lock (prefetch_mutex_);
+  while (true) {
+    batch_queued_.wait (lock, [this]() { return shutdown_ || !batch_queue_.empty(); });
+    if (shutdown_)
+      return;
+    PrefetchSlot& slot = slots_[batch_queue_.front()];
+    batch_queue_.pop_front();
+    lock.unlock();
+
+    bool success = false;
+    try {
+      success = LoadBatch (slot.data, slot.label, slot.helper, slot.weight,
+                           slot.elements, false, slot.dropped_blocks);
+    } catch (const std::exception& e) {
+      LOGERROR << "Loader failed: " << e.what();
+    } catch (...) {
+      LOGERROR << "Loader failed with an unknown exception";
+    }
+
+    lock.lock();
+    if (!success)
+      loader_failed_ = true;
+    slot.loaded = true;
+    batch_loaded_.notify_all();
+  }
+}
+
+unsigned int DatasetInputLayer::SelectTrainingSample() {
+  // Select a sample from the permutation
+  const unsigned int selected_element = perm_[current_element_];
+
+  // Select next element
+  current_element_++;
+
+  // If this is is out of bounds, start at the beginning and randomize
+  // again.
+  if (current_element_ >= perm_.size()) {
+    current_element_ = 0;
+    RedoPermutation();
+  }
+  return selected_element;
+}
+
+void DatasetInputLayer::DrawLossSampling (std::vector<bool>& dropped_blocks) {
+  dropped_blocks.clear();
+  if (dataset_.GetMethod() != FCN)
+    return;
+
+  const unsigned int block_size = 12;
+  for (unsigned int y = 0; y < localized_error_output_->data.height(); y += block_size) {
+    for (unsigned int x = 0; x < localized_error_output_->data.width(); x += block_size) {
+      dropped_blocks.push_back (dist_ (generator_) > loss_sampling_p_);
     }
+  }
+}
+
+bool DatasetInputLayer::LoadBatch (Tensor& data, Tensor& label, Tensor& helper, Tensor& weight,
+                                   const std::vector<unsigned int>& elements, const bool testing,
+                                   const std::vector<std::vector<bool>>& dropped_blocks) {
+  bool success;
+  std::unique_lock<std::mutex> dataset_lock (dataset_mutex, std::defer_lock);
+  if (!dataset_.SupportsConcurrentReads())
+    dataset_lock.lock();
 
-    if (!testing_ && !force_no_weight && dataset_.GetMethod() == FCN) {
-      // Perform loss sampling
-      const unsigned int block_size = 12;
-
-      for (unsigned int y = 0; y < localized_error_output_->data.height(); y += block_size) {
-        for (unsigned int x = 0; x < localized_error_output_->data.width(); x += block_size) {
-          if (dist_ (generator_) > loss_sampling_p_) {
-            for (unsigned int iy = y; iy < y + block_size && iy < localized_error_output_->data.height(); iy++) {
-              for (unsigned int ix = x; ix < x + block_size && ix < localized_error_output_->data.width(); ix++) {
-                *localized_error_output_->data.data_ptr (ix, iy, 0, sample) = 0;
-              }
+  if (testing)
+    success = dataset_.GetTestingBatch (data, label, helper, weight, elements);
+  else
+    success = dataset_.GetTrainingBatch (data, label, helper, weight, elements);
+
+  if (dataset_lock.owns_lock())
+    dataset_lock.unlock();
+
+  if (!success)
+    return false;
+
+  // Perform loss sampling
+  const unsigned int block_size = 12;
+  for (unsigned int sample = 0; sample < elements.size(); sample++) {
+    std::size_t block = 0;
+
+    for (unsigned int y = 0; y < weight.height() && !dropped_blocks[sample].empty(); y += block_size) {
+      for (unsigned int x = 0; x < weight.width(); x += block_size) {
+        if (dropped_blocks[sample][block++]) {
+          for (unsigned int iy = y; iy < y + block_size && iy < weight.height(); iy++) {
+            for (unsigned int ix = x; ix < x + block_size && ix < weight.width(); ix++) {
+              *weight.data_ptr (ix, iy, 0, sample) = 0;
             }
           }
         }
       }
     }
-
-    // Copy localized error
-    if (force_no_weight)
-      localized_error_output_->data.Clear (0.0, sample);
   }
+  return true;
 }
 
 void DatasetInputLayer::BackPropagate() {
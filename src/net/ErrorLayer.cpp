@@ -88,6 +88,10 @@ bool ErrorLayer::Connect ( const std::vector< CombinedTensor* >& inputs,
 }
 
 void ErrorLayer::FeedForward() {
+  // Inference-only nets have no deltas to write
+  if ( inference_only_ )
+    return;
+
   // We write the deltas at this point, because
   // CalculateLossFunction() is called before BackPropagate().
   // We don't precalculate the loss because it is not calculated for every
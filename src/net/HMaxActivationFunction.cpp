@@ -9,6 +9,7 @@
 
 #include "CombinedTensor.h"
 #include "ConfigParsing.h"
+#include "TensorMath.h"
 
 #include "HMaxActivationFunction.h"
 
@@ -86,7 +87,7 @@ bool HMaxActivationFunction::CreateOutputs (
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
                                                input->data.width(),
                                                input->data.height(),
-                                               input->data.maps());
+                                               input->data.maps(), !inference_only_);
   // Tell network about the output
   outputs.push_back (output);
   
@@ -104,7 +105,7 @@ bool HMaxActivationFunction::Connect (const CombinedTensor* input,
   if(!valid)
     return false;
   
-  weights_ = new CombinedTensor(1, 2, 1, 1);
+  weights_ = new CombinedTensor(1, 2, 1, 1, !inference_only_);
   weights_->data.Clear(1.0);
   weights_->delta.Clear();
   
@@ -125,13 +126,10 @@ void HMaxActivationFunction::FeedForward() {
   total_activations_ = (datum)(input_->data.elements());
   sum_of_activations_ = 0;
   
-  for (std::size_t element = 0; element < input_->data.elements(); element++) {
-    const datum input_data = input_->data.data_ptr_const() [element];
-
-    // Calculate sigmoid function
-    const datum output_data = 1.0 / (1.0 + exp(-(a * input_data + b)));
-    sum_of_activations_ += output_data;
-    output_->data.data_ptr() [element] = output_data;
+  // Calculate sigmoid function
+  TensorMath::ACTIVATION(input_->data, ACTIVATION_SIGMOID, output_->data, a, b);
+  for (std::size_t element = 0; element < output_->data.elements(); element++) {
+    sum_of_activations_ += output_->data.data_ptr_const() [element];
   }
 }
   
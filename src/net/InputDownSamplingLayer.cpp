@@ -48,7 +48,7 @@ bool InputDownSamplingLayer::CreateOutputs (
   // Create output
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
       input->data.width() / region_width_, input->data.height() / region_height_,
-      input->data.maps());
+      input->data.maps(), !inference_only_);
 
   // Tell network about the output
   outputs.push_back (output);
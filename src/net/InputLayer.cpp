@@ -142,13 +142,23 @@ bool InputLayer::CreateOutputs ( const std::vector< CombinedTensor* >& inputs,
     return false;
   }
 
+  // The tensors were created before the net was known
+  if ( inference_only_ ) {
+    data_->delta.DeleteIfPossible();
+    helper_->delta.DeleteIfPossible();
+    if ( label_ != nullptr )
+      label_->delta.DeleteIfPossible();
+    if ( weight_ != nullptr )
+      weight_->delta.DeleteIfPossible();
+  }
+
   // Tell the network about our outputs
   outputs.push_back ( data_ );
 
   if ( label_ != nullptr ) {
     outputs.push_back ( label_ );
   } else {
-    outputs.push_back ( new CombinedTensor ( data_->data.samples() ) );
+    outputs.push_back ( new CombinedTensor ( data_->data.samples(), 1, 1, 1, !inference_only_ ) );
   }
 
   outputs.push_back ( helper_ );
@@ -156,7 +166,7 @@ bool InputLayer::CreateOutputs ( const std::vector< CombinedTensor* >& inputs,
   if ( weight_ != nullptr ) {
     outputs.push_back ( weight_ );
   } else {
-    outputs.push_back (new CombinedTensor (data_->data.samples(), data_->data.width(), data_->data.height(), data_->data.maps()));
+    outputs.push_back (new CombinedTensor (data_->data.samples(), data_->data.width(), data_->data.height(), data_->data.maps(), !inference_only_));
   }
 
   return true;
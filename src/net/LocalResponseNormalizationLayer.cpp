@@ -44,7 +44,7 @@ bool LocalResponseNormalizationLayer::
   
   // Create ouput
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
-    input->data.width(), input->data.height(), input->data.maps());
+    input->data.width(), input->data.height(), input->data.maps(), !inference_only_);
   
   // Tell network about the output
   outputs.push_back(output);
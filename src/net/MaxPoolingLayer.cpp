@@ -61,7 +61,7 @@ bool MaxPoolingLayer::CreateOutputs (
   // Create output
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
       input->data.width() / region_width_, input->data.height() / region_height_,
-      input->data.maps());
+      input->data.maps(), !inference_only_);
 
   // Tell network about the output
   outputs.push_back (output);
@@ -91,11 +91,13 @@ bool MaxPoolingLayer::Connect (const CombinedTensor* input,
   maximum_mask_.Resize (input->data.samples(), input_width_,
 			input_height_, maps_);
 #else
-  // Create maximum Tensor
-  maximum_ix_.Resize (input->data.samples(), output_width_,
-                      output_height_, maps_);
-  maximum_iy_.Resize (input->data.samples(), output_width_,
-                      output_height_, maps_);
+  // Create maximum Tensor, only the backward pass reads it
+  if (!inference_only_) {
+    maximum_ix_.Resize (input->data.samples(), output_width_,
+                        output_height_, maps_);
+    maximum_iy_.Resize (input->data.samples(), output_width_,
+                        output_height_, maps_);
+  }
 #endif
 
   return true;
@@ -164,8 +166,10 @@ void MaxPoolingLayer::FeedForward() {
           }
           
           // Found maximum, save
-          *maximum_ix_.data_ptr(ox, oy, map, sample) = mix;
-          *maximum_iy_.data_ptr(ox, oy, map, sample) = miy;
+          if (!inference_only_) {
+            *maximum_ix_.data_ptr(ox, oy, map, sample) = mix;
+            *maximum_iy_.data_ptr(ox, oy, map, sample) = miy;
+          }
           
           // Feed forward
           *output_->data.data_ptr(ox, oy, map, sample) = maximum;
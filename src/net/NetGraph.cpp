@@ -7,17 +7,24 @@
 
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 
 #include "Log.h"
 #include "LossFunctionLayer.h"
 #include "TrainingLayer.h"
 #include "GradientAccumulationLayer.h"
 #include "StatLayer.h"
+#include "ConvolutionLayer.h"
 
 #include "NetGraph.h"
 #include "NetGraphNode.h"
 
 #include "TensorViewer.h"
+#include "TensorAllocator.h"
 
 namespace Conv {
 
@@ -42,6 +49,7 @@ void NetGraph::AddNode(NetGraphNode* node) {
 
 	// Add node to list
 	nodes_.push_back(node);
+	schedule_built_ = false;
 
 	// Add node to registries
 	if (node->is_input)
@@ -205,13 +213,15 @@ void NetGraph::PrintGraph(std::ostream& graph_output) {
 }
 
 void NetGraph::Initialize() {
-	// check for nodes with multiple backprop connections
+	// check for nodes with multiple backprop connections, their gradients
+	// need to be accumulated unless there is no backward pass
   bool no_multiple_connections = true;
   do {
     no_multiple_connections = true;
 		std::vector<NetGraphNode*> nodes(nodes_);
     for (NetGraphNode* node : nodes) {
-      if(node->backprop_connections.size() > 1 && dynamic_cast<GradientAccumulationLayer*>(node->layer) == NULL) {
+      if(node->backprop_connections.size() > 1 && dynamic_cast<GradientAccumulationLayer*>(node->layer) == NULL
+        && !IsInferenceOnly()) {
         no_multiple_connections = false;
         LOGINFO << "Node has multiple backprop connections: " << node->layer->GetLayerDescription();
         
@@ -248,6 +258,9 @@ void NetGraph::Initialize() {
 		InitializeNode(node);
 	}
 
+	if (memory_planning_enabled_)
+		PlanMemory();
+
 }
 
 void NetGraph::InitializeNode(NetGraphNode* node) {
@@ -261,9 +274,16 @@ void NetGraph::InitializeNode(NetGraphNode* node) {
 			input_tensors.push_back(connection.node->output_buffers[connection.buffer].combined_tensor);
 		}
 
-		// Ask layer to create output buffers
+		// Ask layer to create output buffers, unless it runs in place
+		node->layer->SetInferenceOnly(IsInferenceOnly());
 		std::vector<CombinedTensor*> output_tensors;
-		bool success_outputs = node->layer->CreateOutputs(input_tensors, output_tensors);
+		bool success_outputs = true;
+		if (CanRunInPlace(node)) {
+			LOGDEBUG << "Running in place: " << node->layer->GetLayerDescription();
+			output_tensors.push_back(input_tensors[0]);
+		} else {
+			success_outputs = node->layer->CreateOutputs(input_tensors, output_tensors);
+		}
 
 		// Verify output buffer creation
 		if (!success_outputs) {
@@ -289,17 +309,178 @@ void NetGraph::InitializeNode(NetGraphNode* node) {
 	}
 }
 
+/*
+ * A layer runs in place if it is the only consumer of its input buffer and
+ * the layer before it does not need its output data to backpropagate, or
+ * the net never backpropagates. Input nodes keep their data because it
+ * belongs to the caller, output nodes because their data is read after the
+ * pass.
+ */
+bool NetGraph::CanRunInPlace(NetGraphNode* node) const {
+	if (!inplace_enabled_ || !node->layer->IsInPlaceCapable()
+		|| node->input_connections.size() != 1 || node->output_buffers.size() != 1)
+		return false;
+
+	const NetGraphConnection& input = node->input_connections[0];
+	if (input.node->is_input || input.node->is_output
+		|| (!IsInferenceOnly() && input.node->layer->NeedsOutputForBackprop()))
+		return false;
+
+	unsigned int consumers = 0;
+	for (NetGraphNode* other_node : nodes_)
+		for (const NetGraphConnection& connection : other_node->input_connections)
+			if (connection.node == input.node && connection.buffer == input.buffer)
+				consumers++;
+	return consumers == 1;
+}
+
+/*
+ * Every hidden output buffer is alive from the node that writes it to the
+ * last node that reads it, in the order FeedForward visits the nodes. The
+ * buffers are placed in one arena, largest first, each at the lowest offset
+ * where it does not overlap a buffer that is alive at the same time.
+ * Buffers read outside of the forward pass keep their own memory: those of
+ * input and output nodes, those read by loss layers after the pass and
+ * those shadowed by gradient accumulation layers.
+ */
+void NetGraph::PlanMemory() {
+#ifdef BUILD_OPENCL
+	LOGWARN << "Memory planning is not supported with OpenCL";
+	return;
+#endif
+	if (storage_precision_ != PRECISION_FP32) {
+		LOGWARN << "Memory planning is not supported with packed storage";
+		return;
+	}
+
+	std::vector<NetGraphNode*> order;
+	for (NetGraphNode* node : nodes_)
+		node->flag_ff_visited = false;
+	for (NetGraphNode* node : nodes_)
+		OrderNode(node, order);
+	for (NetGraphNode* node : nodes_)
+		node->flag_ff_visited = false;
+
+	struct PlannedBuffer {
+		CombinedTensor* tensor;
+		unsigned int first;
+		unsigned int last;
+		std::size_t elements;
+		std::size_t offset;
+		bool planned;
+	};
+	std::vector<PlannedBuffer> buffers;
+	auto find_buffer = [&](CombinedTensor* tensor) -> PlannedBuffer& {
+		for (PlannedBuffer& buffer : buffers)
+			if (buffer.tensor == tensor)
+				return buffer;
+		// Offsets are kept aligned like the blocks of the TensorAllocator
+		const std::size_t alignment = CN24_TENSOR_ALIGNMENT / sizeof(datum);
+		const std::size_t elements = (tensor->data.elements() + alignment - 1) / alignment * alignment;
+		buffers.push_back({tensor, 0, 0, elements, 0, elements > 0});
+		return buffers.back();
+	};
+
+	for (unsigned int n = 0; n < order.size(); n++) {
+		NetGraphNode* node = order[n];
+		const bool keeps_inputs = dynamic_cast<LossFunctionLayer*>(node->layer) != nullptr
+			|| dynamic_cast<GradientAccumulationLayer*>(node->layer) != nullptr;
+		for (NetGraphConnection& connection : node->input_connections) {
+			PlannedBuffer& buffer = find_buffer(connection.node->output_buffers[connection.buffer].combined_tensor);
+			buffer.last = std::max(buffer.last, n);
+			buffer.planned &= !keeps_inputs;
+		}
+		for (NetGraphBuffer& output_buffer : node->output_buffers) {
+			// In-place nodes write to a buffer that is alive already
+			bool is_new = std::none_of(buffers.begin(), buffers.end(),
+				[&](const PlannedBuffer& buffer) { return buffer.tensor == output_buffer.combined_tensor; });
+			PlannedBuffer& buffer = find_buffer(output_buffer.combined_tensor);
+			if (is_new)
+				buffer.first = buffer.last = n;
+			buffer.planned &= !node->is_input && !node->is_output
+				&& dynamic_cast<GradientAccumulationLayer*>(node->layer) == nullptr;
+		}
+	}
+
+	std::vector<PlannedBuffer*> placement;
+	std::size_t separate_elements = 0;
+	for (PlannedBuffer& buffer : buffers)
+		if (buffer.planned)
+			placement.push_back(&buffer);
+	std::stable_sort(placement.begin(), placement.end(),
+		[](const PlannedBuffer* a, const PlannedBuffer* b) { return a->elements > b->elements; });
+
+	std::size_t arena_elements = 0;
+	for (unsigned int p = 0; p < placement.size(); p++) {
+		PlannedBuffer* buffer = placement[p];
+		separate_elements += buffer->elements;
+
+		std::vector<PlannedBuffer*> alive;
+		for (unsigned int q = 0; q < p; q++)
+			if (placement[q]->first <= buffer->last && buffer->first <= placement[q]->last)
+				alive.push_back(placement[q]);
+		std::sort(alive.begin(), alive.end(),
+			[](const PlannedBuffer* a, const PlannedBuffer* b) { return a->offset < b->offset; });
+
+		buffer->offset = 0;
+		for (PlannedBuffer* other : alive) {
+			if (buffer->offset + buffer->elements <= other->offset)
+				break;
+			buffer->offset = std::max(buffer->offset, other->offset + other->elements);
+		}
+		arena_elements = std::max(arena_elements, buffer->offset + buffer->elements);
+	}
+
+	if (placement.size() == 0)
+		return;
+
+	memory_arena_.Resize(arena_elements);
+	for (PlannedBuffer* buffer : placement) {
+		Tensor& data = buffer->tensor->data;
+		data.Shadow(memory_arena_, buffer->offset, data.samples(), data.width(), data.height(), data.maps());
+	}
+	memory_planned_ = true;
+
+	// The buffers that were replaced are not coming back
+	TensorAllocator::Trim();
+
+	LOGINFO << "Planned " << placement.size() << " buffers into " <<
+		(arena_elements * sizeof(datum)) / 1048576.0 << " MiB instead of " <<
+		(separate_elements * sizeof(datum)) / 1048576.0 << " MiB";
+}
+
+void NetGraph::OrderNode(NetGraphNode* node, std::vector<NetGraphNode*>& order) {
+	if (!node->flag_ff_visited) {
+		node->flag_ff_visited = true;
+		for (NetGraphConnection& connection : node->input_connections)
+			OrderNode(connection.node, order);
+		order.push_back(node);
+	}
+}
+
 void NetGraph::FeedForward() {
-	FeedForward(nodes_, true);
+	// Recomputable outputs of the last pass are outdated
+	for (RecomputableBuffer& buffer : recomputable_)
+		SetResident(buffer.tensor, false);
+	if (CanSchedule())
+		RunScheduled(false);
+	else
+		FeedForward(nodes_, true);
 }
 
 void NetGraph::FeedForward(std::vector<NetGraphNode*>& nodes, bool clear_flag) {
+	auto t_begin = std::chrono::steady_clock::now();
 	if (clear_flag)
 		for (NetGraphNode* node : nodes)
 			node->flag_ff_visited = false;
 
 	for (NetGraphNode* node : nodes)
 		FeedForward(node);
+
+	if (checkpointing_ != CHECKPOINTING_OFF) {
+		std::chrono::duration<double> pass_duration = std::chrono::steady_clock::now() - t_begin;
+		checkpointing_stats_.pass_seconds += pass_duration.count();
+	}
 }
 
 void NetGraph::FeedForward(NetGraphNode* node) {
@@ -313,8 +494,11 @@ void NetGraph::FeedForward(NetGraphNode* node) {
 #endif
 
 		PrepareNode(node);
+		for (NetGraphBuffer& buffer : node->output_buffers)
+			SetResident(buffer.combined_tensor, true);
 		// Call the Layer::FeedForward method and set the visited flag
 		node->layer->FeedForward();
+		node->flag_ff_visited = true;
     if(layerview_enabled_)
       for(NetGraphBuffer buffer: node->output_buffers) {
         for(unsigned int sample = 0; sample < buffer.combined_tensor->data.samples(); sample++) {
@@ -328,8 +512,14 @@ void NetGraph::FeedForward(NetGraphNode* node) {
           }
         }
       }
-    
-		node->flag_ff_visited = true;
+
+		if (storage_precision_ != PRECISION_FP32)
+			for (NetGraphConnection connection : node->input_connections)
+				PackIfUnused(connection.node->output_buffers[connection.buffer].combined_tensor, false);
+
+		if (checkpointing_ != CHECKPOINTING_OFF)
+			for (NetGraphConnection connection : node->input_connections)
+				DiscardIfUnused(connection.node->output_buffers[connection.buffer].combined_tensor, false);
 
 #ifdef LAYERTIME
     auto t_end = std::chrono::system_clock::now();
@@ -340,16 +530,162 @@ void NetGraph::FeedForward(NetGraphNode* node) {
 }
 
 void NetGraph::BackPropagate() {
-	BackPropagate(nodes_, true);
+	if (CanSchedule() && !IsInferenceOnly())
+		RunScheduled(true);
+	else
+		BackPropagate(nodes_, true);
+}
+
+void NetGraph::SetSchedulerThreads(unsigned int threads) {
+#ifdef BUILD_OPENCL
+	if (threads > 1) {
+		LOGWARN << "The scheduler is not supported with OpenCL";
+		threads = 1;
+	}
+#endif
+	if (threads > 1)
+		worker_pool_.reset(new WorkerPool(threads));
+	else
+		worker_pool_.reset();
+	schedule_warned_ = false;
+}
+
+bool NetGraph::CanSchedule() {
+	if (!worker_pool_)
+		return false;
+
+	// These keep track of tensors across nodes in the serial order
+	const bool serial_only = layerview_enabled_ || memory_planned_
+		|| storage_precision_ != PRECISION_FP32 || checkpointing_ != CHECKPOINTING_OFF;
+	if (serial_only && !schedule_warned_) {
+		LOGWARN << "Running one node at a time, the scheduler does not support memory planning, "
+			"packed storage, checkpointing or the layer view";
+		schedule_warned_ = true;
+	}
+	return !serial_only;
+}
+
+void NetGraph::BuildSchedule() {
+	auto index_of = [this](NetGraphNode* node) -> unsigned int {
+		return (unsigned int)(std::find(nodes_.begin(), nodes_.end(), node) - nodes_.begin());
+	};
+
+	forward_schedule_.assign(nodes_.size(), ScheduledNode());
+	backward_schedule_.assign(nodes_.size(), ScheduledNode());
+	for (unsigned int n = 0; n < nodes_.size(); n++) {
+		// A node can read several buffers of the same node
+		std::vector<unsigned int> sources;
+		for (NetGraphConnection& connection : nodes_[n]->input_connections)
+			sources.push_back(index_of(connection.node));
+		std::sort(sources.begin(), sources.end());
+		sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+		for (unsigned int source : sources) {
+			forward_schedule_[n].dependencies++;
+			forward_schedule_[source].dependents.push_back(n);
+		}
+
+		sources.clear();
+		for (NetGraphBackpropConnection& backprop_connection : nodes_[n]->backprop_connections)
+			sources.push_back(index_of(backprop_connection.node));
+		std::sort(sources.begin(), sources.end());
+		sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+		for (unsigned int source : sources) {
+			backward_schedule_[n].dependencies++;
+			backward_schedule_[source].dependents.push_back(n);
+		}
+	}
+	schedule_built_ = true;
+}
+
+/*
+ * Runs every node on the worker pool as soon as the nodes it depends on
+ * are done: the nodes it reads in the forward pass, the nodes it gets its
+ * gradients from in the backward pass. These are the same dependencies the
+ * depth-first walk follows. Each buffer has one writer at a time, because
+ * in-place nodes are the only reader of their input and gradients from
+ * several nodes go through a gradient accumulation node, so the results
+ * do not depend on the order of independent nodes.
+ */
+void NetGraph::RunScheduled(bool backward) {
+	if (!schedule_built_)
+		BuildSchedule();
+	const std::vector<ScheduledNode>& schedule = backward ? backward_schedule_ : forward_schedule_;
+
+	std::vector<unsigned int> dependencies(schedule.size());
+	std::deque<unsigned int> ready;
+	for (unsigned int n = 0; n < schedule.size(); n++) {
+		(backward ? nodes_[n]->flag_bp_visited : nodes_[n]->flag_ff_visited) = false;
+		dependencies[n] = schedule[n].dependencies;
+		if (dependencies[n] == 0)
+			ready.push_back(n);
+	}
+
+	std::mutex mutex;
+	std::condition_variable node_done;
+	std::size_t done = 0;
+	bool failed = false;
+	worker_pool_->Run([&](unsigned int worker) {
+		UNREFERENCED_PARAMETER(worker);
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			node_done.wait(lock, [&]() { return !ready.empty() || done == schedule.size() || failed; });
+			if (ready.empty() || failed)
+				return;
+			const unsigned int n = ready.front();
+			ready.pop_front();
+			lock.unlock();
+
+			NetGraphNode* node = nodes_[n];
+			try {
+				PrepareNode(node);
+				if (backward) {
+					bool do_backprop = false;
+					for (NetGraphConnection connection : node->input_connections)
+						do_backprop |= connection.backprop;
+					node->layer->SetBackpropagationEnabled(do_backprop);
+					node->layer->BackPropagate();
+					node->flag_bp_visited = true;
+					if (backpropagation_callback_)
+						backpropagation_callback_(node);
+				} else {
+					node->layer->FeedForward();
+					node->flag_ff_visited = true;
+				}
+			} catch (...) {
+				// Wake up the other workers, the pool throws again
+				lock.lock();
+				failed = true;
+				node_done.notify_all();
+				throw;
+			}
+
+			lock.lock();
+			done++;
+			for (unsigned int dependent : schedule[n].dependents)
+				if (--dependencies[dependent] == 0)
+					ready.push_back(dependent);
+			node_done.notify_all();
+		}
+	});
 }
 
 void NetGraph::BackPropagate(std::vector<NetGraphNode*>& nodes, bool clear_flag) {
+	if (IsInferenceOnly())
+		FATAL("Cannot backpropagate, the net is inference-only!");
+	if (memory_planned_)
+		FATAL("Cannot backpropagate, the hidden outputs share memory!");
+	auto t_begin = std::chrono::steady_clock::now();
 	if (clear_flag)
 		for (NetGraphNode* node : nodes)
 			node->flag_bp_visited = false;
 
 	for (NetGraphNode* node : nodes)
 		BackPropagate(node);
+
+	if (checkpointing_ != CHECKPOINTING_OFF) {
+		std::chrono::duration<double> pass_duration = std::chrono::steady_clock::now() - t_begin;
+		checkpointing_stats_.pass_seconds += pass_duration.count();
+	}
 }
 
 void NetGraph::BackPropagate(NetGraphNode* node) {
@@ -362,6 +698,18 @@ void NetGraph::BackPropagate(NetGraphNode* node) {
 		for (NetGraphConnection connection : node->input_connections)
 			do_backprop |= connection.backprop;
 
+		// Discarded outputs are needed again, see SetCheckpointing
+		if (checkpointing_ != CHECKPOINTING_OFF) {
+			auto t_recompute_begin = std::chrono::steady_clock::now();
+			for (NetGraphConnection connection : node->input_connections)
+				Recompute(connection.node->output_buffers[connection.buffer].combined_tensor);
+			if (node->layer->NeedsOutputForBackprop())
+				for (NetGraphBuffer& buffer : node->output_buffers)
+					Recompute(buffer.combined_tensor);
+			std::chrono::duration<double> recompute_duration = std::chrono::steady_clock::now() - t_recompute_begin;
+			checkpointing_stats_.recompute_seconds += recompute_duration.count();
+		}
+
 #ifdef LAYERTIME
     auto t_begin = std::chrono::system_clock::now();
 #endif
@@ -371,6 +719,19 @@ void NetGraph::BackPropagate(NetGraphNode* node) {
 		// Call the Layer::FeedForward method and set the visited flag
 		node->layer->BackPropagate();
 		node->flag_bp_visited = true;
+		if (backpropagation_callback_)
+			backpropagation_callback_(node);
+
+		if (storage_precision_ != PRECISION_FP32)
+			for (NetGraphBuffer& buffer : node->output_buffers)
+				PackIfUnused(buffer.combined_tensor, true);
+
+		if (checkpointing_ != CHECKPOINTING_OFF) {
+			for (NetGraphConnection connection : node->input_connections)
+				DiscardIfUnused(connection.node->output_buffers[connection.buffer].combined_tensor, true);
+			for (NetGraphBuffer& buffer : node->output_buffers)
+				DiscardIfUnused(buffer.combined_tensor, true);
+		}
 
 #ifdef LAYERTIME
     auto t_end = std::chrono::system_clock::now();
@@ -417,6 +778,7 @@ void NetGraph::DeserializeParameters(std::istream& input, unsigned int last_laye
       }
       input.peek();
     }
+    layer->OnParametersChanged();
   }
 }
 
@@ -444,7 +806,243 @@ void NetGraph::InitializeWeights(NetGraphNode* node) {
 	}
 }
 
+void NetGraph::SetStoragePrecision(TensorPrecision precision) {
+	if (memory_planned_ && precision != PRECISION_FP32)
+		FATAL("Cannot pack outputs that share memory!");
+	if (checkpointing_ != CHECKPOINTING_OFF && precision != PRECISION_FP32)
+		FATAL("Cannot pack outputs while checkpointing!");
+	storage_precision_ = precision;
+	if (precision == PRECISION_FP32)
+		for (NetGraphNode* node : nodes_)
+			for (NetGraphBuffer& buffer : node->output_buffers)
+				buffer.combined_tensor->data.Unpack();
+}
+
+/*
+ * An output can be recomputed if every node writing it is recomputable and
+ * none of them is an input, output, checkpoint or gradient accumulation
+ * node, and no loss or gradient accumulation layer reads it. In automatic
+ * mode, every n-th of these outputs in the order of the forward pass is
+ * kept anyway, which splits the net into segments of about n nodes
+ * (Chen et al., "Training Deep Nets with Sublinear Memory Cost").
+ */
+void NetGraph::SetCheckpointing(CheckpointingMode mode) {
+	recomputable_.clear();
+	bytes_resident_ = 0;
+	checkpointing_stats_ = CheckpointingStats();
+	checkpointing_ = mode;
+	if (mode == CHECKPOINTING_OFF)
+		return;
+
+#ifdef BUILD_OPENCL
+	LOGWARN << "Checkpointing is not supported with OpenCL";
+	checkpointing_ = CHECKPOINTING_OFF;
+	return;
+#endif
+	if (IsInferenceOnly() || memory_planned_)
+		FATAL("Cannot checkpoint a net that does not backpropagate!");
+	if (storage_precision_ != PRECISION_FP32)
+		FATAL("Cannot checkpoint a net with packed outputs!");
+	for (NetGraphNode* node : nodes_)
+		if (!node->initialized)
+			FATAL("Checkpointing has to be set up after Initialize!");
+
+	std::vector<NetGraphNode*> order;
+	for (NetGraphNode* node : nodes_)
+		node->flag_ff_visited = false;
+	for (NetGraphNode* node : nodes_)
+		OrderNode(node, order);
+	for (NetGraphNode* node : nodes_)
+		node->flag_ff_visited = false;
+
+	std::vector<RecomputableBuffer> buffers;
+	std::vector<CombinedTensor*> kept;
+	bool any_checkpoint = false;
+	for (NetGraphNode* node : order) {
+		any_checkpoint |= node->is_checkpoint;
+		const bool is_ga = dynamic_cast<GradientAccumulationLayer*>(node->layer) != nullptr;
+		const bool keeps_inputs = is_ga || dynamic_cast<LossFunctionLayer*>(node->layer) != nullptr;
+		if (keeps_inputs)
+			for (NetGraphConnection& connection : node->input_connections)
+				kept.push_back(connection.node->output_buffers[connection.buffer].combined_tensor);
+
+		const bool keeps_outputs = is_ga || node->is_input || node->is_output || node->is_checkpoint
+			|| !node->layer->IsRecomputable();
+		for (NetGraphBuffer& output_buffer : node->output_buffers) {
+			CombinedTensor* tensor = output_buffer.combined_tensor;
+			if (keeps_outputs || tensor->data.elements() == 0)
+				kept.push_back(tensor);
+			auto buffer = std::find_if(buffers.begin(), buffers.end(),
+				[&](const RecomputableBuffer& other) { return other.tensor == tensor; });
+			if (buffer == buffers.end()) {
+				buffers.push_back({tensor, {}, true});
+				buffer = buffers.end() - 1;
+			}
+			buffer->writers.push_back(node);
+		}
+	}
+
+	for (RecomputableBuffer& buffer : buffers)
+		if (std::find(kept.begin(), kept.end(), buffer.tensor) == kept.end())
+			recomputable_.push_back(buffer);
+
+	if (mode == CHECKPOINTING_AUTO) {
+		const std::size_t segment = (std::size_t)std::ceil(std::sqrt((double)recomputable_.size()));
+		std::vector<RecomputableBuffer> segmented;
+		for (std::size_t b = 0; b < recomputable_.size(); b++)
+			if ((b + 1) % segment != 0)
+				segmented.push_back(recomputable_[b]);
+		recomputable_.swap(segmented);
+	} else if (!any_checkpoint) {
+		LOGWARN << "No node is marked as a checkpoint, everything is recomputed from the inputs";
+	}
+
+	for (RecomputableBuffer& buffer : recomputable_)
+		bytes_resident_ += buffer.tensor->data.elements() * sizeof(datum);
+	checkpointing_stats_.bytes_recomputable = bytes_resident_;
+
+	LOGINFO << "Checkpointing discards " << recomputable_.size() << " of " << buffers.size() <<
+		" outputs, " << bytes_resident_ / 1048576.0 << " MiB";
+}
+
+void NetGraph::ResetCheckpointingStats() {
+	const std::size_t bytes_recomputable = checkpointing_stats_.bytes_recomputable;
+	checkpointing_stats_ = CheckpointingStats();
+	checkpointing_stats_.bytes_recomputable = bytes_recomputable;
+}
+
+void NetGraph::SetCalibrationEnabled(bool enabled) {
+	for (NetGraphNode* node : nodes_) {
+		ConvolutionLayer* layer = dynamic_cast<ConvolutionLayer*>(node->layer);
+		if (layer != nullptr)
+			layer->SetCalibrationEnabled(enabled);
+	}
+}
+
+void NetGraph::SetQuantizationEnabled(bool enabled) {
+	for (NetGraphNode* node : nodes_) {
+		ConvolutionLayer* layer = dynamic_cast<ConvolutionLayer*>(node->layer);
+		if (layer != nullptr)
+			layer->SetQuantization(enabled ? layer->GetCalibrationRange() : 0);
+	}
+}
+
+void NetGraph::SerializeCalibration(std::ostream& output) {
+	for (NetGraphNode* node : nodes_) {
+		ConvolutionLayer* layer = dynamic_cast<ConvolutionLayer*>(node->layer);
+		if (layer != nullptr)
+			output << node->unique_name << " " << layer->GetCalibrationRange() << "\n";
+	}
+}
+
+bool NetGraph::DeserializeCalibration(std::istream& input) {
+	std::string name;
+	datum range;
+	unsigned int layers = 0;
+	while (input >> name >> range) {
+		ConvolutionLayer* layer = nullptr;
+		for (NetGraphNode* node : nodes_)
+			if (node->unique_name == name)
+				layer = dynamic_cast<ConvolutionLayer*>(node->layer);
+		if (layer == nullptr) {
+			LOGERROR << "Calibration for unknown convolutional layer " << name;
+			return false;
+		}
+		layer->SetQuantization(range);
+		layers++;
+	}
+	LOGINFO << "Quantized " << layers << " convolutional layers";
+	return input.eof();
+}
+
+void NetGraph::PackIfUnused(CombinedTensor* tensor, bool after_backprop) {
+	for (NetGraphNode* node : nodes_) {
+		// Inputs, outputs and loss are read outside of the graph. After the
+		// forward pass, all readers have to be done, after the backward pass
+		// all writers. In-place nodes share the tensor with their input.
+		for (NetGraphBuffer& buffer : node->output_buffers)
+			if (buffer.combined_tensor == tensor && (node->is_input || node->is_output
+				|| (after_backprop && !node->flag_bp_visited)))
+				return;
+		if (!after_backprop && !node->flag_ff_visited)
+			for (NetGraphConnection connection : node->input_connections)
+				if (connection.node->output_buffers[connection.buffer].combined_tensor == tensor)
+					return;
+	}
+	tensor->data.Pack(storage_precision_);
+}
+
+void NetGraph::DiscardIfUnused(CombinedTensor* tensor, bool after_backprop) {
+	RecomputableBuffer* buffer = FindRecomputable(tensor);
+	if (buffer == nullptr || !buffer->resident)
+		return;
+
+	// Every node that reads or writes the tensor has to be done with it
+	for (NetGraphNode* node : nodes_) {
+		if (after_backprop ? node->flag_bp_visited : node->flag_ff_visited)
+			continue;
+		for (NetGraphBuffer& output_buffer : node->output_buffers)
+			if (output_buffer.combined_tensor == tensor)
+				return;
+		for (NetGraphConnection connection : node->input_connections)
+			if (connection.node->output_buffers[connection.buffer].combined_tensor == tensor)
+				return;
+	}
+	SetResident(tensor, false);
+}
+
+void NetGraph::Recompute(CombinedTensor* tensor) {
+	RecomputableBuffer* buffer = FindRecomputable(tensor);
+	if (buffer == nullptr || buffer->resident)
+		return;
+
+	// In-place writers read the tensor they write, it is resident from here
+	SetResident(tensor, true);
+	for (NetGraphNode* node : buffer->writers) {
+		for (NetGraphConnection connection : node->input_connections)
+			Recompute(connection.node->output_buffers[connection.buffer].combined_tensor);
+		PrepareNode(node);
+		for (NetGraphBuffer& output_buffer : node->output_buffers)
+			SetResident(output_buffer.combined_tensor, true);
+		node->layer->FeedForward();
+		checkpointing_stats_.recomputed_nodes++;
+	}
+}
+
+/*
+ * Discards the data of a recomputable tensor or marks it as written again
+ * and keeps track of the bytes held at the same time.
+ */
+void NetGraph::SetResident(CombinedTensor* tensor, bool resident) {
+	RecomputableBuffer* buffer = FindRecomputable(tensor);
+	if (buffer == nullptr || buffer->resident == resident)
+		return;
+
+	buffer->resident = resident;
+	const std::size_t bytes = tensor->data.elements() * sizeof(datum);
+	if (resident) {
+		bytes_resident_ += bytes;
+		checkpointing_stats_.bytes_peak = std::max(checkpointing_stats_.bytes_peak, bytes_resident_);
+	} else {
+		tensor->data.Discard();
+		bytes_resident_ -= bytes;
+	}
+}
+
+NetGraph::RecomputableBuffer* NetGraph::FindRecomputable(CombinedTensor* tensor) {
+	for (RecomputableBuffer& buffer : recomputable_)
+		if (buffer.tensor == tensor)
+			return &buffer;
+	return nullptr;
+}
+
 void NetGraph::PrepareNode(NetGraphNode* node) {
+	// Packed data is needed again, see SetStoragePrecision
+	for (NetGraphConnection connection : node->input_connections)
+		connection.node->output_buffers[connection.buffer].combined_tensor->data.Unpack();
+	for (NetGraphBuffer& buffer : node->output_buffers)
+		buffer.combined_tensor->data.Unpack();
+
 #ifdef BUILD_OPENCL
 	if (!node->layer->IsOpenCLAware()) {
 		for (NetGraphConnection connection : node->input_connections) {
@@ -35,7 +35,7 @@ bool NonLinearityLayer::CreateOutputs (
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
       input->data.width(),
       input->data.height(),
-      input->data.maps());
+      input->data.maps(), !inference_only_);
   // Tell network about the output
   outputs.push_back (output);
 
@@ -55,7 +55,7 @@ bool ResizeLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
   CombinedTensor* output = new CombinedTensor (input->data.samples(),
 					       input->data.width() + borderx_,
 					       input->data.height() + bordery_,
-					       input->data.maps() );
+					       input->data.maps(), !inference_only_ );
   // Tell network about the output
   outputs.push_back (output);
 
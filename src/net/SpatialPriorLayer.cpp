@@ -32,7 +32,7 @@ bool SpatialPriorLayer::CreateOutputs ( const std::vector< CombinedTensor* >& in
   CombinedTensor* output = new CombinedTensor ( input->data.samples(),
       input->data.width(),
       input->data.height(),
-      input->data.maps() + 2 );
+      input->data.maps() + 2, !inference_only_ );
   // Tell network about the output
   outputs.push_back ( output );
 
@@ -52,7 +52,7 @@ bool SumLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
   
   unsigned int samples = input_a->data.samples();
   CombinedTensor* output = new CombinedTensor(samples, input_a->data.width(),
-    input_b->data.height(), maps_a);
+    input_b->data.height(), maps_a, !inference_only_);
   
   outputs.push_back(output);
   return true;
@@ -4,6 +4,7 @@
  *
  * For licensing information, see the LICENSE file included with this project.
  */
+#include <algorithm>
 #include <sstream>
 #include <cmath>
 #include <chrono>
@@ -15,6 +16,8 @@
 #include "LossFunctionLayer.h"
 #include "CLHelper.h"
 #include "StatAggregator.h"
+#include "TensorAllocator.h"
+#include "CompressedTensorStream.h"
 #include "Init.h"
 
 #include "Trainer.h"
@@ -30,6 +33,11 @@ StatDescriptor* Trainer::stat_qp_caseC_ = nullptr;
 StatDescriptor* Trainer::stat_qp_caseM_ = nullptr;
 StatDescriptor* Trainer::stat_sps_ = nullptr;
 StatDescriptor* Trainer::stat_fps_ = nullptr;
+StatDescriptor* Trainer::stat_allocations_ = nullptr;
+StatDescriptor* Trainer::stat_memory_peak_ = nullptr;
+StatDescriptor* Trainer::stat_checkpoint_saved_ = nullptr;
+StatDescriptor* Trainer::stat_recompute_overhead_ = nullptr;
+StatDescriptor* Trainer::stat_decompression_ = nullptr;
 
 template <typename T> int sgn(T val) {
   return (T(0) < val) - (val < T(0));
@@ -168,6 +176,57 @@ void Trainer::InitializeStats() {
         return return_stat;
       };
     
+    stat_allocations_ = new StatDescriptor;
+    stat_allocations_->nullable = true;
+    stat_allocations_->description = "Tensor Allocations";
+    stat_allocations_->unit = "1/s";
+    stat_allocations_->init_function =
+      [](Stat& stat) {stat.is_null = true; stat.value = 0.0;};
+    stat_allocations_->update_function =
+      [](Stat& stat, double user_value) {stat.value += user_value; stat.is_null = false;};
+    stat_allocations_->output_function =
+      [] (Conv::HardcodedStats& hc_stats, Conv::Stat& stat) {
+        Conv::Stat return_stat = stat;
+        return_stat.value = stat.value / hc_stats.seconds_elapsed;
+        return return_stat;
+      };
+    
+    stat_memory_peak_ = new StatDescriptor;
+    stat_memory_peak_->nullable = true;
+    stat_memory_peak_->description = "Tensor Memory Peak";
+    stat_memory_peak_->unit = "MiB";
+    stat_memory_peak_->init_function =
+      [](Stat& stat) {stat.is_null = true; stat.value = 0.0;};
+    stat_memory_peak_->update_function =
+      [](Stat& stat, double user_value) {stat.value = std::max(stat.value, user_value); stat.is_null = false;};
+    
+    stat_checkpoint_saved_ = new StatDescriptor;
+    stat_checkpoint_saved_->nullable = true;
+    stat_checkpoint_saved_->description = "Checkpointing Memory Saved";
+    stat_checkpoint_saved_->unit = "MiB";
+    stat_checkpoint_saved_->init_function =
+      [](Stat& stat) {stat.is_null = true; stat.value = 0.0;};
+    stat_checkpoint_saved_->update_function =
+      [](Stat& stat, double user_value) {stat.value = user_value; stat.is_null = false;};
+    
+    stat_recompute_overhead_ = new StatDescriptor;
+    stat_recompute_overhead_->nullable = true;
+    stat_recompute_overhead_->description = "Recompute Overhead";
+    stat_recompute_overhead_->unit = "%";
+    stat_recompute_overhead_->init_function =
+      [](Stat& stat) {stat.is_null = true; stat.value = 0.0;};
+    stat_recompute_overhead_->update_function =
+      [](Stat& stat, double user_value) {stat.value = user_value; stat.is_null = false;};
+    
+    stat_decompression_ = new StatDescriptor;
+    stat_decompression_->nullable = true;
+    stat_decompression_->description = "Decompression Throughput";
+    stat_decompression_->unit = "MiB/s";
+    stat_decompression_->init_function =
+      [](Stat& stat) {stat.is_null = true; stat.value = 0.0;};
+    stat_decompression_->update_function =
+      [](Stat& stat, double user_value) {stat.value = user_value; stat.is_null = false;};
+    
     // Register stats
     System::stat_aggregator->RegisterStat(stat_aggloss_);
     System::stat_aggregator->RegisterStat(stat_qp_caseA_);
@@ -176,6 +235,11 @@ void Trainer::InitializeStats() {
     System::stat_aggregator->RegisterStat(stat_qp_caseM_);
     System::stat_aggregator->RegisterStat(stat_sps_);
     System::stat_aggregator->RegisterStat(stat_fps_);
+    System::stat_aggregator->RegisterStat(stat_allocations_);
+    System::stat_aggregator->RegisterStat(stat_memory_peak_);
+    System::stat_aggregator->RegisterStat(stat_checkpoint_saved_);
+    System::stat_aggregator->RegisterStat(stat_recompute_overhead_);
+    System::stat_aggregator->RegisterStat(stat_decompression_);
     stats_are_initialized_ = true;
   }
   
@@ -192,6 +256,10 @@ Trainer::Trainer(Conv::NetGraph& graph, TrainerSettings settings) :
     FATAL("Net doesn't have training layer or loss function layer!");
   }
 
+  // Independent nodes can run at the same time
+  if (settings_.scheduler_threads > 1)
+    graph_.SetSchedulerThreads(settings_.scheduler_threads);
+
   // Ask the Net for parameters
   graph_.GetParameters(parameters_);
 
@@ -202,6 +270,10 @@ Trainer::Trainer(Conv::NetGraph& graph, TrainerSettings settings) :
   for (unsigned int p = 0; p < parameters_.size(); p++) {
     w += parameters_[p]->data.elements();
 
+    // Inference-only nets are only tested
+    if (graph_.IsInferenceOnly())
+      continue;
+
     // Allocate Tensors for momentum
     Tensor* last_delta = new Tensor();
     Tensor* last_gradient = new Tensor();
@@ -229,12 +301,183 @@ Trainer::Trainer(Conv::NetGraph& graph, TrainerSettings settings) :
   InitializeStats();
 }
 
+void Trainer::AddReplica (NetGraph& replica) {
+#ifdef BUILD_OPENCL
+  LOGWARN << "Replicas are not supported with OpenCL, training one net";
+  UNREFERENCED_PARAMETER(replica);
+  return;
+#else
+  if (graph_.IsInferenceOnly() || replica.IsInferenceOnly())
+    FATAL("Inference-only nets cannot be trained!");
+
+  if (replica.GetTrainingNodes().size() == 0 || replica.GetLossNodes().size() != graph_.GetLossNodes().size())
+    FATAL("Replica doesn't have training layer or the same loss function layers!");
+
+  TrainingLayer* training_layer = dynamic_cast<TrainingLayer*>(replica.GetTrainingNodes()[0]->layer);
+  if (training_layer->GetBatchSize() != first_training_layer_->GetBatchSize())
+    FATAL("Replica has a different batch size: " << training_layer->GetBatchSize());
+
+  // Every parameter set needs the same shape, the data is shared later
+  std::vector<CombinedTensor*> parameters;
+  replica.GetParameters (parameters);
+  if (parameters.size() != parameters_.size())
+    FATAL("Replica has " << parameters.size() << " sets of parameters instead of " << parameters_.size());
+
+  std::vector<Tensor*> gradients;
+  for (unsigned int p = 0; p < parameters.size(); p++) {
+    const Tensor& data = parameters[p]->data;
+    const Tensor& master_data = parameters_[p]->data;
+    if (data.samples() != master_data.samples() || data.width() != master_data.width() ||
+        data.height() != master_data.height() || data.maps() != master_data.maps())
+      FATAL("Replica parameter set " << p << " is " << data << " instead of " << master_data);
+
+    Tensor* accumulated_gradient = new Tensor();
+    accumulated_gradient->Resize (master_data);
+    accumulated_gradient->Clear();
+    gradients.push_back (accumulated_gradient);
+  }
+
+  if (settings_.scheduler_threads > 1)
+    replica.SetSchedulerThreads(settings_.scheduler_threads);
+
+  replicas_.push_back (&replica);
+  replica_gradients_.push_back (gradients);
+  replica_pool_.reset (new WorkerPool (replicas_.size() + 1));
+  ShareParameters();
+
+  LOGDEBUG << "Training " << replicas_.size() + 1 << " nets";
+  if (replicas_.size() + 1 > settings_.sbatchsize) {
+    LOGWARN << "Only " << settings_.sbatchsize << " of " << replicas_.size() + 1
+      << " nets are used, increase sbatchsize";
+  }
+#endif
+}
+
+void Trainer::ShareParameters() {
+  for (NetGraph* replica : replicas_) {
+    std::vector<CombinedTensor*> parameters;
+    replica->GetParameters (parameters);
+    for (unsigned int p = 0; p < parameters.size(); p++)
+      parameters[p]->data.Shadow (parameters_[p]->data);
+
+    for (NetGraphNode* node : replica->GetNodes())
+      if (node->layer->parameters().size() > 0)
+        node->layer->OnParametersChanged();
+  }
+}
+
+void Trainer::SetTransport (Transport& transport) {
+  if (graph_.IsInferenceOnly())
+    FATAL("Inference-only nets cannot be trained!");
+
+  all_reduce_.reset (new RingAllReduce (transport));
+
+  // Find the gradients of each node for OnBackPropagated
+  unsigned int np = 0;
+  for (NetGraphNode* node : graph_.GetNodes()) {
+    first_parameter_[node] = np;
+    np += node->layer->parameters().size();
+  }
+  gradient_ready_.assign (np, false);
+  gradients_queued_ = 0;
+  graph_.SetBackPropagationCallback ([this] (NetGraphNode* node) { OnBackPropagated (node); });
+
+  LOGDEBUG << "Training as rank " << transport.rank() << " of " << transport.size();
+  if (transport.size() * (replicas_.size() + 1) > settings_.sbatchsize) {
+    LOGWARN << "Only " << settings_.sbatchsize << " of " << transport.size() * (replicas_.size() + 1)
+      << " nets are used, increase sbatchsize";
+  }
+}
+
+/*
+ * The other ranks clear their parameters, so the sum is the parameters of
+ * rank 0 on every rank.
+ */
+void Trainer::SynchronizeParameters() {
+  if (!all_reduce_)
+    return;
+  for (CombinedTensor* parameter : parameters_) {
+    if (all_reduce_->transport().rank() != 0)
+      parameter->data.Clear();
+    all_reduce_->Sum (parameter->data.data_ptr(), parameter->data.elements());
+  }
+  for (NetGraphNode* node : graph_.GetNodes())
+    if (node->layer->parameters().size() > 0)
+      node->layer->OnParametersChanged();
+}
+
+void Trainer::OnBackPropagated (NetGraphNode* node) {
+  if (!last_pass_)
+    return;
+
+  // This pass is the last one, the gradients are complete after adding them
+  Layer* const layer = node->layer;
+  if (layer->parameters().size() == 0)
+    return;
+  const unsigned int first = first_parameter_.find (node)->second;
+  for (unsigned int p = 0; p < layer->parameters().size(); p++) {
+    Tensor& gradients = layer->parameters() [p]->delta;
+#ifdef BUILD_OPENCL
+    gradients.MoveToCPU();
+#endif
+    Tensor& accumulated_gradients = *accumulated_gradients_[first + p];
+    for (unsigned int e = 0; e < gradients.elements(); e++)
+      accumulated_gradients[e] += gradients[e];
+  }
+
+  std::lock_guard<std::mutex> lock (gradient_mutex_);
+  for (unsigned int p = 0; p < layer->parameters().size(); p++)
+    gradient_ready_[first + p] = true;
+  EnqueueReadyGradients();
+}
+
+/*
+ * All ranks have to queue the gradients in the same order. The last
+ * gradients are usually complete first, so they are queued from the back.
+ */
+void Trainer::EnqueueReadyGradients() {
+  while (gradients_queued_ < gradient_ready_.size()) {
+    const unsigned int np = gradient_ready_.size() - 1 - gradients_queued_;
+    if (!gradient_ready_[np])
+      break;
+    all_reduce_->Enqueue (accumulated_gradients_[np]->data_ptr(), accumulated_gradients_[np]->elements());
+    gradients_queued_++;
+  }
+}
+
+void Trainer::SumGradients() {
+  if (!all_reduce_)
+    return;
+
+  // Gradients that were not queued during the backward pass
+  {
+    std::lock_guard<std::mutex> lock (gradient_mutex_);
+    gradient_ready_.assign (gradient_ready_.size(), true);
+    EnqueueReadyGradients();
+  }
+  all_reduce_->Wait();
+
+  gradient_ready_.assign (gradient_ready_.size(), false);
+  gradients_queued_ = 0;
+}
+
 void Trainer::Train (unsigned int epochs, bool do_snapshots) {
   // Update hardcoded stats
   System::stat_aggregator->hardcoded_stats_.weights = weight_count_;
 
   graph_.SetIsTesting(false);
   graph_.SetStatLayersEnabled(settings_.stats_during_training);
+  graph_.SetStoragePrecision(settings_.storage_precision);
+  graph_.SetCheckpointing(settings_.checkpointing);
+
+  // The parameters of the net may have been loaded or reset in between
+  SynchronizeParameters();
+  ShareParameters();
+  for (NetGraph* replica : replicas_) {
+    replica->SetIsTesting(false);
+    replica->SetStoragePrecision(settings_.storage_precision);
+    replica->SetCheckpointing(settings_.checkpointing);
+  }
   
   for (unsigned int e = 0; e < epochs; e++) {
     Epoch();
@@ -246,11 +489,19 @@ void Trainer::Train (unsigned int epochs, bool do_snapshots) {
   }
 
   graph_.SetStatLayersEnabled(true);
+  graph_.SetCheckpointing(CHECKPOINTING_OFF);
+  graph_.SetStoragePrecision(PRECISION_FP32);
+  for (NetGraph* replica : replicas_) {
+    replica->SetCheckpointing(CHECKPOINTING_OFF);
+    replica->SetStoragePrecision(PRECISION_FP32);
+  }
 }
 
 void Trainer::Test() {
   // Update hardcoded stats
   System::stat_aggregator->hardcoded_stats_.weights = weight_count_;
+  TensorAllocator::ResetStats();
+  CompressedTensorStream::ResetStats();
 
 	datum aggregate_loss = 0.0;
 	datum* loss_sums = new datum[graph_.GetLossNodes().size()];
@@ -267,6 +518,11 @@ void Trainer::Test() {
 
   graph_.SetIsTesting(true);
 
+  // The parameters may be shared with a net that was trained since
+  for (NetGraphNode* node : graph_.GetNodes())
+    if (node->layer->parameters().size() > 0)
+      node->layer->OnParametersChanged();
+
   LOGDEBUG << "Testing, iterations: " << iterations <<
            ", batch size: " << first_training_layer_->GetBatchSize();
 
@@ -292,6 +548,8 @@ void Trainer::Test() {
   // Submit performance statistics
   System::stat_aggregator->Update(stat_sps_->stat_id, (double)sample_count_ * (double)iterations);
   System::stat_aggregator->Update(stat_fps_->stat_id, (double)(first_training_layer_->GetBatchSize()) * (double)iterations);
+  UpdateAllocatorStats();
+  UpdateDecompressionStats();
 
 	for (unsigned int n = 0; n < graph_.GetLossNodes().size(); n++) {
 		LOGINFO << "Testing (Epoch " << epoch_ << ", node " << n << ") " << graph_.GetLossNodes()[n]->layer->GetLayerDescription() <<  " lps: " << loss_sums[n] / (datum)(iterations * sample_count_);
@@ -311,9 +569,33 @@ void Trainer::Test() {
 	delete[] loss_sums;
 }
 
+void Trainer::UpdateAllocatorStats() {
+  const TensorAllocatorStats stats = TensorAllocator::GetStats();
+  System::stat_aggregator->Update(stat_allocations_->stat_id, (double)stats.allocations);
+  System::stat_aggregator->Update(stat_memory_peak_->stat_id, (double)stats.bytes_peak / 1048576.0);
+}
+
+void Trainer::UpdateCheckpointingStats() {
+  if (graph_.GetCheckpointing() == CHECKPOINTING_OFF)
+    return;
+  const CheckpointingStats& stats = graph_.GetCheckpointingStats();
+  System::stat_aggregator->Update(stat_checkpoint_saved_->stat_id, (double)stats.bytes_saved() / 1048576.0);
+  System::stat_aggregator->Update(stat_recompute_overhead_->stat_id, 100.0 * stats.recompute_overhead());
+}
+
+void Trainer::UpdateDecompressionStats() {
+  // Only datasets from compressed streams report this
+  const DecompressionStats stats = CompressedTensorStream::GetStats();
+  if (stats.bytes > 0)
+    System::stat_aggregator->Update(stat_decompression_->stat_id, stats.mebibytes_per_second());
+}
+
 void Trainer::Epoch() {
   // Update hardcoded epoch stat
   System::stat_aggregator->hardcoded_stats_.epoch = epoch_;
+  TensorAllocator::ResetStats();
+  CompressedTensorStream::ResetStats();
+  graph_.ResetCheckpointingStats();
 
 	datum aggregate_loss = 0.0;
 	datum* loss_sums = new datum[graph_.GetLossNodes().size()];
@@ -332,6 +614,13 @@ void Trainer::Epoch() {
 
 	for (NetGraphNode* training_node : graph_.GetTrainingNodes())
 		(dynamic_cast<TrainingLayer*>(training_node->layer))->SetTestingMode(false);
+  for (NetGraph* replica : replicas_)
+    for (NetGraphNode* training_node : replica->GetTrainingNodes())
+      (dynamic_cast<TrainingLayer*>(training_node->layer))->SetTestingMode(false);
+
+  const unsigned int loss_nodes = graph_.GetLossNodes().size();
+  std::vector<datum> replica_loss_sums ((replicas_.size() + 1) * loss_nodes);
+  std::vector<datum> replica_aggregate_losses (replicas_.size() + 1);
 
   LOGINFO << "Epoch: " << epoch_ << ", it: " << iterations <<
            ", bsize: " << first_training_layer_->GetBatchSize() * settings_.sbatchsize << ", current lr: " <<
@@ -349,43 +638,24 @@ void Trainer::Epoch() {
     }
     aggregate_loss = 0.0;
 
-    // Reset gradients
-    for (unsigned int np = 0; np < accumulated_gradients_.size(); np++)
-      accumulated_gradients_[np]->Clear();
-
-    for (unsigned int b = 0; b < settings_.sbatchsize; b++) {
-      graph_.FeedForward();
-
-      // Save errors
-			for (unsigned int n = 0; n < graph_.GetLossNodes().size(); n++) {
-				LossFunctionLayer* lossfunction_layer = dynamic_cast<LossFunctionLayer*>(graph_.GetLossNodes()[n]->layer);
-				const datum loss = lossfunction_layer->CalculateLossFunction();
-				loss_sums[n] += loss;
-				aggregate_loss += loss;
-			}
-
-      // Correct errors
-      graph_.BackPropagate();
-
-      unsigned int np = 0;
-
-      // Accumulate gradients
-      for (unsigned int l = 0; l < graph_.GetNodes().size(); l++) {
-				Layer* const layer = graph_.GetNodes()[l]->layer;
-        for (unsigned int p = 0; p < layer->parameters().size(); p++) {
-          Tensor& gradients = layer->parameters() [p]->delta;
-#ifdef BUILD_OPENCL
-          gradients.MoveToCPU();
-#endif
-
-          for (unsigned int e = 0; e < gradients.elements(); e++) {
-            (* (accumulated_gradients_[np])) [e] += gradients[e];
-          }
-
-          np++;
-        }
+    if (replicas_.size() == 0) {
+      RunPasses (0, loss_sums, aggregate_loss);
+    } else {
+      // Every net sums its own losses, they are added in a fixed order
+      for (datum& loss : replica_loss_sums)
+        loss = 0;
+      replica_pool_->Run([this, &replica_loss_sums, &replica_aggregate_losses, loss_nodes] (unsigned int replica) {
+        replica_aggregate_losses[replica] = 0;
+        RunPasses (replica, &replica_loss_sums[replica * loss_nodes], replica_aggregate_losses[replica]);
+      });
+      for (unsigned int r = 0; r <= replicas_.size(); r++) {
+        for (unsigned int n = 0; n < loss_nodes; n++)
+          loss_sums[n] += replica_loss_sums[r * loss_nodes + n];
+        aggregate_loss += replica_aggregate_losses[r];
       }
+      ReduceGradients();
     }
+    SumGradients();
     // Calculate annealed learning rate
     const datum lr =
       CalculateLR (epoch_ * iterations + i);
@@ -405,6 +675,9 @@ void Trainer::Epoch() {
   // Submit performance statistics
   System::stat_aggregator->Update(stat_sps_->stat_id, (double)sample_count_ * (double)iterations * (double)(settings_.sbatchsize));
   System::stat_aggregator->Update(stat_fps_->stat_id, (double)(first_training_layer_->GetBatchSize()) * (double)iterations * (double)(settings_.sbatchsize));
+  UpdateAllocatorStats();
+  UpdateDecompressionStats();
+  UpdateCheckpointingStats();
   
   // Display training epoch_error
 	for (unsigned int n = 0; n < graph_.GetLossNodes().size(); n++) {
@@ -425,6 +698,91 @@ void Trainer::Epoch() {
   epoch_++;
 }
 
+void Trainer::RunPasses (const unsigned int replica, datum* loss_sums, datum& aggregate_loss) {
+  NetGraph& graph = replica == 0 ? graph_ : *replicas_[replica - 1];
+  std::vector<Tensor*>& accumulated_gradients = replica == 0 ?
+    accumulated_gradients_ : replica_gradients_[replica - 1];
+
+  // Reset gradients
+  for (unsigned int np = 0; np < accumulated_gradients.size(); np++)
+    accumulated_gradients[np]->Clear();
+
+  // The passes of a batch are dealt out to the nets of all processes in turn
+  const unsigned int ranks = all_reduce_ ? all_reduce_->transport().size() : 1;
+  const unsigned int rank = all_reduce_ ? all_reduce_->transport().rank() : 0;
+  const unsigned int nets = (replicas_.size() + 1) * ranks;
+  const unsigned int first = rank * (replicas_.size() + 1) + replica;
+  const bool overlap = all_reduce_ && replicas_.size() == 0;
+  for (unsigned int b = first; b < settings_.sbatchsize; b += nets) {
+    // Without replicas, the gradients are summed during the last pass
+    if (overlap)
+      last_pass_ = b + nets >= settings_.sbatchsize;
+    graph.FeedForward();
+
+    // Save errors
+    for (unsigned int n = 0; n < graph.GetLossNodes().size(); n++) {
+      LossFunctionLayer* lossfunction_layer = dynamic_cast<LossFunctionLayer*>(graph.GetLossNodes()[n]->layer);
+      const datum loss = lossfunction_layer->CalculateLossFunction();
+      loss_sums[n] += loss;
+      aggregate_loss += loss;
+    }
+
+    // Correct errors
+    graph.BackPropagate();
+    if (overlap && last_pass_) {
+      last_pass_ = false;
+      continue;
+    }
+
+    unsigned int np = 0;
+
+    // Accumulate gradients
+    for (unsigned int l = 0; l < graph.GetNodes().size(); l++) {
+      Layer* const layer = graph.GetNodes()[l]->layer;
+      for (unsigned int p = 0; p < layer->parameters().size(); p++) {
+        Tensor& gradients = layer->parameters() [p]->delta;
+#ifdef BUILD_OPENCL
+        gradients.MoveToCPU();
+#endif
+
+        for (unsigned int e = 0; e < gradients.elements(); e++) {
+          (* (accumulated_gradients[np])) [e] += gradients[e];
+        }
+
+        np++;
+      }
+    }
+  }
+}
+
+/*
+ * The gradients of net r + s are added to those of net r in rounds with
+ * s = 1, 2, 4, ..., where r is a multiple of 2s. After the last round, the
+ * sum is in the gradients of the trained net. Every worker adds its own part
+ * of each Tensor, so all workers are busy in every round.
+ */
+void Trainer::ReduceGradients() {
+  const unsigned int nets = replicas_.size() + 1;
+  for (unsigned int stride = 1; stride < nets; stride *= 2) {
+    replica_pool_->Run([this, nets, stride] (unsigned int worker) {
+      const std::size_t workers = replica_pool_->workers();
+      for (unsigned int r = 0; r + stride < nets; r += 2 * stride) {
+        std::vector<Tensor*>& target = r == 0 ? accumulated_gradients_ : replica_gradients_[r - 1];
+        std::vector<Tensor*>& source = replica_gradients_[r + stride - 1];
+        for (unsigned int np = 0; np < target.size(); np++) {
+          const std::size_t elements = target[np]->elements();
+          const std::size_t begin = elements * worker / workers;
+          const std::size_t end = elements * (worker + 1) / workers;
+          datum* target_ptr = target[np]->data_ptr();
+          const datum* source_ptr = source[np]->data_ptr_const();
+          for (std::size_t e = begin; e < end; e++)
+            target_ptr[e] += source_ptr[e];
+        }
+      }
+    });
+  }
+}
+
 void Trainer::ApplyGradients (datum lr) {
   unsigned int dp = 0;
   unsigned int qp_caseA = 0, qp_caseB = 0, qp_caseC = 0, qp_caseM = 0;
@@ -539,7 +897,16 @@ void Trainer::ApplyGradients (datum lr) {
 
       dp++;
     }
+
+    if (layer->parameters().size() > 0)
+      layer->OnParametersChanged();
   }
+
+  // The replicas use the same parameters
+  for (NetGraph* replica : replicas_)
+    for (NetGraphNode* node : replica->GetNodes())
+      if (node->layer->parameters().size() > 0)
+        node->layer->OnParametersChanged();
   
   // Update quickprop stats
   if(settings_.optimization_method == QUICKPROP) {
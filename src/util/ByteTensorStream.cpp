@@ -0,0 +1,187 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <fstream>
+
+#ifdef BUILD_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+#include "TensorMathKernels.h"
+#include "CompressedTensor.h"
+#include "ByteTensorStream.h"
+
+namespace Conv {
+
+ByteTensorStream::~ByteTensorStream() {
+#ifdef BUILD_POSIX
+  if(mapping_ != nullptr)
+    munmap(mapping_, mapping_length_);
+#endif
+}
+
+unsigned int ByteTensorStream::LoadFile(std::string path)
+{
+  const std::uint8_t* file = nullptr;
+  std::size_t file_length = 0;
+#ifdef BUILD_POSIX
+  int input_fd = open(path.c_str(), O_RDONLY);
+  if(input_fd < 0) {
+    FATAL("Cannot open file: " << path);
+  }
+  struct stat input_stat;
+  if(fstat(input_fd, &input_stat) != 0) {
+    FATAL("Cannot stat file: " << path);
+  }
+  file_length = input_stat.st_size;
+  if(file_length > 0) {
+    mapping_ = mmap(NULL, file_length, PROT_READ, MAP_PRIVATE, input_fd, 0);
+    if(mapping_ == MAP_FAILED) {
+      FATAL("Memory map failed: " << errno);
+    }
+    mapping_length_ = file_length;
+    file = (const std::uint8_t*)mapping_;
+  }
+  close(input_fd);
+#else
+  std::ifstream input_stream(path, std::ios::binary | std::ios::in);
+  if(!input_stream.good()) {
+    FATAL("Cannot open file: " << path);
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(input_stream), std::istreambuf_iterator<char>());
+  file = buffer_.data();
+  file_length = buffer_.size();
+#endif
+
+  uint64_t magic = 0;
+  if(file_length < sizeof(uint64_t)) {
+    FATAL("Wrong magic at start of stream!");
+  }
+  std::memcpy(&magic, file, sizeof(uint64_t));
+  if(magic != CN24_BTS_MAGIC) {
+    FATAL("Wrong magic at start of stream!");
+  }
+
+  // Go through file
+  std::cout << std::endl << std::flush;
+
+  const std::size_t header_length = 4 * sizeof(uint64_t) + 2 * sizeof(double);
+  std::size_t position = sizeof(uint64_t);
+  while(file_length - position >= header_length) {
+    uint64_t dimensions[4];
+    double scale, offset;
+    std::memcpy(dimensions, file + position, sizeof(dimensions));
+    std::memcpy(&scale, file + position + sizeof(dimensions), sizeof(double));
+    std::memcpy(&offset, file + position + sizeof(dimensions) + sizeof(double), sizeof(double));
+    position += header_length;
+
+    ByteTensor tensor;
+    tensor.samples = dimensions[0];
+    tensor.width = dimensions[1];
+    tensor.height = dimensions[2];
+    tensor.maps = dimensions[3];
+    tensor.scale = (datum)scale;
+    tensor.offset = (datum)offset;
+    tensor.data = file + position;
+
+    const std::size_t elements = tensor.samples * tensor.width * tensor.height * tensor.maps;
+    if(elements == 0)
+      break;
+    if(elements > file_length - position) {
+      FATAL("Stream ends in the middle of a tensor: " << path);
+    }
+    position += elements;
+
+    tensors_.push_back(tensor);
+    std::cout << "." << std::flush;
+  }
+
+  return 0;
+}
+
+bool ByteTensorStream::CopySample(const unsigned int source, const std::size_t source_sample,
+                                  Conv::Tensor& target, const std::size_t target_sample)
+{
+  if(source < tensors_.size() && target_sample < target.samples()) {
+    const ByteTensor& tensor = tensors_[source];
+    if(source_sample >= tensor.samples)
+      return false;
+
+    const std::size_t sample_elements = tensor.width * tensor.height * tensor.maps;
+    const std::uint8_t* sample_data = tensor.data + source_sample * sample_elements;
+    if(tensor.width == target.width() && tensor.height == target.height() && tensor.maps == target.maps()) {
+      // Convert right into the target when the sizes match
+#ifdef BUILD_OPENCL
+      target.MoveToCPU();
+#endif
+      TensorMathKernels::Get().unpack_u8(sample_data, target.data_ptr(0, 0, 0, target_sample),
+                                         sample_elements, tensor.scale, tensor.offset);
+      return true;
+    } else {
+      Tensor& scratch = Scratch(1, tensor.width, tensor.height, tensor.maps);
+      TensorMathKernels::Get().unpack_u8(sample_data, scratch.data_ptr(), sample_elements,
+                                         tensor.scale, tensor.offset);
+      return Tensor::CopySample(scratch, 0, target, target_sample);
+    }
+  } else
+    return false;
+}
+
+bool ByteTensorStream::Serialize(std::ostream& output, Tensor& tensor)
+{
+#ifdef BUILD_OPENCL
+  tensor.MoveToCPU();
+#endif
+  const datum* data = tensor.data_ptr_const();
+  const std::size_t elements = tensor.elements();
+
+  datum scale = 1;
+  datum offset = 0;
+  const bool exact = CompressedTensor::FindByteScale(data, elements, scale);
+
+  std::vector<std::uint8_t> bytes(elements);
+  if(exact) {
+    for(std::size_t e = 0; e < elements; e++)
+      bytes[e] = (std::uint8_t)std::lround(data[e] / scale);
+  } else if(elements > 0) {
+    const datum minimum = *std::min_element(data, data + elements);
+    const datum maximum = *std::max_element(data, data + elements);
+    offset = minimum;
+    scale = maximum > minimum ? (maximum - minimum) / (datum)255 : (datum)1;
+    for(std::size_t e = 0; e < elements; e++) {
+      const long k = std::lround((data[e] - offset) / scale);
+      bytes[e] = (std::uint8_t)std::max(0L, std::min(255L, k));
+    }
+  }
+
+  uint64_t samples = tensor.samples();
+  uint64_t width = tensor.width();
+  uint64_t height = tensor.height();
+  uint64_t maps = tensor.maps();
+  double scale_d = scale;
+  double offset_d = offset;
+  output.write ( ( const char* ) &samples, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &width, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &height, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &maps, sizeof ( uint64_t ) / sizeof ( char ) );
+  output.write ( ( const char* ) &scale_d, sizeof ( double ) / sizeof ( char ) );
+  output.write ( ( const char* ) &offset_d, sizeof ( double ) / sizeof ( char ) );
+  output.write ( ( const char* ) bytes.data(), elements );
+  return exact;
+}
+
+}
@@ -4,6 +4,7 @@
  *
  * For licensing information, see the LICENSE file included with this project.
  */
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -12,6 +13,7 @@
 #include <limits>
 #include <cmath>
 #include <string>
+#include <vector>
 
 
 #ifdef BUILD_POSIX
@@ -30,6 +32,7 @@
 #include "Config.h"
 #include "Log.h"
 #include "CompressedTensor.h"
+#include "TensorAllocator.h"
 #include "CLHelper.h"
 
 namespace Conv {
@@ -44,38 +47,66 @@ CompressedTensor::~CompressedTensor() {
   DeleteIfPossible();
 }
 
-void CompressedTensor::Compress(Tensor& tensor)
+void CompressedTensor::Compress(Tensor& tensor, CompressionCodec codec)
 {
   std::size_t compressed_length = 0;
   std::size_t uncompressed_elements = tensor.elements();
 #ifdef BUILD_OPENCL
   tensor.MoveToCPU();
 #endif
+
+  if(codec == CODEC_BLOCK) {
+    CompressBlocks(tensor);
+    return;
+  }
   
   void* compressed_buffer = new char[2 * tensor.elements() * chars_per_datum + 2];
   CompressedTensor::CompressData((void*)tensor.data_ptr(), uncompressed_elements, compressed_buffer, compressed_length);
   
   Resize(tensor.samples(), tensor.width(), tensor.height(), tensor.maps(), compressed_length, (char*)compressed_buffer, false);
+  codec_ = CODEC_RLE;
 }
 
 void CompressedTensor::Decompress(Tensor& tensor, datum* preallocated_buffer)
 {
-  std::size_t compressed_length = compressed_length_;
-  std::size_t uncompressed_elements = 0;
   datum* uncompressed_buffer = preallocated_buffer;
   if(uncompressed_buffer == nullptr)
-    uncompressed_buffer = new datum[elements_];
+    uncompressed_buffer = (datum*)TensorAllocator::Allocate(elements_ * sizeof(datum));
   
-  CompressedTensor::DecompressData(uncompressed_buffer, uncompressed_elements, compressed_data_ptr_, compressed_length);
+  Decompress(uncompressed_buffer);
+    
+  tensor.Resize(samples_, width_, height_, maps_, uncompressed_buffer, false);
+}
+
+void CompressedTensor::Decompress(datum* target) const
+{
+  if(codec_ == CODEC_BLOCK) {
+    // A header without blocks would leave the target untouched
+    if(block_elements_ == 0 && elements_ > 0) {
+      FATAL("Incorrect encoding!");
+    }
+    const std::size_t blocks = block_elements_ > 0 ? (elements_ + block_elements_ - 1) / block_elements_ : 0;
+    bool success = true;
+    #pragma omp parallel for default(shared) reduction(&&:success) if(blocks > 1)
+    for(long block = 0; block < (long)blocks; block++) {
+      success = DecompressBlock((std::size_t)block, target) && success;
+    }
+    if(!success) {
+      FATAL("Incorrect encoding!");
+    }
+    return;
+  }
+
+  std::size_t compressed_length = compressed_length_;
+  std::size_t uncompressed_elements = 0;
+  
+  CompressedTensor::DecompressData(target, uncompressed_elements, compressed_data_ptr_, compressed_length);
   
   if(uncompressed_elements != elements_) {
     FATAL("Decompressed size mismatch!");
   }
-    
-  tensor.Resize(samples_, width_, height_, maps_, uncompressed_buffer, false);
 }
 
-
 void CompressedTensor::Resize ( const std::size_t samples, const std::size_t width,
                       const std::size_t height, const std::size_t maps, const std::size_t compressed_length, char* const preallocated_memory, bool mmapped) {
   // Delete the old allocation
@@ -113,17 +144,30 @@ void CompressedTensor::Serialize ( std::ostream& output ) {
   output.write ( ( const char* ) &width, sizeof ( uint64_t ) / sizeof ( char ) );
   output.write ( ( const char* ) &height, sizeof ( uint64_t ) / sizeof ( char ) );
   output.write ( ( const char* ) &maps, sizeof ( uint64_t ) / sizeof ( char ) );
+
+  if ( codec_ == CODEC_BLOCK ) {
+    uint64_t encoding = encoding_;
+    uint64_t block_elements = block_elements_;
+    double scale = scale_;
+    output.write ( ( const char* ) &encoding, sizeof ( uint64_t ) / sizeof ( char ) );
+    output.write ( ( const char* ) &block_elements, sizeof ( uint64_t ) / sizeof ( char ) );
+    output.write ( ( const char* ) &scale, sizeof ( double ) / sizeof ( char ) );
+  }
+
   output.write ( ( const char* ) &compressed_length, sizeof ( uint64_t ) / sizeof ( char ) );
 
   if ( elements_ > 0 )
     output.write ( ( const char* ) compressed_data_ptr_, compressed_length_);
 }
 
-void CompressedTensor::Deserialize ( std::istream& input , bool head_only, bool try_mmap, int fd) {
+void CompressedTensor::Deserialize ( std::istream& input , bool head_only, bool try_mmap, int fd, CompressionCodec codec) {
   uint64_t samples = 0;
   uint64_t width = 0;
   uint64_t height = 0;
   uint64_t maps = 0;
+  uint64_t encoding = 0;
+  uint64_t block_elements = 0;
+  double scale = 1;
   uint64_t compressed_length = 0;
 
   if ( !input.good() )
@@ -133,6 +177,11 @@ void CompressedTensor::Deserialize ( std::istream& input , bool head_only, bool
   input.read ( ( char* ) &width, sizeof ( uint64_t ) / sizeof ( char ) );
   input.read ( ( char* ) &height, sizeof ( uint64_t ) / sizeof ( char ) );
   input.read ( ( char* ) &maps, sizeof ( uint64_t ) / sizeof ( char ) );
+  if ( codec == CODEC_BLOCK ) {
+    input.read ( ( char* ) &encoding, sizeof ( uint64_t ) / sizeof ( char ) );
+    input.read ( ( char* ) &block_elements, sizeof ( uint64_t ) / sizeof ( char ) );
+    input.read ( ( char* ) &scale, sizeof ( double ) / sizeof ( char ) );
+  }
   input.read ( ( char* ) &compressed_length, sizeof ( uint64_t ) / sizeof ( char ) );
 
 #ifdef BUILD_POSIX
@@ -167,6 +216,11 @@ void CompressedTensor::Deserialize ( std::istream& input , bool head_only, bool
   }
   else if(head_only)
     input.seekg(compressed_length, std::ios::cur);
+
+  codec_ = codec;
+  encoding_ = encoding;
+  block_elements_ = block_elements;
+  scale_ = (datum)scale;
 }
 
 void CompressedTensor::DeleteIfPossible() {
@@ -346,4 +400,321 @@ void CompressedTensor::DecompressData(void* uncompressed, std::size_t& uncompres
 }
 
 
+
+/*
+ * This is the block codec of version 2 streams. The values are split into
+ * blocks that are compressed independently, so they can be decompressed in
+ * parallel. A tensor whose values are all scale * k for bytes k is stored
+ * as these bytes, optionally as differences to the previous byte, which
+ * turns smooth images and constant label maps into repeating patterns.
+ * Other tensors are stored as their float bytes, sorted by byte position.
+ * The bytes of each block are LZ coded with a format close to LZ4.
+ *
+ * The payload starts with blocks + 1 offsets of the blocks in the payload,
+ * followed by the blocks. Each block starts with its filter byte.
+ * Don't change this or you will break the file format.
+ */
+const std::uint64_t encoding_float = 0;
+const std::uint64_t encoding_byte = 1;
+const unsigned char filter_none = 0;
+const unsigned char filter_delta = 1;
+const std::size_t default_block_elements = 65536;
+
+const std::size_t lz_min_match = 4;
+const std::size_t lz_max_offset = 65535;
+const unsigned int lz_hash_bits = 14;
+// The last literals of a block are never part of a match
+const std::size_t lz_last_literals = 5;
+const std::size_t lz_match_search_end = 12;
+
+static inline std::uint32_t Read32(const unsigned char* ptr) {
+  std::uint32_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+static inline unsigned int LZHash(const std::uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - lz_hash_bits);
+}
+
+static inline void LZWriteLength(unsigned char*& output_ptr, std::size_t length) {
+  for(length -= 15; length >= 255; length -= 255)
+    *output_ptr++ = 255;
+  *output_ptr++ = (unsigned char)length;
+}
+
+static inline std::size_t LZBound(const std::size_t length) {
+  return length + length / 255 + 16;
+}
+
+static std::size_t LZCompress(const unsigned char* input, const std::size_t length, unsigned char* output) {
+  std::vector<std::uint32_t> table(1 << lz_hash_bits, 0);
+  const unsigned char* const input_end = input + length;
+  const unsigned char* input_ptr = input;
+  const unsigned char* anchor = input;
+  unsigned char* output_ptr = output;
+
+  if(length > lz_match_search_end) {
+    const unsigned char* const search_end = input_end - lz_match_search_end;
+    const unsigned char* const match_end = input_end - lz_last_literals;
+    while(input_ptr < search_end) {
+      const std::uint32_t sequence = Read32(input_ptr);
+      const unsigned int hash = LZHash(sequence);
+      const unsigned char* reference = input + table[hash];
+      table[hash] = (std::uint32_t)(input_ptr - input);
+
+      if(reference >= input_ptr || (std::size_t)(input_ptr - reference) > lz_max_offset || Read32(reference) != sequence) {
+        input_ptr++;
+        continue;
+      }
+
+      // Extend the match as far as possible
+      const unsigned char* match_ptr = input_ptr + lz_min_match;
+      reference += lz_min_match;
+      while(match_ptr < match_end && *match_ptr == *reference) {
+        match_ptr++; reference++;
+      }
+
+      const std::size_t literals = input_ptr - anchor;
+      const std::size_t match_length = (match_ptr - input_ptr) - lz_min_match;
+      const std::size_t offset = match_ptr - reference;
+      unsigned char* token = output_ptr++;
+      *token = (unsigned char)((literals >= 15 ? 15 : literals) << 4);
+      if(literals >= 15)
+        LZWriteLength(output_ptr, literals);
+      std::memcpy(output_ptr, anchor, literals);
+      output_ptr += literals;
+      *output_ptr++ = (unsigned char)(offset & 0xFF);
+      *output_ptr++ = (unsigned char)(offset >> 8);
+      *token |= (unsigned char)(match_length >= 15 ? 15 : match_length);
+      if(match_length >= 15)
+        LZWriteLength(output_ptr, match_length);
+
+      input_ptr = match_ptr;
+      anchor = input_ptr;
+    }
+  }
+
+  // The rest is emitted as literals without a match
+  const std::size_t literals = input_end - anchor;
+  *output_ptr++ = (unsigned char)((literals >= 15 ? 15 : literals) << 4);
+  if(literals >= 15)
+    LZWriteLength(output_ptr, literals);
+  std::memcpy(output_ptr, anchor, literals);
+  output_ptr += literals;
+  return output_ptr - output;
+}
+
+static inline bool LZReadLength(const unsigned char*& input_ptr, const unsigned char* input_end, std::size_t& length) {
+  unsigned char byte;
+  do {
+    if(input_ptr >= input_end)
+      return false;
+    byte = *input_ptr++;
+    length += byte;
+  } while(byte == 255);
+  return true;
+}
+
+static bool LZDecompress(const unsigned char* input, const std::size_t compressed_length,
+                         unsigned char* output, const std::size_t length) {
+  const unsigned char* input_ptr = input;
+  const unsigned char* const input_end = input + compressed_length;
+  unsigned char* output_ptr = output;
+  unsigned char* const output_end = output + length;
+
+  while(true) {
+    if(input_ptr >= input_end)
+      return false;
+    const unsigned char token = *input_ptr++;
+
+    std::size_t literals = token >> 4;
+    if(literals == 15 && !LZReadLength(input_ptr, input_end, literals))
+      return false;
+    if(literals > (std::size_t)(input_end - input_ptr) || literals > (std::size_t)(output_end - output_ptr))
+      return false;
+    std::memcpy(output_ptr, input_ptr, literals);
+    output_ptr += literals;
+    input_ptr += literals;
+
+    // Only the last sequence has no match
+    if(output_ptr == output_end)
+      return input_ptr == input_end;
+
+    if(input_end - input_ptr < 2)
+      return false;
+    const std::size_t offset = input_ptr[0] | ((std::size_t)input_ptr[1] << 8);
+    input_ptr += 2;
+    std::size_t match_length = token & 15;
+    if(match_length == 15 && !LZReadLength(input_ptr, input_end, match_length))
+      return false;
+    match_length += lz_min_match;
+    if(offset == 0 || offset > (std::size_t)(output_ptr - output) || match_length > (std::size_t)(output_end - output_ptr))
+      return false;
+
+    const unsigned char* reference = output_ptr - offset;
+    if(offset >= 16) {
+      // Chunks of 16 bytes do not overlap, so they can be copied as a whole
+      std::size_t copied = 0;
+      for(; copied + 16 <= match_length; copied += 16)
+        std::memcpy(output_ptr + copied, reference + copied, 16);
+      std::memcpy(output_ptr + copied, reference + copied, match_length - copied);
+    } else {
+      // Repeats a short pattern, e.g. a run of one byte
+      for(std::size_t b = 0; b < match_length; b++)
+        output_ptr[b] = reference[b];
+    }
+    output_ptr += match_length;
+  }
+}
+
+static bool IsByteEncodable(const datum* data, const std::size_t elements, const datum scale) {
+  for(std::size_t e = 0; e < elements; e++) {
+    const long k = std::lround(data[e] / scale);
+    if(k < 0 || k > 255)
+      return false;
+    // Compare the bits, this also tells -0 from 0
+    const datum decoded = scale * (datum)k;
+    if(std::memcmp(&decoded, &data[e], sizeof(datum)) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool CompressedTensor::FindByteScale(const datum* data, const std::size_t elements, datum& scale) {
+  // The scales of DATUM_FROM_UCHAR and of integer labels
+  const datum scales[] = {DATUM_FROM_UCHAR(1), 1};
+  for(const datum candidate : scales) {
+    if(IsByteEncodable(data, elements, candidate)) {
+      scale = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void CompressedTensor::CompressBlocks(const Tensor& tensor) {
+  const datum* data = tensor.data_ptr_const();
+  const std::size_t elements = tensor.elements();
+
+  datum scale = 1;
+  const std::uint64_t encoding = FindByteScale(data, elements, scale) ? encoding_byte : encoding_float;
+
+  const std::size_t block_elements = default_block_elements;
+  const std::size_t blocks = (elements + block_elements - 1) / block_elements;
+  std::vector<std::vector<unsigned char>> compressed_blocks(blocks);
+
+  #pragma omp parallel for default(shared)
+  for(long block = 0; block < (long)blocks; block++) {
+    const std::size_t first = (std::size_t)block * block_elements;
+    const std::size_t count = std::min(block_elements, elements - first);
+    std::vector<unsigned char>& compressed = compressed_blocks[block];
+
+    if(encoding == encoding_byte) {
+      std::vector<unsigned char> bytes(count);
+      std::vector<unsigned char> deltas(count);
+      unsigned char last = 0;
+      for(std::size_t e = 0; e < count; e++) {
+        bytes[e] = (unsigned char)std::lround(data[first + e] / scale);
+        deltas[e] = (unsigned char)(bytes[e] - last);
+        last = bytes[e];
+      }
+
+      // Keep whichever is smaller
+      std::vector<unsigned char> with_delta(1 + LZBound(count));
+      with_delta[0] = filter_delta;
+      with_delta.resize(1 + LZCompress(deltas.data(), count, &with_delta[1]));
+      compressed.resize(1 + LZBound(count));
+      compressed[0] = filter_none;
+      compressed.resize(1 + LZCompress(bytes.data(), count, &compressed[1]));
+      if(with_delta.size() < compressed.size())
+        compressed.swap(with_delta);
+    } else {
+      const std::size_t count_bytes = count * sizeof(datum);
+      std::vector<unsigned char> planes(count_bytes);
+      const unsigned char* input = (const unsigned char*)(data + first);
+      for(std::size_t e = 0; e < count; e++)
+        for(std::size_t b = 0; b < sizeof(datum); b++)
+          planes[b * count + e] = input[e * sizeof(datum) + b];
+      compressed.resize(1 + LZBound(count_bytes));
+      compressed[0] = filter_none;
+      compressed.resize(1 + LZCompress(planes.data(), count_bytes, &compressed[1]));
+    }
+  }
+
+  std::size_t compressed_length = (blocks + 1) * sizeof(uint64_t);
+  for(const std::vector<unsigned char>& compressed : compressed_blocks)
+    compressed_length += compressed.size();
+
+  char* payload = new char[compressed_length];
+  uint64_t offset = (blocks + 1) * sizeof(uint64_t);
+  for(std::size_t block = 0; block <= blocks; block++) {
+    std::memcpy(payload + block * sizeof(uint64_t), &offset, sizeof(uint64_t));
+    if(block < blocks) {
+      std::memcpy(payload + offset, compressed_blocks[block].data(), compressed_blocks[block].size());
+      offset += compressed_blocks[block].size();
+    }
+  }
+
+  Resize(tensor.samples(), tensor.width(), tensor.height(), tensor.maps(), compressed_length, payload, false);
+  codec_ = CODEC_BLOCK;
+  encoding_ = encoding;
+  scale_ = scale;
+  block_elements_ = block_elements;
+}
+
+bool CompressedTensor::DecompressBlock(const std::size_t block, datum* target) const {
+  const std::size_t blocks = (elements_ + block_elements_ - 1) / block_elements_;
+  if((blocks + 1) * sizeof(uint64_t) > compressed_length_)
+    return false;
+
+  uint64_t begin, end;
+  std::memcpy(&begin, compressed_data_ptr_ + block * sizeof(uint64_t), sizeof(uint64_t));
+  std::memcpy(&end, compressed_data_ptr_ + (block + 1) * sizeof(uint64_t), sizeof(uint64_t));
+  if(begin >= end || end > compressed_length_)
+    return false;
+
+  const std::size_t first = block * block_elements_;
+  const std::size_t count = std::min(block_elements_, elements_ - first);
+  const unsigned char* input = (const unsigned char*)compressed_data_ptr_ + begin;
+  const unsigned char filter = input[0];
+  datum* output = target + first;
+
+  if(encoding_ == encoding_byte) {
+    static thread_local std::vector<unsigned char> bytes;
+    bytes.resize(count);
+    if(!LZDecompress(input + 1, end - begin - 1, bytes.data(), count))
+      return false;
+    const datum scale = scale_;
+    if(filter == filter_delta) {
+      unsigned char last = 0;
+      for(std::size_t e = 0; e < count; e++) {
+        last = (unsigned char)(last + bytes[e]);
+        output[e] = scale * (datum)last;
+      }
+    } else if(filter == filter_none) {
+      const unsigned char* bytes_ptr = bytes.data();
+      for(std::size_t e = 0; e < count; e++)
+        output[e] = scale * (datum)bytes_ptr[e];
+    } else {
+      return false;
+    }
+  } else if(encoding_ == encoding_float) {
+    const std::size_t count_bytes = count * sizeof(datum);
+    static thread_local std::vector<unsigned char> planes;
+    planes.resize(count_bytes);
+    if(filter != filter_none || !LZDecompress(input + 1, end - begin - 1, planes.data(), count_bytes))
+      return false;
+    unsigned char* output_bytes = (unsigned char*)output;
+    for(std::size_t b = 0; b < sizeof(datum); b++) {
+      const unsigned char* plane = planes.data() + b * count;
+      for(std::size_t e = 0; e < count; e++)
+        output_bytes[e * sizeof(datum) + b] = plane[e];
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
 }
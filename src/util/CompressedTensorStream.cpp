@@ -5,6 +5,8 @@
  * For licensing information, see the LICENSE file included with this project.
  */
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 
@@ -17,6 +19,10 @@
 #include "CompressedTensorStream.h"
 
 namespace Conv {
+
+// Summed over all threads and streams
+static std::atomic<std::size_t> decompressed_bytes(0);
+static std::atomic<unsigned long long> decompression_nanoseconds(0);
   
 unsigned int CompressedTensorStream::LoadFile(std::string path)
 {
@@ -34,7 +40,10 @@ unsigned int CompressedTensorStream::LoadFile(std::string path)
   uint64_t magic = 0;
   input_stream.read((char*)&magic, sizeof(uint64_t)/sizeof(char));
   
-  if(magic != CN24_CTS_MAGIC) {
+  CompressionCodec codec = CODEC_RLE;
+  if(magic == CN24_CTS2_MAGIC) {
+    codec = CODEC_BLOCK;
+  } else if(magic != CN24_CTS_MAGIC) {
     FATAL("Wrong magic at start of stream!");
   }
 
@@ -44,9 +53,9 @@ unsigned int CompressedTensorStream::LoadFile(std::string path)
   while (!input_stream.eof()) {
     CompressedTensor* tensor = new CompressedTensor();
 #ifdef BUILD_POSIX
-    tensor->Deserialize (input_stream, false, true, input_fd);
+    tensor->Deserialize (input_stream, false, true, input_fd, codec);
 #else
-    tensor->Deserialize (input_stream, false);
+    tensor->Deserialize (input_stream, false, false, 0, codec);
 #endif
 
     if (tensor->elements() == 0)
@@ -60,35 +69,48 @@ unsigned int CompressedTensorStream::LoadFile(std::string path)
     input_stream.peek();
   }
   
-  temp_tensor_.Resize(1,max_elements_);
   return 0;
 }
 
 bool CompressedTensorStream::CopySample(const unsigned int source, const std::size_t source_sample,
                                    Conv::Tensor& target, const std::size_t target_sample)
 {
-  if(source < tensors_.size()) {
+  if(source < tensors_.size() && target_sample < target.samples()) {
     CompressedTensor* const ctensor = tensors_[source];
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool success = true;
     if(source_sample == 0 && ctensor->width() == target.width() && ctensor->height() == target.height() && ctensor->maps() == target.maps() && ctensor->samples() == 1) {
-      // This is a little hack for faster loading of certain datasets
+      // Decompress right into the target when the sizes match
 #ifdef BUILD_OPENCL
       target.MoveToCPU();
 #endif
-      datum* old_data_ptr = temp_tensor_.data_ptr();
-      datum* direct_ptr = target.data_ptr(0, 0, 0, target_sample);
-      temp_tensor_.Resize(1, max_elements_, 1, 1, direct_ptr, false, true);
-      ctensor->Decompress(temp_tensor_, temp_tensor_.data_ptr());
-      
-      temp_tensor_.Resize(1, max_elements_, 1, 1, old_data_ptr, false, true);
-      return true;
+      ctensor->Decompress(target.data_ptr(0, 0, 0, target_sample));
     } else {
-      ctensor->Decompress(temp_tensor_, temp_tensor_.data_ptr());
-      return Tensor::CopySample(temp_tensor_, source_sample, target, target_sample);
+      Tensor& scratch = Scratch(ctensor->samples(), ctensor->width(), ctensor->height(), ctensor->maps());
+      ctensor->Decompress(scratch.data_ptr());
+      success = Tensor::CopySample(scratch, source_sample, target, target_sample);
     }
+
+    decompressed_bytes += ctensor->elements() * sizeof(datum);
+    decompression_nanoseconds += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+    return success;
   } else
     return false;
 }
 
+DecompressionStats CompressedTensorStream::GetStats() {
+  DecompressionStats stats;
+  stats.bytes = decompressed_bytes;
+  stats.seconds = (double)decompression_nanoseconds / 1e9;
+  return stats;
+}
+
+void CompressedTensorStream::ResetStats() {
+  decompressed_bytes = 0;
+  decompression_nanoseconds = 0;
+}
+
 }
 
 
@@ -53,6 +53,7 @@ void GradientTester::TestGradient ( NetGraph& graph, unsigned int skip_weights,
 	const datum old_param = param->data(e);
 	
 	param->data[e] = old_param + epsilon;
+	layer->OnParametersChanged();
 	graph.FeedForward();
 	const double plus_loss = graph.AggregateLoss();
 	
@@ -60,6 +61,7 @@ void GradientTester::TestGradient ( NetGraph& graph, unsigned int skip_weights,
 	param->data.MoveToCPU();
 #endif
 	param->data[e] = old_param - epsilon;
+	layer->OnParametersChanged();
 graph.FeedForward();
 	const double minus_loss = graph.AggregateLoss();
 	
@@ -88,6 +90,7 @@ graph.FeedForward();
 	param->data.MoveToCPU();
 #endif
 	param->data[e] = old_param;
+	layer->OnParametersChanged();
       }
       // std::cout << "\n";
       if(passed) {
@@ -139,6 +142,7 @@ graph.FeedForward();
 
     // Using central diff
     data.data_ptr()[w] = weight + epsilon;
+    layer->OnParametersChanged();
     layer->FeedForward();
     const Conv::datum forward_loss = CalculateLoss(layer,outputs);
 
@@ -146,6 +150,7 @@ graph.FeedForward();
     data.MoveToCPU();
 #endif
     data.data_ptr()[w] = weight - epsilon;
+    layer->OnParametersChanged();
     layer->FeedForward();
     const Conv::datum backward_loss = CalculateLoss(layer,outputs);
 
@@ -155,6 +160,7 @@ graph.FeedForward();
     data.MoveToCPU();
 #endif
     data.data_ptr()[w] = weight;
+    layer->OnParametersChanged();
 
     const Conv::datum ratio = fd_gradient / gradient;
     if(ratio > 1.2 || ratio < 0.8) {
@@ -8,12 +8,14 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstdlib>
 
 #include "Init.h"
 #include "CLHelper.h"
 #include "Config.h"
 #include "ConfigParsing.h"
 #include "Log.h"
+#include "TensorMathKernels.h"
 
 #include <locale.h>
 
@@ -98,6 +100,8 @@ void System::Init(int requested_log_level) {
   
   unsigned int platform_number = 0;
   unsigned int device_number = 0;
+  std::string cpu_isa = "";
+  unsigned int exact_math = 0;
   
   // Look for configuration file
   std::string config_path = binary_path + "config";
@@ -116,6 +120,8 @@ void System::Init(int requested_log_level) {
       
       ParseUIntIfPossible(line, "opencl_platform", platform_number);
       ParseUIntIfPossible(line, "opencl_device", device_number);
+      ParseStringIfPossible(line, "cpu_isa", cpu_isa);
+      ParseUIntIfPossible(line, "exact_math", exact_math);
     }
   } else {
 #ifdef BUILD_OPENCL
@@ -123,6 +129,18 @@ void System::Init(int requested_log_level) {
 #endif
   }
 
+  // The environment overrides the config file for quick A/B testing
+  const char* cpu_isa_env = std::getenv("CN24_CPU_ISA");
+  if(cpu_isa_env != nullptr)
+    cpu_isa = cpu_isa_env;
+
+  const char* exact_math_env = std::getenv("CN24_EXACT_MATH");
+  if(exact_math_env != nullptr)
+    exact_math = std::atoi(exact_math_env);
+
+  TensorMathKernels::Init(cpu_isa);
+  TensorMathKernels::SetExactMath(exact_math != 0);
+
   CLHelper::Init(platform_number, device_number);
 #ifdef BUILD_GUI
   if(!gtk_init_check ( nullptr, nullptr )) {
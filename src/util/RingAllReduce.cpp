@@ -0,0 +1,155 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <algorithm>
+#include <cstring>
+
+#include "Log.h"
+#include "RingAllReduce.h"
+
+namespace Conv {
+
+RingAllReduce::RingAllReduce(Transport& transport, const std::size_t bucket_elements) :
+  transport_(transport), bucket_elements_(bucket_elements) {
+  thread_ = std::thread(&RingAllReduce::Work, this);
+}
+
+RingAllReduce::~RingAllReduce() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  queued_.notify_all();
+  thread_.join();
+}
+
+void RingAllReduce::Sum(datum* data, const std::size_t elements) {
+  const unsigned int size = transport_.size();
+  const unsigned int rank = transport_.rank();
+  if (size == 1)
+    return;
+
+  // Chunk c is [begin(c), begin(c + 1))
+  auto begin = [elements, size](unsigned int chunk) -> std::size_t {
+    return elements * chunk / size;
+  };
+  auto length = [&begin](unsigned int chunk) -> std::size_t {
+    return begin(chunk + 1) - begin(chunk);
+  };
+  scratch_.resize(std::max<std::size_t>(scratch_.size(), length(0) + 1));
+
+  // Reduce-scatter, afterwards chunk rank + 1 is complete
+  for (unsigned int step = 0; step < size - 1; step++) {
+    const unsigned int send_chunk = (rank + size - step) % size;
+    const unsigned int receive_chunk = (rank + 2 * size - step - 1) % size;
+    transport_.SendReceive(data + begin(send_chunk), length(send_chunk) * sizeof(datum),
+                           scratch_.data(), length(receive_chunk) * sizeof(datum));
+    datum* target = data + begin(receive_chunk);
+    const std::size_t receive_length = length(receive_chunk);
+    for (std::size_t e = 0; e < receive_length; e++)
+      target[e] += scratch_[e];
+  }
+
+  // All-gather
+  for (unsigned int step = 0; step < size - 1; step++) {
+    const unsigned int send_chunk = (rank + 1 + size - step) % size;
+    const unsigned int receive_chunk = (rank + size - step) % size;
+    transport_.SendReceive(data + begin(send_chunk), length(send_chunk) * sizeof(datum),
+                           data + begin(receive_chunk), length(receive_chunk) * sizeof(datum));
+  }
+}
+
+void RingAllReduce::Enqueue(datum* data, const std::size_t elements) {
+  Buffer buffer;
+  buffer.data = data;
+  buffer.elements = elements;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(buffer);
+    pending_++;
+  }
+  queued_.notify_all();
+}
+
+void RingAllReduce::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  flushed_ = true;
+  queued_.notify_all();
+  done_.wait(lock, [this]() { return pending_ == 0 || exception_ != nullptr; });
+  flushed_ = false;
+  if (exception_ != nullptr) {
+    std::exception_ptr exception = exception_;
+    exception_ = nullptr;
+    std::rethrow_exception(exception);
+  }
+}
+
+/*
+ * A bucket is closed when it is big enough or when the caller waits for
+ * the last buffers. Both only depend on the order and the sizes of the
+ * buffers, so the buckets are the same on all ranks.
+ */
+void RingAllReduce::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    std::vector<Buffer> buffers;
+    std::size_t elements = 0;
+    while (true) {
+      queued_.wait(lock, [this]() { return shutdown_ || !queue_.empty() || flushed_; });
+      if (shutdown_)
+        return;
+      while (!queue_.empty() && elements < bucket_elements_) {
+        buffers.push_back(queue_.front());
+        elements += queue_.front().elements;
+        queue_.pop_front();
+      }
+      if (elements >= bucket_elements_ || (queue_.empty() && flushed_ && buffers.size() > 0))
+        break;
+      if (queue_.empty() && flushed_) {
+        // Everything is summed, wait for the next buffer
+        queued_.wait(lock, [this]() { return shutdown_ || !queue_.empty(); });
+        if (shutdown_)
+          return;
+      }
+    }
+    lock.unlock();
+
+    try {
+      if (buffers.size() == 1) {
+        Sum(buffers[0].data, buffers[0].elements);
+      } else {
+        bucket_.resize(elements);
+        std::size_t offset = 0;
+        for (const Buffer& buffer : buffers) {
+          std::memcpy(&bucket_[offset], buffer.data, buffer.elements * sizeof(datum));
+          offset += buffer.elements;
+        }
+        Sum(bucket_.data(), elements);
+        offset = 0;
+        for (const Buffer& buffer : buffers) {
+          std::memcpy(buffer.data, &bucket_[offset], buffer.elements * sizeof(datum));
+          offset += buffer.elements;
+        }
+      }
+    } catch (...) {
+      // The ring cannot be trusted anymore, drop everything that is queued
+      // so that Wait reports the error instead of waiting for the buffers
+      lock.lock();
+      exception_ = std::current_exception();
+      queue_.clear();
+      pending_ = 0;
+      done_.notify_all();
+      continue;
+    }
+
+    lock.lock();
+    pending_ -= buffers.size();
+    if (pending_ == 0)
+      done_.notify_all();
+  }
+}
+
+}
@@ -0,0 +1,202 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+#ifdef BUILD_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Config.h"
+#include "Log.h"
+#include "Transport.h"
+
+namespace Conv {
+
+/*
+ * A ring buffer with one writer and one reader. The positions count all
+ * bytes ever written and read, so the buffer is empty when they are equal
+ * and full when they are capacity apart. The receiving rank sets the magic
+ * number last, the sending rank waits for it before it uses the link.
+ */
+struct SharedMemoryTransport::Link {
+  std::atomic<std::uint64_t> magic;
+  std::atomic<std::uint64_t> written;
+  std::atomic<std::uint64_t> read;
+  std::uint64_t capacity;
+  char data[1];
+};
+
+static const std::uint64_t link_magic = 0x43453234524e4731ULL;
+
+static std::string SegmentName(const std::string& name, unsigned int rank) {
+  std::stringstream ss;
+  ss << "/" << name << "-" << rank;
+  return ss.str();
+}
+
+#ifdef BUILD_POSIX
+SharedMemoryTransport::SharedMemoryTransport(const std::string& name, const unsigned int rank,
+    const unsigned int size, const std::size_t capacity) :
+  Transport(rank, size), capacity_(capacity) {
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory needs lock-free atomics");
+  if (size_ == 1)
+    return;
+
+  // Create the incoming link
+  receive_name_ = SegmentName(name, rank_);
+  shm_unlink(receive_name_.c_str());
+  int receive_fd = shm_open(receive_name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (receive_fd < 0)
+    FATAL("Cannot create shared memory segment " << receive_name_ << ": " << std::strerror(errno));
+  receive_link_ = Map(receive_fd, true);
+  close(receive_fd);
+
+  // Open the outgoing link once the next rank has created it
+  const std::string send_name = SegmentName(name, next());
+  const std::size_t link_size = offsetof(Link, data) + capacity_;
+  while (true) {
+    int send_fd = shm_open(send_name.c_str(), O_RDWR, 0600);
+    if (send_fd >= 0) {
+      struct stat segment_stat;
+      if (fstat(send_fd, &segment_stat) == 0 && (std::size_t)segment_stat.st_size >= link_size) {
+        send_link_ = Map(send_fd, false);
+        close(send_fd);
+        if (send_link_->magic.load(std::memory_order_acquire) == link_magic) {
+          // Both ranks have the segment mapped now, it does not need a name
+          shm_unlink(send_name.c_str());
+          break;
+        }
+        munmap(send_link_, link_size);
+        send_link_ = nullptr;
+      } else {
+        close(send_fd);
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  LOGDEBUG << "Rank " << rank_ << " connected to rank " << next() << " through " << send_name;
+}
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+  const std::size_t link_size = offsetof(Link, data) + capacity_;
+  if (send_link_ != nullptr)
+    munmap(send_link_, link_size);
+  if (receive_link_ != nullptr) {
+    munmap(receive_link_, link_size);
+    shm_unlink(receive_name_.c_str());
+  }
+}
+
+SharedMemoryTransport::Link* SharedMemoryTransport::Map(int fd, bool create) {
+  const std::size_t link_size = offsetof(Link, data) + capacity_;
+  if (create && ftruncate(fd, link_size) != 0)
+    FATAL("Cannot resize shared memory segment: " << std::strerror(errno));
+
+  void* address = mmap(nullptr, link_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (address == MAP_FAILED)
+    FATAL("Cannot map shared memory segment: " << std::strerror(errno));
+
+  Link* link = (Link*)address;
+  if (create) {
+    // The segment is zero-filled, so the magic number is still unset
+    link->written.store(0, std::memory_order_relaxed);
+    link->read.store(0, std::memory_order_relaxed);
+    link->capacity = capacity_;
+    link->magic.store(link_magic, std::memory_order_release);
+  }
+  return link;
+}
+
+std::size_t SharedMemoryTransport::TrySend(const void* data, std::size_t bytes) {
+  const std::uint64_t written = send_link_->written.load(std::memory_order_relaxed);
+  const std::uint64_t read = send_link_->read.load(std::memory_order_acquire);
+  bytes = std::min<std::size_t>(bytes, capacity_ - (std::size_t)(written - read));
+
+  // Copy in up to two parts around the end of the buffer
+  const std::size_t offset = (std::size_t)(written % capacity_);
+  const std::size_t first_part = std::min(bytes, capacity_ - offset);
+  std::memcpy(send_link_->data + offset, data, first_part);
+  std::memcpy(send_link_->data, (const char*)data + first_part, bytes - first_part);
+
+  send_link_->written.store(written + bytes, std::memory_order_release);
+  if (bytes > 0)
+    idle_waits_ = 0;
+  return bytes;
+}
+
+std::size_t SharedMemoryTransport::TryReceive(void* data, std::size_t bytes) {
+  const std::uint64_t read = receive_link_->read.load(std::memory_order_relaxed);
+  const std::uint64_t written = receive_link_->written.load(std::memory_order_acquire);
+  bytes = std::min<std::size_t>(bytes, (std::size_t)(written - read));
+
+  const std::size_t offset = (std::size_t)(read % capacity_);
+  const std::size_t first_part = std::min(bytes, capacity_ - offset);
+  std::memcpy(data, receive_link_->data + offset, first_part);
+  std::memcpy((char*)data + first_part, receive_link_->data, bytes - first_part);
+
+  receive_link_->read.store(read + bytes, std::memory_order_release);
+  if (bytes > 0)
+    idle_waits_ = 0;
+  return bytes;
+}
+
+void SharedMemoryTransport::Wait(bool sending, bool receiving) {
+  UNREFERENCED_PARAMETER(sending);
+  UNREFERENCED_PARAMETER(receiving);
+  // Spin briefly, the other side is usually about to make progress
+  if (idle_waits_++ < 64)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+#else
+SharedMemoryTransport::SharedMemoryTransport(const std::string& name, const unsigned int rank,
+    const unsigned int size, const std::size_t capacity) :
+  Transport(rank, size), capacity_(capacity) {
+  UNREFERENCED_PARAMETER(name);
+  FATAL("Shared memory transport needs a POSIX system!");
+}
+
+SharedMemoryTransport::~SharedMemoryTransport() {}
+
+SharedMemoryTransport::Link* SharedMemoryTransport::Map(int fd, bool create) {
+  UNREFERENCED_PARAMETER(fd);
+  UNREFERENCED_PARAMETER(create);
+  return nullptr;
+}
+
+std::size_t SharedMemoryTransport::TrySend(const void* data, std::size_t bytes) {
+  UNREFERENCED_PARAMETER(data);
+  UNREFERENCED_PARAMETER(bytes);
+  return 0;
+}
+
+std::size_t SharedMemoryTransport::TryReceive(void* data, std::size_t bytes) {
+  UNREFERENCED_PARAMETER(data);
+  UNREFERENCED_PARAMETER(bytes);
+  return 0;
+}
+
+void SharedMemoryTransport::Wait(bool sending, bool receiving) {
+  UNREFERENCED_PARAMETER(sending);
+  UNREFERENCED_PARAMETER(receiving);
+}
+#endif
+
+}
@@ -0,0 +1,156 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <chrono>
+
+#ifdef BUILD_POSIX
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Config.h"
+#include "Log.h"
+#include "Transport.h"
+
+namespace Conv {
+
+#ifdef BUILD_POSIX
+static sockaddr_in LoopbackAddress(unsigned int port) {
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons((uint16_t)port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return address;
+}
+
+static void Configure(int socket_fd) {
+  const int enable = 1;
+  setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
+}
+
+TCPTransport::TCPTransport(const unsigned int port, const unsigned int rank, const unsigned int size) :
+  Transport(rank, size) {
+  if (size_ == 1)
+    return;
+
+  // Listen for the previous rank
+  int listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_socket < 0)
+    FATAL("Cannot create socket: " << std::strerror(errno));
+  const int enable = 1;
+  setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  sockaddr_in listen_address = LoopbackAddress(port + rank_);
+  if (bind(listen_socket, (sockaddr*)&listen_address, sizeof(listen_address)) != 0)
+    FATAL("Cannot bind to port " << port + rank_ << ": " << std::strerror(errno));
+  if (listen(listen_socket, 1) != 0)
+    FATAL("Cannot listen on port " << port + rank_ << ": " << std::strerror(errno));
+
+  // Connect to the next rank, which may not be listening yet
+  const sockaddr_in send_address = LoopbackAddress(port + next());
+  while (true) {
+    send_socket_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (send_socket_ < 0)
+      FATAL("Cannot create socket: " << std::strerror(errno));
+    if (connect(send_socket_, (const sockaddr*)&send_address, sizeof(send_address)) == 0)
+      break;
+    close(send_socket_);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  receive_socket_ = accept(listen_socket, nullptr, nullptr);
+  if (receive_socket_ < 0)
+    FATAL("Cannot accept connection on port " << port + rank_ << ": " << std::strerror(errno));
+  close(listen_socket);
+
+  Configure(send_socket_);
+  Configure(receive_socket_);
+  LOGDEBUG << "Rank " << rank_ << " connected to port " << port + next();
+}
+
+TCPTransport::~TCPTransport() {
+  if (send_socket_ >= 0)
+    close(send_socket_);
+  if (receive_socket_ >= 0)
+    close(receive_socket_);
+}
+
+std::size_t TCPTransport::TrySend(const void* data, std::size_t bytes) {
+  const ssize_t sent = send(send_socket_, data, bytes, MSG_NOSIGNAL);
+  if (sent < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return 0;
+    FATAL("Cannot send to rank " << next() << ": " << std::strerror(errno));
+  }
+  return (std::size_t)sent;
+}
+
+std::size_t TCPTransport::TryReceive(void* data, std::size_t bytes) {
+  const ssize_t received = recv(receive_socket_, data, bytes, 0);
+  if (received < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return 0;
+    FATAL("Cannot receive from rank " << previous() << ": " << std::strerror(errno));
+  }
+  if (received == 0)
+    FATAL("Rank " << previous() << " closed the connection");
+  return (std::size_t)received;
+}
+
+void TCPTransport::Wait(bool sending, bool receiving) {
+  pollfd sockets[2];
+  nfds_t count = 0;
+  if (sending) {
+    sockets[count].fd = send_socket_;
+    sockets[count].events = POLLOUT;
+    sockets[count].revents = 0;
+    count++;
+  }
+  if (receiving) {
+    sockets[count].fd = receive_socket_;
+    sockets[count].events = POLLIN;
+    sockets[count].revents = 0;
+    count++;
+  }
+  poll(sockets, count, -1);
+}
+#else
+TCPTransport::TCPTransport(const unsigned int port, const unsigned int rank, const unsigned int size) :
+  Transport(rank, size) {
+  UNREFERENCED_PARAMETER(port);
+  FATAL("TCP transport needs a POSIX system!");
+}
+
+TCPTransport::~TCPTransport() {}
+
+std::size_t TCPTransport::TrySend(const void* data, std::size_t bytes) {
+  UNREFERENCED_PARAMETER(data);
+  UNREFERENCED_PARAMETER(bytes);
+  return 0;
+}
+
+std::size_t TCPTransport::TryReceive(void* data, std::size_t bytes) {
+  UNREFERENCED_PARAMETER(data);
+  UNREFERENCED_PARAMETER(bytes);
+  return 0;
+}
+
+void TCPTransport::Wait(bool sending, bool receiving) {
+  UNREFERENCED_PARAMETER(sending);
+  UNREFERENCED_PARAMETER(receiving);
+}
+#endif
+
+}
@@ -23,14 +23,12 @@
 #include "PNGUtil.h"
 #include "JPGUtil.h"
 
-#ifdef BLAS_MKL
-#include <mkl_service.h>
-#endif
-
 #include "Config.h"
 #include "Log.h"
 #include "Tensor.h"
+#include "TensorAllocator.h"
 #include "CLHelper.h"
+#include "TensorMathKernels.h"
 
 namespace Conv {
 
@@ -55,7 +53,12 @@ Tensor::Tensor ( const Tensor& tensor, bool intentional ) {
   std::size_t bytes_to_copy = tensor.elements() * sizeof ( datum );
 
   // Copy
-  std::memcpy ( target_data, source_data, bytes_to_copy );
+  if ( tensor.packed_ptr_ != nullptr ) {
+    TensorMathKernels::Get().unpack_half ( tensor.packed_ptr_, target_data,
+      tensor.elements(), tensor.packed_precision_ == PRECISION_BF16 );
+  } else {
+    std::memcpy ( target_data, source_data, bytes_to_copy );
+  }
 
   if ( !intentional ) {
     LOGDEBUG << "Tensor copied! Is this intentional?";
@@ -73,8 +76,11 @@ Tensor::Tensor ( Tensor && tensor ) {
   width_ = tensor.width_;
   height_ = tensor.height_;
   elements_ = tensor.elements_;
+  packed_ptr_ = tensor.packed_ptr_;
+  packed_precision_ = tensor.packed_precision_;
 
   tensor.data_ptr_ = nullptr;
+  tensor.packed_ptr_ = nullptr;
   tensor.DeleteIfPossible();
 }
 
@@ -89,6 +95,7 @@ Tensor::~Tensor() {
 }
 
 void Tensor::Clear ( const datum value, const int sample ) {
+  Unpack ( sample == -1 );
 #ifdef BUILD_OPENCL
   if ( sample == -1 ) {
     MoveToCPU(true);
@@ -128,6 +135,31 @@ void Tensor::Shadow ( Tensor& tensor ) {
 #endif
 }
 
+void Tensor::Shadow ( Tensor& tensor, const std::size_t offset,
+                      const std::size_t samples, const std::size_t width,
+                      const std::size_t height, const std::size_t maps ) {
+#ifdef BUILD_OPENCL
+  // OpenCL buffers cannot be shadowed in parts
+  FATAL ( "Partial shadows are not supported with OpenCL" );
+#endif
+  const std::size_t elements = samples * width * height * maps;
+  if ( offset + elements > tensor.elements_ )
+    FATAL ( "Shadowed part exceeds the Tensor: " << offset << " + " << elements
+      << " > " << tensor.elements_ );
+
+  DeleteIfPossible();
+
+  data_ptr_ = tensor.data_ptr_ + offset;
+  samples_ = samples;
+  maps_ = maps;
+  width_ = width;
+  height_ = height;
+  elements_ = elements;
+
+  is_shadow_ = true;
+  shadow_target_ = &tensor;
+}
+
 
 void Tensor::Resize ( const std::size_t samples, const std::size_t width,
                       const std::size_t height, const std::size_t maps, datum* const preallocated_memory, bool mmapped, bool dont_delete) {
@@ -151,11 +183,7 @@ void Tensor::Resize ( const std::size_t samples, const std::size_t width,
     mmapped_ = mmapped;
   } else {
     // Allocate
-#ifdef BLAS_MKL
-    data_ptr_ = ( datum* ) MKL_malloc ( elements * sizeof ( datum ) / sizeof ( char ), 32 );
-#else
-    data_ptr_ = new datum[elements];
-#endif
+    data_ptr_ = ( datum* ) TensorAllocator::Allocate ( elements * sizeof ( datum ) );
   }
 
   // Save configuration
@@ -218,6 +246,7 @@ void Tensor::Transpose() {
 
 
 void Tensor::Serialize ( std::ostream& output, bool convert ) {
+  Unpack();
 #ifdef BUILD_OPENCL
   MoveToCPU();
 #endif
@@ -402,14 +431,14 @@ void Tensor::DeleteIfPossible() {
         mmapped_ = false;
       } else {
 #endif
-#ifdef BLAS_MKL
-        mkl_free ( data_ptr_ );
-#else
-        delete[] data_ptr_;
-#endif
+        TensorAllocator::Free ( data_ptr_, elements_ * sizeof ( datum ) );
 #ifdef BUILD_POSIX
       }
 #endif
+      if ( packed_ptr_ != nullptr ) {
+        TensorAllocator::Free ( packed_ptr_, elements_ * sizeof ( std::uint16_t ) );
+        packed_ptr_ = nullptr;
+      }
 #ifdef BUILD_OPENCL
       if ( cl_data_ptr_ != 0 ) {
         clReleaseMemObject ( (cl_mem)cl_data_ptr_ );
@@ -532,6 +561,74 @@ void Tensor::MoveToCPU ( bool no_copy ) {
 
 #endif
 
+void Tensor::Pack ( const TensorPrecision precision ) {
+  if ( is_shadow_ ) {
+    shadow_target_->Pack ( precision );
+    return;
+  }
+
+  if ( precision == PRECISION_FP32 || packed_ptr_ != nullptr
+      || data_ptr_ == nullptr || mmapped_ )
+    return;
+
+#ifdef BUILD_OPENCL
+  MoveToCPU();
+#endif
+
+  packed_ptr_ = ( std::uint16_t* ) TensorAllocator::Allocate ( elements_ * sizeof ( std::uint16_t ) );
+  packed_precision_ = precision;
+  TensorMathKernels::Get().pack_half ( data_ptr_, packed_ptr_, elements_,
+    precision == PRECISION_BF16 );
+
+  ReleasePages ( data_ptr_, elements_ );
+}
+
+void Tensor::Discard() {
+  if ( data_ptr_ == nullptr || mmapped_ )
+    return;
+
+#ifdef BUILD_OPENCL
+  MoveToCPU ( true );
+#endif
+
+  // A packed copy is as outdated as the data
+  Unpack ( true );
+  ReleasePages ( data_ptr_, elements_ );
+}
+
+void Tensor::ReleasePages ( datum* data, const std::size_t elements ) {
+#ifdef BUILD_POSIX
+  // Release the pages that lie completely inside the data. They read as
+  // zero when touched again, shadows keep their pointers.
+  const std::uintptr_t page_size = sysconf ( _SC_PAGESIZE );
+  const std::uintptr_t begin = ( ( std::uintptr_t ) data + page_size - 1 ) & ~ ( page_size - 1 );
+  const std::uintptr_t end = ( ( std::uintptr_t ) ( data + elements ) ) & ~ ( page_size - 1 );
+  if ( end > begin )
+    madvise ( ( void* ) begin, end - begin, MADV_DONTNEED );
+#else
+  UNREFERENCED_PARAMETER ( data );
+  UNREFERENCED_PARAMETER ( elements );
+#endif
+}
+
+void Tensor::Unpack ( bool no_copy ) {
+  if ( is_shadow_ ) {
+    shadow_target_->Unpack ( no_copy );
+    return;
+  }
+
+  if ( packed_ptr_ == nullptr )
+    return;
+
+  if ( !no_copy ) {
+    TensorMathKernels::Get().unpack_half ( packed_ptr_, data_ptr_, elements_,
+      packed_precision_ == PRECISION_BF16 );
+  }
+
+  TensorAllocator::Free ( packed_ptr_, elements_ * sizeof ( std::uint16_t ) );
+  packed_ptr_ = nullptr;
+}
+
 std::size_t Tensor::Maximum ( std::size_t sample ) {
   datum max_y = std::numeric_limits<datum>::lowest();
   std::size_t max_x = 0;
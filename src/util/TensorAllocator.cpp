@@ -0,0 +1,314 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#ifdef BUILD_POSIX
+#include <sys/mman.h>
+#endif
+
+#ifdef BUILD_WIN32
+#include <malloc.h>
+#endif
+
+#include "Config.h"
+#include "Log.h"
+#include "TensorAllocator.h"
+
+namespace Conv {
+
+namespace {
+
+// Size classes: multiples of the alignment up to 1 KiB, then four classes
+// per power of two up to 256 MiB. Larger blocks are not pooled.
+const std::size_t small_limit = 1024;
+const int small_classes = small_limit / CN24_TENSOR_ALIGNMENT;
+const int first_exponent = 10;
+const int last_exponent = 27;
+const int size_classes = small_classes + (last_exponent - first_exponent + 1) * 4;
+
+// Blocks from this size on are mapped directly
+const std::size_t mapped_limit = 2 << 20;
+
+// Bytes a thread cache and the shared pool hold at most
+const std::size_t thread_cache_limit = 64 << 20;
+const std::size_t shared_pool_limit = 512 << 20;
+
+std::size_t ClassBytes(const int size_class) {
+  if(size_class < small_classes)
+    return (std::size_t)(size_class + 1) * CN24_TENSOR_ALIGNMENT;
+  const int e = first_exponent + (size_class - small_classes) / 4;
+  const std::size_t steps = (size_class - small_classes) % 4 + 1;
+  return ((std::size_t)1 << e) + (steps << (e - 2));
+}
+
+/*
+ * Returns the size class of a request and its size in bytes, or -1 and
+ * the request rounded up to the alignment if it is too large.
+ */
+int SizeClass(const std::size_t bytes, std::size_t& class_bytes) {
+  const std::size_t aligned = (bytes + CN24_TENSOR_ALIGNMENT - 1) & ~(std::size_t)(CN24_TENSOR_ALIGNMENT - 1);
+  if(aligned <= small_limit) {
+    class_bytes = aligned;
+    return (int)(aligned / CN24_TENSOR_ALIGNMENT) - 1;
+  }
+
+  // 2^e < aligned <= 2^(e+1), in steps of 2^(e-2)
+  int e = first_exponent;
+  while(((std::size_t)2 << e) < aligned)
+    e++;
+  if(e > last_exponent) {
+    class_bytes = aligned;
+    return -1;
+  }
+  const std::size_t step = (std::size_t)1 << (e - 2);
+  const int size_class = small_classes + (e - first_exponent) * 4 +
+    (int)((aligned - ((std::size_t)1 << e) + step - 1) / step) - 1;
+  class_bytes = ClassBytes(size_class);
+  return size_class;
+}
+
+std::atomic<std::size_t> bytes_live(0);
+std::atomic<std::size_t> bytes_peak(0);
+std::atomic<std::size_t> bytes_cached(0);
+std::atomic<unsigned long> allocations(0);
+std::atomic<unsigned long> system_allocations(0);
+std::atomic<bool> huge_pages(false);
+std::atomic<bool> pooling(true);
+std::atomic<std::chrono::steady_clock::rep> stats_start(std::chrono::steady_clock::now().time_since_epoch().count());
+
+void* SystemAllocate(const std::size_t class_bytes) {
+  void* block = nullptr;
+#ifdef BUILD_POSIX
+  if(class_bytes >= mapped_limit) {
+    if(!huge_pages) {
+      block = mmap(nullptr, class_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      return block == MAP_FAILED ? nullptr : block;
+    }
+
+    // Huge pages need 2 MiB alignment, map more and cut off the ends
+    const std::size_t mapped_bytes = class_bytes + mapped_limit;
+    void* mapping = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapping == MAP_FAILED)
+      return nullptr;
+    const std::uintptr_t begin = (std::uintptr_t)mapping;
+    const std::uintptr_t aligned = (begin + mapped_limit - 1) & ~(std::uintptr_t)(mapped_limit - 1);
+    if(aligned > begin)
+      munmap(mapping, aligned - begin);
+    if(begin + mapped_bytes > aligned + class_bytes)
+      munmap((void*)(aligned + class_bytes), begin + mapped_bytes - aligned - class_bytes);
+    block = (void*)aligned;
+#ifdef BUILD_LINUX
+    madvise(block, class_bytes, MADV_HUGEPAGE);
+#endif
+    return block;
+  }
+  if(posix_memalign(&block, CN24_TENSOR_ALIGNMENT, class_bytes) != 0)
+    return nullptr;
+#elif defined(BUILD_WIN32)
+  block = _aligned_malloc(class_bytes, CN24_TENSOR_ALIGNMENT);
+#else
+  block = std::malloc(class_bytes);
+#endif
+  return block;
+}
+
+void SystemFree(void* block, const std::size_t class_bytes) {
+#ifdef BUILD_POSIX
+  if(class_bytes >= mapped_limit) {
+    munmap(block, class_bytes);
+    return;
+  }
+  std::free(block);
+#elif defined(BUILD_WIN32)
+  UNREFERENCED_PARAMETER(class_bytes);
+  _aligned_free(block);
+#else
+  UNREFERENCED_PARAMETER(class_bytes);
+  std::free(block);
+#endif
+}
+
+struct FreeLists {
+  std::vector<void*> blocks[size_classes];
+  std::size_t bytes = 0;
+
+  void* Take(const int size_class, const std::size_t class_bytes) {
+    if(blocks[size_class].empty())
+      return nullptr;
+    void* block = blocks[size_class].back();
+    blocks[size_class].pop_back();
+    bytes -= class_bytes;
+    return block;
+  }
+
+  void Put(const int size_class, const std::size_t class_bytes, void* block) {
+    blocks[size_class].push_back(block);
+    bytes += class_bytes;
+  }
+
+  void Release() {
+    for(int c = 0; c < size_classes; c++) {
+      for(void* block : blocks[c])
+        SystemFree(block, ClassBytes(c));
+      bytes_cached -= blocks[c].size() * ClassBytes(c);
+      blocks[c].clear();
+    }
+    bytes = 0;
+  }
+};
+
+// The shared pool lives until the process ends, Tensors with static storage
+// duration may still free blocks after everything else is gone
+std::mutex& SharedPoolMutex() {
+  static std::mutex* mutex = new std::mutex;
+  return *mutex;
+}
+
+FreeLists& SharedPool() {
+  static FreeLists* pool = new FreeLists;
+  return *pool;
+}
+
+// 0 before the cache of this thread exists, 1 while it does, 2 afterwards
+thread_local int thread_cache_state = 0;
+
+// Hands its blocks to the shared pool when the thread ends
+struct ThreadCache {
+  FreeLists lists;
+  ThreadCache() { thread_cache_state = 1; }
+  ~ThreadCache() {
+    thread_cache_state = 2;
+    std::lock_guard<std::mutex> lock(SharedPoolMutex());
+    for(int c = 0; c < size_classes; c++) {
+      for(void* block : lists.blocks[c])
+        SharedPool().blocks[c].push_back(block);
+    }
+    SharedPool().bytes += lists.bytes;
+  }
+};
+
+FreeLists* GetThreadCache() {
+  thread_local ThreadCache cache;
+  return thread_cache_state == 1 ? &cache.lists : nullptr;
+}
+
+}
+
+void* TensorAllocator::Allocate(const std::size_t bytes) {
+  if(bytes == 0)
+    return nullptr;
+
+  std::size_t class_bytes;
+  const int size_class = SizeClass(bytes, class_bytes);
+  allocations++;
+
+  void* block = nullptr;
+  if(size_class >= 0) {
+    FreeLists* cache = thread_cache_state != 2 ? GetThreadCache() : nullptr;
+    if(cache != nullptr)
+      block = cache->Take(size_class, class_bytes);
+    if(block == nullptr) {
+      std::lock_guard<std::mutex> lock(SharedPoolMutex());
+      block = SharedPool().Take(size_class, class_bytes);
+    }
+    if(block != nullptr)
+      bytes_cached -= class_bytes;
+  }
+
+  if(block == nullptr) {
+    block = SystemAllocate(class_bytes);
+    system_allocations++;
+    if(block == nullptr) {
+      // Cached blocks of other sizes may be in the way
+      Trim();
+      block = SystemAllocate(class_bytes);
+      if(block == nullptr)
+        FATAL("Cannot allocate " << class_bytes << " bytes");
+    }
+  }
+
+  const std::size_t live = bytes_live += class_bytes;
+  std::size_t peak = bytes_peak;
+  while(live > peak && !bytes_peak.compare_exchange_weak(peak, live)) {}
+  return block;
+}
+
+void TensorAllocator::Free(void* block, const std::size_t bytes) {
+  if(block == nullptr)
+    return;
+
+  std::size_t class_bytes;
+  const int size_class = SizeClass(bytes, class_bytes);
+  bytes_live -= class_bytes;
+
+  if(size_class >= 0 && pooling) {
+    FreeLists* cache = thread_cache_state != 2 ? GetThreadCache() : nullptr;
+    if(cache != nullptr && cache->bytes + class_bytes <= thread_cache_limit) {
+      cache->Put(size_class, class_bytes, block);
+      bytes_cached += class_bytes;
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(SharedPoolMutex());
+    if(SharedPool().bytes + class_bytes <= shared_pool_limit) {
+      SharedPool().Put(size_class, class_bytes, block);
+      bytes_cached += class_bytes;
+      return;
+    }
+  }
+
+  SystemFree(block, class_bytes);
+}
+
+void TensorAllocator::SetHugePagesEnabled(const bool enabled) {
+#ifndef BUILD_LINUX
+  if(enabled)
+    LOGWARN << "Huge pages are only supported on Linux";
+#endif
+  huge_pages = enabled;
+}
+
+void TensorAllocator::SetPoolingEnabled(const bool enabled) {
+  pooling = enabled;
+  if(!enabled)
+    Trim();
+}
+
+void TensorAllocator::Trim() {
+  FreeLists* cache = thread_cache_state != 2 ? GetThreadCache() : nullptr;
+  if(cache != nullptr)
+    cache->Release();
+  std::lock_guard<std::mutex> lock(SharedPoolMutex());
+  SharedPool().Release();
+}
+
+TensorAllocatorStats TensorAllocator::GetStats() {
+  TensorAllocatorStats stats;
+  stats.bytes_live = bytes_live;
+  stats.bytes_peak = bytes_peak;
+  stats.bytes_cached = bytes_cached;
+  stats.allocations = allocations;
+  stats.system_allocations = system_allocations;
+  const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now().time_since_epoch() -
+    std::chrono::steady_clock::duration(stats_start);
+  stats.seconds = std::chrono::duration<double>(elapsed).count();
+  return stats;
+}
+
+void TensorAllocator::ResetStats() {
+  allocations = 0;
+  system_allocations = 0;
+  bytes_peak = (std::size_t)bytes_live;
+  stats_start = std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+}
@@ -18,6 +18,7 @@
 #include "TensorStream.h"
 #include "FloatTensorStream.h"
 #include "CompressedTensorStream.h"
+#include "ByteTensorStream.h"
 #include "ListTensorStream.h"
 
 #ifdef BUILD_BOOST
@@ -50,11 +51,16 @@ TensorStream* TensorStream::FromFile(std::string path, std::vector<unsigned int>
   input_stream.read((char*)&magic, sizeof(uint64_t)/sizeof(char));
   input_stream.close();
   
-  if(magic == CN24_CTS_MAGIC) {
+  if(magic == CN24_CTS_MAGIC || magic == CN24_CTS2_MAGIC) {
     LOGDEBUG << "Is compressed tensor, loading...";
     CompressedTensorStream* cts = new CompressedTensorStream();
     cts->LoadFile(path);
     return cts;
+  } else if(magic == CN24_BTS_MAGIC) {
+    LOGDEBUG << "Is byte tensor, loading...";
+    ByteTensorStream* bts = new ByteTensorStream();
+    bts->LoadFile(path);
+    return bts;
   } else {
     LOGDEBUG << "Is float tensor, loading...";
     FloatTensorStream* fts = new FloatTensorStream();
@@ -63,4 +69,29 @@ TensorStream* TensorStream::FromFile(std::string path, std::vector<unsigned int>
   }
 }
 
+bool TensorStream::CopySamples(const std::vector<unsigned int>& sources, Tensor& target,
+                               const std::size_t first_target_sample) {
+  bool success = true;
+  if(IsThreadSafe()) {
+#ifdef BUILD_OPENCL
+    target.MoveToCPU();
+#endif
+    #pragma omp parallel for default(shared) reduction(&&:success)
+    for(long s = 0; s < (long)sources.size(); s++) {
+      success = CopySample(sources[s], 0, target, first_target_sample + s) && success;
+    }
+  } else {
+    for(std::size_t s = 0; s < sources.size(); s++)
+      success &= CopySample(sources[s], 0, target, first_target_sample + s);
+  }
+  return success;
+}
+
+Tensor& TensorStream::Scratch(const std::size_t samples, const std::size_t width,
+                              const std::size_t height, const std::size_t maps) {
+  static thread_local Tensor scratch;
+  scratch.Resize(samples, width, height, maps);
+  return scratch;
+}
+
 }
\ No newline at end of file
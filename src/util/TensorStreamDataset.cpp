@@ -193,48 +193,16 @@ bool TensorStreamDataset::SupportsTesting() const {
   return tensor_count_testing_ > 0;
 }
 
+bool TensorStreamDataset::SupportsConcurrentReads() const {
+  return training_stream_->IsThreadSafe() && testing_stream_->IsThreadSafe();
+}
+
 bool TensorStreamDataset::GetTrainingSample (Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index) {
   if (index < tensor_count_training_ / 2) {
     bool success = true;
     success &= training_stream_->CopySample(2 * index, 0, data_tensor, sample);
     success &= training_stream_->CopySample(2 * index + 1, 0, label_tensor, sample);
-
-    unsigned int data_width = training_stream_->GetWidth(2 * index);
-    unsigned int data_height = training_stream_->GetHeight(2 * index);
-    
-		// Write spatial prior data to helper tensor
-		for (unsigned int y = 0; y < data_height; y++) {
-			for (unsigned int x = 0; x < data_width; x++) {
-				*helper_tensor.data_ptr(x, y, 0, sample) = ((datum)x) / ((datum)data_width - 1);
-				*helper_tensor.data_ptr(x, y, 1, sample) = ((datum)y) / ((datum)data_height - 1);
-			}
-			for (unsigned int x = data_width; x < GetWidth(); x++) {
-				*helper_tensor.data_ptr(x, y, 0, sample) = 0;
-				*helper_tensor.data_ptr(x, y, 1, sample) = 0;
-			}
-		}
-		for (unsigned int y = data_height; y < GetHeight(); y++) {
-			for (unsigned int x = 0; x < GetWidth(); x++) {
-				*helper_tensor.data_ptr(x, y, 0, sample) = 0;
-				*helper_tensor.data_ptr(x, y, 1, sample) = 0;
-			}
-		}
-
-    //if (data_width == GetWidth() && data_height == GetHeight()) {
-    //  success &= Tensor::CopySample (error_cache, 0, weight_tensor, sample);
-    //} else {
-      // Reevaluate error function
-      weight_tensor.Clear (0.0, sample);
-
-      #pragma omp parallel for default(shared)
-      for (unsigned int y = 0; y < data_height; y++) {
-        for (unsigned int x = 0; x < data_width; x++) {
-					const datum class_weight = class_weights_[label_tensor.PixelMaximum(x, y, sample)];
-          *weight_tensor.data_ptr (x, y, 0, sample) = error_function_ (x, y, data_width, data_height) * class_weight;
-        }
-      }
-    //}
-
+    WriteHelperAndWeight(training_stream_, label_tensor, helper_tensor, weight_tensor, sample, index);
     return success;
   } else return false;
 }
@@ -244,10 +212,40 @@ bool TensorStreamDataset::GetTestingSample (Tensor& data_tensor, Tensor& label_t
     bool success = true;
     success &= testing_stream_->CopySample(2 * index, 0, data_tensor, sample);
     success &= testing_stream_->CopySample(2 * index + 1, 0, label_tensor, sample);
-    
-    unsigned int data_width = testing_stream_->GetWidth(2 * index);
-    unsigned int data_height = testing_stream_->GetHeight(2 * index);
+    WriteHelperAndWeight(testing_stream_, label_tensor, helper_tensor, weight_tensor, sample, index);
+    return success;
+  } else return false;
+}
+
+bool TensorStreamDataset::GetTrainingBatch (Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, const std::vector<unsigned int>& indices, unsigned int first_sample) {
+  return GetBatch(training_stream_, tensor_count_training_, data_tensor, label_tensor, helper_tensor, weight_tensor, indices, first_sample);
+}
+
+bool TensorStreamDataset::GetTestingBatch (Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, const std::vector<unsigned int>& indices, unsigned int first_sample) {
+  return GetBatch(testing_stream_, tensor_count_testing_, data_tensor, label_tensor, helper_tensor, weight_tensor, indices, first_sample);
+}
+
+bool TensorStreamDataset::GetBatch (TensorStream* stream, unsigned int tensor_count, Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, const std::vector<unsigned int>& indices, unsigned int first_sample) {
+  std::vector<unsigned int> data_sources, label_sources;
+  for (unsigned int index : indices) {
+    if (index >= tensor_count / 2)
+      return false;
+    data_sources.push_back(2 * index);
+    label_sources.push_back(2 * index + 1);
+  }
 
+  bool success = true;
+  success &= stream->CopySamples(data_sources, data_tensor, first_sample);
+  success &= stream->CopySamples(label_sources, label_tensor, first_sample);
+  for (unsigned int s = 0; s < indices.size(); s++)
+    WriteHelperAndWeight(stream, label_tensor, helper_tensor, weight_tensor, first_sample + s, indices[s]);
+  return success;
+}
+
+void TensorStreamDataset::WriteHelperAndWeight (TensorStream* stream, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index) {
+    unsigned int data_width = stream->GetWidth(2 * index);
+    unsigned int data_height = stream->GetHeight(2 * index);
+    
 		// Write spatial prior data to helper tensor
 		for (unsigned int y = 0; y < data_height; y++) {
 			for (unsigned int x = 0; x < data_width; x++) {
@@ -280,9 +278,6 @@ bool TensorStreamDataset::GetTestingSample (Tensor& data_tensor, Tensor& label_t
         }
       }
     //}
-
-    return success;
-  } else return false;
 }
 
 TensorStreamDataset* TensorStreamDataset::CreateFromConfiguration (std::istream& file , bool dont_load, DatasetLoadSelection selection) {
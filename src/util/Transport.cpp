@@ -0,0 +1,52 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include "Log.h"
+#include "Transport.h"
+
+namespace Conv {
+
+Transport::Transport(const unsigned int rank, const unsigned int size) :
+  rank_(rank), size_(size) {
+  if (size_ == 0 || rank_ >= size_)
+    FATAL("Invalid rank " << rank_ << " of " << size_);
+}
+
+Transport* Transport::Create(TransportType type, const std::string& name,
+                             unsigned int port, unsigned int rank, unsigned int size) {
+  switch (type) {
+    case TRANSPORT_SHM:
+      return new SharedMemoryTransport(name, rank, size);
+    case TRANSPORT_TCP:
+      return new TCPTransport(port, rank, size);
+  }
+  return nullptr;
+}
+
+void Transport::SendReceive(const void* send_data, std::size_t send_bytes,
+                            void* receive_data, std::size_t receive_bytes) {
+  const char* send_ptr = (const char*)send_data;
+  char* receive_ptr = (char*)receive_data;
+  while (send_bytes > 0 || receive_bytes > 0) {
+    std::size_t progress = 0;
+    if (send_bytes > 0) {
+      const std::size_t sent = TrySend(send_ptr, send_bytes);
+      send_ptr += sent;
+      send_bytes -= sent;
+      progress += sent;
+    }
+    if (receive_bytes > 0) {
+      const std::size_t received = TryReceive(receive_ptr, receive_bytes);
+      receive_ptr += received;
+      receive_bytes -= received;
+      progress += received;
+    }
+    if (progress == 0)
+      Wait(send_bytes > 0, receive_bytes > 0);
+  }
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Config.h"
+#include "Log.h"
+#include "WorkerPool.h"
+
+namespace Conv {
+
+WorkerPool::WorkerPool(const unsigned int workers) : workers_(std::max(workers, 1u)) {
+  for(unsigned int w = 1; w < workers_; w++)
+    threads_.emplace_back(&WorkerPool::Work, this, w);
+  LOGDEBUG << "Started " << workers_ - 1 << " worker threads";
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  task_ready_.notify_all();
+  for(std::thread& thread : threads_)
+    thread.join();
+}
+
+void WorkerPool::Run(const std::function<void(unsigned int)>& task) {
+  int threads = 1;
+#ifdef _OPENMP
+  threads = std::max(1, omp_get_max_threads() / (int)workers_);
+#endif
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    threads_per_worker_ = threads;
+    running_ = workers_ - 1;
+    exception_ = nullptr;
+    generation_++;
+  }
+  task_ready_.notify_all();
+
+  Call(0, threads);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_done_.wait(lock, [this]() { return running_ == 0; });
+  task_ = nullptr;
+  if(exception_ != nullptr) {
+    std::exception_ptr exception = exception_;
+    exception_ = nullptr;
+    std::rethrow_exception(exception);
+  }
+}
+
+void WorkerPool::Work(const unsigned int worker) {
+  unsigned long generation = 0;
+  while(true) {
+    int threads;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_ready_.wait(lock, [&]() { return shutdown_ || generation_ != generation; });
+      if(shutdown_)
+        return;
+      generation = generation_;
+      threads = threads_per_worker_;
+    }
+
+    Call(worker, threads);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(--running_ == 0)
+      task_done_.notify_all();
+  }
+}
+
+void WorkerPool::Call(const unsigned int worker, const int threads) {
+#ifdef _OPENMP
+  const int previous_threads = omp_get_max_threads();
+  omp_set_num_threads(threads);
+#else
+  UNREFERENCED_PARAMETER(threads);
+#endif
+
+  try {
+    (*task_)(worker);
+  } catch(...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(exception_ == nullptr)
+      exception_ = std::current_exception();
+  }
+
+#ifdef _OPENMP
+  omp_set_num_threads(previous_threads);
+#endif
+}
+
+}
@@ -0,0 +1,188 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file ByteTensorStream.cpp
+ * @brief Checks the 8 bit conversion kernels and that a ByteTensorStream
+ *  restores images and labels exactly.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include <cn24.h>
+
+#include "TensorMathKernels.h"
+
+/*
+ * Every byte has to convert to DATUM_FROM_UCHAR, also for unaligned tails.
+ * With an offset, the instruction sets may round differently in the last
+ * bit.
+ */
+bool TestKernels() {
+  const Conv::TensorMathKernelTable* generic = Conv::TensorMathKernels::GetTable(Conv::CPU_ISA_GENERIC);
+  const Conv::CPUInstructionSet detected = Conv::TensorMathKernels::DetectInstructionSet();
+  std::vector<std::uint8_t> source(1000 + 3);
+  for(std::size_t e = 0; e < source.size(); e++)
+    source[e] = (std::uint8_t)(e * 37 + e / 256);
+
+  bool passed = true;
+  for(int i = Conv::CPU_ISA_GENERIC; i <= detected; i++) {
+    const Conv::TensorMathKernelTable* kernels = Conv::TensorMathKernels::GetTable((Conv::CPUInstructionSet)i);
+    if(kernels == nullptr)
+      continue;
+
+    std::vector<Conv::datum> target(source.size()), expected(source.size());
+    for(std::size_t first = 0; first < 3; first++) {
+      const std::size_t elements = source.size() - first;
+      kernels->unpack_u8(&source[first], &target[0], elements, DATUM_FROM_UCHAR(1), 0);
+      for(std::size_t e = 0; e < elements; e++)
+        expected[e] = DATUM_FROM_UCHAR(source[first + e]);
+      if(std::memcmp(&target[0], &expected[0], elements * sizeof(Conv::datum)) != 0) {
+        LOGERROR << kernels->name << ": bytes do not match DATUM_FROM_UCHAR";
+        passed = false;
+      }
+
+      kernels->unpack_u8(&source[first], &target[0], elements, (Conv::datum)0.0173, (Conv::datum)-1.37);
+      generic->unpack_u8(&source[first], &expected[0], elements, (Conv::datum)0.0173, (Conv::datum)-1.37);
+      for(std::size_t e = 0; e < elements; e++) {
+        if(std::fabs(target[e] - expected[e]) > 1e-6) {
+          LOGERROR << kernels->name << ": scale and offset differ from the generic kernel";
+          passed = false;
+          break;
+        }
+      }
+    }
+  }
+  return passed;
+}
+
+bool SameBits(const Conv::Tensor& expected, const Conv::Tensor& actual, const std::size_t sample) {
+  const std::size_t elements = expected.width() * expected.height() * expected.maps();
+  return std::memcmp(expected.data_ptr_const(), actual.data_ptr_const(0, 0, 0, sample), elements * sizeof(Conv::datum)) == 0;
+}
+
+bool TestStream() {
+  const std::string file_name = "ByteTensorStream.bts";
+  std::mt19937 generator(1337);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::normal_distribution<Conv::datum> normal(0, 1);
+
+  Conv::Tensor image(1, 64, 48, 3);
+  for(std::size_t e = 0; e < image.elements(); e++)
+    image.data_ptr()[e] = DATUM_FROM_UCHAR(byte(generator));
+  Conv::Tensor labels(1, 64, 48, 4);
+  labels.Clear();
+  for(unsigned int y = 0; y < labels.height(); y++)
+    for(unsigned int x = 0; x < labels.width(); x++)
+      *labels.data_ptr(x, y, (x / 16 + y / 12) % 4, 0) = 1;
+  Conv::Tensor small(1, 31, 17, 3);
+  for(std::size_t e = 0; e < small.elements(); e++)
+    small.data_ptr()[e] = DATUM_FROM_UCHAR(byte(generator));
+  Conv::Tensor floats(1, 20, 10, 2);
+  for(std::size_t e = 0; e < floats.elements(); e++)
+    floats.data_ptr()[e] = normal(generator);
+
+  bool passed = true;
+  {
+    std::ofstream output(file_name, std::ios::out | std::ios::binary);
+    uint64_t magic = CN24_BTS_MAGIC;
+    output.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
+    passed &= Conv::ByteTensorStream::Serialize(output, image);
+    passed &= Conv::ByteTensorStream::Serialize(output, labels);
+    passed &= Conv::ByteTensorStream::Serialize(output, small);
+    if(Conv::ByteTensorStream::Serialize(output, floats)) {
+      LOGERROR << "Floats were stored exactly";
+      passed = false;
+    }
+  }
+
+  // A quarter of the size plus the headers
+  std::ifstream size_check(file_name, std::ios::in | std::ios::binary | std::ios::ate);
+  const std::size_t file_size = size_check.tellg();
+  const std::size_t expected_size = sizeof(uint64_t) + 4 * 48 +
+    image.elements() + labels.elements() + small.elements() + floats.elements();
+  if(file_size != expected_size) {
+    LOGERROR << "File has " << file_size << " bytes instead of " << expected_size;
+    passed = false;
+  }
+
+  Conv::TensorStream* stream = Conv::TensorStream::FromFile(file_name);
+  std::remove(file_name.c_str());
+  if(stream->GetTensorCount() != 4 || stream->GetWidth(2) != 31 || stream->GetMaps(1) != 4) {
+    LOGERROR << "Stream has the wrong tensors";
+    delete stream;
+    return false;
+  }
+
+  Conv::Tensor image_batch(3, 64, 48, 3);
+  Conv::Tensor label_batch(2, 64, 48, 4);
+  const std::vector<unsigned int> images = {0, 2};
+  passed &= stream->CopySamples(images, image_batch, 1);
+  passed &= stream->CopySample(1, 0, label_batch, 1);
+  if(!SameBits(image, image_batch, 1) || !SameBits(labels, label_batch, 1)) {
+    LOGERROR << "Images or labels differ";
+    passed = false;
+  }
+
+  // The smaller image is padded with zeros like Tensor::CopySample does
+  Conv::Tensor expected_small(1, 64, 48, 3);
+  Conv::Tensor::CopySample(small, 0, expected_small, 0);
+  if(!SameBits(expected_small, image_batch, 2)) {
+    LOGERROR << "Padded image differs";
+    passed = false;
+  }
+
+  Conv::Tensor float_target(1, 20, 10, 2);
+  passed &= stream->CopySample(3, 0, float_target, 0);
+  Conv::datum minimum = floats.data_ptr()[0], maximum = floats.data_ptr()[0];
+  for(std::size_t e = 0; e < floats.elements(); e++) {
+    minimum = std::min(minimum, floats.data_ptr()[e]);
+    maximum = std::max(maximum, floats.data_ptr()[e]);
+  }
+  for(std::size_t e = 0; e < floats.elements(); e++) {
+    if(std::fabs(float_target.data_ptr()[e] - floats.data_ptr()[e]) > (maximum - minimum) / 255.0 * 0.501) {
+      LOGERROR << "Quantized value " << e << " is off by more than half a step";
+      passed = false;
+      break;
+    }
+  }
+
+  if(stream->CopySample(4, 0, float_target, 0) || stream->CopySample(0, 1, image_batch, 0) ||
+     stream->CopySample(0, 0, image_batch, 3)) {
+    LOGERROR << "Copied out of range";
+    passed = false;
+  }
+
+  delete stream;
+  return passed;
+}
+
+int main (int argc, char* argv[]) {
+  UNREFERENCED_PARAMETER(argc);
+  UNREFERENCED_PARAMETER(argv);
+  Conv::System::Init();
+
+  bool passed = true;
+  passed &= TestKernels();
+  passed &= TestStream();
+
+  if(!passed)
+    FATAL("Byte tensor stream test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
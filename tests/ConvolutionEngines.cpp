@@ -0,0 +1,233 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file ConvolutionEngines.cpp
+ * @brief Checks that every ConvolutionLayer engine computes the same outputs
+ *  and gradients as the im2col reference, and that 8 bit inference stays
+ *  close to it.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cn24.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Layer configuration (without engine), input width, height, maps, samples
+struct EngineTestCase {
+  std::string configuration;
+  unsigned int width, height, maps, samples;
+};
+
+std::vector<EngineTestCase> test_cases = {
+  {"size=3x3 kernels=4", 9, 7, 3, 2},
+  {"size=3x3 pad=1x1 kernels=5", 12, 10, 2, 3},
+  {"size=3x3 pad=1x1 kernels=32", 21, 18, 24, 2},
+  {"size=3x3 pad=1x1 kernels=4", 36, 30, 3, 3},
+  {"size=3x3 pad=1x1 kernels=4 activation=relu", 36, 30, 3, 3},
+  {"size=3x3 pad=2x2 kernels=3", 6, 9, 2, 2},
+  {"size=3x3 stride=2x2 pad=1x1 kernels=3", 11, 9, 3, 2},
+  {"size=3x3 group=2 kernels=4", 8, 8, 4, 2},
+  {"size=3x3 pad=1x1 group=4 kernels=8", 18, 16, 8, 2},
+  {"size=5x5 pad=2x2 kernels=4", 17, 13, 3, 2},
+  {"size=5x5 pad=2x2 kernels=4 activation=tanh", 17, 13, 3, 2},
+  {"size=7x7 stride=2x1 pad=3x2 kernels=6", 20, 15, 2, 1},
+  {"size=7x7 pad=3x3 kernels=5", 19, 16, 6, 2},
+  {"size=5x3 pad=1x2 kernels=3", 13, 7, 4, 3},
+  {"size=1x1 kernels=7", 6, 5, 4, 3},
+  {"size=1x1 kernels=8", 1, 1, 30, 4},
+  {"size=1x1 kernels=8 activation=sigm", 1, 1, 30, 4},
+  {"size=4x2 stride=3x2 kernels=3", 14, 9, 2, 2}
+};
+
+// Engine name and relative tolerance. The Winograd transforms are less
+// precise, see ConvolutionLayer::ConvolutionEngine.
+std::vector<std::pair<std::string, Conv::datum>> engines = {
+  {"implicit", 1e-4},
+  {"winograd", 1e-3},
+  {"fft", 1e-4},
+  {"pointwise", 1e-4}
+};
+
+struct EngineResult {
+  Conv::Tensor output, input_delta, weights_delta, bias_delta;
+};
+
+void CopyTensor(const Conv::Tensor& source, Conv::Tensor& target) {
+  target.Resize(source);
+  std::memcpy(target.data_ptr(), source.data_ptr_const(), source.elements() * sizeof(Conv::datum));
+}
+
+bool RunLayer(const std::string& descriptor, const EngineTestCase& test_case,
+              const Conv::Tensor& input_data, const Conv::Tensor& output_delta,
+              EngineResult& result, const Conv::datum quantization = 0) {
+  Conv::NetStatus net_status;
+  net_status.SetIsTesting(quantization > 0);
+
+  Conv::Layer* layer = Conv::LayerFactory::ConstructLayer(descriptor);
+  if(layer == nullptr)
+    return false;
+
+  Conv::CombinedTensor input(test_case.samples, test_case.width, test_case.height, test_case.maps);
+  std::memcpy(input.data.data_ptr(), input_data.data_ptr_const(), input_data.elements() * sizeof(Conv::datum));
+  input.delta.Clear(0.0);
+
+  std::vector<Conv::CombinedTensor*> outputs;
+  if(!layer->CreateOutputs({&input}, outputs) || !layer->Connect({&input}, outputs, &net_status)) {
+    delete layer;
+    return false;
+  }
+  layer->OnLayerConnect({});
+
+  // The bias is zero after connecting, give it some values
+  Conv::Tensor& bias = layer->parameters()[1]->data;
+  for(unsigned int e = 0; e < bias.elements(); e++)
+    bias.data_ptr()[e] = 0.1 * (Conv::datum)e - 0.2;
+
+  // The quantized engine only runs forward
+  dynamic_cast<Conv::ConvolutionLayer*>(layer)->SetQuantization(quantization);
+  layer->FeedForward();
+  if(quantization == 0) {
+    std::memcpy(outputs[0]->delta.data_ptr(), output_delta.data_ptr_const(), output_delta.elements() * sizeof(Conv::datum));
+    layer->BackPropagate();
+  }
+
+#ifdef BUILD_OPENCL
+  outputs[0]->data.MoveToCPU();
+  input.delta.MoveToCPU();
+  layer->parameters()[0]->delta.MoveToCPU();
+  layer->parameters()[1]->delta.MoveToCPU();
+#endif
+  CopyTensor(outputs[0]->data, result.output);
+  CopyTensor(input.delta, result.input_delta);
+  CopyTensor(layer->parameters()[0]->delta, result.weights_delta);
+  CopyTensor(layer->parameters()[1]->delta, result.bias_delta);
+
+  delete layer;
+  for(Conv::CombinedTensor* output : outputs)
+    delete output;
+  return true;
+}
+
+unsigned int CountDifferences(const Conv::Tensor& reference, const Conv::Tensor& actual,
+                              const Conv::datum tolerance) {
+  if(reference.elements() != actual.elements())
+    return reference.elements() + 1;
+  unsigned int wrong = 0;
+  for(unsigned int e = 0; e < reference.elements(); e++) {
+    const Conv::datum expected = reference.data_ptr_const()[e];
+    if(std::fabs(expected - actual.data_ptr_const()[e]) > tolerance * (1.0 + std::fabs(expected)))
+      wrong++;
+  }
+  return wrong;
+}
+
+// Quantization errors are spread over all outputs, so they are compared
+// by their norm relative to the norm of the reference
+const Conv::datum int8_tolerance = 0.01;
+
+Conv::datum RelativeError(const Conv::Tensor& reference, const Conv::Tensor& actual) {
+  double difference = 0, norm = 0;
+  for(unsigned int e = 0; e < reference.elements(); e++) {
+    const double d = actual.data_ptr_const()[e] - reference.data_ptr_const()[e];
+    difference += d * d;
+    norm += (double)reference.data_ptr_const()[e] * reference.data_ptr_const()[e];
+  }
+  return (Conv::datum)std::sqrt(difference / norm);
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 generator(4242);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+
+  bool test_failed = false;
+
+  for(EngineTestCase& test_case : test_cases) {
+    Conv::Tensor input_data(test_case.samples, test_case.width, test_case.height, test_case.maps);
+    for(unsigned int e = 0; e < input_data.elements(); e++)
+      input_data.data_ptr()[e] = dist(generator);
+
+    const std::string reference_descriptor = "convolution(" + test_case.configuration + " engine=im2col seed=17)";
+    EngineResult reference;
+    Conv::Tensor output_delta;
+    {
+      // Find out the output size first
+      Conv::Layer* layer = Conv::LayerFactory::ConstructLayer(reference_descriptor);
+      Conv::CombinedTensor input(test_case.samples, test_case.width, test_case.height, test_case.maps);
+      std::vector<Conv::CombinedTensor*> outputs;
+      layer->CreateOutputs({&input}, outputs);
+      output_delta.Resize(outputs[0]->data);
+      for(unsigned int e = 0; e < output_delta.elements(); e++)
+        output_delta.data_ptr()[e] = dist(generator);
+      delete layer;
+      for(Conv::CombinedTensor* output : outputs)
+        delete output;
+    }
+
+    if(!RunLayer(reference_descriptor, test_case, input_data, output_delta, reference)) {
+      LOGERROR << "Could not run reference layer " << reference_descriptor;
+      test_failed = true;
+      continue;
+    }
+
+    for(std::pair<std::string, Conv::datum>& engine : engines) {
+      const std::string descriptor = "convolution(" + test_case.configuration + " engine=" + engine.first + " seed=17)";
+      EngineResult result;
+      if(!RunLayer(descriptor, test_case, input_data, output_delta, result)) {
+        LOGERROR << "Could not run layer " << descriptor;
+        test_failed = true;
+        continue;
+      }
+
+      const Conv::datum tolerance = engine.second;
+      const unsigned int wrong_output = CountDifferences(reference.output, result.output, tolerance);
+      const unsigned int wrong_input_delta = CountDifferences(reference.input_delta, result.input_delta, tolerance);
+      const unsigned int wrong_weights_delta = CountDifferences(reference.weights_delta, result.weights_delta, tolerance);
+      const unsigned int wrong_bias_delta = CountDifferences(reference.bias_delta, result.bias_delta, tolerance);
+
+      if(wrong_output + wrong_input_delta + wrong_weights_delta + wrong_bias_delta > 0) {
+        LOGERROR << descriptor << ": " << wrong_output << " wrong outputs, "
+          << wrong_input_delta << " wrong input deltas, " << wrong_weights_delta
+          << " wrong weight deltas, " << wrong_bias_delta << " wrong bias deltas";
+        test_failed = true;
+      }
+    }
+
+    // 8 bit inference with the range of this input
+    Conv::datum range = 0;
+    for(unsigned int e = 0; e < input_data.elements(); e++)
+      range = std::max(range, std::fabs(input_data.data_ptr_const()[e]));
+    EngineResult quantized;
+    if(!RunLayer(reference_descriptor, test_case, input_data, output_delta, quantized, range)) {
+      LOGERROR << "Could not run quantized layer " << reference_descriptor;
+      test_failed = true;
+      continue;
+    }
+    const Conv::datum error = RelativeError(reference.output, quantized.output);
+    LOGDEBUG << reference_descriptor << ": 8 bit relative error " << error;
+    if(quantized.output.elements() != reference.output.elements() || !(error <= int8_tolerance)) {
+      LOGERROR << reference_descriptor << ": 8 bit outputs have a relative error of " << error;
+      test_failed = true;
+    }
+  }
+
+  if(!test_failed) {
+    LOGINFO << "All engines okay";
+  }
+
+  LOGEND;
+  return test_failed ? -1 : 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file DataParallelTraining.cpp
+ * @brief Compares a net trained together with replicas to the same net
+ *  trained alone.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include <cn24.h>
+
+#include "TestNet.h"
+
+std::string hardcoded_net = "# Network configuration \n\
+method=patch \n\
+?convolutional kernels=8 size=3x3 \n\
+?maxpooling size=2x2 \n\
+?relu \n\
+ \n\
+?convolutional kernels=8 size=3x3 \n\
+?tanh \n\
+ \n\
+?fullyconnected neurons=16 \n\
+?tanh \n\
+?fullyconnected neurons=(o) \n\
+?output \n\
+ \n\
+# Learning settings \n\
+pbatchsize=4 \n\
+sbatchsize=5 \n\
+iterations=3 \n\
+lr=0.01 \n\
+replicas=3 \n\
+";
+
+const unsigned int CLASSES = 3;
+
+int main () {
+  Conv::System::Init();
+
+  std::stringstream net_config(hardcoded_net);
+  Conv::ConfigurableFactory factory(net_config, 238238, true);
+  factory.InitOptimalSettings();
+  const Conv::TrainerSettings settings = factory.optimal_settings();
+  if(settings.replicas != 3)
+    FATAL("Replica setting was not parsed");
+
+  // As many samples as a batch, see TestDataset
+  TestDataset dataset(4, factory.patchsizex(), factory.patchsizey(), CLASSES);
+
+  Conv::DatasetInputLayer serial_input(dataset, 4, 1.0, 1);
+  TestNet serial(hardcoded_net, &serial_input, CLASSES);
+  serial.graph.Initialize();
+  serial.graph.InitializeWeights();
+  const std::vector<Conv::datum> initial = serial.Parameters();
+  std::stringstream parameters;
+  serial.graph.SerializeParameters(parameters);
+
+  Conv::DatasetInputLayer parallel_input(dataset, 4, 1.0, 2);
+  TestNet parallel(hardcoded_net, &parallel_input, CLASSES);
+  parallel.graph.Initialize();
+  parallel.graph.DeserializeParameters(parameters);
+  std::vector<Conv::DatasetInputLayer*> replica_inputs;
+  std::vector<TestNet*> replicas;
+  for(unsigned int r = 1; r < settings.replicas; r++) {
+    replica_inputs.push_back(new Conv::DatasetInputLayer(dataset, 4, 1.0, 2 + r));
+    replicas.push_back(new TestNet(hardcoded_net, replica_inputs.back(), CLASSES));
+    replicas.back()->graph.Initialize();
+  }
+
+  Conv::Trainer serial_trainer(serial.graph, settings);
+  Conv::Trainer parallel_trainer(parallel.graph, settings);
+  for(TestNet* replica : replicas)
+    parallel_trainer.AddReplica(replica->graph);
+
+  serial_trainer.Train(2, false);
+  parallel_trainer.Train(2, false);
+
+  const std::vector<Conv::datum> expected = serial.Parameters();
+  const std::vector<Conv::datum> result = parallel.Parameters();
+
+  bool passed = true;
+  Conv::datum max_change = 0;
+  for(std::size_t e = 0; e < expected.size(); e++) {
+    max_change = std::max(max_change, std::abs(expected[e] - initial[e]));
+    if(std::abs(result[e] - expected[e]) > 1e-4 * (1.0 + std::abs(expected[e]))) {
+      LOGERROR << "Parameter " << e << " is " << result[e] << " instead of " << expected[e];
+      passed = false;
+      break;
+    }
+  }
+
+  if(max_change == 0) {
+    LOGERROR << "Training did not change the parameters";
+    passed = false;
+  }
+
+  for(TestNet* replica : replicas)
+    delete replica;
+  for(Conv::DatasetInputLayer* replica_input : replica_inputs)
+    delete replica_input;
+
+  if(!passed)
+    FATAL("Data-parallel training test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file DatasetPrefetching.cpp
+ * @brief Checks that a DatasetInputLayer that loads batches in the
+ *  background outputs exactly the same batches as one that does not.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cn24.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Every sample is filled with values derived from its index, so a wrong
+ * or missing sample shows up in the comparison.
+ */
+class IndexDataset : public Conv::Dataset {
+public:
+  IndexDataset(bool concurrent) : concurrent_(concurrent) {}
+
+  Conv::Task GetTask() const { return Conv::SEMANTIC_SEGMENTATION; }
+  Conv::Method GetMethod() const { return Conv::FCN; }
+  unsigned int GetWidth() const { return 30; }
+  unsigned int GetHeight() const { return 20; }
+  unsigned int GetInputMaps() const { return 3; }
+  unsigned int GetLabelMaps() const { return 2; }
+  unsigned int GetClasses() const { return 2; }
+  std::vector<std::string> GetClassNames() const { return std::vector<std::string>(2, "class"); }
+  std::vector<unsigned int> GetClassColors() const { return std::vector<unsigned int>(2, 0); }
+  std::vector<Conv::datum> GetClassWeights() const { return std::vector<Conv::datum>(2, 1.0); }
+  unsigned int GetTrainingSamples() const { return 13; }
+  unsigned int GetTestingSamples() const { return 5; }
+  bool SupportsTesting() const { return true; }
+  bool SupportsConcurrentReads() const { return concurrent_; }
+
+  bool GetTrainingSample(Conv::Tensor& data_tensor, Conv::Tensor& label_tensor,
+    Conv::Tensor& helper_tensor, Conv::Tensor& weight_tensor, unsigned int sample, unsigned int index) {
+    return Fill(data_tensor, label_tensor, helper_tensor, weight_tensor, sample, index);
+  }
+
+  bool GetTestingSample(Conv::Tensor& data_tensor, Conv::Tensor& label_tensor,
+    Conv::Tensor& helper_tensor, Conv::Tensor& weight_tensor, unsigned int sample, unsigned int index) {
+    return Fill(data_tensor, label_tensor, helper_tensor, weight_tensor, sample, 1000 + index);
+  }
+
+private:
+  bool Fill(Conv::Tensor& data_tensor, Conv::Tensor& label_tensor,
+    Conv::Tensor& helper_tensor, Conv::Tensor& weight_tensor, unsigned int sample, unsigned int index) {
+    for(unsigned int y = 0; y < GetHeight(); y++) {
+      for(unsigned int x = 0; x < GetWidth(); x++) {
+        for(unsigned int map = 0; map < GetInputMaps(); map++)
+          *data_tensor.data_ptr(x, y, map, sample) = (Conv::datum)(index * 7 + x * 3 + y * 5 + map);
+        for(unsigned int map = 0; map < GetLabelMaps(); map++)
+          *label_tensor.data_ptr(x, y, map, sample) = (Conv::datum)((index + map) % 2);
+        *helper_tensor.data_ptr(x, y, 0, sample) = (Conv::datum)x;
+        *helper_tensor.data_ptr(x, y, 1, sample) = (Conv::datum)y;
+        *weight_tensor.data_ptr(x, y, 0, sample) = (Conv::datum)(index + 1);
+      }
+    }
+    return true;
+  }
+
+  bool concurrent_;
+};
+
+struct Input {
+  Input(Conv::Dataset& dataset) : layer(dataset, 4, 0.5, 4711) {
+    std::vector<Conv::CombinedTensor*> inputs;
+    layer.CreateOutputs(inputs, outputs);
+    layer.Connect(inputs, outputs, nullptr);
+  }
+
+  ~Input() {
+    for(Conv::CombinedTensor* output : outputs)
+      delete output;
+  }
+
+  Conv::DatasetInputLayer layer;
+  std::vector<Conv::CombinedTensor*> outputs;
+};
+
+bool Same(const std::vector<Conv::CombinedTensor*>& expected, const std::vector<Conv::CombinedTensor*>& actual) {
+  for(unsigned int o = 0; o < expected.size(); o++) {
+    if(expected[o]->data.elements() != actual[o]->data.elements() ||
+       std::memcmp(expected[o]->data.data_ptr_const(), actual[o]->data.data_ptr_const(),
+                   expected[o]->data.elements() * sizeof(Conv::datum)) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool TestPrefetching(bool concurrent, unsigned int depth, unsigned int loaders) {
+  IndexDataset dataset(concurrent);
+  Input serial(dataset);
+  Input prefetched(dataset);
+  prefetched.layer.SetPrefetching(depth, loaders);
+
+  // Nothing is loaded before the first batch, so sharding keeps the order
+  serial.layer.SetShard(1, 2);
+  prefetched.layer.SetShard(1, 2);
+
+  // Batches of 4 from 7 samples cross the end of the permutation
+  for(unsigned int batch = 0; batch < 20; batch++) {
+    // Testing in between must not disturb the batches already loaded
+    const bool testing = batch % 7 == 3;
+    serial.layer.SetTestingMode(testing);
+    prefetched.layer.SetTestingMode(testing);
+
+    serial.layer.FeedForward();
+    prefetched.layer.FeedForward();
+    if(!Same(serial.outputs, prefetched.outputs)) {
+      LOGERROR << "Batch " << batch << " differs with depth " << depth << ", " << loaders
+        << " loaders and " << (concurrent ? "concurrent" : "serialized") << " reads";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main (int argc, char* argv[]) {
+  UNREFERENCED_PARAMETER(argc);
+  UNREFERENCED_PARAMETER(argv);
+  Conv::System::Init();
+
+  bool passed = true;
+  passed &= TestPrefetching(false, 1, 1);
+  passed &= TestPrefetching(false, 2, 2);
+  passed &= TestPrefetching(true, 1, 1);
+  passed &= TestPrefetching(true, 3, 4);
+
+  if(!passed)
+    FATAL("Prefetching test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
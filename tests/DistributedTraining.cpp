@@ -0,0 +1,267 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file DistributedTraining.cpp
+ * @brief Sums buffers over several processes with both transports, checks
+ *  that a failed sum is reported and compares a net trained by two
+ *  processes to the same net trained alone.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cn24.h>
+
+#include "TestNet.h"
+
+std::string hardcoded_net = "# Network configuration \n\
+method=patch \n\
+?convolutional kernels=8 size=3x3 \n\
+?maxpooling size=2x2 \n\
+?relu \n\
+ \n\
+?convolutional kernels=8 size=3x3 \n\
+?tanh \n\
+ \n\
+?fullyconnected neurons=16 \n\
+?tanh \n\
+?fullyconnected neurons=(o) \n\
+?output \n\
+ \n\
+# Learning settings \n\
+pbatchsize=4 \n\
+sbatchsize=4 \n\
+iterations=3 \n\
+lr=0.01 \n\
+";
+
+const unsigned int CLASSES = 3;
+
+/*
+ * Runs each function in this process as rank 0 and in forked processes as
+ * the other ranks. All processes are forked before the first function runs
+ * here, because forking after OpenMP was used can hang. Returns true if
+ * every function returned true everywhere.
+ */
+bool RunRanks(unsigned int size, const std::vector<std::function<bool(unsigned int)>>& functions) {
+  std::vector<pid_t> children;
+  for(const std::function<bool(unsigned int)>& function : functions) {
+    for(unsigned int rank = 1; rank < size; rank++) {
+      pid_t pid = fork();
+      if(pid == 0) {
+        bool passed = false;
+        try {
+          passed = function(rank);
+        } catch(...) {}
+        std::cout << std::flush;
+        _exit(passed ? 0 : 1);
+      }
+      children.push_back(pid);
+    }
+  }
+
+  bool passed = true;
+  for(const std::function<bool(unsigned int)>& function : functions)
+    passed &= function(0);
+  for(pid_t child : children) {
+    int status = 0;
+    waitpid(child, &status, 0);
+    passed &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  return passed;
+}
+
+bool TestSum(Conv::TransportType type, const std::string& name, unsigned int port, unsigned int rank) {
+  const unsigned int size = 3;
+  Conv::Transport* transport = Conv::Transport::Create(type, name, port, rank, size);
+  Conv::RingAllReduce all_reduce(*transport, 1000);
+
+  // Small integers are summed exactly in any order
+  const std::size_t lengths[] = {1, 2, 5, 999, 1000, 1001, 300000};
+  std::vector<std::vector<Conv::datum>> buffers;
+  for(std::size_t length : lengths) {
+    std::vector<Conv::datum> buffer(length);
+    for(std::size_t e = 0; e < length; e++)
+      buffer[e] = (Conv::datum)((rank + 1) * (e % 7));
+    buffers.push_back(buffer);
+  }
+
+  // The first half is summed right away, the other half is queued
+  for(unsigned int b = 0; b < buffers.size(); b++) {
+    if(b < buffers.size() / 2)
+      all_reduce.Sum(buffers[b].data(), buffers[b].size());
+    else
+      all_reduce.Enqueue(buffers[b].data(), buffers[b].size());
+  }
+  all_reduce.Wait();
+
+  bool passed = true;
+  for(std::vector<Conv::datum>& buffer : buffers) {
+    for(std::size_t e = 0; e < buffer.size(); e++) {
+      if(buffer[e] != (Conv::datum)(6 * (e % 7))) {
+        LOGERROR << "Rank " << rank << ": element " << e << " of " << buffer.size() << " is " << buffer[e];
+        passed = false;
+        break;
+      }
+    }
+  }
+  delete transport;
+  return passed;
+}
+
+// Fails on the first byte, like a peer that went away
+class FailingTransport : public Conv::Transport {
+public:
+  FailingTransport() : Conv::Transport(0, 2) {}
+
+protected:
+  std::size_t TrySend(const void* data, std::size_t bytes) {
+    UNREFERENCED_PARAMETER(data);
+    UNREFERENCED_PARAMETER(bytes);
+    throw std::runtime_error("Peer went away");
+  }
+  std::size_t TryReceive(void* data, std::size_t bytes) {
+    UNREFERENCED_PARAMETER(data);
+    UNREFERENCED_PARAMETER(bytes);
+    return 0;
+  }
+  void Wait(bool sending, bool receiving) {
+    UNREFERENCED_PARAMETER(sending);
+    UNREFERENCED_PARAMETER(receiving);
+  }
+};
+
+// Wait reports a failed sum once and does not wait for the dropped buffers
+bool TestFailure() {
+  FailingTransport transport;
+  Conv::RingAllReduce all_reduce(transport, 1000);
+  std::vector<Conv::datum> buffer(10, 1);
+  all_reduce.Enqueue(buffer.data(), 5);
+  all_reduce.Enqueue(buffer.data() + 5, 5);
+  bool thrown = false;
+  try {
+    all_reduce.Wait();
+  } catch(const std::runtime_error&) {
+    thrown = true;
+  }
+  all_reduce.Wait();
+  return thrown;
+}
+
+int main (int argc, char* argv[]) {
+  UNREFERENCED_PARAMETER(argc);
+  UNREFERENCED_PARAMETER(argv);
+  Conv::System::Init();
+
+  std::stringstream name;
+  name << "cn24-test-" << getpid();
+  const unsigned int port = 20000 + (getpid() % 9000) * 7;
+
+  bool passed = true;
+  const Conv::TransportType types[] = {Conv::TRANSPORT_SHM, Conv::TRANSPORT_TCP};
+  for(const Conv::TransportType type : types) {
+    const char* type_name = type == Conv::TRANSPORT_SHM ? "shm" : "tcp";
+    if(!RunRanks(3, {[&](unsigned int rank) { return TestSum(type, name.str() + "-sum", port, rank); }})) {
+      LOGERROR << type_name << ": sums differ";
+      passed = false;
+    }
+  }
+
+  if(!TestFailure()) {
+    LOGERROR << "Failed sum was not reported";
+    passed = false;
+  }
+
+  std::stringstream net_config(hardcoded_net);
+  Conv::ConfigurableFactory factory(net_config, 238238, true);
+  factory.InitOptimalSettings();
+  const Conv::TrainerSettings settings = factory.optimal_settings();
+  // A batch of two processes with half of the samples each contains every
+  // sample as often as a batch of one process, so the summed gradients are
+  // the same. See TestDataset.
+  TestDataset dataset(4, factory.patchsizex(), factory.patchsizey(), CLASSES);
+
+  // Both transports train in other processes first, forking after OpenMP
+  // was used can hang
+  std::vector<std::vector<Conv::datum>> results(2);
+  std::vector<std::function<bool(unsigned int)>> training;
+  for(unsigned int t = 0; t < 2; t++) {
+    const Conv::TransportType type = types[t];
+    training.push_back([&, type, t](unsigned int rank) -> bool {
+      std::stringstream transport_name;
+      transport_name << name.str() << "-train-" << t;
+      Conv::Transport* transport = Conv::Transport::Create(type, transport_name.str(), port + 3 + 2 * t, rank, 2);
+      Conv::DatasetInputLayer input(dataset, 4, 1.0, 2 + rank);
+      TestNet distributed(hardcoded_net, &input, CLASSES);
+      distributed.graph.Initialize();
+      distributed.graph.InitializeWeights();
+
+      // The parameters of rank 0 are used everywhere
+      if(rank != 0)
+        distributed.graph.InitializeWeights();
+      input.SetShard(rank, 2);
+      {
+        // The Trainer sums over the transport until it is destroyed
+        Conv::Trainer trainer(distributed.graph, settings);
+        trainer.SetTransport(*transport);
+        trainer.Train(2, false);
+      }
+      results[t] = distributed.Parameters();
+      delete transport;
+      return true;
+    });
+  }
+  if(!RunRanks(2, training)) {
+    LOGERROR << "Training failed";
+    passed = false;
+  }
+
+  Conv::DatasetInputLayer serial_input(dataset, 4, 1.0, 1);
+  TestNet serial(hardcoded_net, &serial_input, CLASSES);
+  serial.graph.Initialize();
+  serial.graph.InitializeWeights();
+  const std::vector<Conv::datum> initial = serial.Parameters();
+  Conv::Trainer serial_trainer(serial.graph, settings);
+  serial_trainer.Train(2, false);
+  const std::vector<Conv::datum> expected = serial.Parameters();
+
+  for(std::vector<Conv::datum>& result : results) {
+    if(result.size() != expected.size()) {
+      passed = false;
+      continue;
+    }
+    for(std::size_t e = 0; e < expected.size(); e++) {
+      if(std::abs(result[e] - expected[e]) > 1e-4 * (1.0 + std::abs(expected[e]))) {
+        LOGERROR << "Parameter " << e << " is " << result[e] << " instead of " << expected[e];
+        passed = false;
+        break;
+      }
+    }
+  }
+
+  if(expected == initial) {
+    LOGERROR << "Training did not change the parameters";
+    passed = false;
+  }
+
+  if(!passed)
+    FATAL("Distributed training test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
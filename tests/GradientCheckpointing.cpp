@@ -0,0 +1,105 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file GradientCheckpointing.cpp
+ * @brief Compares the gradients of a net that recomputes its hidden outputs
+ *  to those of the same net that keeps them.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <sstream>
+#include <vector>
+
+#include <cn24.h>
+
+#include "TestNet.h"
+
+std::string hardcoded_net = "# Network configuration \n\
+method=patch \n\
+?convolutional kernels=12 size=5x5 \n\
+?maxpooling size=2x2 \n\
+?relu \n\
+ \n\
+?convolutional kernels=16 size=3x3 engine=winograd \n\
+?tanh \n\
+checkpoint \n\
+ \n\
+?convolutional kernels=12 size=3x3 \n\
+?amaxpooling size=3x3 stride=2x2 \n\
+?sigm \n\
+ \n\
+?fullyconnected neurons=48 \n\
+?tanh \n\
+ \n\
+?fullyconnected neurons=(o) \n\
+?output \n\
+ \n\
+# Learning settings \n\
+pbatchsize=4 \n\
+checkpointing=auto \n\
+";
+
+const unsigned int CLASSES = 3;
+
+int main () {
+  Conv::System::Init();
+
+  std::stringstream net_config(hardcoded_net);
+  Conv::ConfigurableFactory factory(net_config, 238238, true);
+  factory.InitOptimalSettings();
+  if(factory.optimal_settings().checkpointing != Conv::CHECKPOINTING_AUTO)
+    FATAL("Checkpointing setting was not parsed");
+
+  TestInput input(4, factory.patchsizex(), factory.patchsizey(), CLASSES);
+
+  Conv::InputLayer reference_input(input.data, input.label, input.helper, input.weight);
+  TestNet reference(hardcoded_net, &reference_input, CLASSES);
+  reference.graph.Initialize();
+  reference.graph.SetIsTesting(false);
+  reference.graph.InitializeWeights();
+  std::stringstream parameters;
+  reference.graph.SerializeParameters(parameters);
+  const std::vector<Conv::datum> expected = reference.Run();
+
+  bool passed = true;
+  const Conv::CheckpointingMode modes[] = {Conv::CHECKPOINTING_AUTO, Conv::CHECKPOINTING_MANUAL};
+  for(const Conv::CheckpointingMode mode : modes) {
+    const char* mode_name = mode == Conv::CHECKPOINTING_AUTO ? "auto" : "manual";
+    Conv::InputLayer checkpointed_input(input.data, input.label, input.helper, input.weight);
+    TestNet checkpointed(hardcoded_net, &checkpointed_input, CLASSES);
+    checkpointed.graph.Initialize();
+    checkpointed.graph.SetIsTesting(false);
+    checkpointed.graph.SetCheckpointing(mode);
+    parameters.clear();
+    parameters.seekg(0);
+    checkpointed.graph.DeserializeParameters(parameters);
+
+    for(unsigned int pass = 0; pass < 2; pass++) {
+      if(checkpointed.Run() != expected) {
+        LOGERROR << mode_name << ", pass " << pass << ": loss or gradients differ";
+        passed = false;
+      }
+    }
+
+    const Conv::CheckpointingStats& stats = checkpointed.graph.GetCheckpointingStats();
+    LOGINFO << mode_name << ": " << stats.bytes_saved() << " of " << stats.bytes_recomputable <<
+      " bytes saved, " << stats.recomputed_nodes << " nodes recomputed";
+    if(stats.bytes_saved() == 0 || stats.recomputed_nodes == 0) {
+      LOGERROR << mode_name << ": nothing was discarded and recomputed";
+      passed = false;
+    }
+  }
+
+  if(!passed)
+    FATAL("Gradient checkpointing test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
@@ -23,8 +23,15 @@
 std::string hardcoded_net = "# Network configuration \n\
 ?convolutional kernels=8 size=7x7 \n\
 ?maxpooling size=2x2 \n\
+?relu \n\
+ \n\
+?convolutional kernels=8 size=3x3 pad=1x1 engine=winograd \n\
+?tanh \n\
  \n\
 ?convolutional kernels=12 size=5x5 \n\
+?tanh \n\
+ \n\
+?convolutional kernels=12 size=5x5 engine=fft \n\
 ?tanh \n\
  \n\
 ?fullyconnected neurons=64 \n\
@@ -0,0 +1,120 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file InferenceOnly.cpp
+ * @brief Compares an inference-only net to the same net built for training.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <sstream>
+#include <vector>
+
+#include <cn24.h>
+
+#include "TestNet.h"
+
+std::string hardcoded_net = "# Network configuration \n\
+method=patch \n\
+?convolutional kernels=16 size=7x7 \n\
+?maxpooling size=2x2 \n\
+?relu \n\
+ \n\
+?convolutional kernels=16 size=3x3 engine=winograd \n\
+?tanh \n\
+ \n\
+?convolutional kernels=12 size=3x3 \n\
+?amaxpooling size=3x3 stride=2x2 \n\
+?sigm \n\
+ \n\
+?fullyconnected neurons=64 \n\
+?tanh \n\
+ \n\
+?fullyconnected neurons=(o) \n\
+?output \n\
+ \n\
+# Learning settings \n\
+pbatchsize=8 \n\
+";
+
+const unsigned int CLASSES = 4;
+
+int main () {
+  Conv::System::Init();
+
+  std::stringstream net_config(hardcoded_net);
+  Conv::ConfigurableFactory factory(net_config, 238238, true);
+  TestInput input(8, factory.patchsizex(), factory.patchsizey(), CLASSES);
+
+  // The input layers allocate their deltas when they are constructed
+  std::size_t before = LiveBytes();
+  Conv::InputLayer training_input(input.data, input.label, input.helper, input.weight);
+  TestNet training(hardcoded_net, &training_input, CLASSES);
+  training.graph.Initialize();
+  const std::size_t training_bytes = LiveBytes() - before;
+  training.graph.InitializeWeights();
+
+  before = LiveBytes();
+  Conv::InputLayer inference_input(input.data, input.label, input.helper, input.weight);
+  TestNet inference(hardcoded_net, &inference_input, CLASSES);
+  inference.graph.SetInferenceOnly(true);
+  inference.graph.Initialize();
+  const std::size_t inference_bytes = LiveBytes() - before;
+  training.graph.SetIsTesting(true);
+  inference.graph.SetIsTesting(true);
+
+  std::stringstream parameters;
+  training.graph.SerializeParameters(parameters);
+  inference.graph.DeserializeParameters(parameters);
+
+  bool passed = true;
+  for(Conv::NetGraphNode* node : inference.graph.GetNodes()) {
+    for(Conv::NetGraphBuffer& buffer : node->output_buffers) {
+      if(buffer.combined_tensor->delta.elements() != 0) {
+        LOGERROR << node->layer->GetLayerDescription() << " allocated an output delta";
+        passed = false;
+      }
+    }
+    for(Conv::CombinedTensor* parameter : node->layer->parameters()) {
+      if(parameter->delta.elements() != 0) {
+        LOGERROR << node->layer->GetLayerDescription() << " allocated a parameter delta";
+        passed = false;
+      }
+    }
+  }
+
+  training.graph.FeedForward();
+  inference.graph.FeedForward();
+  Conv::Tensor& expected = training.graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+  Conv::Tensor& output = inference.graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+  for(std::size_t e = 0; e < expected.elements(); e++) {
+    if(output[e] != expected[e]) {
+      LOGERROR << "Output element " << e << " is " << output[e] << " instead of " << expected[e];
+      passed = false;
+      break;
+    }
+  }
+  if(inference.graph.AggregateLoss() != training.graph.AggregateLoss()) {
+    LOGERROR << "Loss differs";
+    passed = false;
+  }
+
+  LOGINFO << "Tensor memory: " << training_bytes << " bytes for training, " <<
+    inference_bytes << " bytes inference-only";
+  if(2 * inference_bytes > training_bytes) {
+    LOGERROR << "Inference-only net uses more than half the memory";
+    passed = false;
+  }
+
+  if(!passed)
+    FATAL("Inference-only test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
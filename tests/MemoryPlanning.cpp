@@ -0,0 +1,103 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file MemoryPlanning.cpp
+ * @brief Compares a fully convolutional net whose hidden outputs share an
+ *  arena to the same net with separate buffers.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <cn24.h>
+
+#include "TestNet.h"
+
+std::string hardcoded_net = "# Network configuration \n\
+method=patch \n\
+?convolutional kernels=16 size=5x5 \n\
+?relu \n\
+?maxpooling size=2x2 \n\
+ \n\
+?convolutional kernels=24 size=3x3 \n\
+?tanh \n\
+?maxpooling size=2x2 \n\
+ \n\
+?convolutional kernels=16 size=3x3 \n\
+?sigm \n\
+ \n\
+?fullyconnected neurons=32 \n\
+?relu \n\
+ \n\
+?fullyconnected neurons=(o) \n\
+?output \n\
+";
+
+const unsigned int CLASSES = 5;
+
+int main () {
+  Conv::System::Init();
+
+  Conv::Tensor data_tensor(1, 96, 64, 3);
+  Conv::Tensor helper_tensor(1, 96, 64, 2);
+  std::mt19937 rand(1337);
+  std::uniform_real_distribution<Conv::datum> dist(0.0, 1.0);
+  for(std::size_t e = 0; e < data_tensor.elements(); e++)
+    data_tensor[e] = dist(rand);
+  helper_tensor.Clear(0.0);
+
+  std::size_t before = LiveBytes();
+  Conv::InputLayer reference_input(data_tensor, helper_tensor);
+  TestNet reference(hardcoded_net, &reference_input, CLASSES, false);
+  reference.graph.Initialize();
+  const std::size_t reference_bytes = LiveBytes() - before;
+  reference.graph.SetIsTesting(true);
+  reference.graph.InitializeWeights();
+
+  Conv::TensorAllocator::Trim();
+  before = LiveBytes();
+  Conv::InputLayer planned_input(data_tensor, helper_tensor);
+  TestNet planned(hardcoded_net, &planned_input, CLASSES, false);
+  planned.graph.SetMemoryPlanningEnabled(true);
+  planned.graph.Initialize();
+  const std::size_t planned_bytes = LiveBytes() - before;
+  planned.graph.SetIsTesting(true);
+
+  std::stringstream parameters;
+  reference.graph.SerializeParameters(parameters);
+  planned.graph.DeserializeParameters(parameters);
+
+  bool passed = true;
+  reference.graph.FeedForward();
+  const std::vector<Conv::datum> expected = reference.Output();
+  for(unsigned int pass = 0; pass < 2; pass++) {
+    planned.graph.FeedForward();
+    if(planned.Output() != expected) {
+      LOGERROR << "Pass " << pass << ": output of the planned net differs";
+      passed = false;
+    }
+  }
+
+  // The deltas are still separate, so only the data part shrinks
+  LOGINFO << "Tensor memory: " << reference_bytes << " bytes separate, " <<
+    planned_bytes << " bytes planned";
+  if(planned_bytes >= reference_bytes) {
+    LOGERROR << "Planning did not save memory";
+    passed = false;
+  }
+
+  if(!passed)
+    FATAL("Memory planning test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
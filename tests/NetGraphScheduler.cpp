@@ -0,0 +1,109 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file NetGraphScheduler.cpp
+ * @brief Compares a net with independent branches that runs its nodes
+ *  concurrently to the same net running one node at a time.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+#include <cn24.h>
+
+#include "TestNet.h"
+
+std::string hardcoded_net = "# Network configuration \n\
+manual rfx=2 rfy=2 factorx=1 factory=1 \n\
+pusha \n\
+?convolutional kernels=8 size=3x3 \n\
+?tanh \n\
+pushb \n\
+popa \n\
+?convolutional kernels=8 size=3x3 \n\
+?relu \n\
+pushb \n\
+?sum stack=b \n\
+ \n\
+pusha \n\
+?convolutional kernels=8 size=1x1 \n\
+?sigm \n\
+pusha \n\
+?concat stack=a \n\
+ \n\
+?fullyconnected neurons=16 \n\
+?tanh \n\
+?fullyconnected neurons=(o) \n\
+?output \n\
+ \n\
+# Learning settings \n\
+method=patch \n\
+pbatchsize=16 \n\
+";
+
+const unsigned int CLASSES = 4;
+
+// Output, loss and parameter gradients of one forward and backward pass
+std::vector<Conv::datum> Run(TestNet& net) {
+  std::vector<Conv::datum> result = net.Run();
+  const std::vector<Conv::datum> output = net.Output();
+  result.insert(result.end(), output.begin(), output.end());
+  return result;
+}
+
+int main () {
+  Conv::System::Init();
+
+  std::stringstream net_config(hardcoded_net);
+  Conv::ConfigurableFactory factory(net_config, 238238, true);
+  TestInput input(16, factory.patchsizex(), factory.patchsizey(), CLASSES);
+
+  Conv::InputLayer serial_input(input.data, input.label, input.helper, input.weight);
+  TestNet serial(hardcoded_net, &serial_input, CLASSES);
+  serial.graph.Initialize();
+  serial.graph.SetIsTesting(false);
+  serial.graph.SetSchedulerThreads(1);
+  serial.graph.InitializeWeights();
+  Conv::InputLayer scheduled_input(input.data, input.label, input.helper, input.weight);
+  TestNet scheduled(hardcoded_net, &scheduled_input, CLASSES);
+  scheduled.graph.Initialize();
+  scheduled.graph.SetIsTesting(false);
+  scheduled.graph.SetSchedulerThreads(4);
+  std::stringstream parameters;
+  serial.graph.SerializeParameters(parameters);
+  scheduled.graph.DeserializeParameters(parameters);
+
+  bool passed = true;
+  double serial_seconds = 0, scheduled_seconds = 0;
+  for(unsigned int pass = 0; pass < 5; pass++) {
+    auto t_begin = std::chrono::steady_clock::now();
+    const std::vector<Conv::datum> expected = Run(serial);
+    auto t_middle = std::chrono::steady_clock::now();
+    const std::vector<Conv::datum> result = Run(scheduled);
+    auto t_end = std::chrono::steady_clock::now();
+    serial_seconds += std::chrono::duration<double>(t_middle - t_begin).count();
+    scheduled_seconds += std::chrono::duration<double>(t_end - t_middle).count();
+
+    if(result != expected) {
+      LOGERROR << "Pass " << pass << ": output, loss or gradients differ";
+      passed = false;
+    }
+  }
+
+  LOGINFO << "Serial: " << serial_seconds << "s, scheduled: " << scheduled_seconds << "s";
+
+  if(!passed)
+    FATAL("Scheduler test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
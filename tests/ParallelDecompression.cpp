@@ -0,0 +1,178 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file ParallelDecompression.cpp
+ * @brief Decompresses a CompressedTensorStream from several threads and
+ *  in batches and compares the samples to the original tensors, also
+ *  through the batches of a TensorStreamDataset.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cn24.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+const unsigned int TENSORS = 24;
+const unsigned int MAX_WIDTH = 40;
+const unsigned int MAX_HEIGHT = 30;
+const unsigned int MAPS = 3;
+
+// Pads the tensor with zeros to the target size like Tensor::CopySample
+bool SameSample(const Conv::Tensor& expected, const Conv::Tensor& actual, std::size_t sample) {
+  for(unsigned int map = 0; map < actual.maps(); map++) {
+    for(unsigned int y = 0; y < actual.height(); y++) {
+      for(unsigned int x = 0; x < actual.width(); x++) {
+        const Conv::datum value = (x < expected.width() && y < expected.height()) ?
+          *expected.data_ptr_const(x, y, map, 0) : 0;
+        if(*actual.data_ptr_const(x, y, map, sample) != value)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main (int argc, char* argv[]) {
+  UNREFERENCED_PARAMETER(argc);
+  UNREFERENCED_PARAMETER(argv);
+  Conv::System::Init();
+
+  // Runs of equal values are compressed, the noise in between is not
+  std::mt19937 generator(1337);
+  std::uniform_int_distribution<int> dist(0, 9);
+  std::vector<Conv::Tensor*> tensors;
+  const std::string file_name = "ParallelDecompression.cts";
+  {
+    std::ofstream output(file_name, std::ios::out | std::ios::binary);
+    uint64_t magic = CN24_CTS_MAGIC;
+    output.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
+    for(unsigned int t = 0; t < TENSORS; t++) {
+      const bool full_size = t % 3 != 0;
+      Conv::Tensor* tensor = new Conv::Tensor(1, full_size ? MAX_WIDTH : MAX_WIDTH - t % 7, full_size ? MAX_HEIGHT : MAX_HEIGHT - t % 5, MAPS);
+      for(std::size_t e = 0; e < tensor->elements(); e++)
+        tensor->data_ptr()[e] = dist(generator) < 6 ? (Conv::datum)t : (Conv::datum)dist(generator);
+      Conv::CompressedTensor ctensor;
+      ctensor.Compress(*tensor);
+      ctensor.Serialize(output);
+      tensors.push_back(tensor);
+    }
+  }
+
+  Conv::CompressedTensorStream stream;
+  stream.LoadFile(file_name);
+  std::remove(file_name.c_str());
+  if(stream.GetTensorCount() != TENSORS)
+    FATAL("Stream has " << stream.GetTensorCount() << " tensors instead of " << TENSORS);
+
+  bool passed = true;
+  Conv::CompressedTensorStream::ResetStats();
+
+  // Several threads decompress every tensor into their own batches
+  const unsigned int threads = 4;
+  std::vector<Conv::Tensor> batches;
+  for(unsigned int t = 0; t < threads; t++)
+    batches.emplace_back(TENSORS, MAX_WIDTH, MAX_HEIGHT, MAPS);
+  std::vector<int> thread_success(threads, 1);
+  std::vector<std::thread> workers;
+  for(unsigned int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&, t]() {
+      for(unsigned int repetition = 0; repetition < 20; repetition++)
+        for(unsigned int s = 0; s < TENSORS; s++)
+          thread_success[t] &= stream.CopySample((s + t * 5) % TENSORS, 0, batches[t], (s + t * 5) % TENSORS) ? 1 : 0;
+    }));
+  }
+  for(std::thread& worker : workers)
+    worker.join();
+
+  for(unsigned int t = 0; t < threads; t++) {
+    for(unsigned int s = 0; s < TENSORS; s++) {
+      if(!thread_success[t] || !SameSample(*tensors[s], batches[t], s)) {
+        LOGERROR << "Thread " << t << ": sample " << s << " differs";
+        passed = false;
+      }
+    }
+  }
+
+  // Batch API with an offset into the target
+  std::vector<unsigned int> sources;
+  for(unsigned int s = 0; s < TENSORS; s++)
+    sources.push_back(TENSORS - 1 - s);
+  Conv::Tensor batch(TENSORS + 2, MAX_WIDTH, MAX_HEIGHT, MAPS);
+  if(!stream.CopySamples(sources, batch, 2)) {
+    LOGERROR << "CopySamples failed";
+    passed = false;
+  }
+  for(unsigned int s = 0; s < TENSORS; s++) {
+    if(!SameSample(*tensors[sources[s]], batch, s + 2)) {
+      LOGERROR << "Batch: sample " << s + 2 << " differs";
+      passed = false;
+    }
+  }
+
+  // Out of range sources and targets fail
+  if(stream.CopySample(TENSORS, 0, batch, 0) || stream.CopySample(0, 0, batch, TENSORS + 2)) {
+    LOGERROR << "Copied out of range";
+    passed = false;
+  }
+
+  const Conv::DecompressionStats stats = Conv::CompressedTensorStream::GetStats();
+  std::size_t expected_bytes = 0;
+  for(Conv::Tensor* tensor : tensors)
+    expected_bytes += tensor->elements() * sizeof(Conv::datum) * (threads * 20 + 1);
+  if(stats.bytes != expected_bytes || !(stats.mebibytes_per_second() > 0)) {
+    LOGERROR << "Stats report " << stats.bytes << " bytes instead of " << expected_bytes;
+    passed = false;
+  }
+  LOGINFO << "Decompression throughput: " << stats.mebibytes_per_second() << " MiB/s";
+
+  // Datasets load their batches through CopySamples, alternating images
+  // and labels
+  {
+    Conv::CompressedTensorStream no_testing;
+    Conv::TensorStreamDataset dataset(&stream, &no_testing, MAPS, {"a", "b", "c"},
+      {0x000000, 0x808080, 0xFFFFFF}, {1.0, 2.0, 0.5});
+    const std::vector<unsigned int> indices = {5, 0, 11, 3};
+    const unsigned int width = dataset.GetWidth(), height = dataset.GetHeight();
+    Conv::Tensor expected[] = {Conv::Tensor(5, width, height, MAPS), Conv::Tensor(5, width, height, MAPS),
+      Conv::Tensor(5, width, height, 2), Conv::Tensor(5, width, height, 1)};
+    Conv::Tensor result[] = {Conv::Tensor(5, width, height, MAPS), Conv::Tensor(5, width, height, MAPS),
+      Conv::Tensor(5, width, height, 2), Conv::Tensor(5, width, height, 1)};
+    for(unsigned int s = 0; s < indices.size(); s++)
+      dataset.GetTrainingSample(expected[0], expected[1], expected[2], expected[3], s + 1, indices[s]);
+    if(!dataset.GetTrainingBatch(result[0], result[1], result[2], result[3], indices, 1)) {
+      LOGERROR << "GetTrainingBatch failed";
+      passed = false;
+    }
+    for(unsigned int t = 0; t < 4; t++) {
+      for(unsigned int s = 1; s <= indices.size(); s++) {
+        const std::size_t sample_elements = expected[t].width() * expected[t].height() * expected[t].maps();
+        if(!std::equal(expected[t].data_ptr_const(0, 0, 0, s), expected[t].data_ptr_const(0, 0, 0, s) + sample_elements,
+                       result[t].data_ptr_const(0, 0, 0, s))) {
+          LOGERROR << "Dataset batch: tensor " << t << ", sample " << s << " differs";
+          passed = false;
+        }
+      }
+    }
+  }
+
+  for(Conv::Tensor* tensor : tensors)
+    delete tensor;
+
+  if(!passed)
+    FATAL("Parallel decompression test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file ReducedPrecisionStorage.cpp
+ * @brief Checks the 16 bit conversions and compares training with packed
+ *  activations to the 32 bit path, on a random net and on the pretrained
+ *  KITTI example.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include <cn24.h>
+
+#include "TensorMathKernels.h"
+
+#include "TestNet.h"
+
+std::string hardcoded_net = "# Network configuration \n\
+method=patch \n\
+?convolutional kernels=16 size=7x7 \n\
+?maxpooling size=2x2 \n\
+?relu \n\
+ \n\
+?convolutional kernels=16 size=3x3 engine=winograd \n\
+?tanh \n\
+ \n\
+?convolutional kernels=12 size=5x5 engine=fft \n\
+?sigm \n\
+ \n\
+?fullyconnected neurons=64 \n\
+?tanh \n\
+ \n\
+?fullyconnected neurons=(o) \n\
+?output \n\
+ \n\
+# Learning settings \n\
+pbatchsize=16 \n\
+";
+
+/*
+ * Every 16 bit value has to survive a round trip, and the midpoints between
+ * neighbouring values have to round to the even one.
+ */
+bool TestConversions(const Conv::TensorMathKernelTable& kernels, const bool bfloat) {
+  const char* format = bfloat ? "bf16" : "fp16";
+  const std::uint16_t infinity = bfloat ? 0x7f80 : 0x7c00;
+  std::vector<std::uint16_t> all(65536), packed(65536);
+  std::vector<Conv::datum> unpacked(65536);
+  for(unsigned int h = 0; h < 65536; h++)
+    all[h] = (std::uint16_t)h;
+  kernels.unpack_half(&all[0], &unpacked[0], all.size(), bfloat);
+  kernels.pack_half(&unpacked[0], &packed[0], all.size(), bfloat);
+
+  for(unsigned int h = 0; h < 65536; h++) {
+    const bool nan = (h & 0x7fff) > infinity;
+    if(nan != std::isnan(unpacked[h]) || (nan && (packed[h] & 0x7fff) <= infinity)
+      || (!nan && packed[h] != h)) {
+      LOGERROR << kernels.name << " " << format << ": round trip of " << h <<
+        " gives " << unpacked[h] << ", " << packed[h];
+      return false;
+    }
+  }
+
+  // Midpoints of all positive finite neighbours
+  std::vector<Conv::datum> midpoints;
+  for(unsigned int h = 0; h + 1 < infinity; h++)
+    midpoints.push_back((Conv::datum)(((double)unpacked[h] + (double)unpacked[h + 1]) / 2.0));
+  packed.resize(midpoints.size());
+  kernels.pack_half(&midpoints[0], &packed[0], midpoints.size(), bfloat);
+  for(unsigned int h = 0; h < midpoints.size(); h++) {
+    const unsigned int even = (h & 1) ? h + 1 : h;
+    if(packed[h] != even) {
+      LOGERROR << kernels.name << " " << format << ": midpoint " << midpoints[h] <<
+        " rounds to " << packed[h] << " instead of " << even;
+      return false;
+    }
+  }
+
+  // Overflow and the largest finite value
+  const Conv::datum largest = unpacked[infinity - 1];
+  const Conv::datum special[] = {largest, -largest,
+    std::numeric_limits<Conv::datum>::infinity(), std::numeric_limits<Conv::datum>::max()};
+  const std::uint16_t expected[] = {(std::uint16_t)(infinity - 1),
+    (std::uint16_t)(0x8000 | (infinity - 1)), infinity, infinity};
+  std::uint16_t result[4];
+  kernels.pack_half(special, result, 4, bfloat);
+  for(unsigned int i = 0; i < 4; i++) {
+    if(result[i] != expected[i]) {
+      LOGERROR << kernels.name << " " << format << ": " << special[i] <<
+        " packs to " << result[i] << " instead of " << expected[i];
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestTensorPacking() {
+  Conv::Tensor tensor(3, 37, 29, 11);
+  std::mt19937 rand(4242);
+  std::uniform_real_distribution<Conv::datum> dist(-8.0, 8.0);
+  for(std::size_t e = 0; e < tensor.elements(); e++)
+    tensor[e] = dist(rand);
+  Conv::Tensor original(tensor, true);
+
+  Conv::Tensor shadow;
+  shadow.Shadow(tensor);
+  Conv::datum* data = tensor.data_ptr();
+
+  const Conv::datum tolerance[] = {0, std::ldexp((Conv::datum)1, -8), std::ldexp((Conv::datum)1, -11)};
+  for(int p = Conv::PRECISION_BF16; p <= Conv::PRECISION_FP16; p++) {
+    const Conv::TensorPrecision precision = (Conv::TensorPrecision)p;
+    shadow.Pack(precision);
+    if(!tensor.packed() || !shadow.packed() || tensor.data_ptr() != data) {
+      LOGERROR << "Packing a shadow did not pack its target in place";
+      return false;
+    }
+
+    // Copies of packed tensors are unpacked
+    Conv::Tensor copy(tensor, true);
+    tensor.Unpack();
+    if(tensor.packed() || copy.packed()) {
+      LOGERROR << "Unpacked tensor is still packed";
+      return false;
+    }
+
+    for(std::size_t e = 0; e < tensor.elements(); e++) {
+      const Conv::datum error = std::fabs(tensor[e] - original[e]);
+      if(error > tolerance[p] * std::fabs(original[e]) || copy[e] != tensor[e]) {
+        LOGERROR << "Precision " << p << ": element " << e << " is " << tensor[e] <<
+          " (copy " << copy[e] << ") instead of " << original[e];
+        return false;
+      }
+      tensor[e] = original[e];
+    }
+  }
+
+  // Clearing a packed tensor discards the packed data
+  tensor.Pack(Conv::PRECISION_BF16);
+  tensor.Clear(3.0);
+  if(tensor.packed() || tensor[tensor.elements() / 2] != 3.0) {
+    LOGERROR << "Clear did not discard the packed data";
+    return false;
+  }
+  return true;
+}
+
+struct PassResult {
+  Conv::datum loss = 0;
+  std::vector<std::vector<Conv::datum>> gradients;
+};
+
+// Loss and gradients of one forward and backward pass, one vector per parameter
+PassResult RunPass(TestNet& net) {
+  const std::vector<Conv::datum> run = net.Run();
+  PassResult result;
+  result.loss = run[0];
+
+  std::vector<Conv::CombinedTensor*> parameters;
+  net.graph.GetParameters(parameters);
+  std::size_t offset = 1;
+  for(Conv::CombinedTensor* parameter : parameters) {
+    result.gradients.push_back(std::vector<Conv::datum>(run.begin() + offset,
+      run.begin() + offset + parameter->delta.elements()));
+    offset += parameter->delta.elements();
+  }
+  return result;
+}
+
+/*
+ * Compares passes with packed activations to the 32 bit pass of the same
+ * net. The forward pass only packs data nobody reads anymore, so the loss
+ * is exact. Gradients see rounded activations.
+ */
+bool TestStorage(const std::string& name, TestNet& net) {
+  const Conv::datum tolerance[] = {0, 1e-2, 1e-3};
+  const PassResult reference = RunPass(net);
+
+  for(int p = Conv::PRECISION_BF16; p <= Conv::PRECISION_FP16; p++) {
+    net.graph.SetStoragePrecision((Conv::TensorPrecision)p);
+    const PassResult result = RunPass(net);
+
+    unsigned int packed_buffers = 0;
+    for(Conv::NetGraphNode* node : net.graph.GetNodes())
+      for(Conv::NetGraphBuffer& buffer : node->output_buffers)
+        packed_buffers += buffer.combined_tensor->data.packed() ? 1 : 0;
+
+    net.graph.SetStoragePrecision(Conv::PRECISION_FP32);
+    for(Conv::NetGraphNode* node : net.graph.GetNodes())
+      for(Conv::NetGraphBuffer& buffer : node->output_buffers)
+        if(buffer.combined_tensor->data.packed())
+          FATAL("Buffer still packed after switching back to 32 bit");
+
+    if(packed_buffers == 0) {
+      LOGERROR << name << ", precision " << p << ": no buffer was packed";
+      return false;
+    }
+
+    if(result.loss != reference.loss) {
+      LOGERROR << name << ", precision " << p << ": loss " << result.loss << " instead of " << reference.loss;
+      return false;
+    }
+
+    for(unsigned int i = 0; i < reference.gradients.size(); i++) {
+      double difference = 0, norm = 0;
+      for(unsigned int e = 0; e < reference.gradients[i].size(); e++) {
+        const double d = result.gradients[i][e] - reference.gradients[i][e];
+        difference += d * d;
+        norm += (double)reference.gradients[i][e] * reference.gradients[i][e];
+      }
+      if(norm == 0) {
+        LOGERROR << name << ": parameter " << i << " has no gradient";
+        return false;
+      }
+      const double relative = std::sqrt(difference / norm);
+      LOGDEBUG << name << ", precision " << p << ", parameter " << i << ": relative error " << relative;
+      if(!(relative <= tolerance[p])) {
+        LOGERROR << name << ", precision " << p << ", parameter " << i << ": relative gradient error " <<
+          relative << " exceeds " << tolerance[p];
+        return false;
+      }
+    }
+    LOGINFO << name << ", precision " << p << ": " << packed_buffers << " buffers packed, gradients okay";
+  }
+
+  // Back to 32 bit, everything matches bit by bit again
+  const PassResult again = RunPass(net);
+  if(again.loss != reference.loss || again.gradients != reference.gradients) {
+    LOGERROR << name << ": 32 bit results changed after packing";
+    return false;
+  }
+  return true;
+}
+
+bool TestGraphStorage() {
+  const unsigned int CLASSES = 10;
+  std::stringstream net_config(hardcoded_net);
+  Conv::ConfigurableFactory factory(net_config, 238238, true);
+  factory.InitOptimalSettings();
+
+  TestInput input(factory.optimal_settings().pbatchsize, factory.patchsizex(), factory.patchsizey(), CLASSES);
+  Conv::InputLayer input_layer(input.data, input.label, input.helper, input.weight);
+  TestNet net(hardcoded_net, &input_layer, CLASSES);
+  net.graph.Initialize();
+  net.graph.InitializeWeights();
+  net.graph.SetIsTesting(true);
+
+  return TestStorage("Random net", net);
+}
+
+/*
+ * Runs the pretrained KITTI example net on a crop of a sample image. There
+ * are no labels for the sample images, so the 32 bit predictions are used.
+ */
+bool TestExampleStorage() {
+#ifdef BUILD_JPG
+  const std::string example_dir(CN24_EXAMPLE_DIR);
+  std::ifstream net_config_file(example_dir + "/kitti.net", std::ios::in);
+  std::ifstream param_tensor_file(example_dir + "/kitti_pretrained.Tensor", std::ios::in | std::ios::binary);
+  if(!net_config_file.good() || !param_tensor_file.good()) {
+    LOGERROR << "Cannot open the KITTI example in " << example_dir;
+    return false;
+  }
+  std::stringstream net_config;
+  net_config << net_config_file.rdbuf();
+
+  // A part of the road, the size is a multiple of the pooling size
+  Conv::Tensor image(example_dir + "/sample1.jpg");
+  const unsigned int width = 192, height = 96;
+  const unsigned int left = (image.width() - width) / 2, top = image.height() - height;
+  Conv::Tensor data_tensor(1, width, height, image.maps());
+  Conv::Tensor label_tensor(1, width, height, 1);
+  Conv::Tensor helper_tensor(1, width, height, 2);
+  Conv::Tensor weight_tensor(1, width, height, 1);
+  for(unsigned int m = 0; m < image.maps(); m++)
+    for(unsigned int y = 0; y < height; y++)
+      for(unsigned int x = 0; x < width; x++)
+        *data_tensor.data_ptr(x, y, m, 0) = *image.data_ptr_const(left + x, top + y, m, 0);
+  for(unsigned int y = 0; y < height; y++) {
+    for(unsigned int x = 0; x < width; x++) {
+      *helper_tensor.data_ptr(x, y, 0, 0) = ((Conv::datum)(left + x)) / ((Conv::datum)image.width() - 1);
+      *helper_tensor.data_ptr(x, y, 1, 0) = ((Conv::datum)(top + y)) / ((Conv::datum)image.height() - 1);
+    }
+  }
+  label_tensor.Clear(0.0);
+  weight_tensor.Clear(1.0);
+
+  Conv::InputLayer input_layer(data_tensor, label_tensor, helper_tensor, weight_tensor);
+  TestNet net(net_config.str(), &input_layer, 1);
+  net.graph.Initialize();
+  net.graph.DeserializeParameters(param_tensor_file);
+  net.graph.SetIsTesting(true);
+
+  net.graph.FeedForward();
+  const std::vector<Conv::datum> prediction = net.Output();
+  if(prediction.size() != label_tensor.elements()) {
+    LOGERROR << "KITTI example: " << prediction.size() << " outputs for " << label_tensor.elements() << " labels";
+    return false;
+  }
+  unsigned int road = 0;
+  for(std::size_t e = 0; e < prediction.size(); e++) {
+    label_tensor[e] = prediction[e] > 0.5 ? 1.0 : 0.0;
+    road += prediction[e] > 0.5 ? 1 : 0;
+  }
+  LOGINFO << "KITTI example: " << road << " of " << prediction.size() << " pixels are road";
+
+  return TestStorage("KITTI example", net);
+#else
+  LOGINFO << "Built without JPEG support, skipping the KITTI example";
+  return true;
+#endif
+}
+
+int main () {
+  Conv::System::Init();
+
+  bool passed = true;
+  const Conv::CPUInstructionSet host = Conv::TensorMathKernels::DetectInstructionSet();
+  for(int isa = Conv::CPU_ISA_GENERIC; isa <= host; isa++) {
+    const Conv::TensorMathKernelTable* kernels =
+      Conv::TensorMathKernels::GetTable((Conv::CPUInstructionSet)isa);
+    if(kernels == nullptr)
+      continue;
+    passed &= TestConversions(*kernels, true);
+    passed &= TestConversions(*kernels, false);
+  }
+
+  passed &= TestTensorPacking();
+  passed &= TestGraphStorage();
+  passed &= TestExampleStorage();
+
+  if(!passed)
+    FATAL("Reduced precision storage test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
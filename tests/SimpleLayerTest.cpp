@@ -27,6 +27,18 @@ std::vector<std::pair<std::string, unsigned int>> test_layers_and_runs = {
   {"convolution(size=3x3 kernels=3)",RANDOM_RUNS},
   {"convolution(size=3x3 stride=2x2 kernels=3)",RANDOM_RUNS},
   {"convolution(size=3x3 group=3 kernels=9)",RANDOM_RUNS},
+  {"convolution(size=3x3 kernels=3 engine=implicit)",RANDOM_RUNS},
+  {"convolution(size=3x3 stride=2x2 pad=1x1 kernels=3 engine=implicit)",RANDOM_RUNS},
+  {"convolution(size=3x3 group=3 kernels=9 engine=implicit)",RANDOM_RUNS},
+  {"convolution(size=3x3 kernels=3 engine=im2col)",RANDOM_RUNS},
+  {"convolution(size=3x3 pad=1x1 kernels=3 engine=winograd)",RANDOM_RUNS},
+  {"convolution(size=3x3 pad=2x2 kernels=4 engine=winograd)",RANDOM_RUNS},
+  {"convolution(size=5x5 kernels=3 engine=fft)",RANDOM_RUNS},
+  {"convolution(size=5x5 pad=2x2 kernels=4 engine=fft)",RANDOM_RUNS},
+  {"convolution(size=1x1 kernels=4 engine=pointwise)",RANDOM_RUNS},
+  {"convolution(size=3x3 kernels=3 activation=tanh)",RANDOM_RUNS},
+  {"convolution(size=3x3 pad=1x1 kernels=3 engine=winograd activation=sigm)",RANDOM_RUNS},
+  {"convolution(size=1x1 kernels=4 engine=pointwise activation=tanh)",RANDOM_RUNS},
   {"hmax(mu=0.1 weight=0.0)",1},
   {"hmax(mu=0.1 weight=0.2)",1},
   {"tanh",1},{"sigm",1},{"relu",1},
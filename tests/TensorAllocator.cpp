@@ -0,0 +1,165 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file TensorAllocator.cpp
+ * @brief Checks alignment, recycling and the counters of the Tensor
+ *  allocator.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <cn24.h>
+
+bool Aligned(const void* block) {
+  return ((std::uintptr_t)block % CN24_TENSOR_ALIGNMENT) == 0;
+}
+
+/*
+ * Every size has to come back aligned and writable, and a freed block has
+ * to be handed out again for the same size without asking the system.
+ */
+bool TestRecycling() {
+  const std::size_t sizes[] = {1, 63, 64, 65, 1000, 1025, 4096, 100000,
+    (3 << 20) + 5, (std::size_t)300 << 20};
+  for(const std::size_t bytes : sizes) {
+    void* block = Conv::TensorAllocator::Allocate(bytes);
+    if(block == nullptr || !Aligned(block)) {
+      LOGERROR << bytes << " bytes: block " << block << " is not aligned";
+      return false;
+    }
+    std::memset(block, 0x5a, bytes);
+    Conv::TensorAllocator::Free(block, bytes);
+
+    Conv::TensorAllocator::ResetStats();
+    void* again = Conv::TensorAllocator::Allocate(bytes);
+    const Conv::TensorAllocatorStats stats = Conv::TensorAllocator::GetStats();
+    Conv::TensorAllocator::Free(again, bytes);
+
+    // Blocks over 256 MiB are not pooled
+    const bool pooled = bytes < ((std::size_t)256 << 20);
+    if(stats.allocations != 1 || stats.system_allocations != (pooled ? 0 : 1)
+      || (pooled && again != block)) {
+      LOGERROR << bytes << " bytes: " << stats.system_allocations << " of " <<
+        stats.allocations << " allocations served by the system";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestCounters() {
+  Conv::TensorAllocator::Trim();
+  Conv::TensorAllocator::ResetStats();
+  const Conv::TensorAllocatorStats before = Conv::TensorAllocator::GetStats();
+  if(before.bytes_cached != 0) {
+    LOGERROR << before.bytes_cached << " bytes cached after trimming";
+    return false;
+  }
+
+  {
+    Conv::Tensor a(4, 32, 32, 3), b(2, 16, 16, 1);
+    if(!Aligned(a.data_ptr()) || !Aligned(b.data_ptr())) {
+      LOGERROR << "Tensor data is not aligned";
+      return false;
+    }
+    const Conv::TensorAllocatorStats during = Conv::TensorAllocator::GetStats();
+    const std::size_t bytes = (a.elements() + b.elements()) * sizeof(Conv::datum);
+    if(during.bytes_live < before.bytes_live + bytes || during.allocations != 2) {
+      LOGERROR << during.bytes_live - before.bytes_live << " bytes live in " <<
+        during.allocations << " allocations for two Tensors of " << bytes << " bytes";
+      return false;
+    }
+
+    // Resizing to the same size again reuses the block
+    Conv::Tensor c;
+    for(unsigned int i = 0; i < 10; i++) {
+      c.Resize(1, 100 + i);
+      c.Resize(1, 10);
+    }
+  }
+
+  const Conv::TensorAllocatorStats after = Conv::TensorAllocator::GetStats();
+  if(after.bytes_live != before.bytes_live || after.bytes_peak <= before.bytes_live
+    || after.system_allocations > 4 || after.bytes_cached == 0) {
+    LOGERROR << "Counters after freeing: " << after.bytes_live << " live, " <<
+      after.bytes_peak << " peak, " << after.bytes_cached << " cached, " <<
+      after.system_allocations << " of " << after.allocations << " system allocations";
+    return false;
+  }
+
+  Conv::TensorAllocator::Trim();
+  if(Conv::TensorAllocator::GetStats().bytes_cached != 0) {
+    LOGERROR << "Trim left cached blocks";
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Blocks freed by a thread that ends go to the shared pool, so the main
+ * thread gets them back.
+ */
+bool TestThreads() {
+  Conv::TensorAllocator::Trim();
+  const std::size_t bytes = 12345;
+  std::vector<void*> blocks(8, nullptr);
+  std::thread worker([&blocks, bytes]() {
+    for(void*& block : blocks)
+      block = Conv::TensorAllocator::Allocate(bytes);
+    for(void* block : blocks)
+      Conv::TensorAllocator::Free(block, bytes);
+  });
+  worker.join();
+
+  Conv::TensorAllocator::ResetStats();
+  for(void*& block : blocks)
+    block = Conv::TensorAllocator::Allocate(bytes);
+  const Conv::TensorAllocatorStats stats = Conv::TensorAllocator::GetStats();
+  for(void* block : blocks)
+    Conv::TensorAllocator::Free(block, bytes);
+  if(stats.system_allocations != 0) {
+    LOGERROR << stats.system_allocations << " blocks of the finished thread were lost";
+    return false;
+  }
+  return true;
+}
+
+bool TestHugePages() {
+  Conv::TensorAllocator::SetHugePagesEnabled(true);
+  Conv::Tensor tensor(1, 1 << 20, 3);
+  tensor.Clear(2.0);
+  const bool okay = Aligned(tensor.data_ptr()) && tensor[tensor.elements() - 1] == 2.0;
+  tensor.Resize(1, 1);
+  Conv::TensorAllocator::Trim();
+  Conv::TensorAllocator::SetHugePagesEnabled(false);
+  if(!okay)
+    LOGERROR << "Huge page backed Tensor is broken";
+  return okay;
+}
+
+int main() {
+  Conv::System::Init();
+
+  bool passed = true;
+  passed &= TestRecycling();
+  passed &= TestCounters();
+  passed &= TestThreads();
+  passed &= TestHugePages();
+
+  if(!passed)
+    FATAL("Tensor allocator test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
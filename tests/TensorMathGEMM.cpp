@@ -0,0 +1,131 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file TensorMathGEMM.cpp
+ * @brief Compares TensorMath::GEMM against a naive reference implementation
+ *  for every instruction set the host supports.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cn24.h>
+
+#include "TensorMathKernels.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+// M, N, K. Includes the shapes ConvolutionLayer produces as well as sizes
+// that do not divide the register tiles or the cache blocks.
+std::vector<std::vector<int>> test_shapes = {
+  {1, 1, 1}, {3, 5, 7}, {6, 16, 4}, {7, 17, 9},
+  {13, 300, 27}, {16, 729, 147}, {12, 97, 400},
+  {27, 144, 3}, {130, 70, 260}, {8, 3100, 20}
+};
+
+Conv::datum Reference(bool row_major, bool transpose_A, bool transpose_B,
+                      const std::vector<Conv::datum>& a, int ldA,
+                      const std::vector<Conv::datum>& b, int ldB,
+                      int i, int j, int K) {
+  double sum = 0;
+  for(int k = 0; k < K; k++) {
+    Conv::datum a_value, b_value;
+    if(row_major) {
+      a_value = transpose_A ? a[k * ldA + i] : a[i * ldA + k];
+      b_value = transpose_B ? b[j * ldB + k] : b[k * ldB + j];
+    } else {
+      a_value = transpose_A ? a[i * ldA + k] : a[k * ldA + i];
+      b_value = transpose_B ? b[k * ldB + j] : b[j * ldB + k];
+    }
+    sum += a_value * b_value;
+  }
+  return (Conv::datum)sum;
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 generator(1337);
+  std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+
+  bool test_failed = false;
+
+  const Conv::CPUInstructionSet detected_isa = Conv::TensorMathKernels::DetectInstructionSet();
+  for(int isa = Conv::CPU_ISA_GENERIC; isa <= detected_isa; isa++) {
+    const Conv::TensorMathKernelTable* table =
+      Conv::TensorMathKernels::GetTable((Conv::CPUInstructionSet)isa);
+    if(table == nullptr)
+      continue;
+    Conv::TensorMathKernels::Init(table->name);
+
+    for(std::vector<int>& shape : test_shapes) {
+      const int M = shape[0], N = shape[1], K = shape[2];
+      for(int variant = 0; variant < 8; variant++) {
+        const bool row_major = (variant & 1) == 0;
+        const bool transpose_A = (variant & 2) != 0;
+        const bool transpose_B = (variant & 4) != 0;
+
+        // Leading dimensions with some padding
+        const int a_rows = row_major ^ transpose_A ? M : K;
+        const int a_cols = row_major ^ transpose_A ? K : M;
+        const int b_rows = row_major ^ transpose_B ? K : N;
+        const int b_cols = row_major ^ transpose_B ? N : K;
+        const int c_rows = row_major ? M : N;
+        const int c_cols = row_major ? N : M;
+        const int ldA = a_cols + 3, ldB = b_cols + 1, ldC = c_cols + 2;
+
+        Conv::Tensor A(a_rows * ldA), B(b_rows * ldB), C(c_rows * ldC);
+        std::vector<Conv::datum> a(A.elements()), b(B.elements()), c(C.elements());
+        for(unsigned int e = 0; e < A.elements(); e++)
+          A.data_ptr()[e] = a[e] = dist(generator);
+        for(unsigned int e = 0; e < B.elements(); e++)
+          B.data_ptr()[e] = b[e] = dist(generator);
+        for(unsigned int e = 0; e < C.elements(); e++)
+          C.data_ptr()[e] = c[e] = dist(generator);
+
+        const Conv::datum alpha = 0.75;
+        const Conv::datum beta = (variant % 3 == 0) ? 0.0 : 0.5;
+
+        Conv::TensorMath::GEMM(row_major, transpose_A, transpose_B, M, N, K,
+                               alpha, A, 0, ldA, B, 0, ldB, beta, C, 0, ldC);
+
+        unsigned int wrong = 0;
+        for(int i = 0; i < M; i++) {
+          for(int j = 0; j < N; j++) {
+            const int offset = row_major ? i * ldC + j : j * ldC + i;
+            const Conv::datum expected = alpha * Reference(row_major, transpose_A,
+              transpose_B, a, ldA, b, ldB, i, j, K) + (beta == 0.0 ? 0.0 : beta * c[offset]);
+            const Conv::datum actual = C.data_ptr_const()[offset];
+            if(std::fabs(expected - actual) > 1e-4 * (1.0 + std::sqrt((double)K)))
+              wrong++;
+          }
+        }
+
+        // Padding between rows must not be touched
+        for(int r = 0; r < c_rows; r++)
+          for(int s = c_cols; s < ldC; s++)
+            if(C.data_ptr_const()[r * ldC + s] != c[r * ldC + s])
+              wrong++;
+
+        if(wrong > 0) {
+          LOGERROR << table->name << " GEMM " << M << "x" << N << "x" << K << (row_major ? " row-major" : " column-major")
+            << (transpose_A ? " A^T" : "") << (transpose_B ? " B^T" : "") << ": " << wrong << " wrong elements";
+          test_failed = true;
+        }
+      }
+    }
+  }
+
+  if(!test_failed) {
+    LOGINFO << "All GEMM variants okay";
+  }
+
+  LOGEND;
+  return test_failed ? -1 : 0;
+}
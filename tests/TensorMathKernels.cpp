@@ -0,0 +1,500 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file TensorMathKernels.cpp
+ * @brief Compares the TensorMath kernels of every instruction set the host
+ *  supports against naive reference implementations.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cn24.h>
+
+#include "TensorMathKernels.h"
+#include "FFTConvolution.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+std::mt19937 generator(1337);
+std::uniform_real_distribution<Conv::datum> dist(-1.0, 1.0);
+
+void Randomize(Conv::Tensor& tensor) {
+  for(unsigned int e = 0; e < tensor.elements(); e++)
+    tensor.data_ptr()[e] = dist(generator);
+}
+
+bool Compare(const std::string& name, const Conv::Tensor& actual,
+             const std::vector<double>& expected) {
+  unsigned int wrong = 0;
+  for(unsigned int e = 0; e < actual.elements(); e++)
+    if(std::fabs(actual.data_ptr_const()[e] - expected[e]) > 1e-4 * (1.0 + std::fabs(expected[e])))
+      wrong++;
+  if(wrong > 0) {
+    LOGERROR << Conv::TensorMathKernels::Get().name << " " << name << ": "
+      << wrong << " wrong elements";
+  }
+  return wrong == 0;
+}
+
+// width, height, maps, samples, kernel w/h, stride w/h, pad w/h
+std::vector<std::vector<int>> conv_shapes = {
+  {7, 5, 2, 3, 3, 3, 1, 1, 1, 1},
+  {13, 11, 3, 2, 5, 3, 2, 1, 2, 0},
+  {9, 9, 1, 1, 1, 1, 1, 1, 0, 0},
+  {33, 17, 2, 2, 4, 4, 3, 2, 1, 3},
+  {8, 8, 4, 1, 8, 8, 1, 1, 0, 0},
+  {10, 9, 2, 3, 1, 2, 2, 3, 0, 1}
+};
+
+bool TestConvolutionKernels() {
+  bool okay = true;
+  for(std::vector<int>& shape : conv_shapes) {
+    const int iw = shape[0], ih = shape[1], maps = shape[2], samples = shape[3];
+    const int kw = shape[4], kh = shape[5], sw = shape[6], sh = shape[7];
+    const int pw = shape[8], ph = shape[9];
+    const int ow = (2 * pw + iw - kw) / sw + 1;
+    const int oh = (2 * ph + ih - kh) / sh + 1;
+    const int target_maps = kw * kh * maps;
+
+    Conv::Tensor image(samples, iw, ih, maps);
+    Conv::Tensor columns(target_maps, ow, oh, samples);
+    Randomize(image);
+    Randomize(columns);
+
+    std::vector<double> expected_columns(columns.elements(), 0);
+    std::vector<double> expected_image(image.elements(), 0);
+    for(int s = 0; s < samples; s++) {
+      for(int tm = 0; tm < target_maps; tm++) {
+        const int kx = tm % kw, ky = (tm / kw) % kh, imap = tm / (kw * kh);
+        for(int oy = 0; oy < oh; oy++) {
+          for(int ox = 0; ox < ow; ox++) {
+            const int ix = ox * sw - pw + kx, iy = oy * sh - ph + ky;
+            const int c = ((tm * samples + s) * oh + oy) * ow + ox;
+            if(ix >= 0 && ix < iw && iy >= 0 && iy < ih) {
+              const int i = ((s * maps + imap) * ih + iy) * iw + ix;
+              expected_columns[c] = image.data_ptr_const()[i];
+              expected_image[i] += columns.data_ptr_const()[c];
+            }
+          }
+        }
+      }
+    }
+
+    Conv::Tensor columns_result(target_maps, ow, oh, samples);
+    Conv::TensorMath::IM2COL(image, iw, ih, maps, samples, kw, kh, sw, sh, pw, ph, columns_result);
+    okay &= Compare("IM2COL", columns_result, expected_columns);
+
+    Conv::Tensor image_result(samples, iw, ih, maps);
+    Randomize(image_result);
+    Conv::TensorMath::COL2IM(image_result, iw, ih, maps, samples, kw, kh, sw, sh, pw, ph, columns);
+    okay &= Compare("COL2IM", image_result, expected_image);
+  }
+  return okay;
+}
+
+bool TestSamplingKernels() {
+  bool okay = true;
+  const int width = 12, height = 9, maps = 3, samples = 2;
+
+  Conv::Tensor source(maps, width, height, samples);
+  Conv::Tensor target(samples, width, height, maps);
+  Randomize(source);
+  std::vector<double> expected(target.elements());
+  for(int s = 0; s < samples; s++)
+    for(int m = 0; m < maps; m++)
+      for(int p = 0; p < width * height; p++)
+        expected[(s * maps + m) * width * height + p] =
+          source.data_ptr_const()[(m * samples + s) * width * height + p];
+  Conv::TensorMath::SMS(source, target);
+  okay &= Compare("SMS", target, expected);
+
+  const int rw = 3, rh = 3;
+  const Conv::datum factor = 1.0 / 9.0;
+  Conv::Tensor small(samples, width / rw, height / rh, maps);
+  Conv::Tensor large(samples, width, height, maps);
+  Randomize(large);
+  std::vector<double> expected_down(small.elements(), 0);
+  std::vector<double> expected_up(large.elements(), 0);
+  for(unsigned int plane = 0; plane < samples * maps; plane++) {
+    for(int y = 0; y < height; y++) {
+      for(int x = 0; x < width; x++) {
+        const int s = (plane * (height / rh) + y / rh) * (width / rw) + x / rw;
+        const int l = (plane * height + y) * width + x;
+        expected_down[s] += large.data_ptr_const()[l] * factor;
+      }
+    }
+  }
+  Conv::TensorMath::DOWN(large, small, rw, rh, factor);
+  okay &= Compare("DOWN", small, expected_down);
+
+  for(unsigned int plane = 0; plane < samples * maps; plane++) {
+    for(int y = 0; y < height; y++) {
+      for(int x = 0; x < width; x++) {
+        const int s = (plane * (height / rh) + y / rh) * (width / rw) + x / rw;
+        const int l = (plane * height + y) * width + x;
+        expected_up[l] = small.data_ptr_const()[s] * factor;
+      }
+    }
+  }
+  Conv::TensorMath::UP(small, large, rw, rh, factor);
+  okay &= Compare("UP", large, expected_up);
+  return okay;
+}
+
+bool TestVectorKernels() {
+  bool okay = true;
+
+  Conv::Tensor a(3, 37, 11, 5), b(3, 37, 11, 5), sum(3, 37, 11, 5);
+  Randomize(a);
+  Randomize(b);
+  std::vector<double> expected(sum.elements());
+  for(unsigned int e = 0; e < sum.elements(); e++)
+    expected[e] = a.data_ptr_const()[e] + b.data_ptr_const()[e];
+  Conv::TensorMath::ADD(a, b, sum);
+  okay &= Compare("ADD", sum, expected);
+
+  for(int variant = 0; variant < 4; variant++) {
+    const bool row_major = (variant & 1) == 0;
+    const bool transpose_A = (variant & 2) != 0;
+    const int M = 37, N = 1029, ldA = (row_major ? N : M) + 3;
+    const int x_elements = transpose_A ? M : N, y_elements = transpose_A ? N : M;
+
+    Conv::Tensor A((row_major ? M : N) * ldA), X(2 * x_elements), Y(y_elements);
+    Randomize(A);
+    Randomize(X);
+    Randomize(Y);
+    std::vector<double> expected_y(y_elements);
+    for(int i = 0; i < M; i++) {
+      for(int j = 0; j < N; j++) {
+        const double a_value = A.data_ptr_const()[row_major ? i * ldA + j : j * ldA + i];
+        if(transpose_A)
+          expected_y[j] += a_value * X.data_ptr_const()[2 * i];
+        else
+          expected_y[i] += a_value * X.data_ptr_const()[2 * j];
+      }
+    }
+    for(int i = 0; i < y_elements; i++)
+      expected_y[i] = 0.5 * expected_y[i] + 0.25 * Y.data_ptr_const()[i];
+
+    Conv::TensorMath::GEMV(row_major, transpose_A, M, N, 0.5, A, 0, ldA,
+                           X, 0, 2, 0.25, Y, 0, 1);
+    okay &= Compare(std::string("GEMV") + (row_major ? " row-major" : " column-major")
+                    + (transpose_A ? " A^T" : ""), Y, expected_y);
+  }
+  return okay;
+}
+
+bool CompareRelative(const std::string& name, const Conv::Tensor& actual,
+                     const std::vector<double>& expected, const double tolerance) {
+  unsigned int wrong = 0;
+  for(unsigned int e = 0; e < actual.elements(); e++)
+    if(std::fabs(actual.data_ptr_const()[e] - expected[e]) > tolerance * std::fabs(expected[e]))
+      wrong++;
+  if(wrong > 0) {
+    LOGERROR << Conv::TensorMathKernels::Get().name << " " << name << ": "
+      << wrong << " wrong elements";
+  }
+  return wrong == 0;
+}
+
+bool TestTranscendentalKernels() {
+  bool okay = true;
+
+  // An odd number of elements exercises the vector tails
+  const int elements = 200001;
+  const double low = -80.0, high = 80.0;
+  Conv::Tensor x(elements), y(elements);
+  for(int e = 0; e < elements; e++)
+    x.data_ptr()[e] = (Conv::datum)(low + (high - low) * e / (elements - 1));
+  std::vector<double> expected(elements);
+
+  for(int e = 0; e < elements; e++)
+    expected[e] = std::exp((double)x.data_ptr_const()[e]);
+  Conv::TensorMath::EXP(x, y);
+  okay &= CompareRelative("EXP", y, expected, 2e-7);
+
+  for(int e = 0; e < elements; e++)
+    expected[e] = 1.0 / (1.0 + std::exp(-(double)x.data_ptr_const()[e]));
+  Conv::TensorMath::ACTIVATION(x, Conv::ACTIVATION_SIGMOID, y);
+  okay &= CompareRelative("ACTIVATION sigmoid", y, expected, 3e-7);
+
+  for(int e = 0; e < elements; e++)
+    expected[e] = std::tanh((double)x.data_ptr_const()[e]);
+  Conv::TensorMath::ACTIVATION(x, Conv::ACTIVATION_TANH, y);
+  okay &= CompareRelative("ACTIVATION tanh", y, expected, 5e-7);
+
+  for(int e = 0; e < elements; e++) {
+    const double input = 0.5 * x.data_ptr_const()[e] - 0.25;
+    expected[e] = input > 0 ? input : 0;
+  }
+  Conv::TensorMath::ACTIVATION(x, Conv::ACTIVATION_RELU, y, 0.5, -0.25);
+  okay &= Compare("ACTIVATION relu", y, expected);
+
+  // Exact math reproduces the libm formulas of the NonLinearityLayers
+  Conv::TensorMathKernels::SetExactMath(true);
+  Conv::TensorMath::ACTIVATION(x, Conv::ACTIVATION_TANH, y);
+  unsigned int different = 0;
+  for(int e = 0; e < elements; e++) {
+    const Conv::datum legacy = 1.0 - 2.0 / (exp (2.0 * x.data_ptr_const()[e]) + 1.0);
+    if(legacy != y.data_ptr_const()[e])
+      different++;
+  }
+  Conv::TensorMathKernels::SetExactMath(false);
+  if(different > 0) {
+    LOGERROR << Conv::TensorMathKernels::Get().name << " exact tanh: "
+      << different << " different elements";
+    okay = false;
+  }
+  return okay;
+}
+
+// 36 GEMMs C[e] = A[e] * B[e] (or A[e] * B[e]^T) of Winograd transformed tensors
+void WinogradGEMMs(const bool transpose_B, const int M, const int N, const int K,
+                   const Conv::Tensor& A, const Conv::Tensor& B, Conv::Tensor& C) {
+  for(int e = 0; e < 36; e++)
+    Conv::TensorMath::GEMM(true, false, transpose_B, M, N, K, 1.0, A, e, K,
+                           B, e, transpose_B ? K : N, 0.0, C, e, N);
+}
+
+bool TestWinogradKernels() {
+  bool okay = true;
+  const int iw = 11, ih = 9, input_maps = 3, output_maps = 4, samples = 2, pad = 1;
+  const int ow = iw + 2 * pad - 2, oh = ih + 2 * pad - 2;
+  const int tiles_x = (ow + 3) / 4, tiles_y = (oh + 3) / 4, tiles = samples * tiles_x * tiles_y;
+  const int input_tiles_x = (iw + 3) / 4, input_tiles_y = (ih + 3) / 4;
+  const int input_tiles = samples * input_tiles_x * input_tiles_y;
+
+  Conv::Tensor input(samples, iw, ih, input_maps), output_delta(samples, ow, oh, output_maps);
+  Conv::Tensor weights(output_maps, 3, 3, input_maps), bias(1, output_maps);
+  Randomize(input);
+  Randomize(output_delta);
+  Randomize(weights);
+  Randomize(bias);
+
+  std::vector<double> expected_output(samples * output_maps * oh * ow, 0);
+  std::vector<double> expected_input_delta(input.elements(), 0);
+  std::vector<double> expected_weights_delta(weights.elements(), 0);
+  for(int s = 0; s < samples; s++) {
+    for(int o = 0; o < output_maps; o++) {
+      for(int oy = 0; oy < oh; oy++) {
+        for(int ox = 0; ox < ow; ox++) {
+          const int out = ((s * output_maps + o) * oh + oy) * ow + ox;
+          expected_output[out] = bias.data_ptr_const()[o];
+          for(int c = 0; c < input_maps; c++) {
+            for(int k = 0; k < 9; k++) {
+              const int iy = oy + k / 3 - pad, ix = ox + k % 3 - pad;
+              if(ix < 0 || ix >= iw || iy < 0 || iy >= ih)
+                continue;
+              const int in = ((s * input_maps + c) * ih + iy) * iw + ix;
+              const int w = (o * input_maps + c) * 9 + k;
+              expected_output[out] += weights.data_ptr_const()[w] * input.data_ptr_const()[in];
+              expected_input_delta[in] += weights.data_ptr_const()[w] * output_delta.data_ptr_const()[out];
+              expected_weights_delta[w] += input.data_ptr_const()[in] * output_delta.data_ptr_const()[out];
+            }
+          }
+        }
+      }
+    }
+  }
+
+  Conv::Tensor filter(36, input_maps, output_maps), transformed_input(36, tiles, input_maps);
+  Conv::Tensor product(36, tiles, output_maps), output(samples, ow, oh, output_maps);
+  Conv::TensorMath::WINOGRAD_FILTER(weights, output_maps, input_maps, false, filter);
+  Conv::TensorMath::WINOGRAD_INPUT(input, iw, ih, input_maps, samples, -pad, -pad, tiles_x, tiles_y, transformed_input);
+  WinogradGEMMs(false, output_maps, tiles, input_maps, filter, transformed_input, product);
+  Conv::TensorMath::WINOGRAD_OUTPUT(product, tiles_x, tiles_y, 1.0, &bias, output, ow, oh, output_maps, samples);
+  okay &= Compare("WINOGRAD forward", output, expected_output);
+
+  Conv::Tensor filter_delta(36, input_maps, output_maps), weights_delta(output_maps, 3, 3, input_maps);
+  Conv::TensorMath::WINOGRAD_DELTA(output_delta, ow, oh, output_maps, samples, tiles_x, tiles_y, product);
+  WinogradGEMMs(true, output_maps, input_maps, tiles, product, transformed_input, filter_delta);
+  Conv::TensorMath::WINOGRAD_FILTER_GRADIENT(filter_delta, output_maps, input_maps, weights_delta);
+  okay &= Compare("WINOGRAD weight gradient", weights_delta, expected_weights_delta);
+
+  Conv::Tensor flipped_filter(36, output_maps, input_maps), transformed_delta(36, input_tiles, output_maps);
+  Conv::Tensor delta_product(36, input_tiles, input_maps), input_delta(samples, iw, ih, input_maps);
+  Conv::TensorMath::WINOGRAD_FILTER(weights, output_maps, input_maps, true, flipped_filter);
+  Conv::TensorMath::WINOGRAD_INPUT(output_delta, ow, oh, output_maps, samples, pad - 2, pad - 2,
+                                   input_tiles_x, input_tiles_y, transformed_delta);
+  WinogradGEMMs(false, input_maps, input_tiles, output_maps, flipped_filter, transformed_delta, delta_product);
+  Conv::TensorMath::WINOGRAD_OUTPUT(delta_product, input_tiles_x, input_tiles_y, 1.0, nullptr,
+                                    input_delta, iw, ih, input_maps, samples);
+  okay &= Compare("WINOGRAD input gradient", input_delta, expected_input_delta);
+  return okay;
+}
+
+// width, height, input maps, output maps, samples, kernel w/h, pad w/h.
+// The FFT grids are 30x18 and 32x18, covering radices 2, 3, 4 and 5.
+std::vector<std::vector<int>> fft_shapes = {
+  {26, 16, 3, 4, 2, 5, 3, 2, 1},
+  {28, 11, 2, 5, 3, 5, 5, 2, 3}
+};
+
+bool TestFFTKernels() {
+  bool okay = true;
+  for(std::vector<int>& shape : fft_shapes) {
+    const int iw = shape[0], ih = shape[1], input_maps = shape[2], output_maps = shape[3];
+    const int samples = shape[4], kw = shape[5], kh = shape[6], pw = shape[7], ph = shape[8];
+    const Conv::ConvolutionGeometry geometry(iw, ih, input_maps, samples, kw, kh, 1, 1, pw, ph);
+    const int ow = geometry.output_width, oh = geometry.output_height;
+
+    Conv::Tensor input(samples, iw, ih, input_maps), output_delta(samples, ow, oh, output_maps);
+    Conv::Tensor weights(output_maps, kw, kh, input_maps), bias(1, output_maps);
+    Randomize(input);
+    Randomize(output_delta);
+    Randomize(weights);
+    Randomize(bias);
+
+    std::vector<double> expected_output(samples * output_maps * oh * ow, 0);
+    std::vector<double> expected_input_delta(input.elements(), 0);
+    std::vector<double> expected_weights_delta(weights.elements(), 0);
+    std::vector<double> expected_bias_delta(output_maps, 0);
+    for(int s = 0; s < samples; s++) {
+      for(int o = 0; o < output_maps; o++) {
+        for(int oy = 0; oy < oh; oy++) {
+          for(int ox = 0; ox < ow; ox++) {
+            const int out = ((s * output_maps + o) * oh + oy) * ow + ox;
+            expected_output[out] = bias.data_ptr_const()[o];
+            expected_bias_delta[o] += output_delta.data_ptr_const()[out];
+            for(int c = 0; c < input_maps; c++) {
+              for(int k = 0; k < kw * kh; k++) {
+                const int iy = oy + k / kw - ph, ix = ox + k % kw - pw;
+                if(ix < 0 || ix >= iw || iy < 0 || iy >= ih)
+                  continue;
+                const int in = ((s * input_maps + c) * ih + iy) * iw + ix;
+                const int w = (o * input_maps + c) * kw * kh + k;
+                expected_output[out] += weights.data_ptr_const()[w] * input.data_ptr_const()[in];
+                expected_input_delta[in] += weights.data_ptr_const()[w] * output_delta.data_ptr_const()[out];
+                expected_weights_delta[w] += input.data_ptr_const()[in] * output_delta.data_ptr_const()[out];
+              }
+            }
+          }
+        }
+      }
+    }
+
+    Conv::FFTConvolution convolution(geometry, output_maps);
+    Conv::Tensor output(samples, ow, oh, output_maps), input_delta(samples, iw, ih, input_maps);
+    Conv::Tensor weights_delta(output_maps, kw, kh, input_maps), bias_delta(1, output_maps);
+    convolution.SetWeights(weights.data_ptr_const());
+    convolution.Forward(input.data_ptr_const(), 1.0, bias.data_ptr_const(), output.data_ptr());
+    convolution.Backward(output_delta.data_ptr_const(), input_delta.data_ptr(),
+                         weights_delta.data_ptr(), bias_delta.data_ptr());
+    okay &= Compare("FFT forward", output, expected_output);
+    okay &= Compare("FFT input gradient", input_delta, expected_input_delta);
+    okay &= Compare("FFT weight gradient", weights_delta, expected_weights_delta);
+    okay &= Compare("FFT bias gradient", bias_delta, expected_bias_delta);
+  }
+  return okay;
+}
+
+// M, N, K, transposed B and C
+std::vector<std::vector<int>> int8_shapes = {
+  {5, 37, 27, 0},
+  {8, 16, 8, 0},
+  {3, 5, 1, 1},
+  {9, 50, 30, 1}
+};
+
+bool TestInt8Kernels() {
+  const Conv::TensorMathKernelTable& kernels = Conv::TensorMathKernels::Get();
+  const int lanes = CN24_INT8_LANES;
+  std::uniform_int_distribution<int> fixed(-40000, 40000), byte(-127, 127);
+  bool okay = true;
+  for(std::vector<int>& shape : int8_shapes) {
+    const int M = shape[0], N = shape[1], K = shape[2];
+    const bool transposed = shape[3] == 1;
+    const int K4 = (K + 3) / 4, panels = (N + lanes - 1) / lanes;
+
+    // Quantized values are multiples of 1/256, so rounding is exact
+    const Conv::datum scale = 1.0 / 64.0;
+    std::vector<Conv::datum> B(K * N);
+    for(Conv::datum& b : B)
+      b = (Conv::datum)fixed(generator) / (Conv::datum)16384.0;
+    const int k_stride = transposed ? 1 : N, n_stride = transposed ? K : 1;
+
+    std::vector<std::uint8_t> expected_packed(panels * K4 * lanes * 4, 128);
+    for(int k = 0; k < K; k++) {
+      for(int n = 0; n < N; n++) {
+        const double q = std::floor(B[k * k_stride + n * n_stride] / scale + 0.5);
+        expected_packed[((n / lanes) * K4 + k / 4) * lanes * 4 + (n % lanes) * 4 + k % 4] =
+          (std::uint8_t)(std::max(-127.0, std::min(127.0, q)) + 128);
+      }
+    }
+    std::vector<std::uint8_t> packed(expected_packed.size(), 0);
+    kernels.pack_u8(&B[0], K, N, k_stride, n_stride, scale, &packed[0]);
+    if(packed != expected_packed) {
+      LOGERROR << kernels.name << " pack_u8 " << M << "x" << N << "x" << K << ": wrong packed matrix";
+      okay = false;
+      continue;
+    }
+
+    std::vector<std::int8_t> A(M * K4 * 4, 0);
+    std::vector<std::int32_t> offset(M);
+    std::vector<Conv::datum> scales(M);
+    for(int m = 0; m < M; m++) {
+      for(int k = 0; k < K; k++)
+        A[m * K4 * 4 + k] = (std::int8_t)byte(generator);
+      offset[m] = byte(generator) * 1000;
+      scales[m] = dist(generator);
+    }
+
+    // The guard after C has to stay untouched
+    const int m_stride = transposed ? 1 : N, c_stride = transposed ? M : 1;
+    const Conv::datum guard = -12345;
+    std::vector<Conv::datum> C(M * N + lanes, guard), expected_C(M * N + lanes, guard);
+    for(int m = 0; m < M; m++) {
+      for(int n = 0; n < N; n++) {
+        std::int32_t sum = 0;
+        for(int k = 0; k < K4 * 4; k++)
+          sum += A[m * K4 * 4 + k] * expected_packed[((n / lanes) * K4 + k / 4) * lanes * 4 + (n % lanes) * 4 + k % 4];
+        expected_C[m * m_stride + n * c_stride] = scales[m] * (Conv::datum)(sum - offset[m]);
+      }
+    }
+    kernels.gemm_u8s8(M, N, K, &A[0], &packed[0], &offset[0], &scales[0], &C[0], m_stride, c_stride);
+    if(C != expected_C) {
+      LOGERROR << kernels.name << " gemm_u8s8 " << M << "x" << N << "x" << K << ": wrong product";
+      okay = false;
+    }
+  }
+  return okay;
+}
+
+int main() {
+  Conv::System::Init();
+
+  bool test_failed = false;
+
+  const Conv::CPUInstructionSet detected_isa = Conv::TensorMathKernels::DetectInstructionSet();
+  for(int isa = Conv::CPU_ISA_GENERIC; isa <= detected_isa; isa++) {
+    const Conv::TensorMathKernelTable* table =
+      Conv::TensorMathKernels::GetTable((Conv::CPUInstructionSet)isa);
+    if(table == nullptr)
+      continue;
+    Conv::TensorMathKernels::Init(table->name);
+
+    test_failed |= !TestConvolutionKernels();
+    test_failed |= !TestSamplingKernels();
+    test_failed |= !TestVectorKernels();
+    test_failed |= !TestTranscendentalKernels();
+    test_failed |= !TestWinogradKernels();
+    test_failed |= !TestFFTKernels();
+    test_failed |= !TestInt8Kernels();
+  }
+
+  if(!test_failed) {
+    LOGINFO << "All kernels okay";
+  }
+
+  LOGEND;
+  return test_failed ? -1 : 0;
+}
@@ -0,0 +1,211 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file TensorStreamCodec.cpp
+ * @brief Compresses typical tensors with both codecs, checks that they are
+ *  restored exactly and that the block codec beats run length encoding.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cn24.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+const unsigned int WIDTH = 320;
+const unsigned int HEIGHT = 240;
+const unsigned int CLASSES = 6;
+
+// Smooth gradients with some sensor noise, stored like images are imported
+void MakeImage(Conv::Tensor& tensor, std::mt19937& generator) {
+  std::uniform_int_distribution<int> noise(-2, 2);
+  for(unsigned int map = 0; map < tensor.maps(); map++) {
+    for(unsigned int y = 0; y < tensor.height(); y++) {
+      for(unsigned int x = 0; x < tensor.width(); x++) {
+        int value = 128 + (int)(60.0 * std::sin(0.02 * (x + 3 * map)) + 50.0 * std::cos(0.03 * y)) + noise(generator);
+        value = value < 0 ? 0 : (value > 255 ? 255 : value);
+        *tensor.data_ptr(x, y, map, 0) = DATUM_FROM_UCHAR(value);
+      }
+    }
+  }
+}
+
+// One-hot labels of a few large regions
+void MakeLabels(Conv::Tensor& tensor) {
+  tensor.Clear();
+  for(unsigned int y = 0; y < tensor.height(); y++) {
+    for(unsigned int x = 0; x < tensor.width(); x++) {
+      const unsigned int label = (x / 64 + (y / 48) * 2) % tensor.maps();
+      *tensor.data_ptr(x, y, label, 0) = 1;
+    }
+  }
+}
+
+// Values that are not bytes, including some that repeat
+void MakeFloats(Conv::Tensor& tensor, std::mt19937& generator) {
+  std::normal_distribution<Conv::datum> dist(0, 1);
+  for(std::size_t e = 0; e < tensor.elements(); e++)
+    tensor.data_ptr()[e] = (e % 5 == 0) ? (Conv::datum)-0.0 : dist(generator);
+}
+
+bool SameBits(const Conv::Tensor& expected, const Conv::Tensor& actual) {
+  return expected.elements() == actual.elements() &&
+    std::memcmp(expected.data_ptr_const(), actual.data_ptr_const(), expected.elements() * sizeof(Conv::datum)) == 0;
+}
+
+struct CodecResult {
+  std::size_t compressed_bytes = 0;
+  double seconds = 0;
+};
+
+CodecResult Check(const std::vector<Conv::Tensor*>& tensors, Conv::CompressionCodec codec, const std::string& codec_name, bool& passed) {
+  CodecResult result;
+  for(Conv::Tensor* tensor : tensors) {
+    Conv::CompressedTensor ctensor;
+    ctensor.Compress(*tensor, codec);
+    result.compressed_bytes += ctensor.compressed_length();
+
+    Conv::Tensor decompressed;
+    ctensor.Decompress(decompressed);
+    if(!SameBits(*tensor, decompressed)) {
+      LOGERROR << codec_name << " changed " << *tensor;
+      passed = false;
+    }
+
+    // Decompress a couple of times to measure the throughput
+    Conv::Tensor target(tensor->samples(), tensor->width(), tensor->height(), tensor->maps());
+    std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+    for(unsigned int repetition = 0; repetition < 10; repetition++)
+      ctensor.Decompress(target.data_ptr());
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.seconds += elapsed.count();
+  }
+  return result;
+}
+
+// Writes and reads a stream of the tensors in the version matching the codec
+bool CheckStream(const std::vector<Conv::Tensor*>& tensors, Conv::CompressionCodec codec) {
+  const std::string file_name = codec == Conv::CODEC_BLOCK ? "TensorStreamCodec2.cts" : "TensorStreamCodec1.cts";
+  {
+    std::ofstream output(file_name, std::ios::out | std::ios::binary);
+    uint64_t magic = codec == Conv::CODEC_BLOCK ? CN24_CTS2_MAGIC : CN24_CTS_MAGIC;
+    output.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
+    for(Conv::Tensor* tensor : tensors) {
+      Conv::CompressedTensor ctensor;
+      ctensor.Compress(*tensor, codec);
+      ctensor.Serialize(output);
+    }
+  }
+
+  Conv::TensorStream* stream = Conv::TensorStream::FromFile(file_name);
+  std::remove(file_name.c_str());
+  bool passed = stream->GetTensorCount() == tensors.size();
+  for(unsigned int t = 0; passed && t < tensors.size(); t++) {
+    Conv::Tensor target(1, tensors[t]->width(), tensors[t]->height(), tensors[t]->maps());
+    passed &= stream->CopySample(t, 0, target, 0) && SameBits(*tensors[t], target);
+  }
+  delete stream;
+
+  if(!passed)
+    LOGERROR << "Stream " << file_name << " differs";
+  return passed;
+}
+
+// A version 2 header without blocks has to be rejected instead of decoding nothing
+bool CheckMissingBlocks() {
+  const std::string file_name = "TensorStreamCodecBroken.cts";
+  {
+    std::ofstream output(file_name, std::ios::out | std::ios::binary);
+    const uint64_t header[] = {CN24_CTS2_MAGIC, 1, 4, 1, 1, 1, 0};
+    const double scale = 1;
+    const uint64_t compressed_length = sizeof(uint64_t);
+    const uint64_t payload = sizeof(uint64_t);
+    output.write((const char*)header, sizeof(header));
+    output.write((const char*)&scale, sizeof(scale));
+    output.write((const char*)&compressed_length, sizeof(compressed_length));
+    output.write((const char*)&payload, sizeof(payload));
+  }
+
+  Conv::CompressedTensorStream stream;
+  stream.LoadFile(file_name);
+  std::remove(file_name.c_str());
+  Conv::Tensor target(1, 4, 1, 1);
+  bool rejected = false;
+  try {
+    stream.CopySample(0, 0, target, 0);
+  } catch(std::runtime_error&) {
+    rejected = true;
+  }
+
+  if(!rejected)
+    LOGERROR << "Tensor without blocks was decoded";
+  return rejected;
+}
+
+int main (int argc, char* argv[]) {
+  UNREFERENCED_PARAMETER(argc);
+  UNREFERENCED_PARAMETER(argv);
+  Conv::System::Init();
+
+  std::mt19937 generator(1337);
+  std::vector<Conv::Tensor*> tensors;
+  for(unsigned int t = 0; t < 3; t++) {
+    Conv::Tensor* image = new Conv::Tensor(1, WIDTH, HEIGHT, 3);
+    MakeImage(*image, generator);
+    tensors.push_back(image);
+    Conv::Tensor* labels = new Conv::Tensor(1, WIDTH, HEIGHT, CLASSES);
+    MakeLabels(*labels);
+    tensors.push_back(labels);
+  }
+  Conv::Tensor* floats = new Conv::Tensor(1, 100, 70, 2);
+  MakeFloats(*floats, generator);
+  tensors.push_back(floats);
+  tensors.push_back(new Conv::Tensor(1, 3, 1, 1));
+  MakeFloats(*tensors.back(), generator);
+
+  bool passed = true;
+  const CodecResult rle = Check(tensors, Conv::CODEC_RLE, "RLE", passed);
+  const CodecResult block = Check(tensors, Conv::CODEC_BLOCK, "Block codec", passed);
+
+  std::size_t uncompressed_bytes = 0;
+  for(Conv::Tensor* tensor : tensors)
+    uncompressed_bytes += tensor->elements() * sizeof(Conv::datum);
+
+  LOGINFO << "RLE: " << 100.0 * (double)rle.compressed_bytes / (double)uncompressed_bytes << "%, "
+    << 10.0 * (double)uncompressed_bytes / 1048576.0 / rle.seconds << " MiB/s";
+  LOGINFO << "Block codec: " << 100.0 * (double)block.compressed_bytes / (double)uncompressed_bytes << "%, "
+    << 10.0 * (double)uncompressed_bytes / 1048576.0 / block.seconds << " MiB/s";
+
+  if(block.compressed_bytes >= rle.compressed_bytes) {
+    LOGERROR << "Block codec does not compress better than RLE";
+    passed = false;
+  }
+
+  // Version 1 streams must stay readable
+  passed &= CheckStream(tensors, Conv::CODEC_RLE);
+  passed &= CheckStream(tensors, Conv::CODEC_BLOCK);
+  passed &= CheckMissingBlocks();
+
+  for(Conv::Tensor* tensor : tensors)
+    delete tensor;
+
+  if(!passed)
+    FATAL("Codec test failed!");
+
+  LOGINFO << "All tests passed!";
+  LOGEND;
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+/**
+ * @file TestNet.h
+ * @brief Nets built from a configuration string and random inputs for
+ *  them, shared by the tests that compare two ways of running the same net.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_TESTNET_H
+#define CONV_TESTNET_H
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cn24.h>
+
+/*
+ * Random data in [0, 1) with one-hot labels, sample s is of class
+ * s % classes. All samples have the weight 1.
+ */
+struct TestInput {
+  TestInput(const unsigned int samples, const unsigned int width, const unsigned int height,
+    const unsigned int classes) : data(samples, width, height, 3), label(samples, 1, 1, classes),
+    helper(samples, 1, 1, 2), weight(samples, 1, 1, 1) {
+    std::mt19937 rand(1337);
+    std::uniform_real_distribution<Conv::datum> dist(0.0, 1.0);
+    for(std::size_t e = 0; e < data.elements(); e++)
+      data[e] = dist(rand);
+    label.Clear(0.0);
+    for(unsigned int sample = 0; sample < samples; sample++)
+      *label.data_ptr(0, 0, sample % classes, sample) = 1.0;
+    helper.Clear(0.0);
+    weight.Clear(1.0);
+  }
+
+  Conv::Tensor data;
+  Conv::Tensor label;
+  Conv::Tensor helper;
+  Conv::Tensor weight;
+};
+
+/*
+ * Training set of a TestInput. A batch as large as the set contains all
+ * samples in some order, so every pass computes the same gradients.
+ */
+class TestDataset : public Conv::Dataset {
+public:
+  TestDataset(const unsigned int samples, const unsigned int width, const unsigned int height,
+    const unsigned int classes) : input_(samples, width, height, classes), classes_(classes) {}
+
+  Conv::Task GetTask() const { return Conv::SEMANTIC_SEGMENTATION; }
+  Conv::Method GetMethod() const { return Conv::PATCH; }
+  unsigned int GetWidth() const { return input_.data.width(); }
+  unsigned int GetHeight() const { return input_.data.height(); }
+  unsigned int GetInputMaps() const { return input_.data.maps(); }
+  unsigned int GetLabelMaps() const { return classes_; }
+  unsigned int GetClasses() const { return classes_; }
+  std::vector<std::string> GetClassNames() const { return std::vector<std::string>(classes_, "class"); }
+  std::vector<unsigned int> GetClassColors() const { return std::vector<unsigned int>(classes_, 0); }
+  std::vector<Conv::datum> GetClassWeights() const { return std::vector<Conv::datum>(classes_, 1.0); }
+  unsigned int GetTrainingSamples() const { return input_.data.samples(); }
+  unsigned int GetTestingSamples() const { return 0; }
+  bool SupportsTesting() const { return false; }
+
+  bool GetTrainingSample(Conv::Tensor& data_tensor, Conv::Tensor& label_tensor,
+    Conv::Tensor& helper_tensor, Conv::Tensor& weight_tensor, unsigned int sample, unsigned int index) {
+    return Conv::Tensor::CopySample(input_.data, index, data_tensor, sample) &&
+      Conv::Tensor::CopySample(input_.label, index, label_tensor, sample) &&
+      Conv::Tensor::CopySample(input_.helper, index, helper_tensor, sample) &&
+      Conv::Tensor::CopySample(input_.weight, index, weight_tensor, sample);
+  }
+
+  bool GetTestingSample(Conv::Tensor& data_tensor, Conv::Tensor& label_tensor,
+    Conv::Tensor& helper_tensor, Conv::Tensor& weight_tensor, unsigned int sample, unsigned int index) {
+    UNREFERENCED_PARAMETER(data_tensor);
+    UNREFERENCED_PARAMETER(label_tensor);
+    UNREFERENCED_PARAMETER(helper_tensor);
+    UNREFERENCED_PARAMETER(weight_tensor);
+    UNREFERENCED_PARAMETER(sample);
+    UNREFERENCED_PARAMETER(index);
+    return false;
+  }
+
+private:
+  TestInput input_;
+  const unsigned int classes_;
+};
+
+/*
+ * Adds the layers of the configuration on top of the input layer. The graph
+ * is not initialized, so tests can change its settings first.
+ */
+struct TestNet {
+  TestNet(const std::string& configuration, Conv::Layer* input_layer, const unsigned int classes,
+    const bool training = true) : input_node(input_layer) {
+    std::stringstream net_config(configuration);
+    Conv::ConfigurableFactory factory(net_config, 238238, training);
+    input_node.is_input = true;
+    graph.AddNode(&input_node);
+    if(!factory.AddLayers(graph, Conv::NetGraphConnection(&input_node), classes, training))
+      FATAL("Failed completeness check, inspect model!");
+  }
+
+  // Output of the last forward pass
+  std::vector<Conv::datum> Output() {
+    const Conv::Tensor& output = graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+    return std::vector<Conv::datum>(output.data_ptr_const(), output.data_ptr_const() + output.elements());
+  }
+
+  // Loss and parameter gradients of one forward and backward pass
+  std::vector<Conv::datum> Run() {
+    graph.FeedForward();
+    std::vector<Conv::datum> result(1, graph.AggregateLoss());
+    graph.BackPropagate();
+    std::vector<Conv::CombinedTensor*> parameters;
+    graph.GetParameters(parameters);
+    for(Conv::CombinedTensor* parameter : parameters)
+      result.insert(result.end(), parameter->delta.data_ptr_const(),
+        parameter->delta.data_ptr_const() + parameter->delta.elements());
+    return result;
+  }
+
+  // Parameters, one after another
+  std::vector<Conv::datum> Parameters() {
+    std::vector<Conv::CombinedTensor*> parameters;
+    graph.GetParameters(parameters);
+    std::vector<Conv::datum> result;
+    for(Conv::CombinedTensor* parameter : parameters)
+      result.insert(result.end(), parameter->data.data_ptr_const(),
+        parameter->data.data_ptr_const() + parameter->data.elements());
+    return result;
+  }
+
+  Conv::NetGraph graph;
+  Conv::NetGraphNode input_node;
+};
+
+inline std::size_t LiveBytes() {
+  return Conv::TensorAllocator::GetStats().bytes_live;
+}
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file calibrateNetwork.cpp
+ * @brief Prepares a trained net for 8 bit inference.
+ *
+ * Runs the testing set through the net to record the input range of every
+ * convolutional layer, then tests again with quantized convolutions and
+ * reports how much the statistics changed. The ranges are written to a
+ * file that classifyImage can use.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <cn24.h>
+
+/*
+ * Keeps the values of the last Generate call
+ */
+class RecordingStatSink : public Conv::StatSink {
+public:
+  void Initialize(std::vector<Conv::StatDescriptor*>& stat_descriptors) {
+    stat_descriptors_ = stat_descriptors;
+  }
+  void SetCurrentExperiment(std::string current_experiment) {
+    UNREFERENCED_PARAMETER(current_experiment);
+  }
+  void Process(Conv::HardcodedStats& hardcoded_stats, std::vector<Conv::Stat*>& stats) {
+    UNREFERENCED_PARAMETER(hardcoded_stats);
+    values.clear();
+    for(Conv::Stat* stat : stats)
+      values.push_back(*stat);
+  }
+
+  std::vector<Conv::StatDescriptor*> stat_descriptors_;
+  std::vector<Conv::Stat> values;
+};
+
+int main (int argc, char* argv[]) {
+  if (argc < 5) {
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <calibration output file>";
+    LOGEND;
+    return -1;
+  }
+
+  // Capture command line arguments
+  std::string calibration_fname (argv[4]);
+  std::string param_tensor_fname (argv[3]);
+  std::string net_config_fname (argv[2]);
+  std::string dataset_config_fname (argv[1]);
+
+  // Initialize CN24
+  Conv::System::Init();
+
+  RecordingStatSink recording_stat_sink;
+  Conv::System::stat_aggregator->RegisterSink(&recording_stat_sink);
+
+  // Open network and dataset configuration files
+  std::ifstream param_tensor_file(param_tensor_fname,std::ios::in | std::ios::binary);
+  std::ifstream net_config_file(net_config_fname,std::ios::in);
+  std::ifstream dataset_config_file(dataset_config_fname,std::ios::in);
+
+  if(!param_tensor_file.good()) {
+    FATAL("Cannot open param tensor file!");
+  }
+  if(!net_config_file.good()) {
+    FATAL("Cannot open net configuration file!");
+  }
+  if(!dataset_config_file.good()) {
+    FATAL("Cannot open dataset configuration file!");
+  }
+
+  // Calibrate the fully convolutional net, the same one classifyImage uses
+  Conv::ConfigurableFactory* factory = new Conv::ConfigurableFactory(net_config_file, 238238, false);
+  factory->InitOptimalSettings();
+  Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration(dataset_config_file, false, Conv::LOAD_TESTING_ONLY);
+  unsigned int CLASSES = dataset->GetClasses();
+
+  // Patchwise nets are tested on whole images one at a time, see trainNetwork
+  Conv::TrainerSettings settings = factory->optimal_settings();
+  if(factory->method() == Conv::PATCH) {
+    settings.pbatchsize = 1;
+    settings.sbatchsize = 1;
+  }
+
+  // Assemble net, it is only tested
+  Conv::NetGraph graph;
+  graph.SetInferenceOnly(true);
+  Conv::DatasetInputLayer* data_layer = new Conv::DatasetInputLayer(*dataset, settings.pbatchsize, 1.0, 983923);
+  Conv::NetGraphNode* input_node = new Conv::NetGraphNode(data_layer);
+  input_node->is_input = true;
+  graph.AddNode(input_node);
+
+  bool complete = factory->AddLayers(graph, Conv::NetGraphConnection(input_node), CLASSES, true);
+  if (!complete)
+    FATAL("Failed completeness check, inspect model!");
+
+  for (Conv::NetGraphNode* output_node : graph.GetOutputNodes()) {
+    Conv::NetGraphNode* stat_node = nullptr;
+    if (CLASSES == 1) {
+      stat_node = new Conv::NetGraphNode(new Conv::BinaryStatLayer(13, -1, 1));
+    } else {
+      stat_node = new Conv::NetGraphNode(new Conv::ConfusionMatrixLayer(dataset->GetClassNames(), CLASSES));
+    }
+    stat_node->input_connections.push_back(Conv::NetGraphConnection(output_node, 0, false));
+    stat_node->input_connections.push_back(Conv::NetGraphConnection(input_node, 1));
+    stat_node->input_connections.push_back(Conv::NetGraphConnection(input_node, 3));
+    graph.AddNode(stat_node);
+  }
+
+  graph.Initialize();
+
+  // Load network parameters
+  graph.DeserializeParameters(param_tensor_file);
+
+  Conv::Trainer trainer(graph, settings);
+  Conv::System::stat_aggregator->Initialize();
+
+  // Test in 32 bit, recording the input ranges on the way, then in 8 bit
+  std::vector<Conv::Stat> results[2];
+  for (unsigned int pass = 0; pass < 2; pass++) {
+    LOGINFO << (pass == 0 ? "Calibrating..." : "Testing quantized net...") << std::flush;
+    graph.SetCalibrationEnabled(pass == 0);
+    graph.SetQuantizationEnabled(pass == 1);
+
+    Conv::System::stat_aggregator->StartRecording();
+    trainer.Test();
+    Conv::System::stat_aggregator->StopRecording();
+    Conv::System::stat_aggregator->Generate();
+    Conv::System::stat_aggregator->Reset();
+    results[pass] = recording_stat_sink.values;
+  }
+
+  LOGRESULT << std::setw(32) << "Statistic" << std::setw(16) << "32 bit" << std::setw(16) << "8 bit" << std::setw(16) << "Change" << LOGRESULTEND;
+  for (unsigned int s = 0; s < results[0].size(); s++) {
+    if (results[0][s].is_null || results[1][s].is_null)
+      continue;
+    LOGRESULT << std::setw(32) << recording_stat_sink.stat_descriptors_[s]->description <<
+      std::setw(16) << results[0][s].value << std::setw(16) << results[1][s].value <<
+      std::setw(16) << results[1][s].value - results[0][s].value << " " <<
+      recording_stat_sink.stat_descriptors_[s]->unit << LOGRESULTEND;
+  }
+
+  std::ofstream calibration_file(calibration_fname, std::ios::out);
+  if (!calibration_file.good()) {
+    FATAL("Cannot open " << calibration_fname);
+  }
+  graph.SerializeCalibration(calibration_file);
+  LOGINFO << "Written calibration to " << calibration_fname;
+
+  LOGINFO << "DONE!";
+  LOGEND;
+  return 0;
+}
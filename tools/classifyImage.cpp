@@ -20,7 +20,7 @@
 
 int main (int argc, char* argv[]) {
   if (argc < 6) {
-    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <input image file> <output image file>";
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <input image file> <output image file> [calibration file]";
     LOGEND;
     return -1;
   }
@@ -120,12 +120,27 @@ int main (int argc, char* argv[]) {
 	if (!complete)
     FATAL("Failed completeness check, inspect model!");
 
+	// Only the forward pass runs, so there are no deltas and the hidden
+	// outputs can share memory
+	graph.SetInferenceOnly(true);
+	graph.SetMemoryPlanningEnabled(true);
 	graph.Initialize();
 
 
   // Load network parameters
   graph.DeserializeParameters(param_tensor_file);
   
+  // Run the convolutions in 8 bit, see calibrateNetwork
+  if(argc > 6) {
+    std::ifstream calibration_file(argv[6], std::ios::in);
+    if(!calibration_file.good()) {
+      FATAL("Cannot open calibration file!");
+    }
+    if(!graph.DeserializeCalibration(calibration_file)) {
+      FATAL("Cannot read calibration file!");
+    }
+  }
+  
   graph.SetIsTesting(true);
   LOGINFO << "Classifying..." << std::flush;
   graph.FeedForward();
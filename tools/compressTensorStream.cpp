@@ -13,12 +13,28 @@
 int main(int argc, char** argv) {
   Conv::System::Init();
   
-  if(argc != 3) {
-    LOGERROR << "USAGE: " << argv[0] << " <input (uncompressed) tensor stream> <output (compressed) tensor stream>";
+  if(argc != 3 && argc != 4) {
+    LOGERROR << "USAGE: " << argv[0] << " <input tensor stream> <output (compressed) tensor stream> [block|rle|byte]";
+    LOGEND;
+    return -1;
   }
   
   std::string input_file_name(argv[1]);
   std::string output_file_name(argv[2]);
+  std::string codec_name = argc > 3 ? argv[3] : "block";
+
+  // Version 2 is the default, rle writes version 1 streams for old builds
+  // and byte writes a ByteTensorStream
+  Conv::CompressionCodec output_codec = Conv::CODEC_BLOCK;
+  bool output_bytes = false;
+  if(codec_name.compare("block") == 0)
+    output_codec = Conv::CODEC_BLOCK;
+  else if(codec_name.compare("rle") == 0)
+    output_codec = Conv::CODEC_RLE;
+  else if(codec_name.compare("byte") == 0)
+    output_bytes = true;
+  else
+    FATAL("Unknown codec: " << codec_name);
   
   std::ifstream input_tensor_stream(input_file_name, std::ios::in | std::ios::binary);
   std::ofstream output_tensor_stream(output_file_name, std::ios::out | std::ios::binary);
@@ -33,24 +49,57 @@ int main(int argc, char** argv) {
   long compressed_total = 0;
   
   Conv::Tensor tensor;
+
+  // Compressed streams of either version are converted, too
+  uint64_t input_magic = 0;
+  input_tensor_stream.read((char*)&input_magic, sizeof(uint64_t)/sizeof(char));
+  bool input_compressed = true;
+  Conv::CompressionCodec input_codec = Conv::CODEC_RLE;
+  if(input_magic == CN24_CTS2_MAGIC) {
+    input_codec = Conv::CODEC_BLOCK;
+  } else if(input_magic == CN24_BTS_MAGIC) {
+    FATAL("Cannot convert byte tensor streams");
+  } else if(input_magic != CN24_CTS_MAGIC) {
+    input_compressed = false;
+    input_tensor_stream.seekg(0, std::ios::beg);
+  }
   
-  uint64_t magic = CN24_CTS_MAGIC;
+  uint64_t magic = output_bytes ? CN24_BTS_MAGIC :
+    (output_codec == Conv::CODEC_BLOCK ? CN24_CTS2_MAGIC : CN24_CTS_MAGIC);
   output_tensor_stream.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
   
   while(!input_tensor_stream.eof()) {
-    tensor.Deserialize(input_tensor_stream);
+    if(input_compressed) {
+      Conv::CompressedTensor input_ctensor;
+      input_ctensor.Deserialize(input_tensor_stream, false, false, 0, input_codec);
+      if(input_ctensor.elements() == 0)
+        break;
+      input_ctensor.Decompress(tensor);
+    } else {
+      tensor.Deserialize(input_tensor_stream);
+    }
     
     LOGDEBUG << "Input tensor: " << tensor;
     
     unsigned int original_size = tensor.elements() * sizeof(Conv::datum)/sizeof(char);
     LOGDEBUG << "Size: " << original_size;
+
+    if(output_bytes) {
+      if(!Conv::ByteTensorStream::Serialize(output_tensor_stream, tensor)) {
+        LOGWARN << "Tensor is not 8 bit, quantized to its range: " << tensor;
+      }
+      compressed_total += tensor.elements();
+      uncompressed_total += original_size;
+      input_tensor_stream.peek();
+      continue;
+    }
     
     Conv::CompressedTensor ctensor;
-    ctensor.Compress(tensor);
+    ctensor.Compress(tensor, output_codec);
     
     ctensor.Serialize(output_tensor_stream);
     
-    LOGDEBUG << "RLE Size: " << ctensor.compressed_length();
+    LOGDEBUG << "Compressed size: " << ctensor.compressed_length();
     
     ctensor.Decompress(tensor);
     unsigned int bytes_out = tensor.elements() * sizeof(Conv::datum)/sizeof(char);
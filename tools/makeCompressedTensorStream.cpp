@@ -85,7 +85,7 @@ int main ( int argc, char** argv ) {
   }
   
   
-  uint64_t magic = CN24_CTS_MAGIC;
+  uint64_t magic = CN24_CTS2_MAGIC;
   output_file.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
 
   // Iterate through lists of images and labels
@@ -184,8 +184,8 @@ int main ( int argc, char** argv ) {
 
     Conv::CompressedTensor compressed_image_tensor;
     Conv::CompressedTensor compressed_label_tensor;
-    compressed_image_tensor.Compress(image_tensor);
-    compressed_label_tensor.Compress(label_tensor);
+    compressed_image_tensor.Compress(image_tensor, Conv::CODEC_BLOCK);
+    compressed_label_tensor.Compress(label_tensor, Conv::CODEC_BLOCK);
     
     compressed_image_tensor.Serialize ( output_file );
     compressed_label_tensor.Serialize ( output_file );
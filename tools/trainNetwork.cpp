@@ -20,6 +20,11 @@
 #include <ctime>
 #include <cstring>
 
+#ifdef BUILD_POSIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include <cn24.h>
 #include <private/ConfigParsing.h>
 
@@ -27,6 +32,9 @@ void addStatLayers(Conv::NetGraph& graph, Conv::NetGraphNode* input_node, Conv::
 bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::Trainer& trainer, Conv::Trainer& testing_trainer, bool hybrid, std::string& command);
 void help();
 
+// Rank of this process in distributed training, only rank 0 saves and tests
+unsigned int process_rank = 0;
+
 int main (int argc, char* argv[]) {
   bool GRADIENT_CHECK = false;
   bool FROM_SCRIPT = false;
@@ -67,12 +75,6 @@ int main (int argc, char* argv[]) {
 
   Conv::System::Init(requested_log_level);
   
-  // Register stat sinks
-  Conv::ConsoleStatSink console_stat_sink;
-  Conv::CSVStatSink csv_stat_sink;
-  Conv::System::stat_aggregator->RegisterSink(&console_stat_sink);
-  Conv::System::stat_aggregator->RegisterSink(&csv_stat_sink);
-  
   Conv::Factory* factory;
   
   // Open network and dataset configuration files
@@ -96,6 +98,43 @@ int main (int argc, char* argv[]) {
   dataset_config_fname = dataset_config_fname.substr (net_config_fname.rfind ("/") + 1);
 
   factory->InitOptimalSettings();
+
+  // Start the other processes for distributed training, they run the same script
+  unsigned int processes = GRADIENT_CHECK ? 1 : factory->optimal_settings().processes;
+  if (processes > 1 && !FROM_SCRIPT) {
+    // Interactive commands would only reach one of the processes
+    LOGWARN << "Distributed training needs a script file, using one process";
+    processes = 1;
+  }
+  std::stringstream transport_name;
+#ifdef BUILD_POSIX
+  std::vector<pid_t> children;
+  transport_name << "cn24-" << getpid();
+  for (unsigned int r = 1; r < processes; r++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      FATAL ("Cannot start process for rank " << r);
+    } else if (pid == 0) {
+      process_rank = r;
+      children.clear();
+      break;
+    }
+    children.push_back (pid);
+  }
+#else
+  if (processes > 1) {
+    LOGWARN << "Distributed training needs a POSIX system, using one process";
+    processes = 1;
+  }
+#endif
+
+  // Register stat sinks
+  Conv::ConsoleStatSink console_stat_sink;
+  Conv::CSVStatSink csv_stat_sink;
+  if (process_rank == 0) {
+    Conv::System::stat_aggregator->RegisterSink(&console_stat_sink);
+    Conv::System::stat_aggregator->RegisterSink(&csv_stat_sink);
+  }
   
   // Extract important settings from parsed configuration
   const bool patchwise_training = (factory->method() == Conv::PATCH);
@@ -180,6 +219,38 @@ int main (int argc, char* argv[]) {
   } else {
     Conv::Trainer trainer (graph, settings);
 
+    // Assemble replicas for data-parallel training, they draw their own samples
+    std::vector<Conv::NetGraph*> replica_graphs;
+    for (unsigned int r = 1; r < settings.replicas; r++) {
+      Conv::NetGraph* replica_graph = new Conv::NetGraph();
+      Conv::DatasetInputLayer* rdata_layer = new Conv::DatasetInputLayer (*dataset, BATCHSIZE, patchwise_training ? 1.0 : loss_sampling_p, 983923 + r);
+      Conv::NetGraphNode* rinput_node = new Conv::NetGraphNode(rdata_layer);
+      rinput_node->is_input = true;
+      replica_graph->AddNode(rinput_node);
+
+      if(!factory->AddLayers(*replica_graph, Conv::NetGraphConnection(rinput_node), CLASSES, true))
+        FATAL("Graph completeness test failed for replica " << r << "!");
+
+      replica_graph->Initialize();
+      trainer.AddReplica(*replica_graph);
+      replica_graphs.push_back(replica_graph);
+    }
+
+    // Connect to the other processes, each one trains on its own part of the samples
+    if (processes > 1) {
+      Conv::Transport* transport = Conv::Transport::Create (settings.transport, transport_name.str(),
+        settings.transport_port, process_rank, processes);
+      data_layer->SetShard (process_rank, processes);
+      for (Conv::NetGraph* replica_graph : replica_graphs)
+        dynamic_cast<Conv::DatasetInputLayer*>(replica_graph->GetTrainingNodes()[0]->layer)->SetShard (process_rank, processes);
+      trainer.SetTransport (*transport);
+    }
+
+    // Load the next batches while the nets work on the current ones
+    data_layer->SetPrefetching (settings.prefetch, settings.loaders);
+    for (Conv::NetGraph* replica_graph : replica_graphs)
+      dynamic_cast<Conv::DatasetInputLayer*>(replica_graph->GetTrainingNodes()[0]->layer)->SetPrefetching (settings.prefetch, settings.loaders);
+
     Conv::NetGraph* testing_graph;
     Conv::Trainer* testing_trainer;
 
@@ -265,6 +336,15 @@ int main (int argc, char* argv[]) {
     }
   }
 
+#ifdef BUILD_POSIX
+  for (pid_t child : children) {
+    int status = 0;
+    waitpid (child, &status, 0);
+    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+      LOGERROR << "Process " << child << " failed";
+  }
+#endif
+
   LOGINFO << "DONE!";
   LOGEND;
   return 0;
@@ -312,6 +392,8 @@ bool parseCommand (Conv::NetGraph& graph, Conv::NetGraph& testing_graph, Conv::T
     if(no_snapshots == 1)
       Conv::System::stat_aggregator->Generate();
     Conv::System::stat_aggregator->Reset();
+  } else if (process_rank != 0 && (command.compare (0, 4, "test") == 0 || command.compare (0, 4, "save") == 0)) {
+    // The parameters are the same in all processes, rank 0 tests and saves them
   } else if (command.compare (0, 4, "test") == 0) {
     Conv::System::stat_aggregator->StartRecording();
     